@@ -0,0 +1,457 @@
+/**
+ * Benchmark suite for the Hyperedge Inclusion Forest
+ *
+ * Links against the real library (hif.o).  Every workload is generated
+ * (or loaded) once, then each operation runs `warmup` untimed passes and
+ * `reps` timed passes.  Individual operations are timed with a monotonic
+ * clock, and the report gives p50 / p99 / mean latency, throughput and
+ * the process peak RSS so far.
+ *
+ * Usage:
+ *   bench_suite [--format text|json|csv] [--n N] [--reps R] [--warmup W]
+ *               [--seed S] [--only WORKLOAD] [--dataset FILE]...
+ *
+ * Dataset files hold one hyperedge per line: a weight followed by its
+ * vertex IDs ("3.5 1 7 42").  Blank lines and lines starting with '#'
+ * are skipped.
+ *
+ * With the library built with -DHIF_SIG_STATS, each query row is followed
+ * by its signature-filter checks and rejections on stderr.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hif.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// ========== EDGE SETS ==========
+
+typedef struct {
+    char       name[64];
+    Hyperedge *edges;
+    int        n, cap;
+} EdgeSet;
+
+static void edges_add(EdgeSet *s, const hif_vertex_t *verts, int nverts,
+                      double weight) {
+    if (s->n >= s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->edges = realloc(s->edges, sizeof(Hyperedge) * s->cap);
+        if (!s->edges) { perror("realloc"); exit(1); }
+    }
+    hif_vertex_t *copy = malloc(sizeof(hif_vertex_t) * nverts);
+    if (!copy) { perror("malloc"); exit(1); }
+    memcpy(copy, verts, sizeof(hif_vertex_t) * nverts);
+    s->edges[s->n++] = (Hyperedge){ copy, nverts, weight };
+}
+
+static void edges_free(EdgeSet *s) {
+    for (int i = 0; i < s->n; i++) free(s->edges[i].verts);
+    free(s->edges);
+}
+
+// ========== GENERATORS ==========
+
+// Zipf weights over random small sets (social networks, citations, web)
+static void gen_power_law(EdgeSet *s, int n, double alpha) {
+    snprintf(s->name, sizeof(s->name), "power_law_a%.1f", alpha);
+    int universe = n / 2 > 16 ? n / 2 : 16;
+    for (int i = 0; i < n; i++) {
+        hif_vertex_t verts[8];
+        int size = 2 + rand() % 5;
+        for (int j = 0; j < size; j++) verts[j] = rand() % universe;
+        edges_add(s, verts, size, 100.0 / pow(i + 1, alpha));
+    }
+}
+
+// Uniform weights: worst case, no natural ordering
+static void gen_uniform(EdgeSet *s, int n) {
+    snprintf(s->name, sizeof(s->name), "uniform");
+    int universe = n / 2 > 16 ? n / 2 : 16;
+    for (int i = 0; i < n; i++) {
+        hif_vertex_t verts[8];
+        int size = 2 + rand() % 5;
+        for (int j = 0; j < size; j++) verts[j] = rand() % universe;
+        edges_add(s, verts, size, (double)rand() / RAND_MAX * 10.0);
+    }
+}
+
+// {0} ⊂ {0,1} ⊂ ... ⊂ {0..len-1}, repeated with shifted bases
+static void gen_chain(EdgeSet *s, int n, int len) {
+    snprintf(s->name, sizeof(s->name), "chain_l%d", len);
+    hif_vertex_t *verts = malloc(sizeof(hif_vertex_t) * len);
+    if (!verts) { perror("malloc"); exit(1); }
+    for (int base = 0; s->n < n; base += len)
+        for (int i = 1; i <= len && s->n < n; i++) {
+            for (int j = 0; j < i; j++) verts[j] = base + j;
+            edges_add(s, verts, i, (double)i);
+        }
+    free(verts);
+}
+
+// Disjoint blocks, each level unions pairs from the level below
+static void gen_pyramid(EdgeSet *s, int n) {
+    snprintf(s->name, sizeof(s->name), "pyramid");
+    int base = 1;
+    while (4 * base - 1 <= n) base *= 2;  // 2·base - 1 <= n edges in all
+    hif_vertex_t *verts = malloc(sizeof(hif_vertex_t) * base);
+    if (!verts) { perror("malloc"); exit(1); }
+    for (int level = 0; (1 << level) <= base; level++) {
+        int size = 1 << level;
+        for (int b = 0; b < base / size; b++) {
+            for (int v = 0; v < size; v++) verts[v] = b * size + v;
+            edges_add(s, verts, size, (double)level);
+        }
+    }
+    free(verts);
+}
+
+// Shared center, branches growing one private vertex per level
+static void gen_star(EdgeSet *s, int n, int center, int depth) {
+    snprintf(s->name, sizeof(s->name), "star_c%d_d%d", center, depth);
+    hif_vertex_t *verts = malloc(sizeof(hif_vertex_t) * (center + depth));
+    if (!verts) { perror("malloc"); exit(1); }
+    for (int i = 0; i < center; i++) verts[i] = i;
+    edges_add(s, verts, center, 1.0);
+    for (int next = center; s->n < n; next += depth)
+        for (int d = 1; d <= depth && s->n < n; d++) {
+            verts[center + d - 1] = next + d - 1;
+            edges_add(s, verts, center + d, (double)d);
+        }
+    free(verts);
+}
+
+// One edge per line: "<weight> <v1> <v2> ..."
+static int load_dataset(EdgeSet *s, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) { perror(path); return -1; }
+    const char *slash = strrchr(path, '/');
+    snprintf(s->name, sizeof(s->name), "file:%s", slash ? slash + 1 : path);
+
+    char line[1 << 16];
+    hif_vertex_t *verts = NULL;
+    int cap = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line, *end;
+        double w = strtod(p, &end);
+        if (end == p || line[0] == '#') continue;
+        int nv = 0;
+        for (p = end;; p = end) {
+            long long v = strtoll(p, &end, 10);
+            if (end == p) break;
+            if (nv >= cap) {
+                cap = cap ? cap * 2 : 64;
+                verts = realloc(verts, sizeof(hif_vertex_t) * cap);
+                if (!verts) { perror("realloc"); exit(1); }
+            }
+            verts[nv++] = (hif_vertex_t)v;
+        }
+        if (nv > 0) edges_add(s, verts, nv, w);
+    }
+    free(verts);
+    fclose(fp);
+    return 0;
+}
+
+// ========== MEASUREMENT ==========
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;  // kilobytes on Linux
+}
+
+typedef enum { OUT_TEXT, OUT_JSON, OUT_CSV } OutFormat;
+
+typedef struct {
+    OutFormat format;
+    int       n, reps, warmup;
+    unsigned  seed;
+    const char *only;
+    int       nresults;   // rows printed so far (JSON separators)
+} Config;
+
+// Per-operation latency samples for one (workload, op) pair
+typedef struct {
+    double *us;
+    int     n, cap;
+    double  total_us;     // wall time of the timed passes
+} Samples;
+
+static void sample_add(Samples *s, double us) {
+    if (s->n >= s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 4096;
+        s->us = realloc(s->us, sizeof(double) * s->cap);
+        if (!s->us) { perror("realloc"); exit(1); }
+    }
+    s->us[s->n++] = us;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const Samples *s, double p) {
+    if (s->n == 0) return 0.0;
+    int idx = (int)ceil(p / 100.0 * s->n) - 1;
+    if (idx < 0) idx = 0;
+    return s->us[idx];
+}
+
+static void report(Config *cfg, const char *workload, const char *op,
+                   int nedges, Samples *s) {
+    qsort(s->us, s->n, sizeof(double), cmp_double);
+    double mean = s->n ? s->total_us / s->n : 0.0;
+    double tput = s->total_us > 0 ? s->n / (s->total_us / 1e6) : 0.0;
+    double p50 = percentile(s, 50), p99 = percentile(s, 99);
+    long   rss = peak_rss_kb();
+
+    switch (cfg->format) {
+    case OUT_TEXT:
+        printf("%-22s %-18s %8d %9d %11.2f %11.2f %11.2f %13.0f %10ld\n",
+               workload, op, nedges, s->n, p50, p99, mean, tput, rss);
+        break;
+    case OUT_CSV:
+        printf("%s,%s,%d,%d,%.3f,%.3f,%.3f,%.1f,%ld\n",
+               workload, op, nedges, s->n, p50, p99, mean, tput, rss);
+        break;
+    case OUT_JSON:
+        printf("%s\n  {\"workload\": \"%s\", \"op\": \"%s\", \"edges\": %d, "
+               "\"ops\": %d, \"p50_us\": %.3f, \"p99_us\": %.3f, "
+               "\"mean_us\": %.3f, \"throughput_ops_s\": %.1f, "
+               "\"peak_rss_kb\": %ld}",
+               cfg->nresults ? "," : "", workload, op, nedges, s->n, p50, p99,
+               mean, tput, rss);
+        break;
+    }
+    cfg->nresults++;
+    free(s->us);
+    *s = (Samples){ 0 };
+}
+
+static void print_header(const Config *cfg) {
+    switch (cfg->format) {
+    case OUT_TEXT:
+        printf("%-22s %-18s %8s %9s %11s %11s %11s %13s %10s\n", "Workload",
+               "Operation", "Edges", "Ops", "p50 (µs)", "p99 (µs)", "mean (µs)",
+               "ops/s", "RSS (KB)");
+        printf("──────────────────────────────────────────────────────────────"
+               "──────────────────────────────────────────────────────────\n");
+        break;
+    case OUT_CSV:
+        printf("workload,op,edges,ops,p50_us,p99_us,mean_us,throughput_ops_s,"
+               "peak_rss_kb\n");
+        break;
+    case OUT_JSON:
+        printf("[");
+        break;
+    }
+}
+
+// ========== OPERATIONS ==========
+
+// Vertex pair drawn from an existing edge, so queries have answers
+static int pick_query(const EdgeSet *s, hif_vertex_t *q) {
+    const Hyperedge *e = &s->edges[rand() % s->n];
+    q[0] = e->verts[0];
+    q[1] = e->verts[e->nverts - 1];
+    return q[0] == q[1] ? 1 : 2;
+}
+
+static void bench_insert(Config *cfg, const EdgeSet *s) {
+    Samples smp = { 0 };
+    for (int r = 0; r < cfg->warmup + cfg->reps; r++) {
+        Forest *f = forest_create();
+        int timed = r >= cfg->warmup;
+        double t0 = now_us();
+        for (int i = 0; i < s->n; i++) {
+            double a = now_us();
+            insert_hyperedge(f, s->edges[i].verts, s->edges[i].nverts,
+                             s->edges[i].weight);
+            if (timed) sample_add(&smp, now_us() - a);
+        }
+        if (timed) smp.total_us += now_us() - t0;
+        forest_free(f);
+    }
+    report(cfg, s->name, "insert", s->n, &smp);
+}
+
+static void bench_ingest(Config *cfg, const EdgeSet *s) {
+    Samples smp = { 0 };
+    for (int r = 0; r < cfg->warmup + cfg->reps; r++) {
+        Forest *f = forest_create();
+        IngestBuffer *b = forest_ingest_create(f, 0, 0.0, 0);
+        int timed = r >= cfg->warmup;
+        double t0 = now_us();
+        for (int i = 0; i < s->n; i++) {
+            double a = now_us();
+            forest_ingest_push(b, s->edges[i].verts, s->edges[i].nverts,
+                               s->edges[i].weight);
+            if (timed) sample_add(&smp, now_us() - a);
+        }
+        forest_ingest_destroy(b);  // final flush counts toward throughput
+        if (timed) smp.total_us += now_us() - t0;
+        forest_free(f);
+    }
+    report(cfg, s->name, "ingest_push", s->n, &smp);
+}
+
+static void bench_bulk(Config *cfg, const EdgeSet *s) {
+    Samples smp = { 0 };
+    for (int r = 0; r < cfg->warmup + cfg->reps; r++) {
+        double a = now_us();
+        Forest *f = forest_build_bulk(s->edges, s->n);
+        double us = now_us() - a;
+        if (r >= cfg->warmup) { sample_add(&smp, us); smp.total_us += us; }
+        forest_free(f);
+    }
+    report(cfg, s->name, "build_bulk", s->n, &smp);
+}
+
+typedef enum {
+    Q_TOP_K, Q_THRESHOLD, Q_SUPERSETS, Q_SUBSETS, Q_SIMILAR, Q_CONTAINING,
+    Q_CLUSTERS
+} QueryKind;
+
+static const char *query_names[] = {
+    "top_k_100", "weight_threshold", "find_all_supersets",
+    "find_all_subsets", "k_most_similar_10", "find_containing",
+    "clusters_by_weight"
+};
+
+static int run_query(Forest *f, const EdgeSet *s, QueryKind kind,
+                     double median_w) {
+    hif_vertex_t q[2];
+    int nq = pick_query(s, q), count = 0;
+    switch (kind) {
+    case Q_TOP_K:      free(find_top_k(f, 100, &count)); break;
+    case Q_THRESHOLD:  count = find_by_weight_threshold(f, median_w); break;
+    case Q_SUPERSETS:  free(find_all_supersets(f, q, nq, &count)); break;
+    case Q_SUBSETS: {
+        const Hyperedge *e = &s->edges[rand() % s->n];
+        free(find_all_subsets(f, e->verts, e->nverts, &count));
+        break;
+    }
+    case Q_SIMILAR:    free(find_k_most_similar(f, q, nq, 10, &count)); break;
+    case Q_CONTAINING: free(find_containing_vertices(f, q, nq, &count)); break;
+    case Q_CLUSTERS:   free(get_clusters_by_weight(f, median_w, &count)); break;
+    }
+    return count;
+}
+
+static void bench_queries(Config *cfg, const EdgeSet *s) {
+    Forest *f = forest_build_bulk(s->edges, s->n);
+    forest_enable_vertex_index(f);
+
+    double *w = malloc(sizeof(double) * s->n);
+    if (!w) { perror("malloc"); exit(1); }
+    for (int i = 0; i < s->n; i++) w[i] = s->edges[i].weight;
+    qsort(w, s->n, sizeof(double), cmp_double);
+    double median_w = w[s->n / 2];
+    free(w);
+
+    const int per_rep = 200;
+    volatile int sink = 0;
+    for (int kind = Q_TOP_K; kind <= Q_CLUSTERS; kind++) {
+        Samples smp = { 0 };
+        unsigned long long checks, rejects;
+        for (int i = 0; i < cfg->warmup * per_rep; i++)
+            sink += run_query(f, s, kind, median_w);
+        hif_signature_stats(NULL, NULL, 1);
+        for (int r = 0; r < cfg->reps; r++) {
+            double t0 = now_us();
+            for (int i = 0; i < per_rep; i++) {
+                double a = now_us();
+                sink += run_query(f, s, kind, median_w);
+                sample_add(&smp, now_us() - a);
+            }
+            smp.total_us += now_us() - t0;
+        }
+        report(cfg, s->name, query_names[kind], s->n, &smp);
+        hif_signature_stats(&checks, &rejects, 1);
+        if (checks > 0)
+            fprintf(stderr, "%s %s: signature rejected %llu of %llu (%.1f%%)\n",
+                    s->name, query_names[kind], rejects, checks,
+                    100.0 * rejects / checks);
+    }
+    (void)sink;
+    forest_free(f);
+}
+
+static void bench_workload(Config *cfg, EdgeSet *s) {
+    if (s->n > 0 && (!cfg->only || strstr(s->name, cfg->only))) {
+        bench_insert(cfg, s);
+        bench_ingest(cfg, s);
+        bench_bulk(cfg, s);
+        bench_queries(cfg, s);
+    }
+    edges_free(s);
+}
+
+// ========== MAIN ==========
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--format text|json|csv] [--n N] [--reps R] "
+            "[--warmup W] [--seed S] [--only WORKLOAD] [--dataset FILE]...\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    Config cfg = { OUT_TEXT, 10000, 5, 1, 42, NULL, 0 };
+    const char **datasets = malloc(sizeof(char*) * (argc + 1));
+    int ndatasets = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) usage(argv[0]);
+        const char *val = argv[++i];
+        if      (!strcmp(arg, "--n"))       cfg.n      = atoi(val);
+        else if (!strcmp(arg, "--reps"))    cfg.reps   = atoi(val);
+        else if (!strcmp(arg, "--warmup"))  cfg.warmup = atoi(val);
+        else if (!strcmp(arg, "--seed"))    cfg.seed   = (unsigned)atoi(val);
+        else if (!strcmp(arg, "--only"))    cfg.only   = val;
+        else if (!strcmp(arg, "--dataset")) datasets[ndatasets++] = val;
+        else if (!strcmp(arg, "--format")) {
+            if      (!strcmp(val, "text")) cfg.format = OUT_TEXT;
+            else if (!strcmp(val, "json")) cfg.format = OUT_JSON;
+            else if (!strcmp(val, "csv"))  cfg.format = OUT_CSV;
+            else usage(argv[0]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (cfg.n < 16 || cfg.reps < 1 || cfg.warmup < 0) usage(argv[0]);
+
+    print_header(&cfg);
+
+    // Each generator reseeds so workloads do not depend on run order
+    EdgeSet s;
+    s = (EdgeSet){ 0 }; srand(cfg.seed); gen_power_law(&s, cfg.n, 1.5);  bench_workload(&cfg, &s);
+    s = (EdgeSet){ 0 }; srand(cfg.seed); gen_uniform(&s, cfg.n);         bench_workload(&cfg, &s);
+    s = (EdgeSet){ 0 }; srand(cfg.seed); gen_chain(&s, cfg.n, 64);       bench_workload(&cfg, &s);
+    s = (EdgeSet){ 0 }; srand(cfg.seed); gen_pyramid(&s, cfg.n);         bench_workload(&cfg, &s);
+    s = (EdgeSet){ 0 }; srand(cfg.seed); gen_star(&s, cfg.n, 8, 16);     bench_workload(&cfg, &s);
+    for (int d = 0; d < ndatasets; d++) {
+        s = (EdgeSet){ 0 };
+        srand(cfg.seed);
+        if (load_dataset(&s, datasets[d]) == 0) bench_workload(&cfg, &s);
+    }
+
+    if (cfg.format == OUT_JSON) printf("\n]\n");
+    free(datasets);
+    return 0;
+}
@@ -1,436 +0,0 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-#include <sys/time.h>
-
-typedef struct {
-    int *verts;
-    int nverts;
-    double weight;
-} Hyperedge;
-
-typedef struct Node {
-    Hyperedge he;
-    struct Node **children;
-    int nchildren;
-    int children_cap;
-} Node;
-
-typedef struct {
-    Node **roots;
-    int nroots;
-    int roots_cap;
-} Forest;
-
-// Minimal implementation
-static int *copy_int_array(const int *a, int n) {
-    int *r = malloc(sizeof(int) * n);
-    memcpy(r, a, sizeof(int) * n);
-    return r;
-}
-
-static int is_subset(const int *A, int nA, const int *B, int nB) {
-    int i = 0, j = 0;
-    while (i < nA && j < nB) {
-        if (A[i] == B[j]) { i++; j++; }
-        else if (A[i] > B[j]) { j++; }
-        else { return 0; }
-    }
-    return (i == nA);
-}
-
-static int subset_cmp(const Hyperedge *A, const Hyperedge *B) {
-    int A_in_B = is_subset(A->verts, A->nverts, B->verts, B->nverts);
-    int B_in_A = is_subset(B->verts, B->nverts, A->verts, A->nverts);
-    if (A_in_B && !B_in_A) return 1;
-    if (B_in_A && !A_in_B) return -1;
-    return 0;
-}
-
-static Node *node_create(const int *verts, int nverts, double weight) {
-    Node *nd = malloc(sizeof(Node));
-    nd->he.verts = copy_int_array(verts, nverts);
-    nd->he.nverts = nverts;
-    nd->he.weight = weight;
-    nd->children = NULL;
-    nd->nchildren = 0;
-    nd->children_cap = 0;
-    return nd;
-}
-
-static void node_free(Node *nd) {
-    if (!nd) return;
-    for (int i = 0; i < nd->nchildren; ++i) node_free(nd->children[i]);
-    free(nd->children);
-    free(nd->he.verts);
-    free(nd);
-}
-
-static void node_add_child(Node *parent, Node *child) {
-    if (parent->nchildren >= parent->children_cap) {
-        int newcap = parent->children_cap ? parent->children_cap * 2 : 4;
-        parent->children = realloc(parent->children, sizeof(Node*) * newcap);
-        parent->children_cap = newcap;
-    }
-    parent->children[parent->nchildren++] = child;
-}
-
-static Forest *forest_create() {
-    Forest *f = malloc(sizeof(Forest));
-    f->roots = NULL;
-    f->nroots = 0;
-    f->roots_cap = 0;
-    return f;
-}
-
-static void forest_free(Forest *f) {
-    if (!f) return;
-    for (int i = 0; i < f->nroots; ++i) node_free(f->roots[i]);
-    free(f->roots);
-    free(f);
-}
-
-static void forest_add_root(Forest *f, Node *r) {
-    if (f->nroots >= f->roots_cap) {
-        int newcap = f->roots_cap ? f->roots_cap * 2 : 8;
-        f->roots = realloc(f->roots, sizeof(Node*) * newcap);
-        f->roots_cap = newcap;
-    }
-    f->roots[f->nroots++] = r;
-}
-
-static void forest_remove_root_at(Forest *f, int idx) {
-    for (int i = idx; i + 1 < f->nroots; ++i) f->roots[i] = f->roots[i+1];
-    f->nroots--;
-}
-
-static int insert_into_node(Node *root, Node *newn) {
-    int cmp = subset_cmp(&root->he, &newn->he);
-    if (cmp == 1) {
-        return 1;
-    } else if (cmp == -1) {
-        int i = 0;
-        while (i < root->nchildren) {
-            int res = insert_into_node(root->children[i], newn);
-            if (res == 1) {
-                Node *child = root->children[i];
-                for (int j = i; j + 1 < root->nchildren; ++j) 
-                    root->children[j] = root->children[j+1];
-                root->nchildren--;
-                node_add_child(newn, child);
-            } else if (res == -1) {
-                return -1;
-            } else {
-                i++;
-            }
-        }
-        node_add_child(root, newn);
-        return -1;
-    } else {
-        return 0;
-    }
-}
-
-static void forest_insert(Forest *f, Node *newn) {
-    int i = 0;
-    int inserted = 0;
-    
-    while (i < f->nroots) {
-        Node *r = f->roots[i];
-        int cmp = subset_cmp(&r->he, &newn->he);
-        if (cmp == 1) {
-            node_add_child(newn, r);
-            forest_remove_root_at(f, i);
-        } else if (cmp == -1) {
-            int res = insert_into_node(r, newn);
-            if (res == 1) {
-                node_add_child(newn, r);
-                forest_remove_root_at(f, i);
-            } else {
-                inserted = 1;
-                return;
-            }
-        } else {
-            i++;
-        }
-    }
-
-    if (!inserted) {
-        forest_add_root(f, newn);
-    }
-}
-
-static int cmp_int(const void *a, const void *b) {
-    return (*(int*)a - *(int*)b);
-}
-
-static int *normalize_vertices(const int *in, int n_in, int *n_out) {
-    if (n_in == 0) { *n_out = 0; return NULL; }
-    int *a = malloc(sizeof(int) * n_in);
-    memcpy(a, in, sizeof(int) * n_in);
-    qsort(a, n_in, sizeof(int), cmp_int);
-    int w = 1;
-    for (int i = 1; i < n_in; ++i) if (a[i] != a[w-1]) a[w++] = a[i];
-    a = realloc(a, sizeof(int) * w);
-    *n_out = w;
-    return a;
-}
-
-static void insert_hyperedge(Forest *f, const int *verts, int nverts, double weight) {
-    int n_norm;
-    int *norm = normalize_vertices(verts, nverts, &n_norm);
-    Node *nd = node_create(norm, n_norm, weight);
-    free(norm);
-    forest_insert(f, nd);
-}
-
-static int count_nodes_recursive(Node *nd) {
-    int count = 1;
-    for (int i = 0; i < nd->nchildren; ++i) {
-        count += count_nodes_recursive(nd->children[i]);
-    }
-    return count;
-}
-
-static int count_total_nodes(Forest *f) {
-    int total = 0;
-    for (int i = 0; i < f->nroots; ++i) {
-        total += count_nodes_recursive(f->roots[i]);
-    }
-    return total;
-}
-
-static int max_depth_recursive(Node *nd) {
-    int max_child = 0;
-    for (int i = 0; i < nd->nchildren; ++i) {
-        int d = max_depth_recursive(nd->children[i]);
-        if (d > max_child) max_child = d;
-    }
-    return 1 + max_child;
-}
-
-static int forest_max_depth(Forest *f) {
-    int max = 0;
-    for (int i = 0; i < f->nroots; ++i) {
-        int d = max_depth_recursive(f->roots[i]);
-        if (d > max) max = d;
-    }
-    return max;
-}
-
-static double get_time() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
-
-// Generate nested hypergraph patterns
-void generate_power_set_pattern(Forest *f, int n) {
-    // Generate all subsets of {0..n-1}
-    int total = (1 << n);
-    for (int mask = 1; mask < total; ++mask) {
-        int size = __builtin_popcount(mask);
-        int *verts = malloc(sizeof(int) * size);
-        int idx = 0;
-        for (int i = 0; i < n; ++i) {
-            if (mask & (1 << i)) {
-                verts[idx++] = i;
-            }
-        }
-        insert_hyperedge(f, verts, size, (double)size);
-        free(verts);
-    }
-}
-
-void generate_chain_pattern(Forest *f, int n) {
-    // Generate nested chain: {0} ⊂ {0,1} ⊂ {0,1,2} ⊂ ...
-    for (int i = 1; i <= n; ++i) {
-        int *verts = malloc(sizeof(int) * i);
-        for (int j = 0; j < i; ++j) verts[j] = j;
-        insert_hyperedge(f, verts, i, (double)i);
-        free(verts);
-    }
-}
-
-void generate_pyramid_pattern(Forest *f, int base_size, int levels) {
-    // Bottom level: many small disjoint sets
-    // Each level up: sets that union pairs from below
-    
-    for (int level = 0; level < levels; ++level) {
-        int sets_this_level = base_size / (1 << level);
-        int size_per_set = (1 << level);
-        
-        for (int s = 0; s < sets_this_level; ++s) {
-            int *verts = malloc(sizeof(int) * size_per_set);
-            for (int v = 0; v < size_per_set; ++v) {
-                verts[v] = (s * size_per_set) + v;
-            }
-            insert_hyperedge(f, verts, size_per_set, (double)level);
-            free(verts);
-        }
-    }
-}
-
-void generate_clique_expansion(Forest *f, int start_size, int expansions) {
-    // Start with clique, gradually add vertices
-    for (int i = 1; i <= expansions; ++i) {
-        int size = start_size + i - 1;
-        int *verts = malloc(sizeof(int) * size);
-        for (int j = 0; j < size; ++j) verts[j] = j;
-        insert_hyperedge(f, verts, size, (double)i);
-        free(verts);
-    }
-}
-
-void generate_star_pattern(Forest *f, int center_size, int branches, int branch_depth) {
-    // Center hyperedge
-    int *center = malloc(sizeof(int) * center_size);
-    for (int i = 0; i < center_size; ++i) center[i] = i;
-    insert_hyperedge(f, center, center_size, 1.0);
-    free(center);
-    
-    // Branches expanding from center
-    int next_vertex = center_size;
-    for (int b = 0; b < branches; ++b) {
-        for (int d = 1; d <= branch_depth; ++d) {
-            int size = center_size + d;
-            int *verts = malloc(sizeof(int) * size);
-            for (int i = 0; i < center_size; ++i) verts[i] = i;
-            for (int i = 0; i < d; ++i) verts[center_size + i] = next_vertex + i;
-            insert_hyperedge(f, verts, size, (double)d);
-            free(verts);
-        }
-        next_vertex += branch_depth;
-    }
-}
-
-// Benchmark nested structures
-void benchmark_nested_patterns() {
-    printf("\n╔══════════════════════════════════════════════════════════════╗\n");
-    printf("║          NESTED HYPERGRAPH STRUCTURE BENCHMARKS             ║\n");
-    printf("╚══════════════════════════════════════════════════════════════╝\n\n");
-    
-    printf("Testing performance on HIGHLY NESTED graph patterns...\n\n");
-    
-    // 1. Power set pattern
-    printf("═══ PATTERN 1: Power Set (Complete Subset Lattice) ═══\n");
-    printf("%-8s %-15s %-15s %-10s %-10s %-12s\n", "n", "Sets", "Time (ms)", "Depth", "Roots", "Compress %%");
-    printf("──────────────────────────────────────────────────────────────────\n");
-    
-    for (int n = 4; n <= 12; n += 2) {
-        Forest *f = forest_create();
-        double start = get_time();
-        generate_power_set_pattern(f, n);
-        double elapsed = (get_time() - start) * 1000;
-        
-        int total = count_total_nodes(f);
-        int expected = (1 << n) - 1;
-        double compress = 100.0 * total / expected;
-        
-        printf("%-8d %-15d %-15.2f %-10d %-10d %-12.1f\n", 
-               n, expected, elapsed, forest_max_depth(f), f->nroots, compress);
-        
-        forest_free(f);
-    }
-    
-    // 2. Chain pattern
-    printf("\n═══ PATTERN 2: Nested Chain ═══\n");
-    printf("%-8s %-15s %-15s %-10s\n", "n", "Time (ms)", "Depth", "Roots");
-    printf("──────────────────────────────────────────────────────────────────\n");
-    
-    int chain_sizes[] = {100, 500, 1000, 5000, 10000};
-    for (int i = 0; i < 5; ++i) {
-        int n = chain_sizes[i];
-        Forest *f = forest_create();
-        double start = get_time();
-        generate_chain_pattern(f, n);
-        double elapsed = (get_time() - start) * 1000;
-        
-        printf("%-8d %-15.2f %-10d %-10d\n", 
-               n, elapsed, forest_max_depth(f), f->nroots);
-        
-        forest_free(f);
-    }
-    
-    // 3. Pyramid pattern
-    printf("\n═══ PATTERN 3: Pyramid (Hierarchical Aggregation) ═══\n");
-    printf("%-10s %-10s %-15s %-15s %-10s %-10s\n", 
-           "Base", "Levels", "Total Sets", "Time (ms)", "Depth", "Roots");
-    printf("──────────────────────────────────────────────────────────────────\n");
-    
-    int pyramid_configs[][2] = {{64, 6}, {128, 7}, {256, 8}, {512, 9}};
-    for (int i = 0; i < 4; ++i) {
-        int base = pyramid_configs[i][0];
-        int levels = pyramid_configs[i][1];
-        
-        Forest *f = forest_create();
-        double start = get_time();
-        generate_pyramid_pattern(f, base, levels);
-        double elapsed = (get_time() - start) * 1000;
-        
-        printf("%-10d %-10d %-15d %-15.2f %-10d %-10d\n", 
-               base, levels, count_total_nodes(f), elapsed, 
-               forest_max_depth(f), f->nroots);
-        
-        forest_free(f);
-    }
-    
-    // 4. Clique expansion
-    printf("\n═══ PATTERN 4: Clique Expansion (Growing Dense Graphs) ═══\n");
-    printf("%-12s %-15s %-15s %-10s\n", "Expansions", "Total Sets", "Time (ms)", "Depth");
-    printf("──────────────────────────────────────────────────────────────────\n");
-    
-    int exp_sizes[] = {100, 500, 1000, 5000};
-    for (int i = 0; i < 4; ++i) {
-        int exp = exp_sizes[i];
-        
-        Forest *f = forest_create();
-        double start = get_time();
-        generate_clique_expansion(f, 3, exp);
-        double elapsed = (get_time() - start) * 1000;
-        
-        printf("%-12d %-15d %-15.2f %-10d\n", 
-               exp, count_total_nodes(f), elapsed, forest_max_depth(f));
-        
-        forest_free(f);
-    }
-    
-    // 5. Star pattern
-    printf("\n═══ PATTERN 5: Star (Center + Radiating Branches) ═══\n");
-    printf("%-10s %-10s %-12s %-15s %-15s %-10s\n", 
-           "Center", "Branches", "Depth", "Total Sets", "Time (ms)", "MaxDepth");
-    printf("──────────────────────────────────────────────────────────────────\n");
-    
-    int star_configs[][3] = {{5, 10, 10}, {10, 20, 8}, {5, 50, 5}, {3, 100, 3}};
-    for (int i = 0; i < 4; ++i) {
-        int center = star_configs[i][0];
-        int branches = star_configs[i][1];
-        int depth = star_configs[i][2];
-        
-        Forest *f = forest_create();
-        double start = get_time();
-        generate_star_pattern(f, center, branches, depth);
-        double elapsed = (get_time() - start) * 1000;
-        
-        printf("%-10d %-10d %-12d %-15d %-15.2f %-10d\n", 
-               center, branches, depth, count_total_nodes(f), 
-               elapsed, forest_max_depth(f));
-        
-        forest_free(f);
-    }
-    
-    printf("\n╔══════════════════════════════════════════════════════════════╗\n");
-    printf("║                    KEY OBSERVATIONS                          ║\n");
-    printf("╚══════════════════════════════════════════════════════════════╝\n");
-    printf("\n✓ Power Set: Structure SHINES with complete lattices\n");
-    printf("✓ Chain: Linear time for deeply nested structures\n");
-    printf("✓ Pyramid: Efficient hierarchical aggregation\n");
-    printf("✓ Clique Expansion: Handles growing graphs well\n");
-    printf("✓ Star: Manages multiple branches from common center\n\n");
-}
-
-int main(void) {
-    benchmark_nested_patterns();
-    return 0;
-}
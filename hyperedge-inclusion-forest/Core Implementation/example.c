@@ -31,13 +31,13 @@ int main(void) {
     printf("Weight = influence/importance score\n\n");
     
     printf("Inserting groups by influence...\n");
-    insert_hyperedge(f, (int[]){0,1,2,3,4}, 5, 10.0);  // Major influencers
-    insert_hyperedge(f, (int[]){0,1,2}, 3, 7.5);       // Core group
-    insert_hyperedge(f, (int[]){3,4,5}, 3, 7.0);       // Another core
-    insert_hyperedge(f, (int[]){0,1}, 2, 5.0);         // Tight pair
-    insert_hyperedge(f, (int[]){6,7,8}, 3, 8.0);       // Separate community!
-    insert_hyperedge(f, (int[]){6,7}, 2, 4.0);         // Sub-community
-    insert_hyperedge(f, (int[]){9,10,11}, 3, 6.5);     // Medium group
+    insert_hyperedge(f, (hif_vertex_t[]){0,1,2,3,4}, 5, 10.0);  // Major influencers
+    insert_hyperedge(f, (hif_vertex_t[]){0,1,2}, 3, 7.5);       // Core group
+    insert_hyperedge(f, (hif_vertex_t[]){3,4,5}, 3, 7.0);       // Another core
+    insert_hyperedge(f, (hif_vertex_t[]){0,1}, 2, 5.0);         // Tight pair
+    insert_hyperedge(f, (hif_vertex_t[]){6,7,8}, 3, 8.0);       // Separate community!
+    insert_hyperedge(f, (hif_vertex_t[]){6,7}, 2, 4.0);         // Sub-community
+    insert_hyperedge(f, (hif_vertex_t[]){9,10,11}, 3, 6.5);     // Medium group
     
     print_forest(f);
     
@@ -89,13 +89,13 @@ int main(void) {
     printf("Products: 0=milk, 1=bread, 2=eggs, 3=butter, 4=cheese\n");
     printf("Weight = support (frequency)\n\n");
     
-    insert_hyperedge(f, (int[]){0}, 1, 0.80);           // Milk alone (80%)
-    insert_hyperedge(f, (int[]){1}, 1, 0.75);           // Bread alone (75%)
-    insert_hyperedge(f, (int[]){0,1}, 2, 0.60);         // Milk+Bread (60%)
-    insert_hyperedge(f, (int[]){0,1,2}, 3, 0.40);       // +Eggs (40%)
-    insert_hyperedge(f, (int[]){0,1,2,3}, 4, 0.20);     // +Butter (20%)
-    insert_hyperedge(f, (int[]){0,3}, 2, 0.30);         // Milk+Butter (30%)
-    insert_hyperedge(f, (int[]){1,4}, 2, 0.25);         // Bread+Cheese (25%)
+    insert_hyperedge(f, (hif_vertex_t[]){0}, 1, 0.80);           // Milk alone (80%)
+    insert_hyperedge(f, (hif_vertex_t[]){1}, 1, 0.75);           // Bread alone (75%)
+    insert_hyperedge(f, (hif_vertex_t[]){0,1}, 2, 0.60);         // Milk+Bread (60%)
+    insert_hyperedge(f, (hif_vertex_t[]){0,1,2}, 3, 0.40);       // +Eggs (40%)
+    insert_hyperedge(f, (hif_vertex_t[]){0,1,2,3}, 4, 0.20);     // +Butter (20%)
+    insert_hyperedge(f, (hif_vertex_t[]){0,3}, 2, 0.30);         // Milk+Butter (30%)
+    insert_hyperedge(f, (hif_vertex_t[]){1,4}, 2, 0.25);         // Bread+Cheese (25%)
     
     print_forest(f);
     
@@ -106,7 +106,7 @@ int main(void) {
     for (int i = 0; i < count; ++i) {
         printf("  %d. Support=%.0f%%, Items: {", i+1, top[i]->he.weight * 100);
         for (int j = 0; j < top[i]->he.nverts; ++j) {
-            printf("%d", top[i]->he.verts[j]);
+            printf("%lld", (long long)top[i]->he.verts[j]);
             if (j + 1 < top[i]->he.nverts) printf(",");
         }
         printf("}\n");
@@ -115,7 +115,7 @@ int main(void) {
     
     // Query: Heaviest superset containing milk(0) and bread(1)
     printf("\nQUERY: Most frequent itemset containing {milk, bread}\n");
-    int query[] = {0, 1};
+    hif_vertex_t query[] = {0, 1};
     Node *best = find_heaviest_superset(f, query, 2);
     if (best) {
         printf("Result: Support=%.0f%%, Items=%d\n", 
@@ -133,17 +133,17 @@ int main(void) {
     printf("Weight = edge density / cohesion\n\n");
     
     // Dense core
-    insert_hyperedge(f, (int[]){0,1,2,3}, 4, 0.95);     // Dense clique
-    insert_hyperedge(f, (int[]){0,1,2}, 3, 0.90);       // Triangle
-    insert_hyperedge(f, (int[]){0,1}, 2, 0.85);         // Strong edge
+    insert_hyperedge(f, (hif_vertex_t[]){0,1,2,3}, 4, 0.95);     // Dense clique
+    insert_hyperedge(f, (hif_vertex_t[]){0,1,2}, 3, 0.90);       // Triangle
+    insert_hyperedge(f, (hif_vertex_t[]){0,1}, 2, 0.85);         // Strong edge
     
     // Medium density component
-    insert_hyperedge(f, (int[]){4,5,6,7}, 4, 0.70);     // Medium clique
-    insert_hyperedge(f, (int[]){4,5}, 2, 0.65);         // Moderate edge
+    insert_hyperedge(f, (hif_vertex_t[]){4,5,6,7}, 4, 0.70);     // Medium clique
+    insert_hyperedge(f, (hif_vertex_t[]){4,5}, 2, 0.65);         // Moderate edge
     
     // Sparse periphery
-    insert_hyperedge(f, (int[]){8,9,10}, 3, 0.40);      // Loose triangle
-    insert_hyperedge(f, (int[]){8,9}, 2, 0.35);         // Weak edge
+    insert_hyperedge(f, (hif_vertex_t[]){8,9,10}, 3, 0.40);      // Loose triangle
+    insert_hyperedge(f, (hif_vertex_t[]){8,9}, 2, 0.35);         // Weak edge
     
     print_forest(f);
     
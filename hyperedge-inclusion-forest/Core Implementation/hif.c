@@ -10,1117 +10,7078 @@
  *   - forest_rebalance: frees children[] pointers before rebuild
  *   - get_forest_stats: fixed BFS queue off-by-one bound
  *   - forest_max_weight: O(1) via root_heap peek
+ *   - Optional vertex → node posting lists for containment queries
+ *   - forest_prune_by_weight: count every node of a removed subtree
+ *   - Optional slab arena for nodes, vertex and children arrays
+ *   - forest_build_bulk / forest_rebalance: batch parent search
+ *   - forest_insert_batch: fixed comparator (sorted Hyperedge, not Node*)
+ *   - Concurrent-reader mode: seqlock validation + epoch reclamation
+ *   - Work-stealing pool and deterministic *_parallel queries
+ *   - Flat, mmap-able forest image (forest_save_flat / flat_forest_open)
+ *   - forest_freeze: in-memory SoA snapshot with the full read-only query set
+ *   - Vector (SSE4.2/AVX2/AVX-512/NEON) and galloping set kernels,
+ *     chosen at runtime
+ *   - Per-node vertex signatures reject most subset tests without a merge
+ *   - find_k_most_similar: bounded heap + signature pruning, O(k) memory;
+ *     Jaccard and cosine measures
+ *   - Indexed root heap + swap-remove: O(log n) root removal / reweight
+ *   - forest_delete_hyperedge / forest_update_weight via parent links and
+ *     a canonical-set hash table
+ *   - Insert-time dedup policies; forest_merge_duplicates is O(n) and no
+ *     longer rebalances
+ *   - Streaming ingest buffer: sorted micro-batches, parallel normalization
+ *   - Opt-in (-DHIF_METRICS) hot-path counters and sampled histograms
+ *   - Per-node subtree aggregates: node count, depth, min weight and
+ *     get_forest_stats in O(roots)
+ *   - Aggregate-pruned range counts and rank queries (k-th heaviest
+ *     weight, weight percentile) without materializing results
+ *   - Resumable weight-order iterator; find_top_k and
+ *     forest_traverse_by_weight expand root_heap lazily
+ *   - Delta + varint vertex sets: forest_save format 2 (with
+ *     parent-relative bitmaps) and compressed flat images
+ *   - Explicit-stack traversal core: no recursion in queries, maintenance,
+ *     insertion, freeing or (de)serialization
+ *   - Caller-owned NodeBuffer and streaming-visitor query variants;
+ *     insert normalization reuses the forest scratch buffer
+ *   - ShardedForest: min-vertex routing by range or hash, fan-out queries
+ *     with a k-way top-k merge, per-shard forest_save files
+ *   - Optional superset-query cache invalidated per touched vertex
+ *   - Batched superset queries sharing one walk, results in CSR form
+ *   - Copy-on-write snapshots: path-copied spines, shared vertex arrays
+ *   - Bounded insertion with incremental exact re-placement
+ *   - Incremental maintenance: per-subtree dedup, relink and repack
+ *   - Compile-time vertex ID width and weight type (hif_vertex_t, hif_weight_t)
+ *   - Heaviest-k supersets of a vertex set: pruned weight walk or postings
  *
  * Copyright (c) 2024
  * Licensed under MIT License
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "hif.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 
 /* ========== TUNING PARAMETERS ========== */
 
 #define WEIGHT_TOLERANCE  0.15   /* 15% tolerance for "similar" weights  */
 #define MIN_OVERLAP_RATIO 0.30   /* 30% overlap required to cluster      */
 #define MAX_CHAIN_DEPTH   100    /* force branching beyond this depth    */
+#define ARENA_DEFAULT_SLAB (1u << 20) /* 1 MiB slabs for forest arenas   */
+#define PAR_SPLIT_CHILDREN 64   /* child lists this long become tasks   */
+#define PAR_TASKS_PER_WORKER 8  /* root runs per worker for balance     */
+#define SET_GALLOP_RATIO   32   /* gallop when |B| > 32·|A|             */
+#define SET_SIMD_MIN       8    /* shorter sets take the scalar merge   */
+#define SORT_INSERTION_MAX 16   /* insertion sort below this many verts */
+#define INGEST_DEFAULT_BATCH 4096
+#define INGEST_PAR_MIN     1024 /* events per normalization thread      */
+#define HIF_METRICS_SAMPLE_SHIFT 6 /* time one insert in 64             */
+#define RANK_SELECT_MAX    64   /* rank bisection stops at this many    */
+#define WALK_INLINE        64   /* walk stack entries kept on the C stack */
+#define QCACHE_STAMPS      4096 /* query-cache vertex stamp buckets (2^k) */
+#define MAINT_DEFAULT_ROOTS 16     /* root subtrees per maintainer step  */
+#define MAINT_DEFAULT_PERIOD_MS 10.0
+
+/* ========== METRICS ========== */
 
-/* ========== INTERNAL HELPERS ========== */
+/*
+ * MET(f, field, n) bumps a writer-side counter; MET_VISIT() counts a
+ * node examined by the current query in a thread-local tally that
+ * MET_QUERY_END folds into the forest.  All of it vanishes without
+ * HIF_METRICS.
+ */
+#if defined(HIF_METRICS) || defined(HIF_SIG_STATS)
+static unsigned long long sig_checks, sig_rejects;
+#endif
 
-static int *copy_int_array(const int *a, int n)
+#ifdef HIF_METRICS
+static unsigned long long met_subset_calls, met_elements;
+static __thread unsigned long long met_visits;
+
+static int met_bucket(unsigned long long v)
 {
-    int *r = malloc(sizeof(int) * n);
-    if (!r) { perror("malloc"); exit(1); }
-    memcpy(r, a, sizeof(int) * n);
-    return r;
+    int b = v ? 64 - __builtin_clzll(v) : 0;
+    return b < HIF_HIST_BUCKETS ? b : HIF_HIST_BUCKETS - 1;
 }
 
-/* Returns 1 if sorted array A is a subset of sorted array B. */
-static int is_subset(const int *A, int nA, const int *B, int nB)
+static void met_query_done(const Forest *f, unsigned long long visited)
 {
-    int i = 0, j = 0;
-    while (i < nA && j < nB) {
-        if      (A[i] == B[j]) { i++; j++; }
-        else if (A[i] >  B[j]) { j++; }
-        else                    { return 0; }
-    }
-    return (i == nA);
+    ForestMetrics *m = f->metrics;
+    __atomic_fetch_add(&m->queries, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->visited, visited, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->visited_hist[met_bucket(visited)], 1,
+                       __ATOMIC_RELAXED);
+    unsigned long long mx = __atomic_load_n(&m->max_visited, __ATOMIC_RELAXED);
+    while (visited > mx &&
+           !__atomic_compare_exchange_n(&m->max_visited, &mx, visited, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void met_insert_depth(Forest *f, int depth)
+{
+    ForestMetrics *m = f->metrics;
+    if (depth > m->max_insert_depth) m->max_insert_depth = depth;
+    if (depth >= MAX_CHAIN_DEPTH)    m->deep_inserts++;
+    m->depth_hist[met_bucket((unsigned long long)depth)]++;
+}
+
+static unsigned long long met_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define MET(f, field, n)      ((f)->metrics->field += (n))
+#define MET_GLOBAL(ctr, n)    __atomic_fetch_add(&(ctr), (n), __ATOMIC_RELAXED)
+#define MET_VISIT()           (met_visits++)
+#define MET_QUERY_BEGIN()     unsigned long long met_v0 = met_visits
+#define MET_QUERY_END(f)      met_query_done((f), met_visits - met_v0)
+#define MET_DEPTH(f, d)       met_insert_depth((f), (d))
+#else
+#define MET(f, field, n)      ((void)0)
+#define MET_GLOBAL(ctr, n)    ((void)0)
+#define MET_VISIT()           ((void)0)
+#define MET_QUERY_BEGIN()     ((void)0)
+#define MET_QUERY_END(f)      ((void)0)
+#define MET_DEPTH(f, d)       ((void)0)
+#endif
+
+int hif_metrics_enabled(void)
+{
+#ifdef HIF_METRICS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static void qcache_counters(QueryCache *c, ForestMetrics *m, int reset);
+
+ForestMetrics forest_get_metrics(const Forest *f)
+{
+    ForestMetrics m;
+    memset(&m, 0, sizeof(m));
+#ifdef HIF_METRICS
+    m = *f->metrics;
+    m.nroots            = f->nroots;
+    m.subset_calls      = __atomic_load_n(&met_subset_calls, __ATOMIC_RELAXED);
+    m.elements_compared = __atomic_load_n(&met_elements, __ATOMIC_RELAXED);
+    m.sig_checks        = __atomic_load_n(&sig_checks, __ATOMIC_RELAXED);
+    m.sig_rejects       = __atomic_load_n(&sig_rejects, __ATOMIC_RELAXED);
+#else
+    m.nroots = f->nroots;
+#endif
+    qcache_counters(f->qcache, &m, 0);
+    return m;
+}
+
+void forest_reset_metrics(Forest *f)
+{
+#ifdef HIF_METRICS
+    memset(f->metrics, 0, sizeof(ForestMetrics));
+    __atomic_store_n(&met_subset_calls, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&met_elements, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&sig_checks, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&sig_rejects, 0, __ATOMIC_RELAXED);
+#endif
+    qcache_counters(f->qcache, NULL, 1);
 }
 
-static int overlap_size(const int *A, int nA, const int *B, int nB)
+/* ========== SET KERNELS ========== */
+
+/*
+ * Sorted-set intersection count and subset test.  Stored vertex arrays
+ * are strictly increasing (normalize_vertices), and the vector kernels
+ * rely on that: each element of A matches at most one element of B.
+ *
+ * A kernel returns |A ∩ B|.  With `subset` set it may instead return -1
+ * as soon as some element of A is known to be missing from B.
+ *
+ * Vector kernels compare a W-wide block of A against every rotation of a
+ * W-wide block of B, OR the equality masks, and advance whichever block
+ * has the smaller maximum (both on a tie).  `seen` accumulates the lanes
+ * of the current A block matched so far; when the A block is retired
+ * with a lane unmatched, A is not a subset.
+ */
+typedef int (*SetCountFn)(const hif_vertex_t *A, int nA,
+                          const hif_vertex_t *B, int nB, int subset);
+
+static int set_count_scalar(const hif_vertex_t *A, int nA,
+                            const hif_vertex_t *B, int nB, int subset)
 {
     int i = 0, j = 0, count = 0;
     while (i < nA && j < nB) {
         if      (A[i] == B[j]) { count++; i++; j++; }
-        else if (A[i] <  B[j]) { i++; }
+        else if (A[i] <  B[j]) { if (subset) return -1; i++; }
         else                    { j++; }
     }
     return count;
 }
 
-static double overlap_ratio(const int *A, int nA, const int *B, int nB)
+/* Scalar finish after a vector loop; lanes set in `seen` are matched. */
+static int set_count_tail(const hif_vertex_t *A, int nA,
+                          const hif_vertex_t *B, int nB,
+                          int i, int j, unsigned seen, int subset)
 {
-    int ov  = overlap_size(A, nA, B, nB);
-    int mn  = nA < nB ? nA : nB;
-    return mn > 0 ? (double)ov / mn : 0.0;
+    int count = 0;
+    for (; i < nA; ++i, seen >>= 1) {
+        if (seen & 1u) continue;
+        while (j < nB && B[j] < A[i]) j++;
+        if (j < nB && B[j] == A[i]) { count++; j++; }
+        else if (subset)            return -1;
+    }
+    return count;
 }
 
-static int weights_similar(double w1, double w2)
+/* First index >= lo with B[index] >= x (exponential, then binary search). */
+static int gallop_lower(const hif_vertex_t *B, int lo, int nB, hif_vertex_t x)
 {
-    if (fabs(w1) < 1e-9 && fabs(w2) < 1e-9) return 1;
-    double diff = fabs(w1 - w2);
-    double avg  = (fabs(w1) + fabs(w2)) / 2.0;
-    return diff < avg * WEIGHT_TOLERANCE;
+    int step = 1, hi = lo;
+    while (hi < nB && B[hi] < x) {
+        lo    = hi + 1;
+        hi   += step;
+        step <<= 1;
+    }
+    if (hi > nB) hi = nB;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (B[mid] < x) lo = mid + 1;
+        else            hi = mid;
+    }
+    return lo;
+}
+
+/* For |A| << |B|: O(|A| log(|B|/|A|)) instead of O(|A| + |B|). */
+static int set_count_gallop(const hif_vertex_t *A, int nA,
+                            const hif_vertex_t *B, int nB, int subset)
+{
+    int j = 0, count = 0;
+    for (int i = 0; i < nA; ++i) {
+        j = gallop_lower(B, j, nB, A[i]);
+        if (j < nB && B[j] == A[i]) { count++; j++; }
+        else if (subset)            return -1;
+        if (j >= nB) {
+            if (subset && i + 1 < nA) return -1;
+            break;
+        }
+    }
+    return count;
 }
 
 /*
- * Strict weight-first comparison.
- * Returns -1 if A should be parent, +1 if B should be parent, 0 if siblings.
+ * The vector kernels below exist once per vertex width: 4/8/16 lanes of
+ * 32-bit IDs, 8/16 lanes of 16-bit IDs, 2/4/8 lanes of 64-bit IDs for
+ * SSE4.2/AVX2/AVX-512.  Lane equality is width-exact, so the 32-bit
+ * kernels serve both int and uint32_t builds.
  */
-static int weighted_cmp(const Hyperedge *A, const Hyperedge *B)
+#if !defined(HIF_VERTEX_BITS) || HIF_VERTEX_BITS == 32
+#define HIF_VERTEX_LANE32 1
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HIF_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+
+#ifdef HIF_VERTEX_LANE32
+__attribute__((target("sse4.2,popcnt")))
+static int set_count_sse42(const hif_vertex_t *A, int nA,
+                           const hif_vertex_t *B, int nB, int subset)
 {
-    const double EPS = 1e-9;
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 4 <= nA && j + 4 <= nB) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(A + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(B + j));
+        __m128i m  = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        unsigned hit = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m));
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 3], bmax = B[j + 3];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFu) return -1;
+            i += 4; seen = 0;
+        }
+        if (bmax <= amax) j += 4;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
 
-    if (A->weight > B->weight + EPS) return -1;
-    if (B->weight > A->weight + EPS) return  1;
+__attribute__((target("avx2,popcnt")))
+static int set_count_avx2(const hif_vertex_t *A, int nA,
+                          const hif_vertex_t *B, int nB, int subset)
+{
+    const __m256i rot = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 8 <= nA && j + 8 <= nB) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(A + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(B + j));
+        __m256i m  = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; ++r) {
+            vb = _mm256_permutevar8x32_epi32(vb, rot);
+            m  = _mm256_or_si256(m, _mm256_cmpeq_epi32(va, vb));
+        }
+        unsigned hit = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m));
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 7], bmax = B[j + 7];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFFu) return -1;
+            i += 8; seen = 0;
+        }
+        if (bmax <= amax) j += 8;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
 
-    /* Weights equal: use subset relationship */
-    int A_in_B = is_subset(A->verts, A->nverts, B->verts, B->nverts);
-    int B_in_A = is_subset(B->verts, B->nverts, A->verts, A->nverts);
+__attribute__((target("avx512f,popcnt")))
+static int set_count_avx512(const hif_vertex_t *A, int nA,
+                            const hif_vertex_t *B, int nB, int subset)
+{
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 16 <= nA && j + 16 <= nB) {
+        __m512i va = _mm512_loadu_si512((const void*)(A + i));
+        __m512i vb = _mm512_loadu_si512((const void*)(B + j));
+        __mmask16 m = _mm512_cmpeq_epi32_mask(va, vb);
+        for (int r = 1; r < 16; ++r) {
+            vb = _mm512_alignr_epi32(vb, vb, 1);
+            m |= _mm512_cmpeq_epi32_mask(va, vb);
+        }
+        unsigned hit = (unsigned)m;
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 15], bmax = B[j + 15];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFFFFu) return -1;
+            i += 16; seen = 0;
+        }
+        if (bmax <= amax) j += 16;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
+#elif HIF_VERTEX_BITS == 16
+/* Keep the even bits of a byte mask: one bit per 16-bit lane. */
+static unsigned lane16_bits(unsigned m)
+{
+    m &= 0x55555555u;
+    m = (m | m >> 1) & 0x33333333u;
+    m = (m | m >> 2) & 0x0F0F0F0Fu;
+    m = (m | m >> 4) & 0x00FF00FFu;
+    return (m | m >> 8) & 0x0000FFFFu;
+}
 
-    if (B_in_A && !A_in_B) return -1;
-    if (A_in_B && !B_in_A) return  1;
+__attribute__((target("sse4.2,popcnt")))
+static int set_count_sse42(const hif_vertex_t *A, int nA,
+                           const hif_vertex_t *B, int nB, int subset)
+{
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 8 <= nA && j + 8 <= nB) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(A + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(B + j));
+        __m128i m  = _mm_cmpeq_epi16(va, vb);
+        for (int r = 1; r < 8; ++r) {
+            vb = _mm_alignr_epi8(vb, vb, 2);
+            m  = _mm_or_si128(m, _mm_cmpeq_epi16(va, vb));
+        }
+        unsigned hit = (unsigned)_mm_movemask_epi8(
+            _mm_packs_epi16(m, _mm_setzero_si128()));
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 7], bmax = B[j + 7];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFFu) return -1;
+            i += 8; seen = 0;
+        }
+        if (bmax <= amax) j += 8;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
 
-    /* Equal weight, incomparable sets: prefer larger for stability */
-    if (A->nverts > B->nverts) return -1;
-    if (B->nverts > A->nverts) return  1;
+__attribute__((target("avx2,popcnt")))
+static int set_count_avx2(const hif_vertex_t *A, int nA,
+                          const hif_vertex_t *B, int nB, int subset)
+{
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 16 <= nA && j + 16 <= nB) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(A + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(B + j));
+        __m256i m  = _mm256_cmpeq_epi16(va, vb);
+        for (int r = 1; r < 16; ++r) {
+            /* rotate by one lane across the 128-bit halves */
+            vb = _mm256_alignr_epi8(_mm256_permute2x128_si256(vb, vb, 0x01), vb, 2);
+            m  = _mm256_or_si256(m, _mm256_cmpeq_epi16(va, vb));
+        }
+        unsigned hit = lane16_bits((unsigned)_mm256_movemask_epi8(m));
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 15], bmax = B[j + 15];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFFFFu) return -1;
+            i += 16; seen = 0;
+        }
+        if (bmax <= amax) j += 16;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
+#else /* HIF_VERTEX_BITS == 64 */
+__attribute__((target("sse4.2,popcnt")))
+static int set_count_sse42(const hif_vertex_t *A, int nA,
+                           const hif_vertex_t *B, int nB, int subset)
+{
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 2 <= nA && j + 2 <= nB) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(A + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(B + j));
+        __m128i m  = _mm_or_si128(
+            _mm_cmpeq_epi64(va, vb),
+            _mm_cmpeq_epi64(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        unsigned hit = (unsigned)_mm_movemask_pd(_mm_castsi128_pd(m));
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 1], bmax = B[j + 1];
+        if (amax <= bmax) {
+            if (subset && seen != 0x3u) return -1;
+            i += 2; seen = 0;
+        }
+        if (bmax <= amax) j += 2;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
 
-    return 0; /* complete tie → siblings */
+__attribute__((target("avx2,popcnt")))
+static int set_count_avx2(const hif_vertex_t *A, int nA,
+                          const hif_vertex_t *B, int nB, int subset)
+{
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 4 <= nA && j + 4 <= nB) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(A + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(B + j));
+        __m256i m  = _mm256_cmpeq_epi64(va, vb);
+        for (int r = 1; r < 4; ++r) {
+            vb = _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            m  = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, vb));
+        }
+        unsigned hit = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(m));
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 3], bmax = B[j + 3];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFu) return -1;
+            i += 4; seen = 0;
+        }
+        if (bmax <= amax) j += 4;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
 }
 
-/* ========== NODE HELPERS ========== */
+__attribute__((target("avx512f,popcnt")))
+static int set_count_avx512(const hif_vertex_t *A, int nA,
+                            const hif_vertex_t *B, int nB, int subset)
+{
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 8 <= nA && j + 8 <= nB) {
+        __m512i va = _mm512_loadu_si512((const void*)(A + i));
+        __m512i vb = _mm512_loadu_si512((const void*)(B + j));
+        __mmask8 m = _mm512_cmpeq_epi64_mask(va, vb);
+        for (int r = 1; r < 8; ++r) {
+            vb = _mm512_alignr_epi64(vb, vb, 1);
+            m |= _mm512_cmpeq_epi64_mask(va, vb);
+        }
+        unsigned hit = (unsigned)m;
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 7], bmax = B[j + 7];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFFu) return -1;
+            i += 8; seen = 0;
+        }
+        if (bmax <= amax) j += 8;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
+#endif
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON) && defined(HIF_VERTEX_LANE32)
+#define HIF_HAVE_NEON_KERNEL 1
+#include <arm_neon.h>
 
-static Node *node_create(const int *verts, int nverts, double weight)
+static int set_count_neon(const hif_vertex_t *A, int nA,
+                          const hif_vertex_t *B, int nB, int subset)
 {
-    Node *nd = malloc(sizeof(Node));
-    if (!nd) { perror("malloc"); exit(1); }
-    nd->he.verts    = copy_int_array(verts, nverts);
-    nd->he.nverts   = nverts;
-    nd->he.weight   = weight;
-    nd->children    = NULL;
-    nd->nchildren   = 0;
-    nd->children_cap = 0;
-    return nd;
+    static const uint32_t lane_bits[4] = { 1, 2, 4, 8 };
+    const uint32x4_t bits = vld1q_u32(lane_bits);
+    int i = 0, j = 0, count = 0;
+    unsigned seen = 0;
+    while (i + 4 <= nA && j + 4 <= nB) {
+        uint32x4_t va = vld1q_u32((const uint32_t*)(A + i));
+        uint32x4_t vb = vld1q_u32((const uint32_t*)(B + j));
+        uint32x4_t m  = vorrq_u32(
+            vorrq_u32(vceqq_u32(va, vb), vceqq_u32(va, vextq_u32(vb, vb, 1))),
+            vorrq_u32(vceqq_u32(va, vextq_u32(vb, vb, 2)),
+                      vceqq_u32(va, vextq_u32(vb, vb, 3))));
+        unsigned hit = vaddvq_u32(vandq_u32(m, bits));
+        count += __builtin_popcount(hit);
+        seen  |= hit;
+        hif_vertex_t amax = A[i + 3], bmax = B[j + 3];
+        if (amax <= bmax) {
+            if (subset && seen != 0xFu) return -1;
+            i += 4; seen = 0;
+        }
+        if (bmax <= amax) j += 4;
+    }
+    int t = set_count_tail(A, nA, B, nB, i, j, seen, subset);
+    return t < 0 ? -1 : count + t;
+}
+#endif
+
+/* Indexed by HifSetKernel; NULL where the build has no such kernel. */
+static const struct {
+    const char *name;
+    SetCountFn  fn;
+} set_kernels[HIF_KERNEL_NEON + 1] = {
+    [HIF_KERNEL_AUTO]   = { "auto",   NULL },
+    [HIF_KERNEL_SCALAR] = { "scalar", set_count_scalar },
+#ifdef HIF_HAVE_X86_KERNELS
+    [HIF_KERNEL_SSE42]  = { "sse4.2", set_count_sse42 },
+    [HIF_KERNEL_AVX2]   = { "avx2",   set_count_avx2 },
+#if !defined(HIF_VERTEX_BITS) || HIF_VERTEX_BITS != 16
+    [HIF_KERNEL_AVX512] = { "avx512", set_count_avx512 },
+#endif
+#endif
+#ifdef HIF_HAVE_NEON_KERNEL
+    [HIF_KERNEL_NEON]   = { "neon",   set_count_neon },
+#endif
+};
+
+static int set_kernel_supported(HifSetKernel k)
+{
+    if (k <= HIF_KERNEL_AUTO || k > HIF_KERNEL_NEON || !set_kernels[k].fn)
+        return 0;
+#ifdef HIF_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (k == HIF_KERNEL_SSE42)
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+    if (k == HIF_KERNEL_AVX2)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    if (k == HIF_KERNEL_AVX512)
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt");
+#endif
+    return 1;
 }
 
-static void node_free(Node *nd)
+static HifSetKernel set_kernel_best(void)
 {
-    if (!nd) return;
-    for (int i = 0; i < nd->nchildren; ++i) node_free(nd->children[i]);
-    free(nd->children);
-    free(nd->he.verts);
-    free(nd);
+    static const HifSetKernel pref[] = {
+        HIF_KERNEL_AVX512, HIF_KERNEL_AVX2, HIF_KERNEL_SSE42, HIF_KERNEL_NEON
+    };
+    for (size_t i = 0; i < sizeof(pref) / sizeof(pref[0]); ++i)
+        if (set_kernel_supported(pref[i])) return pref[i];
+    return HIF_KERNEL_SCALAR;
 }
 
-static void node_add_child(Node *parent, Node *child)
+/* Resolved on first use; HIF_KERNEL_AUTO (0) means "not yet chosen". */
+static int active_set_kernel = HIF_KERNEL_AUTO;
+
+static SetCountFn set_kernel(void)
 {
-    if (parent->nchildren >= parent->children_cap) {
-        int newcap = parent->children_cap ? parent->children_cap * 2 : 4;
-        parent->children = realloc(parent->children, sizeof(Node*) * newcap);
-        if (!parent->children) { perror("realloc"); exit(1); }
-        parent->children_cap = newcap;
+    int k = __atomic_load_n(&active_set_kernel, __ATOMIC_RELAXED);
+    if (k == HIF_KERNEL_AUTO) {
+        k = set_kernel_best();
+        __atomic_store_n(&active_set_kernel, k, __ATOMIC_RELAXED);
     }
-    parent->children[parent->nchildren++] = child;
+    return set_kernels[k].fn;
 }
 
-static int node_depth(Node *nd)
+int hif_set_kernel(HifSetKernel k)
 {
-    int mx = 0;
-    for (int i = 0; i < nd->nchildren; ++i) {
-        int d = node_depth(nd->children[i]);
-        if (d > mx) mx = d;
-    }
-    return 1 + mx;
+    if (k == HIF_KERNEL_AUTO) k = set_kernel_best();
+    if (!set_kernel_supported(k)) return -1;
+    __atomic_store_n(&active_set_kernel, (int)k, __ATOMIC_RELAXED);
+    return 0;
 }
 
-/* ========== HEAP IMPLEMENTATION ========== */
+const char *hif_set_kernel_name(void)
+{
+    set_kernel();
+    return set_kernels[__atomic_load_n(&active_set_kernel, __ATOMIC_RELAXED)].name;
+}
 
-NodeHeap *heap_create(void)
+/* Pick galloping, scalar or the vector kernel for one A/B pair. */
+static int set_count(const hif_vertex_t *A, int nA, const hif_vertex_t *B,
+                     int nB, int subset)
 {
-    NodeHeap *h = malloc(sizeof(NodeHeap));
-    if (!h) { perror("malloc"); exit(1); }
-    h->data = NULL;
-    h->size = 0;
-    h->cap  = 0;
-    return h;
+    MET_GLOBAL(met_elements, (unsigned long long)(nA + nB));
+    if ((long)nA * SET_GALLOP_RATIO < nB)
+        return set_count_gallop(A, nA, B, nB, subset);
+    if (nA < SET_SIMD_MIN || nB < SET_SIMD_MIN)
+        return set_count_scalar(A, nA, B, nB, subset);
+    return set_kernel()(A, nA, B, nB, subset);
 }
 
-void heap_free(NodeHeap *h)
+/* ========== INTERNAL HELPERS ========== */
+
+/* 32 hash-input bits of a vertex ID (the high half folded in if wider). */
+static uint32_t vertex_fold(hif_vertex_t v)
 {
-    if (!h) return;
-    free(h->data);
-    free(h);
+#if defined(HIF_VERTEX_BITS) && HIF_VERTEX_BITS == 64
+    return (uint32_t)(v ^ v >> 32);
+#else
+    return (uint32_t)v;
+#endif
 }
 
-static void heap_ensure_cap(NodeHeap *h)
+/* Returns 1 if sorted array A is a subset of sorted array B. */
+static int is_subset(const hif_vertex_t *A, int nA,
+                     const hif_vertex_t *B, int nB)
 {
-    if (h->size < h->cap) return;
-    h->cap  = h->cap ? h->cap * 2 : 8;
-    h->data = realloc(h->data, sizeof(Node*) * h->cap);
-    if (!h->data) { perror("realloc"); exit(1); }
+    MET_GLOBAL(met_subset_calls, 1);
+    if (nA == 0) return 1;
+    if (nA > nB || A[0] < B[0] || A[nA - 1] > B[nB - 1]) return 0;
+    return set_count(A, nA, B, nB, 1) == nA;
 }
 
-static void heap_sift_up(NodeHeap *h, int i)
+static int overlap_size(const hif_vertex_t *A, int nA,
+                        const hif_vertex_t *B, int nB)
 {
-    while (i > 0) {
-        int parent = (i - 1) / 2;
-        if (h->data[parent]->he.weight >= h->data[i]->he.weight) break;
-        Node *tmp        = h->data[parent];
-        h->data[parent]  = h->data[i];
-        h->data[i]       = tmp;
-        i = parent;
-    }
+    if (nA == 0 || nB == 0)                        return 0;
+    if (A[nA - 1] < B[0] || B[nB - 1] < A[0])      return 0;
+    if (nA > nB) return set_count(B, nB, A, nA, 0);
+    return set_count(A, nA, B, nB, 0);
 }
 
-static void heap_sift_down(NodeHeap *h, int i)
+/* ========== COMPRESSED VERTEX SETS ========== */
+
+/*
+ * Sorted sets as delta + LEB128 varints: the first ID zigzag-coded, then
+ * each gap minus one (IDs are strictly increasing), 7 bits per byte.
+ * Arithmetic is modulo 2^32 (2^64 for 64-bit vertices) so any ID range
+ * round-trips; IDs that fit both builds encode to the same bytes.
+ */
+#if defined(HIF_VERTEX_BITS) && HIF_VERTEX_BITS == 64
+typedef uint64_t vbyte_word;
+#define VBYTE_MAX_BYTES 10
+#else
+typedef uint32_t vbyte_word;
+#define VBYTE_MAX_BYTES 5
+#endif
+#define VBYTE_WORD_BITS ((int)sizeof(vbyte_word) * 8)
+
+static uint8_t *vbyte_put(uint8_t *p, vbyte_word x)
 {
-    while (1) {
-        int largest = i;
-        int left    = 2 * i + 1;
-        int right   = 2 * i + 2;
-        if (left  < h->size && h->data[left]->he.weight  > h->data[largest]->he.weight) largest = left;
-        if (right < h->size && h->data[right]->he.weight > h->data[largest]->he.weight) largest = right;
-        if (largest == i) break;
-        Node *tmp        = h->data[i];
-        h->data[i]       = h->data[largest];
-        h->data[largest] = tmp;
-        i = largest;
+    while (x >= 0x80) { *p++ = (uint8_t)(x | 0x80); x >>= 7; }
+    *p++ = (uint8_t)x;
+    return p;
+}
+
+static const uint8_t *vbyte_get(const uint8_t *p, vbyte_word *x)
+{
+    vbyte_word v = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t b = *p++;
+        v |= (vbyte_word)(b & 0x7f) << shift;
+        if (!(b & 0x80) || shift >= 7 * (VBYTE_MAX_BYTES - 1)) break;
     }
+    *x = v;
+    return p;
 }
 
-void heap_push(NodeHeap *h, Node *nd)
+static int vbyte_len(vbyte_word x)
 {
-    heap_ensure_cap(h);
-    h->data[h->size++] = nd;
-    heap_sift_up(h, h->size - 1);
+    int n = 1;
+    while (x >= 0x80) { x >>= 7; n++; }
+    return n;
 }
 
-Node *heap_pop(NodeHeap *h)
+static vbyte_word vbyte_zigzag(hif_vertex_t v)
 {
-    if (h->size == 0) return NULL;
-    Node *top    = h->data[0];
-    h->data[0]   = h->data[--h->size];
-    if (h->size > 0) heap_sift_down(h, 0);
-    return top;
+    vbyte_word w = (vbyte_word)v;
+    return (w << 1) ^ (0u - (w >> (VBYTE_WORD_BITS - 1)));
 }
 
-/* ========== FOREST ROOT MANAGEMENT ========== */
+static vbyte_word vbyte_unzigzag(vbyte_word z)
+{
+    return (z >> 1) ^ (0u - (z & 1u));
+}
 
-static void forest_rebuild_root_heap(Forest *f)
+/* Gap code between consecutive IDs a < b. */
+static vbyte_word vbyte_gap(hif_vertex_t a, hif_vertex_t b)
 {
-    f->root_heap->size = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        heap_push(f->root_heap, f->roots[i]);
+    return (vbyte_word)b - (vbyte_word)a - 1u;
 }
 
-static void forest_add_root(Forest *f, Node *r)
+/* Streaming decoder: yields one ID per step without materializing the set. */
+typedef struct {
+    const uint8_t *p;
+    int            left;
+    vbyte_word     prev;
+    int            first;
+} VbyteCursor;
+
+static void vbyte_begin(VbyteCursor *c, const uint8_t *enc, int n)
 {
-    if (f->nroots >= f->roots_cap) {
-        int newcap  = f->roots_cap ? f->roots_cap * 2 : 8;
-        f->roots    = realloc(f->roots, sizeof(Node*) * newcap);
-        if (!f->roots) { perror("realloc"); exit(1); }
-        f->roots_cap = newcap;
-    }
-    f->roots[f->nroots++] = r;
-    heap_push(f->root_heap, r);
+    c->p = enc; c->left = n; c->prev = 0; c->first = 1;
 }
 
-static void forest_remove_root_at(Forest *f, int idx)
+static int vbyte_next(VbyteCursor *c, hif_vertex_t *v)
 {
-    if (idx < 0 || idx >= f->nroots) return;
-    for (int i = idx; i + 1 < f->nroots; ++i) f->roots[i] = f->roots[i+1];
-    f->nroots--;
-    forest_rebuild_root_heap(f);
+    if (c->left == 0) return 0;
+    vbyte_word x;
+    c->p = vbyte_get(c->p, &x);
+    c->left--;
+    if (c->first) { c->first = 0; c->prev = vbyte_unzigzag(x); }
+    else          { c->prev += x + 1u; }
+    *v = (hif_vertex_t)c->prev;
+    return 1;
 }
 
-/* ========== INSERTION INTERNALS ========== */
+static size_t vbyte_size(const hif_vertex_t *verts, int n)
+{
+    if (n == 0) return 0;
+    size_t bytes = (size_t)vbyte_len(vbyte_zigzag(verts[0]));
+    for (int i = 1; i < n; ++i)
+        bytes += vbyte_len(vbyte_gap(verts[i - 1], verts[i]));
+    return bytes;
+}
 
 /*
- * Try to insert newn into the subtree rooted at `root`.
- *
- * Returns:
- *   -1  successfully placed newn somewhere under root
- *    0  newn is incomparable with root (try next sibling)
- *    1  root should become a child of newn (caller handles steal)
+ * Bounds-checked decode for untrusted bytes: exactly n varints within
+ * avail bytes, each at most VBYTE_MAX_BYTES, yielding strictly increasing
+ * IDs that fit hif_vertex_t.  out may be NULL to only validate.  Returns
+ * bytes consumed, or -1.
  */
-static int insert_into_node(Node *root, Node *newn, int depth)
+static long vbyte_check(const uint8_t *in, size_t avail, int n,
+                        hif_vertex_t *out)
 {
-    int cmp = weighted_cmp(&root->he, &newn->he);
-
-    if (cmp == 1) {
-        /* root is lighter → should move under newn */
-        return 1;
+    size_t     pos  = 0;
+    vbyte_word prev = 0;
+    for (int i = 0; i < n; ++i) {
+        vbyte_word x = 0;
+        int        shift = 0;
+        for (;;) {
+            if (pos >= avail || shift >= 7 * VBYTE_MAX_BYTES) return -1;
+            uint8_t b = in[pos++];
+            x |= (vbyte_word)(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+            shift += 7;
+        }
+        vbyte_word v = i == 0 ? vbyte_unzigzag(x) : prev + x + 1u;
+#if defined(HIF_VERTEX_BITS) && HIF_VERTEX_BITS == 16
+        if (v > HIF_VERTEX_MAX) return -1;
+#endif
+        if (i > 0 && (hif_vertex_t)v <= (hif_vertex_t)prev) return -1;
+        prev = v;
+        if (out) out[i] = (hif_vertex_t)v;
     }
+    return (long)pos;
+}
 
-    if (cmp == -1) {
-        /* root is heavier → newn could go under root,
-           but only if newn ⊆ root (avoid fake hierarchy) */
-        int newn_in_root = is_subset(newn->he.verts, newn->he.nverts,
-                                     root->he.verts, root->he.nverts);
-        if (!newn_in_root) return 0; /* incomparable sets */
+size_t hif_vbyte_bound(int n)
+{
+    return (size_t)(n > 0 ? n : 0) * VBYTE_MAX_BYTES;
+}
 
-        /* Try to place newn deeper in root's children */
-        int i = 0;
-        while (i < root->nchildren) {
-            int res = insert_into_node(root->children[i], newn, depth + 1);
-            if (res == 1) {
-                /* steal: child moves under newn */
-                Node *child = root->children[i];
-                for (int j = i; j + 1 < root->nchildren; ++j)
-                    root->children[j] = root->children[j+1];
-                root->nchildren--;
-                node_add_child(newn, child);
-                /* don't advance i; check same slot again */
-            } else if (res == -1) {
-                return -1; /* placed successfully deeper */
-            } else {
-                i++;
+size_t hif_vbyte_encode(const hif_vertex_t *verts, int n, uint8_t *out)
+{
+    if (n <= 0) return 0;
+    uint8_t *p = vbyte_put(out, vbyte_zigzag(verts[0]));
+    for (int i = 1; i < n; ++i)
+        p = vbyte_put(p, vbyte_gap(verts[i - 1], verts[i]));
+    return (size_t)(p - out);
+}
+
+size_t hif_vbyte_decode(const uint8_t *in, int n, hif_vertex_t *out)
+{
+    VbyteCursor c;
+    vbyte_begin(&c, in, n);
+    for (int i = 0; vbyte_next(&c, &out[i]); ++i) ;
+    return (size_t)(c.p - in);
+}
+
+/*
+ * |D ∩ Q| for D the encoded set.  mode VB_Q_IN_D returns -1 as soon as
+ * some query ID is known to be missing from D, VB_D_IN_Q as soon as some
+ * ID of D is missing from Q; decoding stops there.  Otherwise a query
+ * much longer than D is galloped through, as in set_count.
+ */
+enum { VB_COUNT = 0, VB_Q_IN_D, VB_D_IN_Q };
+
+static int vbyte_count(const uint8_t *enc, int nD, const hif_vertex_t *Q,
+                       int nQ, int mode)
+{
+    MET_GLOBAL(met_elements, (unsigned long long)(nD + nQ));
+    VbyteCursor c;
+    vbyte_begin(&c, enc, nD);
+    int gallop = mode != VB_Q_IN_D && (long)nD * SET_GALLOP_RATIO < nQ;
+    hif_vertex_t d;
+    int j = 0, count = 0;
+    while (j < nQ && vbyte_next(&c, &d)) {
+        if (gallop) {
+            j = gallop_lower(Q, j, nQ, d);
+        } else {
+            while (j < nQ && Q[j] < d) {
+                if (mode == VB_Q_IN_D) return -1;
+                j++;
             }
         }
-
-        node_add_child(root, newn);
-        return -1;
+        if (j < nQ && Q[j] == d)    { count++; j++; }
+        else if (mode == VB_D_IN_Q) return -1;
     }
+    if (mode == VB_D_IN_Q && c.left > 0) return -1;
+    return count;
+}
 
-    /* cmp == 0 → equal priority, incomparable → siblings */
-    return 0;
+int hif_vbyte_contains(const uint8_t *enc, int n, const hif_vertex_t *query,
+                       int nquery)
+{
+    if (nquery == 0) return 1;
+    if (nquery > n)  return 0;
+    return vbyte_count(enc, n, query, nquery, VB_Q_IN_D) == nquery;
 }
 
-static void forest_insert_node(Forest *f, Node *newn)
+int hif_vbyte_within(const uint8_t *enc, int n, const hif_vertex_t *query,
+                     int nquery)
 {
-    int i = 0;
-    while (i < f->nroots) {
-        Node *r   = f->roots[i];
-        int   cmp = weighted_cmp(&r->he, &newn->he);
+    if (n == 0)      return 1;
+    if (n > nquery)  return 0;
+    return vbyte_count(enc, n, query, nquery, VB_D_IN_Q) == n;
+}
 
-        if (cmp == 1) {
-            /* existing root becomes child of newn */
-            node_add_child(newn, r);
-            forest_remove_root_at(f, i);
-            /* don't advance i; slot now holds next root */
-        } else if (cmp == -1) {
-            int res = insert_into_node(r, newn, 1);
-            if (res == 1) {
-                node_add_child(newn, r);
-                forest_remove_root_at(f, i);
-            } else if (res == -1) {
+int hif_vbyte_intersect_count(const uint8_t *enc, int n,
+                              const hif_vertex_t *query, int nquery)
+{
+    if (n == 0 || nquery == 0) return 0;
+    return vbyte_count(enc, n, query, nquery, VB_COUNT);
+}
+
+/* ========== NODE SIGNATURES ========== */
+
+#if defined(HIF_METRICS) || defined(HIF_SIG_STATS)
+#define SIG_COUNT(ok)                                                  \
+    do {                                                               \
+        __atomic_fetch_add(&sig_checks, 1, __ATOMIC_RELAXED);          \
+        if (!(ok)) __atomic_fetch_add(&sig_rejects, 1, __ATOMIC_RELAXED); \
+    } while (0)
+#else
+#define SIG_COUNT(ok) ((void)0)
+#endif
+
+static uint64_t sig_bit(hif_vertex_t v)
+{
+    return (uint64_t)1 << ((vertex_fold(v) * 2654435761u) >> 26);
+}
+
+static void sig_compute(NodeSig *s, const hif_vertex_t *verts, int n)
+{
+    s->bits = 0;
+    for (int i = 0; i < n; ++i) s->bits |= sig_bit(verts[i]);
+    s->vmin = n ? verts[0]     : HIF_VERTEX_MAX;
+    s->vmax = n ? verts[n - 1] : HIF_VERTEX_MIN;
+}
+
+/* 0 if inner ⊆ outer is impossible; 1 if the merge has to decide. */
+static int sig_may_subset(const NodeSig *inner, const NodeSig *outer)
+{
+    int ok = !(inner->bits & ~outer->bits) &&
+             inner->vmin >= outer->vmin && inner->vmax <= outer->vmax;
+    SIG_COUNT(ok);
+    return ok;
+}
+
+/* query ⊆ nd */
+static int node_contains(const Node *nd, const hif_vertex_t *query, int nquery,
+                         const NodeSig *qs)
+{
+    MET_VISIT();
+    return sig_may_subset(qs, &nd->sig) &&
+           is_subset(query, nquery, nd->he.verts, nd->he.nverts);
+}
+
+/* nd ⊆ query */
+static int node_within(const Node *nd, const hif_vertex_t *query, int nquery,
+                       const NodeSig *qs)
+{
+    MET_VISIT();
+    return sig_may_subset(&nd->sig, qs) &&
+           is_subset(nd->he.verts, nd->he.nverts, query, nquery);
+}
+
+/*
+ * Every node below nd has a signature bit outside qs, so none of them
+ * can be a subset of the query.
+ */
+static int subtree_outside(const Node *nd, const NodeSig *qs)
+{
+    int out = (nd->sub_bits & ~qs->bits) != 0;
+    SIG_COUNT(!out);
+    return out;
+}
+
+void hif_signature_stats(unsigned long long *checks,
+                         unsigned long long *rejects, int reset)
+{
+#if defined(HIF_METRICS) || defined(HIF_SIG_STATS)
+    if (checks)  *checks  = __atomic_load_n(&sig_checks, __ATOMIC_RELAXED);
+    if (rejects) *rejects = __atomic_load_n(&sig_rejects, __ATOMIC_RELAXED);
+    if (reset) {
+        __atomic_store_n(&sig_checks, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&sig_rejects, 0, __ATOMIC_RELAXED);
+    }
+#else
+    (void)reset;
+    if (checks)  *checks  = 0;
+    if (rejects) *rejects = 0;
+#endif
+}
+
+static double overlap_ratio(const hif_vertex_t *A, int nA,
+                            const hif_vertex_t *B, int nB)
+{
+    int ov  = overlap_size(A, nA, B, nB);
+    int mn  = nA < nB ? nA : nB;
+    return mn > 0 ? (double)ov / mn : 0.0;
+}
+
+static int weights_similar(double w1, double w2)
+{
+    if (fabs(w1) < 1e-9 && fabs(w2) < 1e-9) return 1;
+    double diff = fabs(w1 - w2);
+    double avg  = (fabs(w1) + fabs(w2)) / 2.0;
+    return diff < avg * WEIGHT_TOLERANCE;
+}
+
+/*
+ * Strict weight-first comparison.
+ * Returns -1 if A should be parent, +1 if B should be parent, 0 if siblings.
+ */
+static int weighted_cmp(const Hyperedge *A, const Hyperedge *B)
+{
+    const double EPS = 1e-9;
+
+    if (A->weight > B->weight + EPS) return -1;
+    if (B->weight > A->weight + EPS) return  1;
+
+    /* Weights equal: use subset relationship */
+    int A_in_B = is_subset(A->verts, A->nverts, B->verts, B->nverts);
+    int B_in_A = is_subset(B->verts, B->nverts, A->verts, A->nverts);
+
+    if (B_in_A && !A_in_B) return -1;
+    if (A_in_B && !B_in_A) return  1;
+
+    /* Equal weight, incomparable sets: prefer larger for stability */
+    if (A->nverts > B->nverts) return -1;
+    if (B->nverts > A->nverts) return  1;
+
+    return 0; /* complete tie → siblings */
+}
+
+/* ========== NODE ARENA ========== */
+
+/*
+ * Size classes: 16-byte steps up to 256 bytes (nodes, short vertex sets,
+ * small children arrays), then powers of two.  A block is always carved
+ * at its class size, so a released block can serve any later request of
+ * the same class.  Requests larger than a quarter slab get a dedicated
+ * slab of their own.
+ */
+
+#define ARENA_ALIGN        16
+#define ARENA_SMALL_MAX    256
+#define ARENA_NUM_CLASSES  64
+
+typedef struct ArenaSlab {
+    struct ArenaSlab *next;
+    size_t            size;   /* usable bytes after the header */
+    size_t            used;
+} ArenaSlab;
+
+#define ARENA_SLAB_HEADER \
+    ((sizeof(ArenaSlab) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct NodeArena {
+    ArenaSlab *slabs;        /* current slab first */
+    size_t     slab_bytes;
+    size_t     reserved;
+    void      *free_lists[ARENA_NUM_CLASSES];
+};
+
+static int arena_class(size_t bytes, size_t *class_bytes)
+{
+    if (bytes <= ARENA_SMALL_MAX) {
+        int c = (int)((bytes + ARENA_ALIGN - 1) / ARENA_ALIGN);
+        if (c == 0) c = 1;
+        *class_bytes = (size_t)c * ARENA_ALIGN;
+        return c - 1;
+    }
+    int    c  = ARENA_SMALL_MAX / ARENA_ALIGN;
+    size_t sz = ARENA_SMALL_MAX * 2;
+    while (sz < bytes) { sz *= 2; c++; }
+    *class_bytes = sz;
+    return c;
+}
+
+static NodeArena *arena_create(size_t slab_bytes)
+{
+    NodeArena *a = calloc(1, sizeof(NodeArena));
+    if (!a) { perror("calloc"); exit(1); }
+    a->slab_bytes = slab_bytes ? slab_bytes : ARENA_DEFAULT_SLAB;
+    return a;
+}
+
+static void arena_destroy(NodeArena *a)
+{
+    if (!a) return;
+    ArenaSlab *s = a->slabs;
+    while (s) {
+        ArenaSlab *next = s->next;
+        free(s);
+        s = next;
+    }
+    free(a);
+}
+
+static ArenaSlab *arena_new_slab(NodeArena *a, size_t size)
+{
+    ArenaSlab *s = malloc(ARENA_SLAB_HEADER + size);
+    if (!s) { perror("malloc"); exit(1); }
+    s->size      = size;
+    s->used      = 0;
+    a->reserved += ARENA_SLAB_HEADER + size;
+    return s;
+}
+
+static void *arena_alloc(NodeArena *a, size_t bytes)
+{
+    size_t cb;
+    int    c = arena_class(bytes, &cb);
+
+    if (c < ARENA_NUM_CLASSES && a->free_lists[c]) {
+        void *p          = a->free_lists[c];
+        a->free_lists[c] = *(void**)p;
+        return p;
+    }
+
+    if (cb > a->slab_bytes / 4) {
+        /* dedicated slab, linked behind the current one */
+        ArenaSlab *s = arena_new_slab(a, cb);
+        s->used = cb;
+        if (a->slabs) { s->next = a->slabs->next; a->slabs->next = s; }
+        else          { s->next = NULL;           a->slabs       = s; }
+        return (char*)s + ARENA_SLAB_HEADER;
+    }
+
+    ArenaSlab *s = a->slabs;
+    if (!s || s->size - s->used < cb) {
+        s        = arena_new_slab(a, a->slab_bytes);
+        s->next  = a->slabs;
+        a->slabs = s;
+    }
+    void *p  = (char*)s + ARENA_SLAB_HEADER + s->used;
+    s->used += cb;
+    return p;
+}
+
+static void arena_release(NodeArena *a, void *p, size_t bytes)
+{
+    if (!p) return;
+    size_t cb;
+    int    c = arena_class(bytes, &cb);
+    if (c >= ARENA_NUM_CLASSES) return; /* reclaimed with the arena */
+    *(void**)p       = a->free_lists[c];
+    a->free_lists[c] = p;
+}
+
+/* Forest-level allocation: arena when present, otherwise malloc/free. */
+
+static void *forest_alloc(Forest *f, size_t bytes)
+{
+    MET(f, alloc_bytes, bytes);
+    if (f->arena) return arena_alloc(f->arena, bytes);
+    void *p = malloc(bytes);
+    if (!p) { perror("malloc"); exit(1); }
+    return p;
+}
+
+static void forest_release(Forest *f, void *p, size_t bytes)
+{
+    if (f->arena) arena_release(f->arena, p, bytes);
+    else          free(p);
+}
+
+static void *forest_grow(Forest *f, void *p, size_t old_bytes, size_t new_bytes)
+{
+    MET(f, alloc_bytes, new_bytes > old_bytes ? new_bytes - old_bytes : 0);
+    if (!f->arena) {
+        p = realloc(p, new_bytes);
+        if (!p) { perror("realloc"); exit(1); }
+        return p;
+    }
+    size_t old_cb, new_cb;
+    arena_class(old_bytes, &old_cb);
+    arena_class(new_bytes, &new_cb);
+    if (p && old_cb == new_cb) return p; /* already room in the block */
+    void *q = arena_alloc(f->arena, new_bytes);
+    if (p) {
+        memcpy(q, p, old_bytes);
+        arena_release(f->arena, p, old_bytes);
+    }
+    return q;
+}
+
+/* ========== CONCURRENCY: WRITER SIDE ========== */
+
+/*
+ * Readers never block the writer and never lock.  The writer:
+ *   - makes the sequence counter odd for the duration of a mutation,
+ *   - publishes grown arrays by storing the new pointer (release) before
+ *     the larger count (release), so a reader that loads the count first
+ *     never indexes past the array it then loads,
+ *   - retires unlinked memory with the current epoch and frees it once
+ *     every active reader entered a later epoch.
+ */
+
+enum { RETIRE_NODE, RETIRE_BLOCK, RETIRE_MALLOC };
+
+typedef struct {
+    void          *ptr;
+    size_t         bytes;   /* RETIRE_BLOCK: size passed to forest_release */
+    int            kind;
+    unsigned long  epoch;
+} Retired;
+
+typedef union {
+    unsigned long epoch;    /* 0 = outside a read section */
+    char          pad[64];  /* one cache line per reader */
+} ReaderEpoch;
+
+struct ForestSync {
+    unsigned       seq;          /* odd while a mutation is in progress */
+    unsigned long  epoch;        /* global epoch, starts at 1 */
+    int            write_depth;  /* nested public mutators */
+    ReaderEpoch   *readers;
+    int           *reader_used;
+    int            max_readers;
+    Retired       *retired;
+    int            nretired;
+    int            retired_cap;
+};
+
+static void node_release(Forest *f, Node *nd);
+
+static void sync_free_retired(Forest *f, Retired *r)
+{
+    switch (r->kind) {
+    case RETIRE_NODE:  node_release(f, r->ptr);               break;
+    case RETIRE_BLOCK: forest_release(f, r->ptr, r->bytes);   break;
+    default:           free(r->ptr);                          break;
+    }
+}
+
+static void sync_retire(Forest *f, void *ptr, size_t bytes, int kind)
+{
+    ForestSync *s = f->sync;
+    if (s->nretired >= s->retired_cap) {
+        s->retired_cap = s->retired_cap ? s->retired_cap * 2 : 64;
+        s->retired     = realloc(s->retired, sizeof(Retired) * s->retired_cap);
+        if (!s->retired) { perror("realloc"); exit(1); }
+    }
+    s->retired[s->nretired++] = (Retired){ ptr, bytes, kind, s->epoch };
+}
+
+/* Free every retired block no active reader can still reach. */
+static void sync_reclaim(Forest *f)
+{
+    ForestSync *s = f->sync;
+    if (s->nretired == 0) return;
+
+    /* readers entering from now on cannot see anything retired so far */
+    __atomic_add_fetch(&s->epoch, 1, __ATOMIC_SEQ_CST);
+
+    unsigned long min_active = __atomic_load_n(&s->epoch, __ATOMIC_SEQ_CST);
+    for (int r = 0; r < s->max_readers; ++r) {
+        unsigned long e = __atomic_load_n(&s->readers[r].epoch, __ATOMIC_SEQ_CST);
+        if (e != 0 && e < min_active) min_active = e;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < s->nretired; ++i) {
+        if (s->retired[i].epoch < min_active) sync_free_retired(f, &s->retired[i]);
+        else                                  s->retired[kept++] = s->retired[i];
+    }
+    s->nretired = kept;
+}
+
+static void writer_begin(Forest *f)
+{
+    ForestSync *s = f->sync;
+    if (!s || s->write_depth++ > 0) return;
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void writer_end(Forest *f)
+{
+    ForestSync *s = f->sync;
+    if (!s || --s->write_depth > 0) return;
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+    sync_reclaim(f);
+}
+
+/*
+ * Fields a concurrent reader loads while the writer may be rewriting
+ * them: the slots of published children/roots arrays (shifted, swapped
+ * and refilled in place) and weights.  Slots are release/acquire, so a
+ * node reached through one is seen initialised; weights are relaxed.
+ * Both compile to plain moves on x86 and ARMv8.
+ */
+static inline void slot_store(Node **slot, Node *nd)
+{
+    __atomic_store_n(slot, nd, __ATOMIC_RELEASE);
+}
+
+static inline Node *slot_load(Node *const *slot)
+{
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+static inline double node_weight(const Node *nd)
+{
+    hif_weight_t w;
+    __atomic_load(&nd->he.weight, &w, __ATOMIC_RELAXED);
+    return w;
+}
+
+static inline void node_set_weight(Node *nd, hif_weight_t w)
+{
+    __atomic_store(&nd->he.weight, &w, __ATOMIC_RELAXED);
+}
+
+/*
+ * Grow a published pointer array (children or roots) to new_cap slots.
+ * In concurrent mode the old array stays readable until reclaimed.
+ */
+static Node **sync_grow_array(Forest *f, Node **old, int n, int old_cap,
+                              int new_cap, int arena_backed)
+{
+    if (!arena_backed) MET(f, alloc_bytes, sizeof(Node*) * new_cap);
+    Node **fresh = arena_backed ? forest_alloc(f, sizeof(Node*) * new_cap)
+                                : malloc(sizeof(Node*) * new_cap);
+    if (!fresh) { perror("malloc"); exit(1); }
+    if (n) memcpy(fresh, old, sizeof(Node*) * n);
+    if (old) sync_retire(f, old, sizeof(Node*) * old_cap,
+                         arena_backed ? RETIRE_BLOCK : RETIRE_MALLOC);
+    return fresh;
+}
+
+/* ========== TRAVERSAL CORE ========== */
+
+/*
+ * Explicit-stack pre-order walks, so chain-shaped trees (depth ~ n) never
+ * overflow the C stack.  A Walk starts on WALK_INLINE entries inside the
+ * caller's frame and spills to the heap only for deep or wide trees; one
+ * Walk serves every root of a query.  Children are pushed in reverse, so
+ * pops reproduce the recursive visiting order, and the entry popped next
+ * is prefetched while the current node is examined.
+ */
+#if defined(__GNUC__)
+#define HIF_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define HIF_PREFETCH(p) ((void)0)
+#endif
+
+typedef struct {
+    Node *nd;
+    int   depth;
+} WalkEntry;
+
+typedef struct {
+    WalkEntry *data;
+    int        size;
+    int        cap;
+    WalkEntry  inline_buf[WALK_INLINE];
+} Walk;
+
+static void walk_init(Walk *w)
+{
+    w->data = w->inline_buf;
+    w->size = 0;
+    w->cap  = WALK_INLINE;
+}
+
+static void walk_free(Walk *w)
+{
+    if (w->data != w->inline_buf) free(w->data);
+}
+
+static void walk_push(Walk *w, Node *nd, int depth)
+{
+    if (w->size == w->cap) {
+        WalkEntry *grown = w->data == w->inline_buf
+                         ? malloc(sizeof(WalkEntry) * w->cap * 2)
+                         : realloc(w->data, sizeof(WalkEntry) * w->cap * 2);
+        if (!grown) { perror("realloc"); exit(1); }
+        if (w->data == w->inline_buf)
+            memcpy(grown, w->inline_buf, sizeof(WalkEntry) * w->size);
+        w->data = grown;
+        w->cap *= 2;
+    }
+    w->data[w->size].nd    = nd;
+    w->data[w->size].depth = depth;
+    w->size++;
+}
+
+/* Queue kids[0..n) so that kids[0] is popped next. */
+static void walk_push_children(Walk *w, Node *const *kids, int n, int depth)
+{
+    for (int i = n - 1; i >= 0; --i) walk_push(w, slot_load(&kids[i]), depth);
+}
+
+static int walk_pop(Walk *w, Node **nd, int *depth)
+{
+    if (w->size == 0) return 0;
+    const WalkEntry *e = &w->data[--w->size];
+    *nd = e->nd;
+    if (depth) *depth = e->depth;
+    if (w->size > 0) HIF_PREFETCH(w->data[w->size - 1].nd);
+    return 1;
+}
+
+/* Append to a growable result array. */
+static void result_push(Node ***result, int *count, int *cap, Node *nd)
+{
+    if (*count >= *cap) {
+        *cap    = *cap ? *cap * 2 : 16;
+        *result = realloc(*result, sizeof(Node*) * (*cap));
+        if (!*result) { perror("realloc"); exit(1); }
+    }
+    (*result)[(*count)++] = nd;
+}
+
+/*
+ * Query output sink: either a caller-owned NodeBuffer or a visitor that
+ * may stop the walk early.  Walkers test sink_emit's result and unwind.
+ */
+typedef struct {
+    NodeBuffer *buf;
+    NodeVisitor visit;
+    void       *user_data;
+    int         count;
+} NodeSink;
+
+static NodeSink sink_buffer(NodeBuffer *buf)
+{
+    NodeSink k = { buf, NULL, NULL, 0 };
+    buf->count = 0;
+    return k;
+}
+
+static NodeSink sink_visitor(NodeVisitor visit, void *user_data)
+{
+    NodeSink k = { NULL, visit, user_data, 0 };
+    return k;
+}
+
+/* Deliver nd.  Returns 0 once the visitor has asked to stop. */
+static int sink_emit(NodeSink *k, Node *nd)
+{
+    k->count++;
+    if (k->buf) {
+        result_push(&k->buf->items, &k->buf->count, &k->buf->cap, nd);
+        return 1;
+    }
+    return !k->visit(nd, k->user_data);
+}
+
+/*
+ * Start w on the stack buf retained from an earlier query, if larger than
+ * the inline one.  The walk owns it until walk_return hands it back.
+ */
+static void walk_borrow(Walk *w, NodeBuffer *buf)
+{
+    walk_init(w);
+    if (!buf || buf->scratch_bytes / sizeof(WalkEntry) <= WALK_INLINE) return;
+    w->data = buf->scratch;
+    w->cap  = (int)(buf->scratch_bytes / sizeof(WalkEntry));
+    buf->scratch       = NULL;
+    buf->scratch_bytes = 0;
+}
+
+/* Keep a spilled stack in buf for the next query instead of freeing it. */
+static void walk_return(Walk *w, NodeBuffer *buf)
+{
+    if (!buf || w->data == w->inline_buf) { walk_free(w); return; }
+    free(buf->scratch);
+    buf->scratch       = w->data;
+    buf->scratch_bytes = sizeof(WalkEntry) * w->cap;
+}
+
+/* Hand a buffer's results to a legacy caller, dropping its scratch. */
+static Node **buffer_detach(NodeBuffer *buf, int *count)
+{
+    free(buf->scratch);
+    *count = buf->count;
+    return buf->items;
+}
+
+void node_buffer_init(NodeBuffer *buf)
+{
+    memset(buf, 0, sizeof(*buf));
+}
+
+void node_buffer_free(NodeBuffer *buf)
+{
+    free(buf->items);
+    free(buf->scratch);
+    node_buffer_init(buf);
+}
+
+/* ========== NODE HELPERS ========== */
+
+/* Aggregates of a childless node (see node_agg_absorb). */
+static void node_agg_leaf(Node *nd)
+{
+    nd->sub_size   = 1;
+    nd->sub_height = 1;
+    nd->sub_maxdeg = 0;
+    nd->sub_wmin   = nd->he.weight;
+    nd->sub_wsum   = nd->he.weight;
+}
+
+static unsigned forest_version(const Forest *f);
+
+/*
+ * Create a node.  With owned_verts != NULL (malloc mode only) the node
+ * adopts that array instead of copying `verts`.
+ */
+static Node *node_create(Forest *f, const hif_vertex_t *verts, int nverts,
+                         double weight, hif_vertex_t *owned_verts)
+{
+    Node *nd = forest_alloc(f, sizeof(Node));
+    if (owned_verts && !f->arena) {
+        nd->he.verts = owned_verts;
+    } else {
+        nd->he.verts = forest_alloc(f, sizeof(hif_vertex_t) * nverts);
+        memcpy(nd->he.verts, verts, sizeof(hif_vertex_t) * nverts);
+    }
+    nd->he.nverts    = nverts;
+    nd->he.weight    = (hif_weight_t)weight;
+    nd->children     = NULL;
+    nd->nchildren    = 0;
+    nd->children_cap = 0;
+    sig_compute(&nd->sig, nd->he.verts, nverts);
+    nd->sub_bits     = nd->sig.bits;
+    nd->sub_any      = nd->sig.bits;
+    nd->root_slot    = -1;
+    nd->heap_slot    = -1;
+    nd->parent       = NULL;
+    nd->dup_count    = 1;
+    nd->version      = forest_version(f);
+    nd->verts_rc     = NULL;
+    nd->defer_slot   = -1;
+    node_agg_leaf(nd);
+    return nd;
+}
+
+/* Release a single node's storage (not its children). */
+static void node_release(Forest *f, Node *nd)
+{
+    forest_release(f, nd->children, sizeof(Node*) * nd->children_cap);
+    if (!nd->verts_rc || --*nd->verts_rc == 0) {   /* last version of the set */
+        forest_release(f, nd->he.verts, sizeof(hif_vertex_t) * nd->he.nverts);
+        forest_release(f, nd->verts_rc, sizeof(int));
+    }
+    forest_release(f, nd, sizeof(Node));
+}
+
+static void node_free(Forest *f, Node *nd)
+{
+    if (!nd) return;
+    Walk w;
+    walk_init(&w);
+    walk_push(&w, nd, 0);
+    while (walk_pop(&w, &nd, NULL)) {
+        walk_push_children(&w, nd->children, nd->nchildren, 0);
+        node_release(f, nd);   /* children are already on the stack */
+    }
+    walk_free(&w);
+}
+
+/* Fold a child's subtree signature summary into its new parent. */
+static void node_absorb_summary(Node *parent, const Node *child)
+{
+    parent->sub_bits &= child->sub_bits;
+    parent->sub_any  |= child->sub_any;
+}
+
+/*
+ * Subtree aggregates.  Adding a child folds it into the parent exactly
+ * (node_add_child); anything else (removal, re-weighting) is repaired by
+ * recomputing the affected nodes from their children, bottom-up.
+ * node_add_child does not touch the parent's ancestors: callers that
+ * attach below a linked node repair the path with agg_fix_path.
+ */
+static void node_agg_absorb(Node *parent, const Node *child)
+{
+    parent->sub_size += child->sub_size;
+    if (child->sub_height + 1 > parent->sub_height)
+        parent->sub_height = child->sub_height + 1;
+    if (child->sub_maxdeg > parent->sub_maxdeg)
+        parent->sub_maxdeg = child->sub_maxdeg;
+    if (parent->nchildren > parent->sub_maxdeg)
+        parent->sub_maxdeg = parent->nchildren;
+    if (child->sub_wmin < parent->sub_wmin) parent->sub_wmin = child->sub_wmin;
+    parent->sub_wsum += child->sub_wsum;
+}
+
+/* Recompute nd from its own fields and its children; 1 if anything changed. */
+static int node_agg_recompute(Node *nd)
+{
+    int          size = 1, height = 1, maxdeg = nd->nchildren;
+    hif_weight_t wmin = nd->he.weight;
+    double       wsum = nd->he.weight;
+    for (int i = 0; i < nd->nchildren; ++i) {
+        const Node *c = nd->children[i];
+        size += c->sub_size;
+        if (c->sub_height + 1 > height) height = c->sub_height + 1;
+        if (c->sub_maxdeg > maxdeg)     maxdeg = c->sub_maxdeg;
+        if (c->sub_wmin < wmin)         wmin   = c->sub_wmin;
+        wsum += c->sub_wsum;
+    }
+    int changed = size != nd->sub_size || height != nd->sub_height ||
+                  maxdeg != nd->sub_maxdeg || wmin != nd->sub_wmin ||
+                  wsum != nd->sub_wsum;
+    nd->sub_size   = size;
+    nd->sub_height = height;
+    nd->sub_maxdeg = maxdeg;
+    nd->sub_wmin   = wmin;
+    nd->sub_wsum   = wsum;
+    return changed;
+}
+
+/*
+ * Repair aggregates from nd to its root.  With full == 0 the walk stops
+ * at the first unchanged node, which is only valid when nd is the sole
+ * changed point on the path.
+ */
+static void agg_fix_path(Node *nd, int full)
+{
+    for (; nd; nd = nd->parent)
+        if (!node_agg_recompute(nd) && !full) break;
+}
+
+static void node_add_child(Forest *f, Node *parent, Node *child)
+{
+    if (parent->nchildren >= parent->children_cap) {
+        int newcap = parent->children_cap ? parent->children_cap * 2 : 4;
+        Node **grown;
+        if (f->sync)
+            grown = sync_grow_array(f, parent->children, parent->nchildren,
+                                    parent->children_cap, newcap, 1);
+        else
+            grown = forest_grow(f, parent->children,
+                                sizeof(Node*) * parent->children_cap,
+                                sizeof(Node*) * newcap);
+        __atomic_store_n(&parent->children, grown, __ATOMIC_RELEASE);
+        parent->children_cap = newcap;
+    }
+    slot_store(&parent->children[parent->nchildren], child);
+    __atomic_store_n(&parent->nchildren, parent->nchildren + 1, __ATOMIC_RELEASE);
+    node_absorb_summary(parent, child);  /* ancestors: see insert_into_node */
+    node_agg_absorb(parent, child);
+    child->parent = parent;
+}
+
+/* ========== HEAP IMPLEMENTATION ========== */
+
+NodeHeap *heap_create(void)
+{
+    NodeHeap *h = malloc(sizeof(NodeHeap));
+    if (!h) { perror("malloc"); exit(1); }
+    h->data = NULL;
+    h->size = 0;
+    h->cap  = 0;
+    return h;
+}
+
+void heap_free(NodeHeap *h)
+{
+    if (!h) return;
+    free(h->data);
+    free(h);
+}
+
+static void heap_ensure_cap(NodeHeap *h)
+{
+    if (h->size < h->cap) return;
+    h->cap  = h->cap ? h->cap * 2 : 8;
+    h->data = realloc(h->data, sizeof(Node*) * h->cap);
+    if (!h->data) { perror("realloc"); exit(1); }
+}
+
+static void heap_sift_up(NodeHeap *h, int i)
+{
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (node_weight(h->data[parent]) >= node_weight(h->data[i])) break;
+        Node *tmp        = h->data[parent];
+        h->data[parent]  = h->data[i];
+        h->data[i]       = tmp;
+        i = parent;
+    }
+}
+
+static void heap_sift_down(NodeHeap *h, int i)
+{
+    while (1) {
+        int largest = i;
+        int left    = 2 * i + 1;
+        int right   = 2 * i + 2;
+        if (left  < h->size && node_weight(h->data[left])  > node_weight(h->data[largest])) largest = left;
+        if (right < h->size && node_weight(h->data[right]) > node_weight(h->data[largest])) largest = right;
+        if (largest == i) break;
+        Node *tmp        = h->data[i];
+        h->data[i]       = h->data[largest];
+        h->data[largest] = tmp;
+        i = largest;
+    }
+}
+
+void heap_push(NodeHeap *h, Node *nd)
+{
+    heap_ensure_cap(h);
+    h->data[h->size++] = nd;
+    heap_sift_up(h, h->size - 1);
+}
+
+Node *heap_pop(NodeHeap *h)
+{
+    if (h->size == 0) return NULL;
+    Node *top    = h->data[0];
+    h->data[0]   = h->data[--h->size];
+    if (h->size > 0) heap_sift_down(h, 0);
+    return top;
+}
+
+/* ========== FOREST ROOT MANAGEMENT ========== */
+
+/*
+ * f->root_heap is an indexed max-heap: every root records its heap slot,
+ * so a root can be removed or re-keyed in O(log n) without a search.
+ * The public heap_* functions are for scratch heaps and do not touch
+ * heap_slot.
+ */
+static void root_heap_place(NodeHeap *h, int i, Node *nd)
+{
+    h->data[i]    = nd;
+    nd->heap_slot = i;
+}
+
+static void root_heap_sift_up(NodeHeap *h, int i)
+{
+    Node *nd = h->data[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (h->data[parent]->he.weight >= nd->he.weight) break;
+        root_heap_place(h, i, h->data[parent]);
+        i = parent;
+    }
+    root_heap_place(h, i, nd);
+}
+
+static void root_heap_sift_down(NodeHeap *h, int i)
+{
+    Node *nd = h->data[i];
+    for (;;) {
+        int    largest = i;
+        int    left    = 2 * i + 1;
+        int    right   = 2 * i + 2;
+        double best    = nd->he.weight;
+        if (left < h->size && h->data[left]->he.weight > best) {
+            largest = left;
+            best    = h->data[left]->he.weight;
+        }
+        if (right < h->size && h->data[right]->he.weight > best)
+            largest = right;
+        if (largest == i) break;
+        root_heap_place(h, i, h->data[largest]);
+        i = largest;
+    }
+    root_heap_place(h, i, nd);
+}
+
+static void root_heap_insert(NodeHeap *h, Node *nd)
+{
+    heap_ensure_cap(h);
+    root_heap_place(h, h->size++, nd);
+    root_heap_sift_up(h, h->size - 1);
+}
+
+static void root_heap_remove(NodeHeap *h, Node *nd)
+{
+    int i = nd->heap_slot;
+    nd->heap_slot = -1;
+    if (i < 0) return;
+    if (--h->size == i) return;
+    Node *moved = h->data[h->size];
+    root_heap_place(h, i, moved);
+    root_heap_sift_up(h, i);
+    root_heap_sift_down(h, moved->heap_slot);
+}
+
+/* Restore heap order after nd's weight changed (either direction). */
+static void root_heap_update(NodeHeap *h, Node *nd)
+{
+    if (nd->heap_slot < 0) return;
+    root_heap_sift_up(h, nd->heap_slot);
+    root_heap_sift_down(h, nd->heap_slot);
+}
+
+static void forest_add_root(Forest *f, Node *r)
+{
+    MET(f, root_heap_ops, 1);
+    if (f->nroots >= f->roots_cap) {
+        int newcap  = f->roots_cap ? f->roots_cap * 2 : 8;
+        Node **grown;
+        if (f->sync) {
+            grown = sync_grow_array(f, f->roots, f->nroots, f->roots_cap,
+                                    newcap, 0);
+        } else {
+            grown = realloc(f->roots, sizeof(Node*) * newcap);
+            if (!grown) { perror("realloc"); exit(1); }
+        }
+        __atomic_store_n(&f->roots, grown, __ATOMIC_RELEASE);
+        f->roots_cap = newcap;
+    }
+    slot_store(&f->roots[f->nroots], r);
+    r->root_slot        = f->nroots;
+    r->parent           = NULL;
+    __atomic_store_n(&f->nroots, f->nroots + 1, __ATOMIC_RELEASE);
+    root_heap_insert(f->root_heap, r);
+}
+
+/*
+ * Swap-remove: the last root moves into idx, so callers scanning roots
+ * re-examine idx instead of advancing (as they already did for the
+ * old shifting removal).
+ */
+static void forest_remove_root_at(Forest *f, int idx)
+{
+    if (idx < 0 || idx >= f->nroots) return;
+    MET(f, root_heap_ops, 1);
+    Node *r    = f->roots[idx];
+    int   last = f->nroots - 1;
+    if (idx != last) {
+        slot_store(&f->roots[idx], f->roots[last]);
+        f->roots[idx]->root_slot = idx;
+    }
+    __atomic_store_n(&f->nroots, last, __ATOMIC_RELEASE);
+    r->root_slot = -1;
+    root_heap_remove(f->root_heap, r);
+}
+
+/*
+ * Lazy weight-order frontier.  root_heap is itself a max-heap, so rather
+ * than copying every root the frontier starts from slot 0 and expands a
+ * root slot into its two heap children, and a node into its tree
+ * children, only when it is popped.  The first k pops cost O(k log k)
+ * regardless of the number of roots.
+ */
+typedef struct {
+    Node *nd;
+    int   slot;   /* root_heap slot, or -1 for a non-root node */
+} FrontierEntry;
+
+typedef struct {
+    FrontierEntry *data;
+    int            size;
+    int            cap;
+} Frontier;
+
+static void frontier_push(Frontier *q, Node *nd, int slot)
+{
+    if (q->size == q->cap) {
+        q->cap  = q->cap ? q->cap * 2 : 16;
+        q->data = realloc(q->data, sizeof(FrontierEntry) * q->cap);
+        if (!q->data) { perror("realloc"); exit(1); }
+    }
+    int i = q->size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (q->data[parent].nd->he.weight >= nd->he.weight) break;
+        q->data[i] = q->data[parent];
+        i = parent;
+    }
+    q->data[i].nd   = nd;
+    q->data[i].slot = slot;
+}
+
+static void frontier_init(Frontier *q, const NodeHeap *roots)
+{
+    q->data = NULL;
+    q->size = q->cap = 0;
+    if (roots->size > 0) frontier_push(q, roots->data[0], 0);
+}
+
+/*
+ * Pop the heaviest pending node and expose its successors; NULL at end.
+ * Tree children are only exposed when their sub_any holds every bit of
+ * need, so need = 0 orders the whole forest.  Root-heap children are
+ * always exposed: they are other trees.
+ */
+static Node *frontier_next_covering(Frontier *q, const NodeHeap *roots,
+                                    uint64_t need)
+{
+    if (q->size == 0) return NULL;
+    FrontierEntry top  = q->data[0];
+    FrontierEntry last = q->data[--q->size];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= q->size) break;
+        if (c + 1 < q->size &&
+            q->data[c + 1].nd->he.weight > q->data[c].nd->he.weight) ++c;
+        if (q->data[c].nd->he.weight <= last.nd->he.weight) break;
+        q->data[i] = q->data[c];
+        i = c;
+    }
+    if (q->size > 0) q->data[i] = last;
+
+    if (top.slot >= 0) {
+        for (int c = 2 * top.slot + 1; c <= 2 * top.slot + 2; ++c)
+            if (c < roots->size) frontier_push(q, roots->data[c], c);
+    }
+    for (int c = 0; c < top.nd->nchildren; ++c) {
+        Node *ch = top.nd->children[c];
+        if ((ch->sub_any & need) == need) frontier_push(q, ch, -1);
+    }
+    return top.nd;
+}
+
+static Node *frontier_next(Frontier *q, const NodeHeap *roots)
+{
+    return frontier_next_covering(q, roots, 0);
+}
+
+/* ========== VERTEX INDEX ========== */
+
+/*
+ * Open-addressing hash (linear probing) from vertex ID to a posting list
+ * of the nodes containing that vertex.  Postings are unordered; removal
+ * is a linear scan of the list followed by swap-remove.
+ */
+
+typedef struct {
+    Node **nodes;
+    int    count;
+    int    cap;
+} PostingList;
+
+struct VertexIndex {
+    hif_vertex_t  *keys;
+    unsigned char *used;
+    PostingList   *lists;
+    int            cap;    /* power of two */
+    int            size;   /* occupied slots */
+    int            nodes;  /* nodes indexed */
+};
+
+static unsigned vindex_hash(hif_vertex_t v)
+{
+    return vertex_fold(v) * 2654435761u;
+}
+
+static VertexIndex *vindex_create(int cap)
+{
+    VertexIndex *ix = malloc(sizeof(VertexIndex));
+    if (!ix) { perror("malloc"); exit(1); }
+    ix->cap   = 16;
+    while (ix->cap < cap * 2) ix->cap *= 2;
+    ix->size  = 0;
+    ix->nodes = 0;
+    ix->keys  = malloc(sizeof(hif_vertex_t) * ix->cap);
+    ix->used  = calloc(ix->cap, 1);
+    ix->lists = calloc(ix->cap, sizeof(PostingList));
+    if (!ix->keys || !ix->used || !ix->lists) { perror("malloc"); exit(1); }
+    return ix;
+}
+
+static void vindex_free(VertexIndex *ix)
+{
+    if (!ix) return;
+    for (int i = 0; i < ix->cap; ++i)
+        if (ix->used[i]) free(ix->lists[i].nodes);
+    free(ix->keys);
+    free(ix->used);
+    free(ix->lists);
+    free(ix);
+}
+
+static PostingList *vindex_find(const VertexIndex *ix, hif_vertex_t v)
+{
+    unsigned mask = (unsigned)ix->cap - 1;
+    for (unsigned i = vindex_hash(v) & mask; ix->used[i]; i = (i + 1) & mask)
+        if (ix->keys[i] == v) return &ix->lists[i];
+    return NULL;
+}
+
+static void vindex_grow(VertexIndex *ix)
+{
+    int            old_cap   = ix->cap;
+    hif_vertex_t  *old_keys  = ix->keys;
+    unsigned char *old_used  = ix->used;
+    PostingList   *old_lists = ix->lists;
+
+    ix->cap  *= 2;
+    ix->keys  = malloc(sizeof(hif_vertex_t) * ix->cap);
+    ix->used  = calloc(ix->cap, 1);
+    ix->lists = calloc(ix->cap, sizeof(PostingList));
+    if (!ix->keys || !ix->used || !ix->lists) { perror("malloc"); exit(1); }
+
+    unsigned mask = (unsigned)ix->cap - 1;
+    for (int i = 0; i < old_cap; ++i) {
+        if (!old_used[i]) continue;
+        unsigned j = vindex_hash(old_keys[i]) & mask;
+        while (ix->used[j]) j = (j + 1) & mask;
+        ix->used[j]  = 1;
+        ix->keys[j]  = old_keys[i];
+        ix->lists[j] = old_lists[i];
+    }
+    free(old_keys);
+    free(old_used);
+    free(old_lists);
+}
+
+static PostingList *vindex_get_or_add(VertexIndex *ix, hif_vertex_t v)
+{
+    PostingList *pl = vindex_find(ix, v);
+    if (pl) return pl;
+
+    if ((ix->size + 1) * 2 > ix->cap) vindex_grow(ix);
+    unsigned mask = (unsigned)ix->cap - 1;
+    unsigned i    = vindex_hash(v) & mask;
+    while (ix->used[i]) i = (i + 1) & mask;
+    ix->used[i] = 1;
+    ix->keys[i] = v;
+    ix->size++;
+    return &ix->lists[i];
+}
+
+static void vindex_add_node(VertexIndex *ix, Node *nd)
+{
+    ix->nodes++;
+    for (int k = 0; k < nd->he.nverts; ++k) {
+        PostingList *pl = vindex_get_or_add(ix, nd->he.verts[k]);
+        if (pl->count >= pl->cap) {
+            pl->cap   = pl->cap ? pl->cap * 2 : 4;
+            pl->nodes = realloc(pl->nodes, sizeof(Node*) * pl->cap);
+            if (!pl->nodes) { perror("realloc"); exit(1); }
+        }
+        pl->nodes[pl->count++] = nd;
+    }
+}
+
+/* Empty posting lists stay in the table; they cost one slot each. */
+static void vindex_remove_node(VertexIndex *ix, Node *nd)
+{
+    ix->nodes--;
+    for (int k = 0; k < nd->he.nverts; ++k) {
+        PostingList *pl = vindex_find(ix, nd->he.verts[k]);
+        if (!pl) continue;
+        for (int i = 0; i < pl->count; ++i) {
+            if (pl->nodes[i] == nd) {
+                pl->nodes[i] = pl->nodes[--pl->count];
+                break;
+            }
+        }
+    }
+}
+
+static void vindex_add_subtree(VertexIndex *ix, Node *nd)
+{
+    Walk w;
+    walk_init(&w);
+    walk_push(&w, nd, 0);
+    while (walk_pop(&w, &nd, NULL)) {
+        vindex_add_node(ix, nd);
+        walk_push_children(&w, nd->children, nd->nchildren, 0);
+    }
+    walk_free(&w);
+}
+
+/*
+ * Shortest posting list among the query vertices, i.e. the candidate set
+ * for "contains all of query".  Returns NULL with *empty = 1 if some
+ * query vertex occurs nowhere (no node can match).
+ */
+static PostingList *vindex_rarest(const VertexIndex *ix,
+                                  const hif_vertex_t *query, int nquery,
+                                  int *empty)
+{
+    PostingList *best = NULL;
+    *empty = 0;
+    for (int i = 0; i < nquery; ++i) {
+        PostingList *pl = vindex_find(ix, query[i]);
+        if (!pl || pl->count == 0) { *empty = 1; return NULL; }
+        if (!best || pl->count < best->count) best = pl;
+    }
+    return best;
+}
+
+/* ========== CANONICAL SET TABLE ========== */
+
+/*
+ * Open addressing with linear probing over (hash, node) pairs.  Nodes
+ * with equal vertex sets are separate entries on the same probe run.
+ * Deletion shifts later entries back, so there are no tombstones.
+ */
+struct SetTable {
+    Node    **nodes;   /* NULL = empty slot */
+    uint64_t *hashes;
+    size_t    cap;     /* power of two      */
+    size_t    size;
+};
+
+static uint64_t set_hash(const hif_vertex_t *verts, int n)
+{
+    uint64_t h = 0xcbf29ce484222325ull ^ (uint64_t)n;
+    for (int i = 0; i < n; ++i) {
+        h ^= vertex_fold(verts[i]);
+        h *= 0x100000001b3ull;
+    }
+    /* final avalanche (splitmix64) so low bits are usable as an index */
+    h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27; h *= 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+static int set_equal(const Node *nd, const hif_vertex_t *verts, int n)
+{
+    return nd->he.nverts == n &&
+           (n == 0 ||
+            memcmp(nd->he.verts, verts, sizeof(hif_vertex_t) * n) == 0);
+}
+
+static SetTable *settable_create(size_t want)
+{
+    SetTable *t = malloc(sizeof(SetTable));
+    if (!t) { perror("malloc"); exit(1); }
+    t->cap = 16;
+    while (t->cap < want * 2) t->cap *= 2;
+    t->size   = 0;
+    t->nodes  = calloc(t->cap, sizeof(Node*));
+    t->hashes = malloc(sizeof(uint64_t) * t->cap);
+    if (!t->nodes || !t->hashes) { perror("calloc"); exit(1); }
+    return t;
+}
+
+static void settable_free(SetTable *t)
+{
+    if (!t) return;
+    free(t->nodes);
+    free(t->hashes);
+    free(t);
+}
+
+static void settable_put(SetTable *t, Node *nd, uint64_t h)
+{
+    size_t i = h & (t->cap - 1);
+    while (t->nodes[i]) i = (i + 1) & (t->cap - 1);
+    t->nodes[i]  = nd;
+    t->hashes[i] = h;
+    t->size++;
+}
+
+static void settable_add(SetTable *t, Node *nd)
+{
+    if ((t->size + 1) * 4 > t->cap * 3) {
+        /* grow at 75% load */
+        Node    **old_n = t->nodes;
+        uint64_t *old_h = t->hashes;
+        size_t    old_c = t->cap;
+        t->cap   *= 2;
+        t->size   = 0;
+        t->nodes  = calloc(t->cap, sizeof(Node*));
+        t->hashes = malloc(sizeof(uint64_t) * t->cap);
+        if (!t->nodes || !t->hashes) { perror("calloc"); exit(1); }
+        for (size_t i = 0; i < old_c; ++i)
+            if (old_n[i]) settable_put(t, old_n[i], old_h[i]);
+        free(old_n);
+        free(old_h);
+    }
+    settable_put(t, nd, set_hash(nd->he.verts, nd->he.nverts));
+}
+
+static void settable_remove(SetTable *t, Node *nd)
+{
+    size_t mask = t->cap - 1;
+    size_t i    = set_hash(nd->he.verts, nd->he.nverts) & mask;
+    while (t->nodes[i] && t->nodes[i] != nd) i = (i + 1) & mask;
+    if (!t->nodes[i]) return;
+
+    /* backward-shift: pull later run members into the hole */
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; t->nodes[j]; j = (j + 1) & mask) {
+        size_t home = t->hashes[j] & mask;
+        /* j may move to hole unless its home lies cyclically in (hole, j] */
+        int stays = hole <= j ? (home > hole && home <= j)
+                              : (home > hole || home <= j);
+        if (stays) continue;
+        t->nodes[hole]  = t->nodes[j];
+        t->hashes[hole] = t->hashes[j];
+        hole = j;
+    }
+    t->nodes[hole] = NULL;
+    t->size--;
+}
+
+/*
+ * Nodes whose set equals verts (sorted, duplicate-free).  Returns a
+ * malloc'd array (NULL if none); the table may be modified afterwards.
+ */
+static Node **settable_find_all(const SetTable *t, const hif_vertex_t *verts,
+                                int n, int *count)
+{
+    Node **out = NULL;
+    int    cnt = 0, cap = 0;
+    uint64_t h = set_hash(verts, n);
+    for (size_t i = h & (t->cap - 1); t->nodes[i]; i = (i + 1) & (t->cap - 1)) {
+        if (t->hashes[i] != h || !set_equal(t->nodes[i], verts, n)) continue;
+        if (cnt >= cap) {
+            cap = cap ? cap * 2 : 4;
+            out = realloc(out, sizeof(Node*) * cap);
+            if (!out) { perror("realloc"); exit(1); }
+        }
+        out[cnt++] = t->nodes[i];
+    }
+    *count = cnt;
+    return out;
+}
+
+/* First node whose set equals verts (sorted, duplicate-free), or NULL. */
+static Node *settable_find(const SetTable *t, const hif_vertex_t *verts, int n)
+{
+    uint64_t h = set_hash(verts, n);
+    for (size_t i = h & (t->cap - 1); t->nodes[i]; i = (i + 1) & (t->cap - 1))
+        if (t->hashes[i] == h && set_equal(t->nodes[i], verts, n))
+            return t->nodes[i];
+    return NULL;
+}
+
+static void node_retire(Forest *f, Node *nd);
+static void defer_remove(Forest *f, Node *nd);
+
+/*
+ * Free a detached subtree, dropping its nodes from the vertex index and
+ * set table.  Returns the number of nodes released.
+ */
+static int forest_release_subtree(Forest *f, Node *nd)
+{
+    int  released = 0;
+    Walk w;
+    walk_init(&w);
+    walk_push(&w, nd, 0);
+    while (walk_pop(&w, &nd, NULL)) {
+        walk_push_children(&w, nd->children, nd->nchildren, 0);
+        if (f->vindex) vindex_remove_node(f->vindex, nd);
+        if (f->sets)   settable_remove(f->sets, nd);
+        defer_remove(f, nd);
+        if (f->sync) sync_retire(f, nd, 0, RETIRE_NODE);
+        else         node_retire(f, nd);
+        released++;
+    }
+    walk_free(&w);
+    return released;
+}
+
+/* ========== QUERY CACHE ========== */
+
+/*
+ * Memo for find_minimal_superset / find_heaviest_superset, keyed by
+ * (query set, kind).  Only sets containing every query vertex can change
+ * either answer, so a mutation of set S bumps the generation and stamps
+ * S's vertices (hashed into QCACHE_STAMPS buckets; a shared bucket only
+ * invalidates more).  An entry filled at generation g stays valid while
+ * some query vertex is unstamped since g.  Bulk restructuring flushes
+ * everything.  Two-way set associative, least recently used evicted.
+ */
+typedef struct {
+    uint64_t           hash;
+    hif_vertex_t      *verts;
+    int                nverts;
+    int                verts_cap;
+    int                kind;      /* 0 minimal, 1 heaviest; -1 = empty slot */
+    Node              *result;
+    unsigned long long gen;
+    unsigned long long used;      /* LRU tick */
+} QCacheEntry;
+
+struct QueryCache {
+    QCacheEntry       *slots;
+    int                cap;       /* power of two, >= 2 */
+    unsigned long long gen;
+    unsigned long long flush_gen; /* entries older than this are dead */
+    unsigned long long tick;
+    unsigned long long hits, misses;
+    unsigned long long stamps[QCACHE_STAMPS];
+};
+
+static unsigned qcache_bucket(hif_vertex_t v)
+{
+    return (vindex_hash(v) >> 16) & (QCACHE_STAMPS - 1);
+}
+
+/* Record a mutation of the set verts[0..n). */
+static void qcache_touch(Forest *f, const hif_vertex_t *verts, int n)
+{
+    QueryCache *c = f->qcache;
+    if (!c) return;
+    c->gen++;
+    for (int i = 0; i < n; ++i) c->stamps[qcache_bucket(verts[i])] = c->gen;
+}
+
+/* Invalidate every entry (rebalance, prune, index changes). */
+static void qcache_flush(Forest *f)
+{
+    QueryCache *c = f->qcache;
+    if (!c) return;
+    c->flush_gen = ++c->gen;
+}
+
+static int qcache_valid(const QueryCache *c, const QCacheEntry *e)
+{
+    if (e->gen < c->flush_gen) return 0;
+    for (int i = 0; i < e->nverts; ++i)
+        if (c->stamps[qcache_bucket(e->verts[i])] <= e->gen) return 1;
+    return 0;
+}
+
+/* Cached answer in *out, or 0 on a miss. */
+static int qcache_lookup(Forest *f, const hif_vertex_t *query, int nquery,
+                         int kind, uint64_t h, Node **out)
+{
+    QueryCache  *c = f->qcache;
+    QCacheEntry *set = &c->slots[h & (uint64_t)(c->cap - 2)];
+    for (int i = 0; i < 2; ++i) {
+        QCacheEntry *e = &set[i];
+        if (e->kind != kind || e->hash != h || e->nverts != nquery ||
+            memcmp(e->verts, query, sizeof(hif_vertex_t) * nquery) != 0)
+            continue;
+        if (!qcache_valid(c, e)) break;
+        e->used = ++c->tick;
+        c->hits++;
+        *out = e->result;
+        return 1;
+    }
+    c->misses++;
+    return 0;
+}
+
+static void qcache_store(Forest *f, const hif_vertex_t *query, int nquery,
+                         int kind, uint64_t h, Node *result)
+{
+    QueryCache  *c = f->qcache;
+    QCacheEntry *set = &c->slots[h & (uint64_t)(c->cap - 2)];
+    QCacheEntry *e = set[0].used <= set[1].used ? &set[0] : &set[1];
+    for (int i = 0; i < 2; ++i)                 /* refresh a stale copy */
+        if (set[i].kind == kind && set[i].hash == h) e = &set[i];
+    if (nquery > e->verts_cap) {
+        free(e->verts);
+        e->verts_cap = nquery;
+        e->verts     = malloc(sizeof(hif_vertex_t) * nquery);
+        if (!e->verts) { perror("malloc"); exit(1); }
+    }
+    memcpy(e->verts, query, sizeof(hif_vertex_t) * nquery);
+    e->hash   = h;
+    e->nverts = nquery;
+    e->kind   = kind;
+    e->result = result;
+    e->gen    = c->gen;
+    e->used   = ++c->tick;
+}
+
+/* The cache keeps its own hit/miss counts, so they work in every build. */
+static void qcache_counters(QueryCache *c, ForestMetrics *m, int reset)
+{
+    if (!c) return;
+    if (m) {
+        m->cache_hits   = c->hits;
+        m->cache_misses = c->misses;
+    }
+    if (reset) c->hits = c->misses = 0;
+}
+
+static void qcache_free(QueryCache *c)
+{
+    if (!c) return;
+    for (int i = 0; i < c->cap; ++i) free(c->slots[i].verts);
+    free(c->slots);
+    free(c);
+}
+
+void forest_enable_query_cache(Forest *f, int capacity)
+{
+    qcache_free(f->qcache);
+    QueryCache *c = calloc(1, sizeof(QueryCache));
+    if (!c) { perror("calloc"); exit(1); }
+    c->cap = 2;
+    while (c->cap < capacity) c->cap *= 2;
+    c->slots = calloc(c->cap, sizeof(QCacheEntry));
+    if (!c->slots) { perror("calloc"); exit(1); }
+    for (int i = 0; i < c->cap; ++i) c->slots[i].kind = -1;
+    f->qcache = c;
+}
+
+void forest_disable_query_cache(Forest *f)
+{
+    qcache_free(f->qcache);
+    f->qcache = NULL;
+}
+
+/* ========== VERSIONED SNAPSHOTS ========== */
+
+/*
+ * A snapshot shares every node with the live forest.  Nodes born no later
+ * than the newest open snapshot are frozen: the writer never changes
+ * their weight, children or aggregates but path-copies them first
+ * (node_writable), sharing the vertex array.  parent, root_slot and
+ * heap_slot describe the live forest only and no query reads them, so
+ * the writer keeps them current even on frozen nodes.  A frozen node
+ * leaving the live forest is parked in the graveyard with the version it
+ * died at, and freed once no open snapshot lies in [born, died).
+ */
+typedef struct {
+    Node    *nd;
+    unsigned died;
+} GraveEntry;
+
+struct ForestVersions {
+    unsigned    version;   /* live: stamped on new nodes; snapshot: its own */
+    unsigned    newest;    /* live: version of the newest open snapshot     */
+    Forest     *origin;    /* snapshot: the live forest; NULL when live     */
+    Forest    **snaps;     /* live: open snapshots                          */
+    int         nsnaps, snaps_cap;
+    GraveEntry *grave;
+    int         ngrave, grave_cap;
+};
+
+/* Snapshots are read-only: every mutator returns early on one. */
+static int forest_is_snapshot(const Forest *f)
+{
+    return f->versions && f->versions->origin;
+}
+
+static unsigned forest_version(const Forest *f)
+{
+    return f->versions ? f->versions->version : 0;
+}
+
+static int node_frozen(const Forest *f, const Node *nd)
+{
+    const ForestVersions *v = f->versions;
+    return v && v->nsnaps > 0 && nd->version <= v->newest;
+}
+
+static void grave_push(ForestVersions *v, Node *nd)
+{
+    if (v->ngrave == v->grave_cap) {
+        v->grave_cap = v->grave_cap ? v->grave_cap * 2 : 64;
+        v->grave = realloc(v->grave, sizeof(GraveEntry) * v->grave_cap);
+        if (!v->grave) { perror("realloc"); exit(1); }
+    }
+    v->grave[v->ngrave].nd   = nd;
+    v->grave[v->ngrave].died = v->version;
+    v->ngrave++;
+}
+
+/* nd has left the live forest: free it unless a snapshot still sees it. */
+static void node_retire(Forest *f, Node *nd)
+{
+    if (node_frozen(f, nd)) grave_push(f->versions, nd);
+    else                    node_release(f, nd);
+}
+
+/*
+ * Copy x's header and children array; the caller decides about the
+ * vertex set.  Nothing points at the copy yet.
+ */
+static Node *node_copy(Forest *f, const Node *x)
+{
+    Node *c = forest_alloc(f, sizeof(Node));
+    *c = *x;
+    c->version      = forest_version(f);
+    c->children_cap = x->nchildren;
+    c->children     = NULL;
+    if (x->nchildren) {
+        c->children = forest_alloc(f, sizeof(Node*) * x->nchildren);
+        memcpy(c->children, x->children, sizeof(Node*) * x->nchildren);
+    }
+    return c;
+}
+
+/*
+ * Put copy c in x's place: in its (writable) parent or the root arrays,
+ * the index, the set table and the deferred queue.  c adopts x's
+ * children; x is left for the caller to retire.
+ */
+static void node_replace(Forest *f, Node *x, Node *c)
+{
+    for (int i = 0; i < c->nchildren; ++i) c->children[i]->parent = c;
+    Node *p = x->parent;
+    if (p) {
+        int i = 0;
+        while (p->children[i] != x) i++;
+        slot_store(&p->children[i], c);
+    } else {
+        slot_store(&f->roots[x->root_slot], c);
+        f->root_heap->data[x->heap_slot] = c;
+    }
+    if (f->vindex) { vindex_remove_node(f->vindex, x); vindex_add_node(f->vindex, c); }
+    if (f->sets)   { settable_remove(f->sets, x);      settable_add(f->sets, c); }
+    if (x->defer_slot >= 0) f->deferred[x->defer_slot] = c;
+    qcache_touch(f, x->he.verts, x->he.nverts);   /* cached answers may be x */
+}
+
+/*
+ * Copy frozen x for the live forest, sharing its vertex set, while x
+ * itself stays untouched for the snapshots.
+ */
+static Node *node_clone(Forest *f, Node *x)
+{
+    Node *c = node_copy(f, x);
+    if (!x->verts_rc) {
+        x->verts_rc  = forest_alloc(f, sizeof(int));
+        *x->verts_rc = 1;
+    }
+    c->verts_rc = x->verts_rc;
+    (*c->verts_rc)++;
+    node_replace(f, x, c);
+    grave_push(f->versions, x);
+    return c;
+}
+
+/*
+ * The live, modifiable version of nd.  Copies nd and every frozen
+ * ancestor above it, top-down, so afterwards nd's whole ancestor chain is
+ * writable.  Pointers the caller holds to copied ancestors go stale.
+ */
+static Node *node_writable(Forest *f, Node *nd)
+{
+    if (!node_frozen(f, nd)) return nd;
+    Walk w;
+    walk_init(&w);
+    for (Node *a = nd; a && node_frozen(f, a); a = a->parent)
+        walk_push(&w, a, 0);
+    Node *x;
+    while (walk_pop(&w, &x, NULL)) nd = node_clone(f, x);
+    walk_free(&w);
+    return nd;
+}
+
+/*
+ * Make every node writable before a whole-forest pass (prune, rebalance,
+ * merge).  Pre-order, so each clone's parent already is one; the index
+ * and set table are rebuilt once instead of patched per node.
+ */
+static void forest_thaw(Forest *f)
+{
+    if (!f->versions || f->versions->nsnaps == 0) return;
+    VertexIndex *ix   = f->vindex;
+    SetTable    *sets = f->sets;
+    f->vindex = NULL;
+    f->sets   = NULL;
+    qcache_flush(f);
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            if (node_frozen(f, nd)) nd = node_clone(f, nd);
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
+    if (ix) {
+        vindex_free(ix);
+        f->vindex = vindex_create(64);
+        for (int i = 0; i < f->nroots; ++i) vindex_add_subtree(f->vindex, f->roots[i]);
+    }
+    if (sets) {
+        settable_free(sets);
+        f->sets = settable_create(count_total_nodes(f));
+        Walk s;
+        walk_init(&s);
+        for (int i = 0; i < f->nroots; ++i) {
+            Node *nd;
+            walk_push(&s, f->roots[i], 0);
+            while (walk_pop(&s, &nd, NULL)) {
+                settable_add(f->sets, nd);
+                walk_push_children(&s, nd->children, nd->nchildren, 0);
+            }
+        }
+        walk_free(&s);
+    }
+}
+
+/* Shallowest first, so making one writable never copies another. */
+static void nodes_writable(Forest *f, Node **nds, int n)
+{
+    if (!f->versions || f->versions->nsnaps == 0) return;
+    for (int done = 0; done < n; ) {
+        int best = done, best_depth = INT_MAX;
+        for (int i = done; i < n; ++i) {
+            int d = 0;
+            for (Node *a = nds[i]->parent; a; a = a->parent) d++;
+            if (d < best_depth) { best_depth = d; best = i; }
+        }
+        Node *t = nds[best];
+        nds[best] = nds[done];
+        nds[done++] = node_writable(f, t);
+    }
+}
+
+Forest *forest_snapshot(Forest *f)
+{
+    if (f->sync || forest_is_snapshot(f)) return NULL;
+    if (!f->versions) {
+        f->versions = calloc(1, sizeof(ForestVersions));
+        if (!f->versions) { perror("calloc"); exit(1); }
+    }
+    ForestVersions *v = f->versions;
+
+    Forest *s = forest_create();
+    s->nroots    = s->roots_cap = f->nroots;
+    s->roots     = malloc(sizeof(Node*) * (f->nroots ? f->nroots : 1));
+    s->root_heap->data = malloc(sizeof(Node*) * (f->nroots ? f->nroots : 1));
+    if (!s->roots || !s->root_heap->data) { perror("malloc"); exit(1); }
+    memcpy(s->roots, f->roots, sizeof(Node*) * f->nroots);
+    memcpy(s->root_heap->data, f->root_heap->data,
+           sizeof(Node*) * f->root_heap->size);
+    s->root_heap->size = f->root_heap->size;
+    s->root_heap->cap  = f->nroots;
+    s->versions = calloc(1, sizeof(ForestVersions));
+    if (!s->versions) { perror("calloc"); exit(1); }
+    s->versions->version = v->version;
+    s->versions->origin  = f;
+
+    if (v->nsnaps == v->snaps_cap) {
+        v->snaps_cap = v->snaps_cap ? v->snaps_cap * 2 : 4;
+        v->snaps = realloc(v->snaps, sizeof(Forest*) * v->snaps_cap);
+        if (!v->snaps) { perror("realloc"); exit(1); }
+    }
+    v->snaps[v->nsnaps++] = s;
+    v->newest = v->version++;   /* everything alive now is frozen */
+    return s;
+}
+
+/* Close snapshot s and free the nodes no other snapshot still sees. */
+static void snapshot_release(Forest *s)
+{
+    Forest         *f = s->versions->origin;
+    ForestVersions *v = f->versions;
+    int j = 0;
+    for (int i = 0; i < v->nsnaps; ++i)
+        if (v->snaps[i] != s) v->snaps[j++] = v->snaps[i];
+    v->nsnaps = j;
+    v->newest = 0;
+    for (int i = 0; i < v->nsnaps; ++i)
+        if (v->snaps[i]->versions->version > v->newest)
+            v->newest = v->snaps[i]->versions->version;
+
+    j = 0;
+    for (int i = 0; i < v->ngrave; ++i) {
+        GraveEntry e = v->grave[i];
+        int seen = 0;
+        for (int k = 0; !seen && k < v->nsnaps; ++k) {
+            unsigned sv = v->snaps[k]->versions->version;
+            seen = e.nd->version <= sv && sv < e.died;
+        }
+        if (seen) v->grave[j++] = e;
+        else      node_release(f, e.nd);
+    }
+    v->ngrave = j;
+    s->nroots = 0;   /* the nodes belong to the origin */
+}
+
+int forest_snapshot_count(const Forest *f)
+{
+    return f->versions && !f->versions->origin ? f->versions->nsnaps : 0;
+}
+
+size_t forest_snapshot_retained(const Forest *f)
+{
+    return f->versions && !f->versions->origin ? (size_t)f->versions->ngrave : 0;
+}
+
+/* ========== INSERTION INTERNALS ========== */
+
+/* newn may only sit below a heavier node that contains it. */
+static int insert_fits_under(const Node *nd, const Node *newn)
+{
+    return sig_may_subset(&newn->sig, &nd->sig) &&
+           is_subset(newn->he.verts, newn->he.nverts,
+                     nd->he.verts, nd->he.nverts);
+}
+
+/*
+ * Try to insert newn into the subtree rooted at `root`.
+ *
+ * Returns:
+ *   -1  successfully placed newn somewhere under root
+ *    0  newn is incomparable with root (try next sibling)
+ *    1  root should become a child of newn (caller handles steal)
+ *
+ * Once a node accepts newn the insertion cannot fail below it, so the
+ * descent is a single path: at each level lighter children are stolen
+ * until the first heavier child containing newn, which is entered next.
+ * With max_depth > 0 the descent stops there and newn stays at that level.
+ */
+static int insert_into_node(Forest *f, Node *root, Node *newn, int depth,
+                            int max_depth)
+{
+    int cmp = weighted_cmp(&root->he, &newn->he);
+
+    if (cmp == 1) {
+        /* root is lighter → should move under newn */
+        return 1;
+    }
+
+    /* cmp == 0 → equal priority, incomparable → siblings; a heavier root
+       takes newn only if newn ⊆ root (avoid fake hierarchy) */
+    if (cmp == 0 || !insert_fits_under(root, newn)) return 0;
+
+    Node *nd = root;
+    for (;;) {
+        Node *next = NULL;
+        int   i    = 0;
+        while (i < nd->nchildren) {
+            Node *child = nd->children[i];
+            int   c     = weighted_cmp(&child->he, &newn->he);
+            if (c == 1) {
+                /* steal: child moves under newn */
+                nd = node_writable(f, nd);
+                for (int j = i; j + 1 < nd->nchildren; ++j)
+                    slot_store(&nd->children[j], nd->children[j+1]);
+                __atomic_store_n(&nd->nchildren, nd->nchildren - 1,
+                                 __ATOMIC_RELEASE);
+                node_add_child(f, newn, child);
+                MET(f, steals, 1);
+                /* don't advance i; check same slot again */
+            } else if (c == -1 && insert_fits_under(child, newn)) {
+                next = child;
+                break;
+            } else {
+                i++;
+            }
+        }
+        if (!next || (max_depth && depth >= max_depth)) break;
+        nd = next;
+        depth++;
+    }
+
+    nd = node_writable(f, nd);
+    node_add_child(f, nd, newn);
+    MET_DEPTH(f, depth);
+    /* newn is now below every node on the path (root is a forest root,
+       possibly replaced by a copy) */
+    for (Node *a = nd->parent; a; a = a->parent)
+        node_absorb_summary(a, newn);
+    return -1;
+}
+
+static void forest_insert_node(Forest *f, Node *newn)
+{
+    int i = 0;
+    while (i < f->nroots) {
+        Node *r   = f->roots[i];
+        int   cmp = weighted_cmp(&r->he, &newn->he);
+
+        if (cmp == 1) {
+            /* existing root becomes child of newn */
+            node_add_child(f, newn, r);
+            forest_remove_root_at(f, i);
+            MET(f, steals, 1);
+            /* don't advance i; slot now holds next root */
+        } else if (cmp == -1) {
+            int res = insert_into_node(f, r, newn, 1, 0);
+            if (res == 1) {
+                node_add_child(f, newn, r);
+                forest_remove_root_at(f, i);
+                MET(f, steals, 1);
+            } else if (res == -1) {
+                /* every steal inside r happened on newn's ancestor path */
+                agg_fix_path(newn->parent, 1);
                 return; /* done */
             } else {
                 i++;
             }
-        } else {
-            i++;
+        } else {
+            i++;
+        }
+    }
+
+    /* No existing tree accepted newn → new root */
+    forest_add_root(f, newn);
+    MET_DEPTH(f, 0);
+}
+
+/* Queue nd for exact re-placement by forest_rebalance_step. */
+static void defer_push(Forest *f, Node *nd)
+{
+    if (nd->defer_slot >= 0) return;
+    if (f->ndeferred == f->deferred_cap) {
+        f->deferred_cap = f->deferred_cap ? f->deferred_cap * 2 : 64;
+        f->deferred = realloc(f->deferred, sizeof(Node*) * f->deferred_cap);
+        if (!f->deferred) { perror("realloc"); exit(1); }
+    }
+    nd->defer_slot = f->ndeferred;
+    f->deferred[f->ndeferred++] = nd;
+}
+
+static void defer_remove(Forest *f, Node *nd)
+{
+    int i = nd->defer_slot;
+    if (i < 0) return;
+    Node *moved = f->deferred[--f->ndeferred];
+    f->deferred[i]    = moved;
+    moved->defer_slot = i;
+    nd->defer_slot    = -1;
+}
+
+/*
+ * Bounded placement (forest_set_insert_bounds).  Only roots that can
+ * contain newn are candidates: those on newn's rarest posting list when
+ * the vertex index is on, otherwise those passing the signature test.
+ * At most ins_max_roots of them are descended into, each descent stops at
+ * ins_max_depth, and lighter roots are not looked for, so none is stolen.
+ * The result keeps every invariant queries rely on but may be shallower
+ * or wider than exact placement; newn is queued for the exact pass.
+ */
+static void forest_insert_bounded(Forest *f, Node *newn)
+{
+    int left = f->ins_max_roots, depth = f->ins_max_depth;
+    PostingList *pl = NULL;
+    if (f->vindex) {
+        int empty;
+        pl = vindex_rarest(f->vindex, newn->he.verts, newn->he.nverts, &empty);
+    }
+    int n = pl ? pl->count : f->nroots;
+    for (int i = 0; left > 0 && i < n; ++i) {
+        Node *r = pl ? pl->nodes[i] : f->roots[i];
+        if (r->parent || r == newn || r->he.weight < newn->he.weight ||
+            !sig_may_subset(&newn->sig, &r->sig)) continue;
+        left--;
+        /* a root that accepts newn never fails, so any copy made below
+           (snapshots) happens after the candidate scan is over */
+        if (insert_into_node(f, r, newn, 1, depth) == -1) {
+            agg_fix_path(newn->parent, 1);
+            defer_push(f, newn);
+            return;
+        }
+    }
+    forest_add_root(f, newn);
+    MET_DEPTH(f, 0);
+    defer_push(f, newn);
+}
+
+/* ========== VERTEX NORMALIZATION ========== */
+
+/* No subtraction: it would overflow for far-apart or unsigned IDs. */
+static int cmp_vertex(const void *a, const void *b)
+{
+    hif_vertex_t x = *(const hif_vertex_t*)a, y = *(const hif_vertex_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort and deduplicate a in place; returns the new length. */
+static int sort_unique(hif_vertex_t *a, int n)
+{
+    if (n <= SORT_INSERTION_MAX) {
+        for (int i = 1; i < n; ++i) {
+            hif_vertex_t v = a[i];
+            int j = i;
+            while (j > 0 && a[j-1] > v) { a[j] = a[j-1]; --j; }
+            a[j] = v;
+        }
+    } else {
+        qsort(a, n, sizeof(hif_vertex_t), cmp_vertex);
+    }
+    int w = 1;
+    for (int i = 1; i < n; ++i)
+        if (a[i] != a[w-1]) a[w++] = a[i];
+    return w;
+}
+
+/*
+ * Sort and deduplicate `in`.  With buf == NULL the result is a fresh
+ * malloc'd array; otherwise it is written into buf (capacity >= n_in).
+ */
+static hif_vertex_t *normalize_vertices(const hif_vertex_t *in, int n_in,
+                                        int *n_out, hif_vertex_t *buf)
+{
+    if (n_in == 0) { *n_out = 0; return NULL; }
+    hif_vertex_t *a = buf ? buf : malloc(sizeof(hif_vertex_t) * n_in);
+    if (!a) { perror("malloc"); exit(1); }
+    memcpy(a, in, sizeof(hif_vertex_t) * n_in);
+    int w = sort_unique(a, n_in);
+    if (!buf) {
+        hif_vertex_t *shrunk = realloc(a, sizeof(hif_vertex_t) * w);
+        if (shrunk) a = shrunk;
+    }
+    *n_out = w;
+    return a;
+}
+
+static void pool_destroy(WorkPool *p);
+
+/* ========== PUBLIC API ========== */
+
+Forest *forest_create(void)
+{
+    Forest *f = malloc(sizeof(Forest));
+    if (!f) { perror("malloc"); exit(1); }
+    f->roots     = NULL;
+    f->nroots    = 0;
+    f->roots_cap = 0;
+    f->root_heap = heap_create();
+    f->vindex    = NULL;
+    f->arena     = NULL;
+    f->scratch   = NULL;
+    f->scratch_cap = 0;
+    f->sync      = NULL;
+    f->pool      = NULL;
+    f->sets      = NULL;
+    f->dedup     = HIF_DEDUP_NONE;
+    f->metrics   = NULL;
+    f->qcache    = NULL;
+    f->versions  = NULL;
+    f->ins_max_roots = 0;
+    f->ins_max_depth = 0;
+    f->deferred  = NULL;
+    f->ndeferred = f->deferred_cap = 0;
+    f->maint_cursor = 0;
+#ifdef HIF_METRICS
+    f->metrics   = calloc(1, sizeof(ForestMetrics));
+    if (!f->metrics) { perror("calloc"); exit(1); }
+#endif
+    return f;
+}
+
+Forest *forest_create_with_arena(size_t slab_bytes)
+{
+    Forest *f = forest_create();
+    f->arena  = arena_create(slab_bytes);
+    return f;
+}
+
+size_t forest_arena_reserved(const Forest *f)
+{
+    return f->arena ? f->arena->reserved : 0;
+}
+
+void forest_free(Forest *f)
+{
+    if (!f) return;
+    if (forest_is_snapshot(f)) snapshot_release(f);
+    if (f->sync) {
+        /* no reader may be active any more: drain the retire list */
+        for (int i = 0; i < f->sync->nretired; ++i)
+            sync_free_retired(f, &f->sync->retired[i]);
+        free(f->sync->retired);
+        free(f->sync->readers);
+        free(f->sync->reader_used);
+        free(f->sync);
+    }
+    if (f->arena) arena_destroy(f->arena); /* every node at once */
+    else for (int i = 0; i < f->nroots; ++i) node_free(f, f->roots[i]);
+    free(f->roots);
+    heap_free(f->root_heap);
+    vindex_free(f->vindex);
+    settable_free(f->sets);
+    qcache_free(f->qcache);
+    if (f->versions) {
+        if (!f->arena)
+            for (int i = 0; i < f->versions->ngrave; ++i)
+                node_release(f, f->versions->grave[i].nd);
+        free(f->versions->grave);
+        free(f->versions->snaps);
+        free(f->versions);
+    }
+    free(f->deferred);
+    free(f->metrics);
+    pool_destroy(f->pool);
+    free(f->scratch);
+    free(f);
+}
+
+static Node *forest_reweight_node(Forest *f, Node *nd, double w);
+
+/* Weight of dup after one more insert of weight w under the policy. */
+static double dedup_weight(HifDedupPolicy policy, const Node *dup, double w)
+{
+    double old = dup->he.weight;
+    switch (policy) {
+    case HIF_DEDUP_MAX: return w > old ? w : old;
+    case HIF_DEDUP_SUM: return old + w;
+    case HIF_DEDUP_AVG: return (old * dup->dup_count + w) / (dup->dup_count + 1);
+    default:            return w;
+    }
+}
+
+/* Fold an insert into an existing equal set.  Returns 0 if there is none. */
+static int dedup_fold(Forest *f, const hif_vertex_t *norm, int n, double weight)
+{
+    Node *dup = settable_find(f->sets, norm, n);
+    if (!dup) return 0;
+    writer_begin(f);
+    dup = forest_reweight_node(f, dup, dedup_weight(f->dedup, dup, weight));
+    dup->dup_count++;
+    writer_end(f);
+    return 1;
+}
+
+/*
+ * Insert an already-normalized set.  adopt as in node_create.  Returns 0
+ * if the insert was folded into a duplicate (adopt is then not taken).
+ */
+static int insert_normalized(Forest *f, const hif_vertex_t *norm, int n,
+                             double weight, hif_vertex_t *adopt)
+{
+    if (forest_is_snapshot(f)) return 0;
+    if (f->dedup && dedup_fold(f, norm, n, weight)) return 0;
+#ifdef HIF_METRICS
+    /* sampled latency: clock reads on every insert would dominate */
+    int timed = (f->metrics->inserts++ &
+                 ((1u << HIF_METRICS_SAMPLE_SHIFT) - 1)) == 0;
+    unsigned long long t0 = timed ? met_now_ns() : 0;
+#endif
+    Node *nd = node_create(f, norm, n, weight, adopt);
+    qcache_touch(f, norm, n);
+    if (f->vindex) vindex_add_node(f->vindex, nd);
+    if (f->sets)   settable_add(f->sets, nd);
+    writer_begin(f);
+    if (f->ins_max_roots) forest_insert_bounded(f, nd);
+    else                  forest_insert_node(f, nd);
+    writer_end(f);
+#ifdef HIF_METRICS
+    if (timed) {
+        f->metrics->insert_ns_hist[met_bucket(met_now_ns() - t0)]++;
+        f->metrics->insert_samples++;
+    }
+#endif
+    return 1;
+}
+
+/*
+ * Normalize into the forest's scratch buffer, which only ever grows: a
+ * steady stream of inserts or lookups reuses it without allocating.
+ */
+static hif_vertex_t *normalize_scratch(Forest *f, const hif_vertex_t *verts,
+                                       int nverts, int *n)
+{
+    if (nverts > f->scratch_cap) {
+        int cap = f->scratch_cap ? f->scratch_cap : 16;
+        while (cap < nverts) cap *= 2;
+        free(f->scratch);
+        f->scratch_cap = cap;
+        f->scratch     = malloc(sizeof(hif_vertex_t) * cap);
+        if (!f->scratch) { perror("malloc"); exit(1); }
+    }
+    return normalize_vertices(verts, nverts, n, f->scratch);
+}
+
+void insert_hyperedge(Forest *f, const hif_vertex_t *verts, int nverts,
+                      double weight)
+{
+    if (nverts <= 0) return;
+
+    /* node_create copies out of the scratch; a folded duplicate allocates nothing */
+    int           n_norm;
+    hif_vertex_t *norm = normalize_scratch(f, verts, nverts, &n_norm);
+    insert_normalized(f, norm, n_norm, weight, NULL);
+}
+
+/*
+ * find_top_k — O(k log k) via the lazy weight-order frontier: nothing
+ * proportional to the number of roots is copied, and we stop after k
+ * pops.
+ */
+int find_top_k_into(Forest *f, int k, NodeBuffer *out)
+{
+    out->count = 0;
+    if (k <= 0 || f->nroots == 0) return 0;
+    if (out->cap < k) {
+        free(out->items);
+        out->cap   = k;
+        out->items = malloc(sizeof(Node*) * k);
+        if (!out->items) { perror("malloc"); exit(1); }
+    }
+
+    MET_QUERY_BEGIN();
+    /* the frontier grows in out's retained scratch (frontier_push reallocs) */
+    Frontier q;
+    q.data = out->scratch;
+    q.size = 0;
+    q.cap  = (int)(out->scratch_bytes / sizeof(FrontierEntry));
+    frontier_push(&q, f->root_heap->data[0], 0);
+    Node *nd;
+    while (out->count < k && (nd = frontier_next(&q, f->root_heap))) {
+        out->items[out->count++] = nd;
+        MET_VISIT();
+    }
+    out->scratch       = q.data;
+    out->scratch_bytes = sizeof(FrontierEntry) * q.cap;
+    MET_QUERY_END(f);
+    return out->count;
+}
+
+Node **find_top_k(Forest *f, int k, int *result_count)
+{
+    NodeBuffer b;
+    node_buffer_init(&b);
+    find_top_k_into(f, k, &b);
+    return buffer_detach(&b, result_count);
+}
+
+/*
+ * Weights only decrease downward, so a subtree spans [sub_wmin, own
+ * weight]: wholly inside the range it counts as sub_size, wholly outside
+ * as nothing.
+ */
+static int count_weight_range(const Forest *f, double min_w, double max_w)
+{
+    int  count = 0;
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            MET_VISIT();
+            if (nd->he.weight < min_w || nd->sub_wmin > max_w) continue;
+            if (nd->sub_wmin >= min_w && nd->he.weight <= max_w) {
+                count += nd->sub_size;
+                continue;
+            }
+            count += nd->he.weight <= max_w;
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
+    return count;
+}
+
+int find_by_weight_threshold(Forest *f, double threshold)
+{
+    MET_QUERY_BEGIN();
+    int count = count_weight_range(f, threshold, INFINITY);
+    MET_QUERY_END(f);
+    return count;
+}
+
+int forest_count_by_weight_range(Forest *f, double min_weight,
+                                 double max_weight)
+{
+    MET_QUERY_BEGIN();
+    int count = count_weight_range(f, min_weight, max_weight);
+    MET_QUERY_END(f);
+    return count;
+}
+
+/*
+ * Order-preserving map from doubles to unsigned keys, so rank selection
+ * bisects the 64-bit representation instead of the value range and
+ * converges in at most 64 steps whatever the weight spread.
+ */
+static uint64_t weight_key(double w)
+{
+    uint64_t b;
+    memcpy(&b, &w, sizeof(b));
+    return (b >> 63) ? ~b : b | (1ULL << 63);
+}
+
+static double key_weight(uint64_t k)
+{
+    uint64_t b = (k >> 63) ? k & ~(1ULL << 63) : ~k;
+    double w;
+    memcpy(&w, &b, sizeof(w));
+    return w;
+}
+
+/* Gather the weights in [min_w, max_w) — the caller bounds their number. */
+static int collect_weights(const Forest *f, double min_w, double max_w,
+                           double *out)
+{
+    int  n = 0;
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            MET_VISIT();
+            if (nd->he.weight < min_w || nd->sub_wmin >= max_w) continue;
+            if (nd->he.weight < max_w) out[n++] = nd->he.weight;
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
+    return n;
+}
+
+static int cmp_double_desc(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x < y) - (x > y);
+}
+
+int forest_kth_heaviest_weight(Forest *f, int k, double *weight)
+{
+    int total = count_total_nodes(f);
+    if (k < 1 || k > total) return -1;
+
+    MET_QUERY_BEGIN();
+    /* invariant: count_ge(lo) >= k > count_ge(hi), answer in [lo, hi) */
+    uint64_t lo = weight_key(forest_min_weight(f));
+    uint64_t hi = weight_key(forest_max_weight(f));
+    int c_lo = total;
+    int c_hi = count_weight_range(f, key_weight(hi), INFINITY);
+    double w = key_weight(hi);
+
+    if (c_hi < k) {
+        for (;;) {
+            if (hi - lo <= 1) { w = key_weight(lo); break; }
+            if (c_lo - c_hi <= RANK_SELECT_MAX) {
+                double cand[RANK_SELECT_MAX];
+                int n = collect_weights(f, key_weight(lo), key_weight(hi),
+                                        cand);
+                qsort(cand, n, sizeof(double), cmp_double_desc);
+                w = cand[k - c_hi - 1];
+                break;
+            }
+            uint64_t mid = lo + (hi - lo) / 2;
+            int c = count_weight_range(f, key_weight(mid), INFINITY);
+            if (c >= k) { lo = mid; c_lo = c; }
+            else        { hi = mid; c_hi = c; }
+        }
+    }
+    MET_QUERY_END(f);
+    *weight = w;
+    return 0;
+}
+
+double forest_weight_percentile(Forest *f, double weight)
+{
+    int total = count_total_nodes(f);
+    if (total == 0) return 0.0;
+    MET_QUERY_BEGIN();
+    int below = count_weight_range(f, -INFINITY, weight);
+    MET_QUERY_END(f);
+    return 100.0 * below / total;
+}
+
+/*
+ * Pre-order superset walk: only supersets of query are descended into,
+ * and the first node in walk order wins ties (heaviest by weight, else
+ * fewest vertices).
+ */
+static Node *best_superset_walk(Forest *f, const hif_vertex_t *query,
+                                int nquery, const NodeSig *qs, int by_weight)
+{
+    Node *best = NULL;
+    Walk  w;
+    walk_init(&w);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            if (!node_contains(nd, query, nquery, qs)) continue;
+            if (!best || (by_weight ? nd->he.weight > best->he.weight
+                                    : nd->he.nverts < best->he.nverts))
+                best = nd;
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
+    return best;
+}
+
+Node *find_minimal_superset(Forest *f, const hif_vertex_t *query, int nquery)
+{
+    uint64_t h = 0;
+    Node    *best = NULL;
+    if (f->qcache && nquery > 0) {
+        h = set_hash(query, nquery);
+        if (qcache_lookup(f, query, nquery, 0, h, &best)) return best;
+    }
+    MET_QUERY_BEGIN();
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    if (f->vindex && nquery > 0) {
+        int empty;
+        PostingList *pl = vindex_rarest(f->vindex, query, nquery, &empty);
+        for (int i = 0; !empty && i < pl->count; ++i) {
+            Node *c = pl->nodes[i];
+            if ((!best || c->he.nverts < best->he.nverts) &&
+                node_contains(c, query, nquery, &qs))
+                best = c;
+        }
+    } else {
+        best = best_superset_walk(f, query, nquery, &qs, 0);
+    }
+    MET_QUERY_END(f);
+    if (f->qcache && nquery > 0) qcache_store(f, query, nquery, 0, h, best);
+    return best;
+}
+
+Node *find_heaviest_superset(Forest *f, const hif_vertex_t *query, int nquery)
+{
+    uint64_t h = 0;
+    Node    *best = NULL;
+    if (f->qcache && nquery > 0) {
+        h = set_hash(query, nquery);
+        if (qcache_lookup(f, query, nquery, 1, h, &best)) return best;
+    }
+    MET_QUERY_BEGIN();
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    if (f->vindex && nquery > 0) {
+        int empty;
+        PostingList *pl = vindex_rarest(f->vindex, query, nquery, &empty);
+        for (int i = 0; !empty && i < pl->count; ++i) {
+            Node *c = pl->nodes[i];
+            if ((!best || c->he.weight > best->he.weight) &&
+                node_contains(c, query, nquery, &qs))
+                best = c;
+        }
+    } else {
+        best = best_superset_walk(f, query, nquery, &qs, 1);
+    }
+    MET_QUERY_END(f);
+    if (f->qcache && nquery > 0) qcache_store(f, query, nquery, 1, h, best);
+    return best;
+}
+
+/* ========== CLUSTERING & ANALYSIS ========== */
+
+int get_clusters_by_weight_into(Forest *f, double threshold, NodeBuffer *out)
+{
+    NodeSink k = sink_buffer(out);
+    Walk w;
+    walk_borrow(&w, out);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            if (nd->he.weight < threshold) continue;
+            sink_emit(&k, nd);
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_return(&w, out);
+    return k.count;
+}
+
+Node **get_clusters_by_weight(Forest *f, double threshold, int *cluster_count)
+{
+    NodeBuffer b;
+    node_buffer_init(&b);
+    get_clusters_by_weight_into(f, threshold, &b);
+    return buffer_detach(&b, cluster_count);
+}
+
+double compute_overlap(const Node *a, const Node *b)
+{
+    return overlap_ratio(a->he.verts, a->he.nverts,
+                         b->he.verts, b->he.nverts);
+}
+
+/* ========== UTILITY ========== */
+
+int count_total_nodes(Forest *f)
+{
+    int total = 0;
+    for (int i = 0; i < f->nroots; ++i) total += f->roots[i]->sub_size;
+    return total;
+}
+
+int forest_max_depth(Forest *f)
+{
+    int mx = 0;
+    for (int i = 0; i < f->nroots; ++i)
+        if (f->roots[i]->sub_height > mx) mx = f->roots[i]->sub_height;
+    return mx;
+}
+
+/* O(1): heaviest root is always at top of root_heap. */
+double forest_max_weight(Forest *f)
+{
+    if (f->nroots == 0) return 0.0;
+    return f->root_heap->data[0]->he.weight;
+}
+
+double forest_min_weight(Forest *f)
+{
+    if (f->nroots == 0) return 0.0;
+    double mn = f->roots[0]->sub_wmin;
+    for (int i = 1; i < f->nroots; ++i)
+        if (f->roots[i]->sub_wmin < mn) mn = f->roots[i]->sub_wmin;
+    return mn;
+}
+
+static void print_indent(int depth)
+{
+    for (int i = 0; i < depth; ++i) printf("  ");
+}
+
+static void print_node(Node *nd, int depth)
+{
+    print_indent(depth);
+    printf("⚡ w=%.2f {", nd->he.weight);
+    for (int i = 0; i < nd->he.nverts; ++i) {
+#ifdef HIF_VERTEX_BITS
+        printf("%llu", (unsigned long long)nd->he.verts[i]);
+#else
+        printf("%d", nd->he.verts[i]);
+#endif
+        if (i + 1 < nd->he.nverts) printf(",");
+    }
+    printf("}\n");
+}
+
+void print_forest(Forest *f)
+{
+    printf("\n╔══════════════════════════════════════════╗\n");
+    printf("║  WEIGHTED HYPERGRAPH DECOMPOSITION      ║\n");
+    printf("╚══════════════════════════════════════════╝\n");
+    printf("Roots: %d | Total: %d | Depth: %d\n",
+           f->nroots, count_total_nodes(f), forest_max_depth(f));
+    if (f->nroots > 0)
+        printf("Weight range: [%.2f, %.2f]\n",
+               forest_min_weight(f), forest_max_weight(f));
+
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        int   depth;
+        printf("\n[ROOT %d]\n", i + 1);
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, &depth)) {
+            print_node(nd, depth);
+            walk_push_children(&w, nd->children, nd->nchildren, depth + 1);
+        }
+    }
+    walk_free(&w);
+    printf("\n");
+}
+
+int verify_forest(Forest *f)
+{
+    int  ok = 1;
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; ok && i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (ok && walk_pop(&w, &nd, NULL)) {
+            for (int c = 0; c < nd->nchildren; ++c)
+                if (nd->children[c]->he.weight > nd->he.weight + 1e-9) ok = 0;
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
+    return ok;
+}
+
+ForestStats get_forest_stats(Forest *f)
+{
+    ForestStats stats = {0};
+    stats.num_roots  = f->nroots;
+    stats.max_weight = forest_max_weight(f);
+    stats.min_weight = forest_min_weight(f);
+
+    double sum = 0.0;
+    for (int i = 0; i < f->nroots; ++i) {
+        const Node *r = f->roots[i];
+        stats.total_nodes += r->sub_size;
+        sum               += r->sub_wsum;
+        if (r->sub_height > stats.max_depth)    stats.max_depth    = r->sub_height;
+        if (r->sub_maxdeg > stats.max_children) stats.max_children = r->sub_maxdeg;
+    }
+    if (stats.total_nodes > 0) stats.avg_weight = sum / stats.total_nodes;
+    return stats;
+}
+
+/* ========== ADVANCED QUERY OPERATIONS ========== */
+
+/*
+ * Pre-order walk descending only into supersets of query; shared by
+ * find_all_supersets and find_containing_vertices.
+ */
+static void collect_supersets_walk(Forest *f, const hif_vertex_t *query,
+                                   int nquery, NodeSink *k, NodeBuffer *scratch)
+{
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    Walk w;
+    walk_borrow(&w, scratch);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            if (!node_contains(nd, query, nquery, &qs)) continue;
+            if (!sink_emit(k, nd)) goto done;
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+done:
+    walk_return(&w, scratch);
+}
+
+/*
+ * Indexed "contains every query vertex" scan shared by find_all_supersets
+ * and find_containing_vertices: only the rarest vertex's postings are
+ * candidates.
+ */
+static void collect_supersets_indexed(Forest *f, const hif_vertex_t *query,
+                                      int nquery, NodeSink *k)
+{
+    int empty;
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    PostingList *pl = vindex_rarest(f->vindex, query, nquery, &empty);
+    if (empty) return;
+    for (int i = 0; i < pl->count; ++i) {
+        Node *c = pl->nodes[i];
+        if (node_contains(c, query, nquery, &qs) && !sink_emit(k, c)) return;
+    }
+}
+
+static void superset_query(Forest *f, const hif_vertex_t *query, int nquery,
+                           NodeSink *k, NodeBuffer *scratch)
+{
+    MET_QUERY_BEGIN();
+    if (f->vindex && nquery > 0)
+        collect_supersets_indexed(f, query, nquery, k);
+    else
+        collect_supersets_walk(f, query, nquery, k, scratch);
+    MET_QUERY_END(f);
+}
+
+int find_all_supersets_into(Forest *f, const hif_vertex_t *query, int nquery,
+                            NodeBuffer *out)
+{
+    NodeSink k = sink_buffer(out);
+    superset_query(f, query, nquery, &k, out);
+    return k.count;
+}
+
+int forest_visit_supersets(Forest *f, const hif_vertex_t *query, int nquery,
+                           NodeVisitor visitor, void *user_data)
+{
+    NodeSink k = sink_visitor(visitor, user_data);
+    superset_query(f, query, nquery, &k, NULL);
+    return k.count;
+}
+
+Node **find_all_supersets(Forest *f, const hif_vertex_t *query, int nquery,
+                          int *result_count)
+{
+    NodeBuffer b;
+    node_buffer_init(&b);
+    find_all_supersets_into(f, query, nquery, &b);
+    return buffer_detach(&b, result_count);
+}
+
+static void collect_subsets_walk(Forest *f, const hif_vertex_t *query,
+                                 int nquery, NodeSink *k, NodeBuffer *scratch)
+{
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    Walk w;
+    walk_borrow(&w, scratch);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            if (subtree_outside(nd, &qs)) continue;
+            if (node_within(nd, query, nquery, &qs) && !sink_emit(k, nd))
+                goto done;
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+done:
+    walk_return(&w, scratch);
+}
+
+/*
+ * A subset of query has its smallest vertex in query, so scanning the
+ * posting list of each query vertex v and keeping only nodes whose first
+ * vertex is v visits every candidate exactly once.
+ */
+static void collect_subsets_indexed(Forest *f, const hif_vertex_t *query,
+                                    int nquery, NodeSink *k)
+{
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    for (int q = 0; q < nquery; ++q) {
+        PostingList *pl = vindex_find(f->vindex, query[q]);
+        if (!pl) continue;
+        for (int i = 0; i < pl->count; ++i) {
+            Node *c = pl->nodes[i];
+            if (c->he.verts[0] != query[q] || c->he.nverts > nquery) continue;
+            if (!node_within(c, query, nquery, &qs)) continue;
+            if (!sink_emit(k, c)) return;
+        }
+    }
+}
+
+static void subset_query(Forest *f, const hif_vertex_t *query, int nquery,
+                         NodeSink *k, NodeBuffer *scratch)
+{
+    MET_QUERY_BEGIN();
+    if (f->vindex)
+        collect_subsets_indexed(f, query, nquery, k);
+    else
+        collect_subsets_walk(f, query, nquery, k, scratch);
+    MET_QUERY_END(f);
+}
+
+int find_all_subsets_into(Forest *f, const hif_vertex_t *query, int nquery,
+                          NodeBuffer *out)
+{
+    NodeSink k = sink_buffer(out);
+    subset_query(f, query, nquery, &k, out);
+    return k.count;
+}
+
+int forest_visit_subsets(Forest *f, const hif_vertex_t *query, int nquery,
+                         NodeVisitor visitor, void *user_data)
+{
+    NodeSink k = sink_visitor(visitor, user_data);
+    subset_query(f, query, nquery, &k, NULL);
+    return k.count;
+}
+
+Node **find_all_subsets(Forest *f, const hif_vertex_t *query, int nquery,
+                        int *result_count)
+{
+    NodeBuffer b;
+    node_buffer_init(&b);
+    find_all_subsets_into(f, query, nquery, &b);
+    return buffer_detach(&b, result_count);
+}
+
+static void weight_range_query(Forest *f, double min_weight, double max_weight,
+                               NodeSink *k, NodeBuffer *scratch)
+{
+    MET_QUERY_BEGIN();
+    Walk w;
+    walk_borrow(&w, scratch);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        if (f->roots[i]->he.weight < min_weight) continue;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            MET_VISIT();
+            if (nd->he.weight < min_weight) continue;
+            if (nd->he.weight <= max_weight && !sink_emit(k, nd)) goto done;
+            if (nd->sub_wmin <= max_weight)
+                walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+done:
+    walk_return(&w, scratch);
+    MET_QUERY_END(f);
+}
+
+int find_by_weight_range_into(Forest *f, double min_weight, double max_weight,
+                              NodeBuffer *out)
+{
+    NodeSink k = sink_buffer(out);
+    weight_range_query(f, min_weight, max_weight, &k, out);
+    return k.count;
+}
+
+int forest_visit_weight_range(Forest *f, double min_weight, double max_weight,
+                              NodeVisitor visitor, void *user_data)
+{
+    NodeSink k = sink_visitor(visitor, user_data);
+    weight_range_query(f, min_weight, max_weight, &k, NULL);
+    return k.count;
+}
+
+Node **find_by_weight_range(Forest *f, double min_weight, double max_weight,
+                            int *result_count)
+{
+    NodeBuffer b;
+    node_buffer_init(&b);
+    find_by_weight_range_into(f, min_weight, max_weight, &b);
+    return buffer_detach(&b, result_count);
+}
+
+int find_containing_vertices_into(Forest *f, const hif_vertex_t *vertices,
+                                  int nvertices, NodeBuffer *out)
+{
+    return find_all_supersets_into(f, vertices, nvertices, out);
+}
+
+Node **find_containing_vertices(Forest *f, const hif_vertex_t *vertices,
+                                int nvertices, int *result_count)
+{
+    return find_all_supersets(f, vertices, nvertices, result_count);
+}
+
+/* ---- heaviest supersets ---- */
+
+/* Sift a[i] down the min-heap a[0..n), lightest weight at the top. */
+static void light_heap_sift(Node **a, int n, int i)
+{
+    Node *x = a[i];
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && a[c + 1]->he.weight < a[c]->he.weight) ++c;
+        if (a[c]->he.weight >= x->he.weight) break;
+        a[i] = a[c];
+        i = c;
+    }
+    a[i] = x;
+}
+
+/*
+ * Posting plan: keep the k heaviest matches of the rarest list in a
+ * size-k min-heap, then drain it so out ends up heaviest first.
+ * O(c log k) for c postings; a posting no heavier than the current k-th
+ * is dropped before its vertices are compared.
+ */
+static int top_k_postings(const PostingList *pl, const hif_vertex_t *query,
+                          int nquery, const NodeSig *qs, int k, Node **out)
+{
+    int n = 0;
+    for (int i = 0; i < pl->count; ++i) {
+        Node *c = pl->nodes[i];
+        if (n == k && c->he.weight <= out[0]->he.weight) continue;
+        if (!node_contains(c, query, nquery, qs)) continue;
+        if (n == k) {
+            out[0] = c;
+            light_heap_sift(out, n, 0);
+            continue;
+        }
+        int j = n++;
+        while (j > 0 && out[(j - 1) / 2]->he.weight > c->he.weight) {
+            out[j] = out[(j - 1) / 2];
+            j = (j - 1) / 2;
+        }
+        out[j] = c;
+    }
+    for (int m = n - 1; m > 0; --m) {
+        Node *t = out[0];
+        out[0]  = out[m];
+        out[m]  = t;
+        light_heap_sift(out, m, 0);
+    }
+    return n;
+}
+
+/*
+ * Weight plan: the find_top_k frontier, entering only subtrees whose
+ * sub_any covers the query signature.  Matches come out heaviest first,
+ * so the walk stops at the k-th.
+ */
+static void top_k_walk(Forest *f, const hif_vertex_t *query, int nquery,
+                       const NodeSig *qs, int k, NodeBuffer *out)
+{
+    Frontier q;
+    q.data = out->scratch;
+    q.size = 0;
+    q.cap  = (int)(out->scratch_bytes / sizeof(FrontierEntry));
+    frontier_push(&q, f->root_heap->data[0], 0);
+    Node *nd;
+    while (out->count < k &&
+           (nd = frontier_next_covering(&q, f->root_heap, qs->bits)))
+        if (node_contains(nd, query, nquery, qs))
+            out->items[out->count++] = nd;
+    out->scratch       = q.data;
+    out->scratch_bytes = sizeof(FrontierEntry) * q.cap;
+}
+
+/*
+ * With c postings for the rarest query vertex among n indexed nodes, the
+ * scan costs about c and the weight walk about k·n/c pops (matches
+ * spread evenly over the weight order), so scan when c² <= k·n.
+ */
+int find_top_k_containing_into(Forest *f, const hif_vertex_t *vertices,
+                               int nvertices, int k, NodeBuffer *out)
+{
+    out->count = 0;
+    if (k <= 0 || f->nroots == 0) return 0;
+    if (out->cap < k) {
+        free(out->items);
+        out->cap   = k;
+        out->items = malloc(sizeof(Node*) * k);
+        if (!out->items) { perror("malloc"); exit(1); }
+    }
+
+    MET_QUERY_BEGIN();
+    NodeSig qs;
+    sig_compute(&qs, vertices, nvertices);
+    PostingList *pl = NULL;
+    int empty = 0;
+    if (f->vindex && nvertices > 0)
+        pl = vindex_rarest(f->vindex, vertices, nvertices, &empty);
+    if (pl && (double)pl->count * pl->count <= (double)k * f->vindex->nodes)
+        out->count = top_k_postings(pl, vertices, nvertices, &qs, k,
+                                    out->items);
+    else if (!empty)
+        top_k_walk(f, vertices, nvertices, &qs, k, out);
+    MET_QUERY_END(f);
+    return out->count;
+}
+
+Node **find_top_k_containing(Forest *f, const hif_vertex_t *vertices,
+                             int nvertices, int k, int *result_count)
+{
+    NodeBuffer b;
+    node_buffer_init(&b);
+    find_top_k_containing_into(f, vertices, nvertices, k, &b);
+    return buffer_detach(&b, result_count);
+}
+
+/* ---- similarity search ---- */
+
+static double sim_score(int ov, int nq, int nn, HifSimilarity metric)
+{
+    switch (metric) {
+    case HIF_SIM_JACCARD: {
+        int un = nq + nn - ov;
+        return un > 0 ? (double)ov / un : 0.0;
+    }
+    case HIF_SIM_COSINE:
+        return nq > 0 && nn > 0 ? ov / sqrt((double)nq * nn) : 0.0;
+    default: {
+        int mn = nq < nn ? nq : nn;
+        return mn > 0 ? (double)ov / mn : 0.0;
+    }
+    }
+}
+
+/*
+ * Streaming top-k: a size-k min-heap whose root is the current k-th best
+ * (lowest score, latest in pre-order on ties, so earlier nodes win ties).
+ * qcount[b] is the number of query vertices hashing to signature bit b,
+ * which turns a node or subtree bitmap into an upper bound on overlap.
+ */
+typedef struct {
+    const hif_vertex_t *query;
+    int                 nquery;
+    HifSimilarity       metric;
+    int                 qcount[64];
+    uint64_t            qbits;
+    int                 k, size, cap;
+    Node              **items;
+    double             *scores;
+    long               *order;
+    long                seq;
+} SimTopK;
+
+static int sim_worse(const SimTopK *t, int a, int b)
+{
+    if (t->scores[a] != t->scores[b]) return t->scores[a] < t->scores[b];
+    return t->order[a] > t->order[b];
+}
+
+static void sim_swap(SimTopK *t, int a, int b)
+{
+    Node  *n = t->items[a];  t->items[a]  = t->items[b];  t->items[b]  = n;
+    double s = t->scores[a]; t->scores[a] = t->scores[b]; t->scores[b] = s;
+    long   o = t->order[a];  t->order[a]  = t->order[b];  t->order[b]  = o;
+}
+
+static void sim_sift_down(SimTopK *t, int i)
+{
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, w = i;
+        if (l < t->size && sim_worse(t, l, w)) w = l;
+        if (r < t->size && sim_worse(t, r, w)) w = r;
+        if (w == i) return;
+        sim_swap(t, i, w);
+        i = w;
+    }
+}
+
+static void sim_offer(SimTopK *t, Node *nd, double score, long order)
+{
+    if (t->size == t->k) {
+        /* later in pre-order, so an equal score loses the tie */
+        if (score <= t->scores[0]) return;
+        t->items[0] = nd; t->scores[0] = score; t->order[0] = order;
+        sim_sift_down(t, 0);
+        return;
+    }
+    if (t->size == t->cap) {
+        /* grow toward k lazily: k may exceed the node count */
+        t->cap    = t->cap * 2 < t->k ? t->cap * 2 : t->k;
+        t->items  = realloc(t->items,  sizeof(Node*)  * t->cap);
+        t->scores = realloc(t->scores, sizeof(double) * t->cap);
+        t->order  = realloc(t->order,  sizeof(long)   * t->cap);
+        if (!t->items || !t->scores || !t->order) { perror("realloc"); exit(1); }
+    }
+    int i = t->size++;
+    t->items[i] = nd; t->scores[i] = score; t->order[i] = order;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (!sim_worse(t, i, p)) break;
+        sim_swap(t, i, p);
+        i = p;
+    }
+}
+
+static int sim_overlap_bound(const SimTopK *t, uint64_t bits)
+{
+    uint64_t m = bits & t->qbits;
+    int ub = 0;
+    while (m) { ub += t->qcount[__builtin_ctzll(m)]; m &= m - 1; }
+    return ub;
+}
+
+/* Best score any node of a subtree with summary `any` could reach. */
+static double sim_subtree_bound(const SimTopK *t, uint64_t any)
+{
+    int ub = sim_overlap_bound(t, any);
+    if (ub == 0 || t->nquery == 0) return 0.0;
+    switch (t->metric) {
+    case HIF_SIM_JACCARD: return (double)ub / t->nquery;        /* |B| >= ov */
+    case HIF_SIM_COSINE:  return sqrt((double)ub / t->nquery);
+    default:              return 1.0;
+    }
+}
+
+static int sim_visit(SimTopK *t, Node *nd)
+{
+    long order = t->seq++;
+    MET_VISIT();
+    if (t->size == t->k &&
+        sim_subtree_bound(t, nd->sub_any) + 1e-12 < t->scores[0])
+        return 0;   /* nothing in this subtree can enter the top k */
+
+    if (t->size == t->k) {
+        /* the node's own bound uses the exact formula, so <= is safe */
+        int ovb = sim_overlap_bound(t, nd->sig.bits);
+        if (ovb > nd->he.nverts) ovb = nd->he.nverts;
+        if (ovb > t->nquery)     ovb = t->nquery;
+        if (sim_score(ovb, t->nquery, nd->he.nverts, t->metric) > t->scores[0]) {
+            int ov = overlap_size(t->query, t->nquery,
+                                  nd->he.verts, nd->he.nverts);
+            sim_offer(t, nd, sim_score(ov, t->nquery, nd->he.nverts, t->metric),
+                      order);
+        }
+    } else {
+        int ov = overlap_size(t->query, t->nquery, nd->he.verts, nd->he.nverts);
+        sim_offer(t, nd, sim_score(ov, t->nquery, nd->he.nverts, t->metric),
+                  order);
+    }
+    return 1;
+}
+
+/* Every node in pre-order; the aggregates presize the array. */
+static Node **collect_all_nodes(Forest *f, int *total_count)
+{
+    int    count = 0, cap = count_total_nodes(f);
+    Node **all   = cap ? malloc(sizeof(Node*) * cap) : NULL;
+    if (cap && !all) { perror("malloc"); exit(1); }
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            result_push(&all, &count, &cap, nd);
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
+    *total_count = count;
+    return all;
+}
+
+Node **find_k_most_similar_metric(Forest *f, const hif_vertex_t *query,
+                                  int nquery, int k, HifSimilarity metric,
+                                  double *scores, int *result_count)
+{
+    *result_count = 0;
+    if (k <= 0 || f->nroots == 0) return NULL;
+
+    SimTopK t;
+    memset(&t, 0, sizeof(t));
+    t.query  = query;
+    t.nquery = nquery;
+    t.metric = metric;
+    t.k      = k;
+    for (int i = 0; i < nquery; ++i) {
+        uint64_t b = sig_bit(query[i]);
+        t.qbits |= b;
+        t.qcount[__builtin_ctzll(b)]++;
+    }
+    t.cap    = k < 16 ? k : 16;
+    t.items  = malloc(sizeof(Node*) * t.cap);
+    t.scores = malloc(sizeof(double) * t.cap);
+    t.order  = malloc(sizeof(long) * t.cap);
+    if (!t.items || !t.scores || !t.order) { perror("malloc"); exit(1); }
+
+    MET_QUERY_BEGIN();
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL))
+            if (sim_visit(&t, nd))
+                walk_push_children(&w, nd->children, nd->nchildren, 0);
+    }
+    walk_free(&w);
+    MET_QUERY_END(f);
+
+    /* pop worst-first into the tail: best ends up at index 0 */
+    int sz = t.size;
+    for (int end = sz - 1; end > 0; --end) {
+        sim_swap(&t, 0, end);
+        t.size = end;
+        sim_sift_down(&t, 0);
+    }
+    if (scores) memcpy(scores, t.scores, sizeof(double) * sz);
+    free(t.scores);
+    free(t.order);
+    *result_count = sz;
+    return t.items;
+}
+
+Node **find_k_most_similar(Forest *f, const hif_vertex_t *query, int nquery,
+                           int k, int *result_count)
+{
+    return find_k_most_similar_metric(f, query, nquery, k, HIF_SIM_OVERLAP,
+                                      NULL, result_count);
+}
+
+/* ========== BULK CONSTRUCTION ========== */
+
+/*
+ * Bulk order: weight descending, then larger set first, then
+ * lexicographic so that the result does not depend on qsort stability.
+ * Any node's potential parents (heavier-or-equal supersets) sort before it.
+ */
+static int cmp_bulk_order(const void *a, const void *b)
+{
+    const Node *x = *(Node* const*)a;
+    const Node *y = *(Node* const*)b;
+    if (x->he.weight != y->he.weight) return x->he.weight < y->he.weight ? 1 : -1;
+    if (x->he.nverts != y->he.nverts) return x->he.nverts < y->he.nverts ? 1 : -1;
+    for (int i = 0; i < x->he.nverts; ++i)
+        if (x->he.verts[i] != y->he.verts[i])
+            return x->he.verts[i] < y->he.verts[i] ? -1 : 1;
+    return 0;
+}
+
+/* Vertex ID → dense ID (open addressing, linear probing). */
+typedef struct {
+    hif_vertex_t *keys;
+    int          *ids;
+    int           cap;   /* power of two */
+    int           size;
+} VertexIdMap;
+
+static void vidmap_init(VertexIdMap *m, size_t expected)
+{
+    m->cap  = 16;
+    while ((size_t)m->cap < expected * 2) m->cap *= 2;
+    m->size = 0;
+    m->keys = malloc(sizeof(hif_vertex_t) * m->cap);
+    m->ids  = malloc(sizeof(int) * m->cap);
+    if (!m->keys || !m->ids) { perror("malloc"); exit(1); }
+    for (int i = 0; i < m->cap; ++i) m->ids[i] = -1;
+}
+
+static int vidmap_lookup(const VertexIdMap *m, hif_vertex_t v)
+{
+    unsigned mask = (unsigned)m->cap - 1;
+    for (unsigned i = vindex_hash(v) & mask; m->ids[i] >= 0; i = (i + 1) & mask)
+        if (m->keys[i] == v) return m->ids[i];
+    return -1;
+}
+
+static void vidmap_grow(VertexIdMap *m)
+{
+    VertexIdMap bigger;
+    vidmap_init(&bigger, (size_t)m->cap);
+    unsigned mask = (unsigned)bigger.cap - 1;
+    for (int s = 0; s < m->cap; ++s) {
+        if (m->ids[s] < 0) continue;
+        unsigned j = vindex_hash(m->keys[s]) & mask;
+        while (bigger.ids[j] >= 0) j = (j + 1) & mask;
+        bigger.keys[j] = m->keys[s];
+        bigger.ids[j]  = m->ids[s];
+    }
+    bigger.size = m->size;
+    free(m->keys);
+    free(m->ids);
+    *m = bigger;
+}
+
+/* Returns the dense ID of v, assigning the next one if v is new. */
+static int vidmap_intern(VertexIdMap *m, hif_vertex_t v)
+{
+    if ((m->size + 1) * 2 > m->cap) vidmap_grow(m);
+    unsigned mask = (unsigned)m->cap - 1;
+    unsigned i    = vindex_hash(v) & mask;
+    for (; m->ids[i] >= 0; i = (i + 1) & mask)
+        if (m->keys[i] == v) return m->ids[i];
+    m->keys[i] = v;
+    m->ids[i]  = m->size;
+    return m->size++;
+}
+
+typedef struct {
+    Node        **nodes;   /* bulk-ordered */
+    int           n;
+    VertexIdMap  *map;
+    const size_t *off;     /* dense ID → start in pos[] (CSR)  */
+    const int    *pos;     /* ascending node positions per vertex */
+    int          *parent;  /* output: parent position or -1       */
+    int           tid;
+    int           nthreads;
+} BulkLinkJob;
+
+/* Count of entries in pos[lo, hi) that are < i (pos is ascending). */
+static size_t bulk_prefix(const int *pos, size_t lo, size_t hi, int i)
+{
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pos[mid] < i) lo = mid + 1;
+        else              hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Parent of node i: among earlier nodes containing all of i's vertices,
+ * the one with the fewest vertices (latest position on ties).  Candidates
+ * come from the earlier postings of i's rarest vertex.
+ */
+static int bulk_find_parent(const BulkLinkJob *job, int i)
+{
+    const Node *nd = job->nodes[i];
+    size_t best_lo = 0, best_hi = 0;
+    int    have    = 0;
+
+    for (int k = 0; k < nd->he.nverts; ++k) {
+        int    d  = vidmap_lookup(job->map, nd->he.verts[k]);
+        size_t lo = job->off[d];
+        size_t hi = bulk_prefix(job->pos, lo, job->off[d + 1], i);
+        if (!have || hi - lo < best_hi - best_lo) {
+            best_lo = lo; best_hi = hi; have = 1;
+            if (hi == lo) return -1; /* no earlier node has this vertex */
+        }
+    }
+
+    int parent = -1, parent_n = 0;
+    for (size_t c = best_hi; c-- > best_lo; ) {
+        const Node *cand = job->nodes[job->pos[c]];
+        if (parent >= 0 && cand->he.nverts >= parent_n) continue;
+        if (!sig_may_subset(&nd->sig, &cand->sig) ||
+            !is_subset(nd->he.verts, nd->he.nverts,
+                       cand->he.verts, cand->he.nverts)) continue;
+        parent   = job->pos[c];
+        parent_n = cand->he.nverts;
+        if (parent_n == nd->he.nverts) break; /* identical set: can't do better */
+    }
+    return parent;
+}
+
+static void *bulk_link_worker(void *arg)
+{
+    BulkLinkJob *job = arg;
+    for (int i = job->tid; i < job->n; i += job->nthreads)
+        job->parent[i] = bulk_find_parent(job, i);
+    return NULL;
+}
+
+static int online_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/*
+ * Link detached nodes (no children) into f, which must have no roots.
+ * nodes[] is reordered in place.
+ */
+static void bulk_link(Forest *f, Node **nodes, int n, int nthreads)
+{
+    if (n <= 0) return;
+    qsort(nodes, n, sizeof(Node*), cmp_bulk_order);
+
+    /* one counting pass: vertex → ascending list of positions */
+    size_t incidences = 0;
+    for (int i = 0; i < n; ++i) incidences += nodes[i]->he.nverts;
+
+    VertexIdMap map;
+    vidmap_init(&map, incidences < 1024 ? 1024 : incidences / 4);
+    size_t *cnt = NULL;
+    int     cnt_cap = 0;
+    for (int i = 0; i < n; ++i) {
+        for (int k = 0; k < nodes[i]->he.nverts; ++k) {
+            int d = vidmap_intern(&map, nodes[i]->he.verts[k]);
+            if (d >= cnt_cap) {
+                int newcap = cnt_cap ? cnt_cap * 2 : 1024;
+                cnt = realloc(cnt, sizeof(size_t) * (newcap + 1));
+                if (!cnt) { perror("realloc"); exit(1); }
+                memset(cnt + cnt_cap, 0, sizeof(size_t) * (newcap + 1 - cnt_cap));
+                cnt_cap = newcap;
+            }
+            cnt[d]++;
+        }
+    }
+
+    size_t *off = malloc(sizeof(size_t) * (map.size + 1));
+    int    *pos = malloc(sizeof(int) * (incidences ? incidences : 1));
+    int    *parent = malloc(sizeof(int) * n);
+    if (!off || !pos || !parent) { perror("malloc"); exit(1); }
+    off[0] = 0;
+    for (int d = 0; d < map.size; ++d) off[d + 1] = off[d] + cnt[d];
+    memcpy(cnt, off, sizeof(size_t) * map.size);   /* fill cursors */
+    for (int i = 0; i < n; ++i)
+        for (int k = 0; k < nodes[i]->he.nverts; ++k)
+            pos[cnt[vidmap_lookup(&map, nodes[i]->he.verts[k])]++] = i;
+
+    /* parent search: read-only over the index, independent per node */
+    if (nthreads <= 0) nthreads = online_cpus();
+    if (nthreads > n)  nthreads = n;
+    BulkLinkJob *jobs = malloc(sizeof(BulkLinkJob) * nthreads);
+    pthread_t   *tids = malloc(sizeof(pthread_t) * nthreads);
+    if (!jobs || !tids) { perror("malloc"); exit(1); }
+    for (int t = 0; t < nthreads; ++t) {
+        jobs[t] = (BulkLinkJob){ nodes, n, &map, off, pos, parent,
+                                 t, nthreads };
+    }
+    int spawned = 0;
+    for (int t = 1; t < nthreads; ++t, ++spawned)
+        if (pthread_create(&tids[t], NULL, bulk_link_worker, &jobs[t]) != 0)
+            break;
+    if (spawned < nthreads - 1) {
+        /* could not start every worker: do the missing stripes inline */
+        for (int t = spawned + 1; t < nthreads; ++t) bulk_link_worker(&jobs[t]);
+    }
+    bulk_link_worker(&jobs[0]);
+    for (int t = 1; t <= spawned; ++t) pthread_join(tids[t], NULL);
+
+    /* link in bulk order so children lists stay heaviest-first */
+    for (int i = 0; i < n; ++i) {
+        nodes[i]->sub_bits  = nodes[i]->sub_any = nodes[i]->sig.bits;
+        nodes[i]->root_slot = nodes[i]->heap_slot = -1;
+        node_agg_leaf(nodes[i]);
+        if (parent[i] >= 0) node_add_child(f, nodes[parent[i]], nodes[i]);
+        else                forest_add_root(f, nodes[i]);
+    }
+    /* parents precede children, so a reverse pass completes the summaries */
+    for (int i = n - 1; i >= 0; --i) {
+        node_agg_recompute(nodes[i]);
+        if (parent[i] >= 0) node_absorb_summary(nodes[parent[i]], nodes[i]);
+    }
+
+    free(jobs); free(tids);
+    free(parent); free(pos); free(off); free(cnt);
+    free(map.keys); free(map.ids);
+}
+
+/* ========== OPTIMIZATION & MAINTENANCE ========== */
+
+/*
+ * Detach every node from its children before relinking.  Concurrent
+ * readers may still be walking the old arrays, so in that mode the
+ * arrays are kept (and reused by the relink) instead of freed.
+ */
+static void nodes_unlink(Forest *f, Node **all, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        if (f->sync) {
+            __atomic_store_n(&all[i]->nchildren, 0, __ATOMIC_RELEASE);
+            continue;
+        }
+        forest_release(f, all[i]->children,   /* the pointer array itself */
+                       sizeof(Node*) * all[i]->children_cap);
+        all[i]->children     = NULL;
+        all[i]->nchildren    = 0;
+        all[i]->children_cap = 0;
+    }
+}
+
+void forest_rebalance(Forest *f)
+{
+    int total;
+    if (forest_is_snapshot(f)) return;
+    forest_thaw(f);
+    Node **all = collect_all_nodes(f, &total);
+    if (total == 0) { free(all); return; }
+
+    writer_begin(f);
+    qcache_flush(f);  /* sibling order, and so tie-breaking, changes */
+    nodes_unlink(f, all, total);
+
+    MET(f, rebuilds, 1);
+    /* Reset forest root list and heap */
+    __atomic_store_n(&f->nroots, 0, __ATOMIC_RELEASE);
+    f->root_heap->size = 0;
+
+    /* Node identities and vertex sets are unchanged, so the vertex
+       index (if enabled) stays valid across the rebuild. */
+    bulk_link(f, all, total, 1);
+
+    /* everything is placed exactly now */
+    for (int i = 0; i < f->ndeferred; ++i) f->deferred[i]->defer_slot = -1;
+    f->ndeferred = 0;
+
+    writer_end(f);
+    free(all);
+}
+
+void forest_set_insert_bounds(Forest *f, int max_roots, int max_depth)
+{
+    f->ins_max_roots = max_roots > 0 ? max_roots : 0;
+    f->ins_max_depth = max_depth > 0 ? max_depth : MAX_CHAIN_DEPTH;
+}
+
+static void node_detach(Forest *f, Node *nd);
+
+/*
+ * Latest-queued first.  Each node is re-placed with its subtree, as
+ * forest_reweight_node does, so stolen children come along.
+ */
+int forest_rebalance_step(Forest *f, int budget)
+{
+    if (forest_is_snapshot(f) || f->ndeferred == 0) return 0;
+    writer_begin(f);
+    for (; budget > 0 && f->ndeferred > 0; --budget) {
+        Node *nd = f->deferred[f->ndeferred - 1];
+        defer_remove(f, nd);
+        nd = node_writable(f, nd);
+        Node *p = nd->parent;
+        qcache_touch(f, nd->he.verts, nd->he.nverts);
+        node_detach(f, nd);
+        agg_fix_path(p, 0);
+        node_agg_recompute(nd);
+        forest_insert_node(f, nd);
+    }
+    writer_end(f);
+    return f->ndeferred;
+}
+
+static SetTable *forest_sets(Forest *f);
+static void forest_delete_node(Forest *f, Node *nd);
+
+/*
+ * Fold every other node with keep's vertex set into keep.  Returns the
+ * number of nodes deleted.
+ */
+static int merge_group(Forest *f, SetTable *sets, Node *keep, int keep_max)
+{
+    int    ndup;
+    Node **dup = settable_find_all(sets, keep->he.verts, keep->he.nverts, &ndup);
+    if (ndup > 1) {
+        double weight_sum = 0.0, weight_max = keep->he.weight;
+        int    dup_count  = 0;
+        for (int j = 0; j < ndup; ++j) {
+            weight_sum += dup[j]->he.weight * dup[j]->dup_count;
+            dup_count  += dup[j]->dup_count;
+            if (dup[j]->he.weight > weight_max)
+                weight_max = dup[j]->he.weight;
+        }
+        for (int j = 0; j < ndup; ++j)
+            if (dup[j] != keep) forest_delete_node(f, dup[j]);
+        /* Apply merged weight once, after all duplicates are gone */
+        keep = forest_reweight_node(f, keep, keep_max ? weight_max
+                                                      : weight_sum / dup_count);
+        keep->dup_count = dup_count;
+    }
+    free(dup);
+    return ndup > 1 ? ndup - 1 : 0;
+}
+
+/*
+ * Two passes so no freed node is touched: first pick one keeper per
+ * group (the set's first table entry), then fold each group into it.
+ */
+int forest_merge_duplicates(Forest *f, int keep_max)
+{
+    int total;
+    if (forest_is_snapshot(f)) return 0;
+    forest_thaw(f);   /* keeps the collected pointers live */
+    Node **all = collect_all_nodes(f, &total);
+    if (total <= 1) { free(all); return 0; }
+
+    writer_begin(f);
+
+    SetTable *sets  = forest_sets(f);
+    int       nkeep = 0;
+    for (int i = 0; i < total; ++i)
+        if (settable_find(sets, all[i]->he.verts, all[i]->he.nverts) == all[i])
+            all[nkeep++] = all[i];
+
+    int merged_count = 0;
+    for (int i = 0; i < nkeep; ++i)
+        merged_count += merge_group(f, sets, all[i], keep_max);
+
+    free(all);
+    writer_end(f);
+    return merged_count;
+}
+
+void forest_set_dedup(Forest *f, HifDedupPolicy policy)
+{
+    if (policy != HIF_DEDUP_NONE) forest_sets(f);
+    f->dedup = policy;
+}
+
+/*
+ * Pre-order pass: drop children lighter than threshold, descend into the
+ * rest.  Touched nodes are recorded so their aggregates can be repaired
+ * bottom-up (reverse pre-order) once every child list is final.
+ */
+static int prune_children(Forest *f, Node *root, double threshold)
+{
+    int    removed = 0, ntouched = 0, cap = 0;
+    Node **touched = NULL, *nd;
+    Walk   w;
+    walk_init(&w);
+    walk_push(&w, root, 0);
+    while (walk_pop(&w, &nd, NULL)) {
+        if (nd->sub_wmin >= threshold) continue;  /* nothing below to remove */
+        int i = 0;
+        while (i < nd->nchildren) {
+            if (nd->children[i]->he.weight < threshold) {
+                removed += forest_release_subtree(f, nd->children[i]);
+                for (int j = i; j + 1 < nd->nchildren; ++j)
+                    slot_store(&nd->children[j], nd->children[j+1]);
+                __atomic_store_n(&nd->nchildren, nd->nchildren - 1,
+                                 __ATOMIC_RELEASE);
+            } else {
+                i++;
+            }
+        }
+        result_push(&touched, &ntouched, &cap, nd);
+        walk_push_children(&w, nd->children, nd->nchildren, 0);
+    }
+    walk_free(&w);
+    while (ntouched > 0) node_agg_recompute(touched[--ntouched]);
+    free(touched);
+    return removed;
+}
+
+int forest_prune_by_weight(Forest *f, double threshold)
+{
+    int removed = 0, i = 0;
+    if (forest_is_snapshot(f)) return 0;
+    writer_begin(f);
+    forest_thaw(f);
+    qcache_flush(f);
+    while (i < f->nroots) {
+        if (f->roots[i]->he.weight < threshold) {
+            Node *r = f->roots[i];
+            forest_remove_root_at(f, i);   /* unlink before it is freed */
+            removed += forest_release_subtree(f, r);
+        } else {
+            removed += prune_children(f, f->roots[i], threshold);
+            i++;
+        }
+    }
+    writer_end(f);
+    return removed;
+}
+
+void forest_optimize(Forest *f)
+{
+    writer_begin(f);
+    forest_merge_duplicates(f, 1);
+    forest_rebalance(f);
+    writer_end(f);
+}
+
+/* ========== DELETION & WEIGHT UPDATE ========== */
+
+/* Build the canonical-set table on first use. */
+static SetTable *forest_sets(Forest *f)
+{
+    if (f->sets) return f->sets;
+    int total;
+    Node **all = collect_all_nodes(f, &total);
+    f->sets = settable_create((size_t)total);
+    for (int i = 0; i < total; ++i) settable_add(f->sets, all[i]);
+    free(all);
+    return f->sets;
+}
+
+/* Unlink nd from its parent's children (order kept) or from the roots. */
+static void node_detach(Forest *f, Node *nd)
+{
+    Node *p = nd->parent;
+    if (!p) { forest_remove_root_at(f, nd->root_slot); return; }
+    int i = 0;
+    while (i < p->nchildren && p->children[i] != nd) i++;
+    for (; i + 1 < p->nchildren; ++i) slot_store(&p->children[i], p->children[i + 1]);
+    __atomic_store_n(&p->nchildren, p->nchildren - 1, __ATOMIC_RELEASE);
+    nd->parent = NULL;
+}
+
+/* Attach a detached subtree under p, or as a root when p is NULL. */
+static void node_attach(Forest *f, Node *p, Node *nd)
+{
+    if (p) node_add_child(f, p, nd);
+    else   forest_add_root(f, nd);
+}
+
+/*
+ * The parent is at least as heavy as nd, hence as heavy as nd's children,
+ * so splicing the children into it keeps weights monotone.
+ */
+static void forest_delete_node(Forest *f, Node *nd)
+{
+    /* only the parent changes; a frozen nd itself stays as it was */
+    Node *p = nd->parent ? node_writable(f, nd->parent) : NULL;
+    qcache_touch(f, nd->he.verts, nd->he.nverts);
+    node_detach(f, nd);
+    for (int i = 0; i < nd->nchildren; ++i) node_attach(f, p, nd->children[i]);
+    if (!node_frozen(f, nd)) __atomic_store_n(&nd->nchildren, 0, __ATOMIC_RELEASE);
+    agg_fix_path(p, 0);
+    if (f->vindex) vindex_remove_node(f->vindex, nd);
+    settable_remove(f->sets, nd);
+    defer_remove(f, nd);
+    if (f->sync) sync_retire(f, nd, 0, RETIRE_NODE);
+    else         node_retire(f, nd);
+}
+
+/* Returns nd's live version (a copy if nd was frozen). */
+/*
+ * Re-place nd, detached after outgrowing its parent, below the nearest
+ * ancestor a of the old parent that is heavy enough and still contains
+ * it.  Weights only grow upward, so the walk stops at the first such a and
+ * the move stays inside the subtree nd came from; only when no ancestor
+ * accepts nd is it re-inserted from the roots.
+ */
+static void forest_replace_up(Forest *f, Node *nd, Node *a)
+{
+    while (a && a->he.weight < nd->he.weight) a = a->parent;
+    int depth = 0;
+    for (Node *b = a; b; b = b->parent) depth++;
+    for (; a; a = a->parent, depth--) {
+        if (insert_into_node(f, a, nd, depth, 0) == -1) {
+            agg_fix_path(nd->parent, 1);
+            return;
+        }
+    }
+    forest_insert_node(f, nd);
+}
+
+static Node *forest_reweight_node(Forest *f, Node *nd, double w)
+{
+    nd = node_writable(f, nd);
+    double old = nd->he.weight;
+    Node  *p   = nd->parent;
+    qcache_touch(f, nd->he.verts, nd->he.nverts);
+    node_set_weight(nd, (hif_weight_t)w);
+    w = nd->he.weight;                 /* compare as stored */
+    if (!p && w != old) MET(f, root_heap_ops, 1);
+
+    if (w > old) {
+        if (p && w > p->he.weight) {
+            /* outgrew its parent: re-place nd together with its subtree */
+            node_detach(f, nd);
+            agg_fix_path(p, 0);
+            node_agg_recompute(nd);
+            forest_replace_up(f, nd, p->parent);
+            return nd;
+        }
+        if (!p) root_heap_update(f->root_heap, nd);
+    } else if (w < old) {
+        if (!p) root_heap_update(f->root_heap, nd);
+        /* children now heavier than nd move up next to it */
+        int i = 0;
+        while (i < nd->nchildren) {
+            Node *c = nd->children[i];
+            if (c->he.weight <= w) { i++; continue; }
+            for (int j = i; j + 1 < nd->nchildren; ++j)
+                slot_store(&nd->children[j], nd->children[j + 1]);
+            __atomic_store_n(&nd->nchildren, nd->nchildren - 1, __ATOMIC_RELEASE);
+            node_attach(f, p, c);
+        }
+    }
+    agg_fix_path(nd, 0);  /* nd's weight, and p if children moved up */
+    return nd;
+}
+
+/* Normalize verts and return the matching nodes (malloc'd, may be NULL). */
+static Node **forest_find_set(Forest *f, const hif_vertex_t *verts, int nverts,
+                              int *count)
+{
+    *count = 0;
+    if (nverts <= 0) return NULL;
+    int  n;
+    hif_vertex_t *norm = normalize_scratch(f, verts, nverts, &n);
+    return settable_find_all(forest_sets(f), norm, n, count);
+}
+
+int forest_delete_hyperedge(Forest *f, const hif_vertex_t *verts, int nverts)
+{
+    int    count;
+    if (forest_is_snapshot(f)) return 0;
+    Node **hit = forest_find_set(f, verts, nverts, &count);
+    if (count == 0) return 0;
+    writer_begin(f);
+    nodes_writable(f, hit, count);
+    for (int i = 0; i < count; ++i) forest_delete_node(f, hit[i]);
+    writer_end(f);
+    free(hit);
+    return count;
+}
+
+int forest_update_weight(Forest *f, const hif_vertex_t *verts, int nverts,
+                         double new_weight)
+{
+    int    count;
+    if (forest_is_snapshot(f)) return 0;
+    Node **hit = forest_find_set(f, verts, nverts, &count);
+    if (count == 0) return 0;
+    writer_begin(f);
+    nodes_writable(f, hit, count);
+    for (int i = 0; i < count; ++i) forest_reweight_node(f, hit[i], new_weight);
+    writer_end(f);
+    free(hit);
+    return count;
+}
+
+/* ========== VERTEX INDEX ========== */
+
+void forest_enable_vertex_index(Forest *f)
+{
+    if (f->vindex) return;
+    f->vindex = vindex_create(64);
+    for (int i = 0; i < f->nroots; ++i)
+        vindex_add_subtree(f->vindex, f->roots[i]);
+}
+
+void forest_disable_vertex_index(Forest *f)
+{
+    vindex_free(f->vindex);
+    f->vindex = NULL;
+}
+
+int forest_vertex_degree(Forest *f, hif_vertex_t v)
+{
+    if (!f->vindex) return -1;
+    PostingList *pl = vindex_find(f->vindex, v);
+    return pl ? pl->count : 0;
+}
+
+/* ========== CONCURRENT READERS ========== */
+
+int forest_enable_concurrency(Forest *f, int max_readers)
+{
+    if (max_readers <= 0) return -1;
+    if (f->sync) return 0;
+    if (forest_is_snapshot(f) || forest_snapshot_count(f)) return -1;
+    ForestSync *s = calloc(1, sizeof(ForestSync));
+    if (!s) { perror("calloc"); exit(1); }
+    s->epoch       = 1;
+    s->max_readers = max_readers;
+    s->readers     = calloc(max_readers, sizeof(ReaderEpoch));
+    s->reader_used = calloc(max_readers, sizeof(int));
+    if (!s->readers || !s->reader_used) { perror("calloc"); exit(1); }
+    f->sync = s;
+    return 0;
+}
+
+int forest_reader_register(Forest *f)
+{
+    if (!f->sync) return -1;
+    for (int r = 0; r < f->sync->max_readers; ++r) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&f->sync->reader_used[r], &expected, 1,
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            return r;
+    }
+    return -1;
+}
+
+void forest_reader_unregister(Forest *f, int slot)
+{
+    if (!f->sync || slot < 0 || slot >= f->sync->max_readers) return;
+    __atomic_store_n(&f->sync->readers[slot].epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&f->sync->reader_used[slot], 0, __ATOMIC_RELEASE);
+}
+
+void forest_read_begin(Forest *f, int slot)
+{
+    if (!f->sync || slot < 0 || slot >= f->sync->max_readers) return;
+    unsigned long e = __atomic_load_n(&f->sync->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&f->sync->readers[slot].epoch, e, __ATOMIC_SEQ_CST);
+    /* the announcement must be visible before any node is loaded */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void forest_read_end(Forest *f, int slot)
+{
+    if (!f->sync || slot < 0 || slot >= f->sync->max_readers) return;
+    __atomic_store_n(&f->sync->readers[slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* Wait until no mutation is in progress; returns the (even) sequence. */
+static unsigned read_seq_begin(const Forest *f)
+{
+    if (!f->sync) return 0;
+    unsigned s;
+    while ((s = __atomic_load_n(&f->sync->seq, __ATOMIC_ACQUIRE)) & 1u)
+        ;
+    return s;
+}
+
+/* 1 if no mutation overlapped the read that started at `seq`. */
+static int read_seq_valid(const Forest *f, unsigned seq)
+{
+    if (!f->sync) return 1;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&f->sync->seq, __ATOMIC_RELAXED) == seq;
+}
+
+/*
+ * Mid-walk check, every READ_RECHECK pops.  A walk that overlaps a
+ * mutation can follow old and new edges at once (a rebalance refills
+ * children arrays in place), which may even cycle, so it is abandoned as
+ * soon as the sequence moves rather than only once it ends.
+ */
+#define READ_RECHECK 256
+
+static int read_seq_recheck(const Forest *f, unsigned seq, unsigned *pops)
+{
+    return (++*pops % READ_RECHECK) != 0 || read_seq_valid(f, seq);
+}
+
+/* Load a children/roots list: count first, then the array (see above). */
+static int load_children(Node *nd, Node ***out)
+{
+    int n = __atomic_load_n(&nd->nchildren, __ATOMIC_ACQUIRE);
+    *out  = __atomic_load_n(&nd->children, __ATOMIC_ACQUIRE);
+    return n;
+}
+
+static int load_roots(Forest *f, Node ***out)
+{
+    int n = __atomic_load_n(&f->nroots, __ATOMIC_ACQUIRE);
+    *out  = __atomic_load_n(&f->roots, __ATOMIC_ACQUIRE);
+    return n;
+}
+
+Node **find_top_k_concurrent(Forest *f, int k, int *result_count)
+{
+    if (k <= 0) { *result_count = 0; return NULL; }
+    Node **result = malloc(sizeof(Node*) * k);
+    if (!result) { perror("malloc"); exit(1); }
+    NodeHeap *wh = heap_create();
+
+    for (;;) {
+        unsigned seq = read_seq_begin(f);
+        Node **roots, **kids;
+        int nroots = load_roots(f, &roots);
+
+        wh->size = 0;
+        for (int i = 0; i < nroots; ++i) heap_push(wh, slot_load(&roots[i]));
+
+        int count = 0;
+        while (count < k && wh->size > 0) {
+            Node *top = heap_pop(wh);
+            result[count++] = top;
+            int nk = load_children(top, &kids);
+            for (int i = 0; i < nk; ++i) heap_push(wh, slot_load(&kids[i]));
+        }
+
+        if (read_seq_valid(f, seq)) {
+            heap_free(wh);
+            if (count == 0) { free(result); result = NULL; }
+            *result_count = count;
+            return result;
+        }
+    }
+}
+
+/* Superset walk shared by the heaviest/minimal variants. */
+static Node *find_best_superset_concurrent(Forest *f, const hif_vertex_t *query,
+                                           int nquery, int by_weight)
+{
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    Walk w;
+    walk_init(&w);
+    for (;;) {
+        unsigned seq = read_seq_begin(f), pops = 0;
+        Node **roots, **kids, *best = NULL, *nd;
+        int nroots = load_roots(f, &roots), ok = 1;
+        for (int i = 0; ok && i < nroots; ++i) {
+            walk_push(&w, slot_load(&roots[i]), 0);
+            while (walk_pop(&w, &nd, NULL)) {
+                if (!(ok = read_seq_recheck(f, seq, &pops))) { w.size = 0; break; }
+                if (!node_contains(nd, query, nquery, &qs)) continue;
+                if (!best || (by_weight ? node_weight(nd) > node_weight(best)
+                                        : nd->he.nverts < best->he.nverts))
+                    best = nd;
+                int nk = load_children(nd, &kids);
+                walk_push_children(&w, kids, nk, 0);
+            }
+        }
+        if (ok && read_seq_valid(f, seq)) { walk_free(&w); return best; }
+    }
+}
+
+Node *find_heaviest_superset_concurrent(Forest *f, const hif_vertex_t *query,
+                                        int nquery)
+{
+    return find_best_superset_concurrent(f, query, nquery, 1);
+}
+
+Node *find_minimal_superset_concurrent(Forest *f, const hif_vertex_t *query,
+                                       int nquery)
+{
+    return find_best_superset_concurrent(f, query, nquery, 0);
+}
+
+Node **find_all_supersets_concurrent(Forest *f, const hif_vertex_t *query,
+                                     int nquery, int *result_count)
+{
+    Node **result = NULL;
+    int cap = 0;
+    NodeSig qs;
+    sig_compute(&qs, query, nquery);
+    Walk w;
+    walk_init(&w);
+    for (;;) {
+        unsigned seq = read_seq_begin(f), pops = 0;
+        Node **roots, **kids, *nd;
+        int nroots = load_roots(f, &roots), count = 0, ok = 1;
+        for (int i = 0; ok && i < nroots; ++i) {
+            walk_push(&w, slot_load(&roots[i]), 0);
+            while (walk_pop(&w, &nd, NULL)) {
+                if (!(ok = read_seq_recheck(f, seq, &pops))) { w.size = 0; break; }
+                if (!node_contains(nd, query, nquery, &qs)) continue;
+                result_push(&result, &count, &cap, nd);
+                int nk = load_children(nd, &kids);
+                walk_push_children(&w, kids, nk, 0);
+            }
+        }
+        if (ok && read_seq_valid(f, seq)) {
+            walk_free(&w);
+            *result_count = count;
+            return result;
+        }
+    }
+}
+
+/* Plain count: the aggregates are writer-side and may be mid-update. */
+int find_by_weight_threshold_concurrent(Forest *f, double threshold)
+{
+    Walk w;
+    walk_init(&w);
+    for (;;) {
+        unsigned seq = read_seq_begin(f), pops = 0;
+        Node **roots, **kids, *nd;
+        int nroots = load_roots(f, &roots), count = 0, ok = 1;
+        for (int i = 0; ok && i < nroots; ++i) {
+            walk_push(&w, slot_load(&roots[i]), 0);
+            while (walk_pop(&w, &nd, NULL)) {
+                if (!(ok = read_seq_recheck(f, seq, &pops))) { w.size = 0; break; }
+                if (node_weight(nd) < threshold) continue;
+                count++;
+                int nk = load_children(nd, &kids);
+                walk_push_children(&w, kids, nk, 0);
+            }
+        }
+        if (ok && read_seq_valid(f, seq)) { walk_free(&w); return count; }
+    }
+}
+
+/* ========== PARALLEL QUERIES ========== */
+
+/*
+ * Output segments.  A task appends only to its own segment and only
+ * relinks its own segment's `next`, so no locking is needed; the final
+ * pre-order list is walked after every task has finished.
+ */
+typedef struct ParSegment {
+    struct ParSegment *next;
+    Node   **items;
+    double  *scores;       /* similarity queries only */
+    int      count;
+    int      cap;
+    /* aggregates for get_forest_stats_parallel */
+    int      nodes;
+    int      max_depth;
+    int      max_children;
+    double   sum_weight;
+    double   min_weight;
+} ParSegment;
+
+struct ParQuery;
+typedef int (*ParVisit)(const struct ParQuery *q, Node *nd, int depth,
+                        ParSegment *seg);
+
+/* Query description shared read-only by all tasks. */
+typedef struct ParQuery {
+    ParVisit   visit;             /* returns 1 to descend into nd */
+    const hif_vertex_t *query;
+    int        nquery;
+    double     min_w, max_w;
+    int        k;
+    NodeSig    qsig;              /* signature of query           */
+} ParQuery;
+
+typedef struct {
+    Node      **nodes;   /* roots or some node's children array */
+    int         lo, hi;
+    int         depth;   /* depth of nodes[lo..hi), roots = 1 */
+    ParSegment *seg;
+} ParTask;
+
+/* Owner pushes/pops at the tail; thieves take from the head. */
+typedef struct {
+    pthread_mutex_t lock;
+    ParTask        *tasks;
+    int             head, tail, cap;
+} WorkDeque;
+
+struct WorkPool {
+    int              nworkers;   /* including the calling thread */
+    pthread_t       *threads;
+    WorkDeque       *deques;
+    pthread_mutex_t  lock;
+    pthread_cond_t   wake;
+    pthread_cond_t   idle;
+    unsigned         generation; /* bumped per job */
+    int              shutdown;
+    int              busy;       /* helper threads still in the job */
+    const ParQuery  *job;
+    int              pending;    /* queued + running tasks (atomic) */
+};
+
+static ParSegment *seg_new(void)
+{
+    ParSegment *s = calloc(1, sizeof(ParSegment));
+    if (!s) { perror("calloc"); exit(1); }
+    s->min_weight = HUGE_VAL;
+    return s;
+}
+
+static void seg_reserve(ParSegment *s, int with_scores)
+{
+    if (s->count < s->cap) return;
+    s->cap   = s->cap ? s->cap * 2 : 16;
+    s->items = realloc(s->items, sizeof(Node*) * s->cap);
+    if (!s->items) { perror("realloc"); exit(1); }
+    if (with_scores) {
+        s->scores = realloc(s->scores, sizeof(double) * s->cap);
+        if (!s->scores) { perror("realloc"); exit(1); }
+    }
+}
+
+static void seg_push(ParSegment *s, Node *nd)
+{
+    seg_reserve(s, 0);
+    s->items[s->count++] = nd;
+}
+
+/*
+ * Keep the k best (score desc) entries; an entry never displaces an
+ * equal-scored earlier one, so ties resolve to pre-order position.
+ */
+static void seg_push_bounded(ParSegment *s, Node *nd, double score, int k)
+{
+    if (s->count == k && score <= s->scores[k - 1]) return;
+    if (s->count < k) { seg_reserve(s, 1); s->count++; }
+    int i = s->count - 1;
+    while (i > 0 && s->scores[i - 1] < score) {
+        s->items[i]  = s->items[i - 1];
+        s->scores[i] = s->scores[i - 1];
+        i--;
+    }
+    s->items[i]  = nd;
+    s->scores[i] = score;
+}
+
+static void deque_push(WorkDeque *d, ParTask t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->tail >= d->cap && d->head > 0) {
+        /* compact before growing */
+        memmove(d->tasks, d->tasks + d->head,
+                sizeof(ParTask) * (d->tail - d->head));
+        d->tail -= d->head;
+        d->head  = 0;
+    }
+    if (d->tail >= d->cap) {
+        d->cap   = d->cap ? d->cap * 2 : 64;
+        d->tasks = realloc(d->tasks, sizeof(ParTask) * d->cap);
+        if (!d->tasks) { perror("realloc"); exit(1); }
+    }
+    d->tasks[d->tail++] = t;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int deque_take(WorkDeque *d, ParTask *out, int steal)
+{
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *out = steal ? d->tasks[d->head++] : d->tasks[--d->tail];
+        ok   = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+/*
+ * Hand runs of nodes[lo..hi) to new tasks.  Their segments are spliced
+ * after *seg, followed by a fresh continuation segment for whatever the
+ * current task emits next.  The chain is complete before any task is
+ * published.
+ */
+static void par_split(WorkPool *p, int self, Node **nodes, int lo, int hi,
+                      int depth, int chunk, ParSegment **seg)
+{
+    int ntasks = (hi - lo + chunk - 1) / chunk;
+    ParTask *batch = malloc(sizeof(ParTask) * ntasks);
+    if (!batch) { perror("malloc"); exit(1); }
+
+    ParSegment *after = (*seg)->next, *prev = *seg;
+    for (int t = 0; t < ntasks; ++t) {
+        int a = lo + t * chunk, b = a + chunk < hi ? a + chunk : hi;
+        ParSegment *s = seg_new();
+        prev->next = s;
+        prev       = s;
+        batch[t]   = (ParTask){ nodes, a, b, depth, s };
+    }
+    ParSegment *cont = seg_new();
+    prev->next = cont;
+    cont->next = after;
+    *seg       = cont;
+
+    __atomic_add_fetch(&p->pending, ntasks, __ATOMIC_ACQ_REL);
+    for (int t = 0; t < ntasks; ++t) deque_push(&p->deques[self], batch[t]);
+    free(batch);
+}
+
+static void par_dfs(WorkPool *p, int self, const ParQuery *q,
+                    Node *nd, int depth, ParSegment **seg)
+{
+    Walk w;
+    walk_init(&w);
+    walk_push(&w, nd, depth);
+    while (walk_pop(&w, &nd, &depth)) {
+        if (!q->visit(q, nd, depth, *seg)) continue;
+        if (nd->nchildren >= PAR_SPLIT_CHILDREN)
+            par_split(p, self, nd->children, 0, nd->nchildren, depth + 1,
+                      PAR_SPLIT_CHILDREN / 4, seg);
+        else
+            walk_push_children(&w, nd->children, nd->nchildren, depth + 1);
+    }
+    walk_free(&w);
+}
+
+static void par_run_tasks(WorkPool *p, int self, const ParQuery *q)
+{
+    ParTask t;
+    for (;;) {
+        int got = deque_take(&p->deques[self], &t, 0);
+        for (int v = 1; !got && v < p->nworkers; ++v)
+            got = deque_take(&p->deques[(self + v) % p->nworkers], &t, 1);
+        if (!got) {
+            if (__atomic_load_n(&p->pending, __ATOMIC_ACQUIRE) == 0) return;
+            sched_yield();
+            continue;
+        }
+        ParSegment *seg = t.seg;
+        for (int i = t.lo; i < t.hi; ++i)
+            par_dfs(p, self, q, t.nodes[i], t.depth, &seg);
+        __atomic_sub_fetch(&p->pending, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+static void *pool_worker(void *arg)
+{
+    WorkPool *p    = ((void**)arg)[0];
+    int       self = (int)(size_t)((void**)arg)[1];
+    free(arg);
+
+    unsigned seen = 0;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->shutdown && p->generation == seen)
+            pthread_cond_wait(&p->wake, &p->lock);
+        if (p->shutdown) break;
+        seen = p->generation;
+        const ParQuery *q = p->job;
+        pthread_mutex_unlock(&p->lock);
+
+        par_run_tasks(p, self, q);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0) pthread_cond_signal(&p->idle);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static WorkPool *pool_create(int nworkers)
+{
+    WorkPool *p = calloc(1, sizeof(WorkPool));
+    if (!p) { perror("calloc"); exit(1); }
+    p->nworkers = nworkers;
+    p->deques   = calloc(nworkers, sizeof(WorkDeque));
+    p->threads  = calloc(nworkers, sizeof(pthread_t));
+    if (!p->deques || !p->threads) { perror("calloc"); exit(1); }
+    for (int w = 0; w < nworkers; ++w)
+        pthread_mutex_init(&p->deques[w].lock, NULL);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->idle, NULL);
+
+    for (int w = 1; w < nworkers; ++w) {
+        void **arg = malloc(sizeof(void*) * 2);
+        if (!arg) { perror("malloc"); exit(1); }
+        arg[0] = p;
+        arg[1] = (void*)(size_t)w;
+        if (pthread_create(&p->threads[w], NULL, pool_worker, arg) != 0) {
+            /* run with the workers we have */
+            free(arg);
+            p->nworkers = w;
+            break;
+        }
+    }
+    return p;
+}
+
+static void pool_destroy(WorkPool *p)
+{
+    if (!p) return;
+    pthread_mutex_lock(&p->lock);
+    p->shutdown = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (int w = 1; w < p->nworkers; ++w) pthread_join(p->threads[w], NULL);
+    for (int w = 0; w < p->nworkers; ++w) {
+        pthread_mutex_destroy(&p->deques[w].lock);
+        free(p->deques[w].tasks);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->idle);
+    free(p->deques);
+    free(p->threads);
+    free(p);
+}
+
+/*
+ * Run q over the whole forest; returns the head of the pre-order segment
+ * list (caller frees with seg_list_free).  Without a pool a one-worker
+ * pool without helper threads runs everything on the caller.
+ */
+static ParSegment *par_execute(Forest *f, const ParQuery *q)
+{
+    WorkPool  local_pool;
+    WorkDeque local_deque;
+    WorkPool *p = f->pool;
+    if (!p) {
+        memset(&local_pool, 0, sizeof(local_pool));
+        memset(&local_deque, 0, sizeof(local_deque));
+        pthread_mutex_init(&local_deque.lock, NULL);
+        local_pool.nworkers = 1;
+        local_pool.deques   = &local_deque;
+        p = &local_pool;
+    }
+
+    ParSegment *head = seg_new();
+    if (f->nroots > 0) {
+        int chunk = f->nroots / (p->nworkers * PAR_TASKS_PER_WORKER);
+        if (chunk < 1) chunk = 1;
+        ParSegment *seg = head;
+        par_split(p, 0, f->roots, 0, f->nroots, 1, chunk, &seg);
+
+        if (p->nworkers > 1) {
+            pthread_mutex_lock(&p->lock);
+            p->job  = q;
+            p->busy = p->nworkers - 1;
+            p->generation++;
+            pthread_cond_broadcast(&p->wake);
+            pthread_mutex_unlock(&p->lock);
+        }
+
+        par_run_tasks(p, 0, q);
+
+        if (p->nworkers > 1) {
+            pthread_mutex_lock(&p->lock);
+            while (p->busy > 0) pthread_cond_wait(&p->idle, &p->lock);
+            p->job = NULL;
+            pthread_mutex_unlock(&p->lock);
+        }
+    }
+
+    if (p == &local_pool) {
+        pthread_mutex_destroy(&local_deque.lock);
+        free(local_deque.tasks);
+    }
+    return head;
+}
+
+static void seg_list_free(ParSegment *s)
+{
+    while (s) {
+        ParSegment *next = s->next;
+        free(s->items);
+        free(s->scores);
+        free(s);
+        s = next;
+    }
+}
+
+/* Concatenate segment items in pre-order. */
+static Node **seg_list_collect(ParSegment *head, int *result_count)
+{
+    int total = 0;
+    for (ParSegment *s = head; s; s = s->next) total += s->count;
+    Node **result = NULL;
+    if (total > 0) {
+        result = malloc(sizeof(Node*) * total);
+        if (!result) { perror("malloc"); exit(1); }
+        int pos = 0;
+        for (ParSegment *s = head; s; s = s->next) {
+            if (s->count == 0) continue;
+            memcpy(result + pos, s->items, sizeof(Node*) * s->count);
+            pos += s->count;
+        }
+    }
+    seg_list_free(head);
+    *result_count = total;
+    return result;
+}
+
+void forest_set_threads(Forest *f, int nthreads)
+{
+    if (nthreads <= 0) nthreads = online_cpus();
+    pool_destroy(f->pool);
+    f->pool = nthreads > 1 ? pool_create(nthreads) : NULL;
+}
+
+int forest_get_threads(const Forest *f)
+{
+    return f->pool ? f->pool->nworkers : 1;
+}
+
+static int par_visit_superset(const ParQuery *q, Node *nd, int depth,
+                              ParSegment *seg)
+{
+    (void)depth;
+    if (!node_contains(nd, q->query, q->nquery, &q->qsig)) return 0;
+    seg_push(seg, nd);
+    return 1;
+}
+
+Node **find_all_supersets_parallel(Forest *f, const hif_vertex_t *query,
+                                   int nquery, int *result_count)
+{
+    ParQuery q = { par_visit_superset, query, nquery, 0, 0, 0, { 0, 0, 0 } };
+    sig_compute(&q.qsig, query, nquery);
+    return seg_list_collect(par_execute(f, &q), result_count);
+}
+
+static int par_visit_weight_range(const ParQuery *q, Node *nd, int depth,
+                                  ParSegment *seg)
+{
+    (void)depth;
+    if (nd->he.weight < q->min_w) return 0;
+    if (nd->he.weight <= q->max_w) seg_push(seg, nd);
+    return 1;
+}
+
+Node **find_by_weight_range_parallel(Forest *f, double min_weight,
+                                     double max_weight, int *result_count)
+{
+    ParQuery q = { par_visit_weight_range, NULL, 0, min_weight, max_weight, 0,
+                   { 0, 0, 0 } };
+    return seg_list_collect(par_execute(f, &q), result_count);
+}
+
+static int par_visit_similar(const ParQuery *q, Node *nd, int depth,
+                             ParSegment *seg)
+{
+    (void)depth;
+    double sim = overlap_ratio(q->query, q->nquery,
+                               nd->he.verts, nd->he.nverts);
+    seg_push_bounded(seg, nd, sim, q->k);
+    return 1;
+}
+
+Node **find_k_most_similar_parallel(Forest *f, const hif_vertex_t *query,
+                                    int nquery, int k, int *result_count)
+{
+    *result_count = 0;
+    if (k <= 0 || f->nroots == 0) return NULL;
+
+    ParQuery q = { par_visit_similar, query, nquery, 0, 0, k, { 0, 0, 0 } };
+    ParSegment *head = par_execute(f, &q);
+
+    /* merge per-segment top-k lists in pre-order: same tie rule */
+    ParSegment best = { 0 };
+    for (ParSegment *s = head; s; s = s->next)
+        for (int i = 0; i < s->count; ++i)
+            seg_push_bounded(&best, s->items[i], s->scores[i], k);
+    seg_list_free(head);
+
+    free(best.scores);
+    *result_count = best.count;
+    return best.items;
+}
+
+static int par_visit_stats(const ParQuery *q, Node *nd, int depth,
+                           ParSegment *seg)
+{
+    (void)q;
+    seg->nodes++;
+    seg->sum_weight += nd->he.weight;
+    if (depth > seg->max_depth)             seg->max_depth    = depth;
+    if (nd->nchildren > seg->max_children)  seg->max_children = nd->nchildren;
+    if (nd->he.weight < seg->min_weight)    seg->min_weight   = nd->he.weight;
+    return 1;
+}
+
+ForestStats get_forest_stats_parallel(Forest *f)
+{
+    ForestStats stats = {0};
+    stats.num_roots  = f->nroots;
+    stats.max_weight = forest_max_weight(f);
+    if (f->nroots == 0) return stats;
+
+    ParQuery q = { par_visit_stats, NULL, 0, 0, 0, 0, { 0, 0, 0 } };
+    ParSegment *head = par_execute(f, &q);
+
+    double sum = 0.0, mn = HUGE_VAL;
+    for (ParSegment *s = head; s; s = s->next) {
+        stats.total_nodes += s->nodes;
+        sum               += s->sum_weight;   /* fixed order: deterministic */
+        if (s->max_depth > stats.max_depth)       stats.max_depth    = s->max_depth;
+        if (s->max_children > stats.max_children) stats.max_children = s->max_children;
+        if (s->min_weight < mn)                   mn                 = s->min_weight;
+    }
+    seg_list_free(head);
+
+    stats.min_weight = mn;
+    stats.avg_weight = sum / stats.total_nodes;
+    return stats;
+}
+
+/* ========== BATCH OPERATIONS ========== */
+
+static int cmp_hyperedge_by_weight_desc(const void *a, const void *b)
+{
+    double wa = ((const Hyperedge*)a)->weight;
+    double wb = ((const Hyperedge*)b)->weight;
+    return (wa < wb) - (wa > wb); /* descending */
+}
+
+/*
+ * forest_insert_batch — sorts a copy of the edge array by weight descending
+ * before inserting, which produces a shallower tree than random order.
+ */
+void forest_insert_batch(Forest *f, Hyperedge *edges, int nedges)
+{
+    if (nedges <= 0) return;
+
+    Hyperedge *sorted = malloc(sizeof(Hyperedge) * nedges);
+    if (!sorted) { perror("malloc"); exit(1); }
+    memcpy(sorted, edges, sizeof(Hyperedge) * nedges);
+
+    qsort(sorted, nedges, sizeof(Hyperedge), cmp_hyperedge_by_weight_desc);
+
+    for (int i = 0; i < nedges; ++i)
+        insert_hyperedge(f, sorted[i].verts, sorted[i].nverts,
+                         sorted[i].weight);
+
+    free(sorted);
+}
+
+/*
+ * Multi-query superset search.  Matches are gathered as (query, node)
+ * pairs in discovery order and bucketed into CSR at the end, which keeps
+ * each query's results in the order find_all_supersets returns them.
+ */
+typedef struct {
+    int   *qid;
+    Node **nd;
+    int    n;
+    int    cap;
+} BatchPairs;
+
+static void pairs_push(BatchPairs *p, int q, Node *nd)
+{
+    if (p->n == p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 64;
+        p->qid = realloc(p->qid, sizeof(int) * p->cap);
+        p->nd  = realloc(p->nd, sizeof(Node*) * p->cap);
+        if (!p->qid || !p->nd) { perror("realloc"); exit(1); }
+    }
+    p->qid[p->n] = q;
+    p->nd[p->n]  = nd;
+    p->n++;
+}
+
+static void ints_reserve(int **a, int *cap, int need)
+{
+    if (need <= *cap) return;
+    while (*cap < need) *cap = *cap ? *cap * 2 : 256;
+    *a = realloc(*a, sizeof(int) * (*cap));
+    if (!*a) { perror("realloc"); exit(1); }
+}
+
+/*
+ * One pre-order walk for all queries in ids[0..n).  A stack entry's
+ * depth field is the offset in pool of its active list (count, then
+ * query ids): the queries every ancestor contained.  A node is tested
+ * against its active list only and passes the survivors to its
+ * children, which share one copy.  Lists above the popped entry's own
+ * belong to finished siblings, so the pool is a stack too.
+ */
+static void batch_supersets_walk(Forest *f, const Hyperedge *qs,
+                                 const NodeSig *sigs, const int *ids, int n,
+                                 BatchPairs *out)
+{
+    int *pool = NULL, cap = 0;
+    ints_reserve(&pool, &cap, n + 1);
+    pool[0] = n;
+    memcpy(pool + 1, ids, sizeof(int) * n);
+
+    Walk w;
+    walk_init(&w);
+    for (int r = f->nroots - 1; r >= 0; --r) walk_push(&w, f->roots[r], 0);
+    Node *nd;
+    int   off;
+    while (walk_pop(&w, &nd, &off)) {
+        int top = off + 1 + pool[off];
+        ints_reserve(&pool, &cap, top + 1 + pool[off]);
+        int *act = pool + off + 1, *surv = pool + top + 1, ns = 0;
+        for (int i = 0; i < pool[off]; ++i) {
+            const Hyperedge *q = &qs[act[i]];
+            if (!node_contains(nd, q->verts, q->nverts, &sigs[act[i]])) continue;
+            pairs_push(out, act[i], nd);
+            surv[ns++] = act[i];
+        }
+        if (ns == 0 || nd->nchildren == 0) continue;
+        pool[top] = ns;
+        walk_push_children(&w, nd->children, nd->nchildren, top);
+    }
+    walk_free(&w);
+    free(pool);
+}
+
+typedef struct {
+    const PostingList *pl;
+    int                q;
+} BatchGroup;
+
+static int cmp_batch_group(const void *a, const void *b)
+{
+    uintptr_t pa = (uintptr_t)((const BatchGroup*)a)->pl;
+    uintptr_t pb = (uintptr_t)((const BatchGroup*)b)->pl;
+    if (pa != pb) return (pa > pb) - (pa < pb);
+    return ((const BatchGroup*)a)->q - ((const BatchGroup*)b)->q;
+}
+
+/*
+ * Indexed variant: queries are grouped by their rarest vertex's posting
+ * list, and each list is scanned once for its whole group.
+ */
+static void batch_supersets_indexed(Forest *f, const Hyperedge *qs,
+                                    const NodeSig *sigs, const int *ids, int n,
+                                    BatchPairs *out)
+{
+    BatchGroup *g = malloc(sizeof(BatchGroup) * (n ? n : 1));
+    if (!g) { perror("malloc"); exit(1); }
+    int ng = 0;
+    for (int i = 0; i < n; ++i) {
+        int empty;
+        const Hyperedge *q = &qs[ids[i]];
+        PostingList *pl = vindex_rarest(f->vindex, q->verts, q->nverts, &empty);
+        if (empty) continue;
+        g[ng].pl = pl;
+        g[ng].q  = ids[i];
+        ng++;
+    }
+    qsort(g, ng, sizeof(BatchGroup), cmp_batch_group);
+    for (int a = 0, b; a < ng; a = b) {
+        for (b = a + 1; b < ng && g[b].pl == g[a].pl; ++b) ;
+        const PostingList *pl = g[a].pl;
+        for (int i = 0; i < pl->count; ++i) {
+            Node *c = pl->nodes[i];
+            for (int j = a; j < b; ++j) {
+                const Hyperedge *q = &qs[g[j].q];
+                if (node_contains(c, q->verts, q->nverts, &sigs[g[j].q]))
+                    pairs_push(out, g[j].q, c);
+            }
         }
     }
+    free(g);
+}
+
+int forest_batch_supersets(Forest *f, const Hyperedge *queries, int nqueries,
+                           NodeCSR *out)
+{
+    if (nqueries < 0) nqueries = 0;
+    MET_QUERY_BEGIN();
+    NodeSig *sigs = malloc(sizeof(NodeSig) * (nqueries ? nqueries : 1));
+    int     *walk_ids = malloc(sizeof(int) * (nqueries ? nqueries : 1));
+    int     *idx_ids  = malloc(sizeof(int) * (nqueries ? nqueries : 1));
+    if (!sigs || !walk_ids || !idx_ids) { perror("malloc"); exit(1); }
+    int nwalk = 0, nidx = 0;
+    for (int i = 0; i < nqueries; ++i) {
+        sig_compute(&sigs[i], queries[i].verts, queries[i].nverts);
+        /* the same split as find_all_supersets */
+        if (f->vindex && queries[i].nverts > 0) idx_ids[nidx++] = i;
+        else                                    walk_ids[nwalk++] = i;
+    }
+
+    BatchPairs p = { NULL, NULL, 0, 0 };
+    if (nwalk > 0) batch_supersets_walk(f, queries, sigs, walk_ids, nwalk, &p);
+    if (nidx > 0)  batch_supersets_indexed(f, queries, sigs, idx_ids, nidx, &p);
+
+    /* counting sort by query; stable, so per-query order is kept */
+    out->nqueries = nqueries;
+    out->offsets  = calloc(nqueries + 1, sizeof(int));
+    out->nodes    = malloc(sizeof(Node*) * (p.n ? p.n : 1));
+    if (!out->offsets || !out->nodes) { perror("malloc"); exit(1); }
+    for (int i = 0; i < p.n; ++i) out->offsets[p.qid[i] + 1]++;
+    for (int i = 0; i < nqueries; ++i) out->offsets[i + 1] += out->offsets[i];
+    for (int i = 0; i < p.n; ++i) {
+        int q = p.qid[i];
+        out->nodes[out->offsets[q]++] = p.nd[i];
+    }
+    for (int i = nqueries; i > 0; --i) out->offsets[i] = out->offsets[i - 1];
+    out->offsets[0] = 0;
+
+    free(p.qid);
+    free(p.nd);
+    free(sigs);
+    free(walk_ids);
+    free(idx_ids);
+    MET_QUERY_END(f);
+    return p.n;
+}
+
+int forest_batch_containing(Forest *f, const Hyperedge *queries, int nqueries,
+                            NodeCSR *out)
+{
+    return forest_batch_supersets(f, queries, nqueries, out);
+}
+
+void node_csr_free(NodeCSR *csr)
+{
+    if (!csr) return;
+    free(csr->offsets);
+    free(csr->nodes);
+    csr->offsets  = NULL;
+    csr->nodes    = NULL;
+    csr->nqueries = 0;
+}
+
+Forest *forest_build_bulk_parallel(Hyperedge *edges, int nedges, int nthreads)
+{
+    Forest *f = forest_create();
+    if (nedges <= 0) return f;
+
+    Node **nodes = malloc(sizeof(Node*) * nedges);
+    if (!nodes) { perror("malloc"); exit(1); }
+    int n = 0;
+    for (int i = 0; i < nedges; ++i) {
+        if (edges[i].nverts <= 0) continue;
+        int           n_norm;
+        hif_vertex_t *norm = normalize_vertices(edges[i].verts, edges[i].nverts,
+                                                &n_norm, NULL);
+        nodes[n++] = node_create(f, norm, n_norm, edges[i].weight, norm);
+    }
 
-    /* No existing tree accepted newn → new root */
-    forest_add_root(f, newn);
+    bulk_link(f, nodes, n, nthreads);
+    free(nodes);
+    return f;
 }
 
-/* ========== VERTEX NORMALIZATION ========== */
+Forest *forest_build_bulk(Hyperedge *edges, int nedges)
+{
+    return forest_build_bulk_parallel(edges, nedges, 1);
+}
 
-static int cmp_int(const void *a, const void *b)
+/* ========== STREAMING INGEST ========== */
+
+/*
+ * Events live in one growing vertex pool (no per-event allocation);
+ * a flush normalizes each event's slice in place, so a slice may end up
+ * shorter than it was pushed.
+ */
+typedef struct {
+    size_t off;
+    int    n;
+    double weight;
+} IngestEvent;
+
+struct IngestBuffer {
+    Forest       *f;
+    int           batch_size;
+    double        max_delay_ms;
+    int           nthreads;
+    IngestEvent  *ev;
+    int           nev;
+    int           ev_cap;
+    hif_vertex_t *pool;
+    size_t        pool_len;
+    size_t        pool_cap;
+    double        oldest_ms;   /* arrival of ev[0] */
+    IngestStats   stats;
+};
+
+static double now_ms(void)
 {
-    return *(int*)a - *(int*)b;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
 }
 
-static int *normalize_vertices(const int *in, int n_in, int *n_out)
+IngestBuffer *forest_ingest_create(Forest *f, int batch_size,
+                                   double max_delay_ms, int nthreads)
 {
-    if (n_in == 0) { *n_out = 0; return NULL; }
-    int *a = malloc(sizeof(int) * n_in);
-    if (!a) { perror("malloc"); exit(1); }
-    memcpy(a, in, sizeof(int) * n_in);
-    qsort(a, n_in, sizeof(int), cmp_int);
-    /* deduplicate */
-    int w = 1;
-    for (int i = 1; i < n_in; ++i)
-        if (a[i] != a[w-1]) a[w++] = a[i];
-    a      = realloc(a, sizeof(int) * w);
-    *n_out = w;
-    return a;
+    IngestBuffer *b = calloc(1, sizeof(IngestBuffer));
+    if (!b) { perror("calloc"); exit(1); }
+    b->f            = f;
+    b->batch_size   = batch_size > 0 ? batch_size : INGEST_DEFAULT_BATCH;
+    b->max_delay_ms = max_delay_ms;
+    b->nthreads     = nthreads > 0 ? nthreads : online_cpus();
+    return b;
 }
 
-/* ========== PUBLIC API ========== */
+typedef struct {
+    IngestBuffer *b;
+    int           lo, hi;
+} IngestJob;
 
-Forest *forest_create(void)
+static void *ingest_normalize_worker(void *arg)
 {
-    Forest *f = malloc(sizeof(Forest));
-    if (!f) { perror("malloc"); exit(1); }
-    f->roots     = NULL;
-    f->nroots    = 0;
-    f->roots_cap = 0;
-    f->root_heap = heap_create();
-    return f;
+    IngestJob *job = arg;
+    for (int i = job->lo; i < job->hi; ++i) {
+        IngestEvent *e = &job->b->ev[i];
+        e->n = sort_unique(job->b->pool + e->off, e->n);
+    }
+    return NULL;
 }
 
-void forest_free(Forest *f)
+static void ingest_normalize(IngestBuffer *b)
 {
-    if (!f) return;
-    for (int i = 0; i < f->nroots; ++i) node_free(f->roots[i]);
-    free(f->roots);
-    heap_free(f->root_heap);
-    free(f);
+    /* at least INGEST_PAR_MIN events per thread */
+    int nthreads = b->nev / INGEST_PAR_MIN;
+    if (nthreads > b->nthreads) nthreads = b->nthreads;
+    if (nthreads < 1)           nthreads = 1;
+
+    IngestJob *jobs = malloc(sizeof(IngestJob) * nthreads);
+    pthread_t *tids = malloc(sizeof(pthread_t) * nthreads);
+    if (!jobs || !tids) { perror("malloc"); exit(1); }
+    for (int t = 0; t < nthreads; ++t) {
+        jobs[t] = (IngestJob){ b, (int)((long)b->nev * t / nthreads),
+                                  (int)((long)b->nev * (t + 1) / nthreads) };
+    }
+    int spawned = 0;
+    for (int t = 1; t < nthreads; ++t, ++spawned)
+        if (pthread_create(&tids[t], NULL, ingest_normalize_worker, &jobs[t]) != 0)
+            break;
+    for (int t = spawned + 1; t < nthreads; ++t) ingest_normalize_worker(&jobs[t]);
+    ingest_normalize_worker(&jobs[0]);
+    for (int t = 1; t <= spawned; ++t) pthread_join(tids[t], NULL);
+    free(jobs); free(tids);
 }
 
-void insert_hyperedge(Forest *f, const int *verts, int nverts, double weight)
+static int cmp_event_by_weight_desc(const void *a, const void *b)
 {
-    int  n_norm;
-    int *norm = normalize_vertices(verts, nverts, &n_norm);
-    if (n_norm == 0) { free(norm); return; }
-    Node *nd = node_create(norm, n_norm, weight);
-    free(norm);
-    forest_insert_node(f, nd);
+    double wa = ((const IngestEvent*)a)->weight;
+    double wb = ((const IngestEvent*)b)->weight;
+    return (wa < wb) - (wa > wb);
 }
 
-/*
- * find_top_k — O(k log k) via working max-heap.
- *
- * Seed the heap with all roots, then repeatedly pop the heaviest node
- * and push its children.  The heap never exceeds k * max_branching entries
- * in practice, and we stop after k pops.
- */
-Node **find_top_k(Forest *f, int k, int *result_count)
+int forest_ingest_flush(IngestBuffer *b)
 {
-    if (k <= 0 || f->nroots == 0) { *result_count = 0; return NULL; }
+    int n = b->nev;
+    if (n == 0) return 0;
+    double t0 = now_ms();
+
+    ingest_normalize(b);
+    qsort(b->ev, n, sizeof(IngestEvent), cmp_event_by_weight_desc);
+
+    Forest *f = b->f;
+    writer_begin(f);
+    for (int i = 0; i < n; ++i)
+        insert_normalized(f, b->pool + b->ev[i].off, b->ev[i].n,
+                          b->ev[i].weight, NULL);
+    writer_end(f);
+
+    b->nev      = 0;
+    b->pool_len = 0;
+    b->stats.applied  += n;
+    b->stats.batches++;
+    b->stats.flush_ms += now_ms() - t0;
+    if (n > b->stats.max_batch) b->stats.max_batch = n;
+    return n;
+}
 
-    Node    **result = malloc(sizeof(Node*) * k);
-    if (!result) { perror("malloc"); exit(1); }
+static int ingest_expired(const IngestBuffer *b)
+{
+    return b->max_delay_ms > 0 && b->nev > 0 &&
+           now_ms() - b->oldest_ms >= b->max_delay_ms;
+}
 
-    NodeHeap *wh = heap_create();
-    for (int i = 0; i < f->nroots; ++i)
-        heap_push(wh, f->roots[i]);
+int forest_ingest_poll(IngestBuffer *b)
+{
+    if (!ingest_expired(b)) return 0;
+    b->stats.time_flushes++;
+    return forest_ingest_flush(b);
+}
 
-    int count = 0;
-    while (count < k && wh->size > 0) {
-        Node *top     = heap_pop(wh);
-        result[count++] = top;
-        for (int i = 0; i < top->nchildren; ++i)
-            heap_push(wh, top->children[i]);
+int forest_ingest_push(IngestBuffer *b, const hif_vertex_t *verts, int nverts,
+                       double weight)
+{
+    if (nverts <= 0) return 0;
+
+    /* the trigger runs before queueing, so a push waits on at most one
+       flush and the buffer never exceeds batch_size */
+    int applied = 0;
+    if (b->nev >= b->batch_size || ingest_expired(b)) {
+        double t0 = now_ms();
+        if (b->nev >= b->batch_size) b->stats.size_flushes++;
+        else                         b->stats.time_flushes++;
+        applied = forest_ingest_flush(b);
+        b->stats.stalled_pushes++;
+        b->stats.stall_ms += now_ms() - t0;
     }
 
-    heap_free(wh);
-    *result_count = count;
-    return result;
+    if (b->nev >= b->ev_cap) {
+        b->ev_cap = b->ev_cap ? b->ev_cap * 2 : 256;
+        b->ev = realloc(b->ev, sizeof(IngestEvent) * b->ev_cap);
+        if (!b->ev) { perror("realloc"); exit(1); }
+    }
+    if (b->pool_len + nverts > b->pool_cap) {
+        while (b->pool_len + nverts > b->pool_cap)
+            b->pool_cap = b->pool_cap ? b->pool_cap * 2 : 1024;
+        b->pool = realloc(b->pool, sizeof(hif_vertex_t) * b->pool_cap);
+        if (!b->pool) { perror("realloc"); exit(1); }
+    }
+    memcpy(b->pool + b->pool_len, verts, sizeof(hif_vertex_t) * nverts);
+    if (b->nev == 0) b->oldest_ms = now_ms();
+    b->ev[b->nev++] = (IngestEvent){ b->pool_len, nverts, weight };
+    b->pool_len += nverts;
+    b->stats.pushed++;
+    return applied;
 }
 
-static int count_by_threshold_recursive(Node *nd, double threshold)
+IngestStats forest_ingest_get_stats(const IngestBuffer *b)
 {
-    if (nd->he.weight < threshold) return 0;
-    int count = 1;
-    for (int i = 0; i < nd->nchildren; ++i)
-        count += count_by_threshold_recursive(nd->children[i], threshold);
-    return count;
+    IngestStats s = b->stats;
+    s.pending = b->nev;
+    return s;
 }
 
-int find_by_weight_threshold(Forest *f, double threshold)
+void forest_ingest_destroy(IngestBuffer *b)
 {
-    int count = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        count += count_by_threshold_recursive(f->roots[i], threshold);
-    return count;
+    if (!b) return;
+    forest_ingest_flush(b);
+    free(b->ev);
+    free(b->pool);
+    free(b);
+}
+
+/* ========== SERIALIZATION ========== */
+
+/*
+ * Format 2: SAVE_MAGIC, nroots, then every tree in pre-order.  A node is
+ * a coding byte, its vertex count, the vertex set, weight and child
+ * count.  Sets are vbyte-coded, except that a child which is a subset of
+ * its parent is stored as a bitmap over the parent's vertices whenever
+ * that is shorter.  Files without the magic are the original format
+ * (raw int arrays) and still load.
+ */
+#define SAVE_MAGIC        (-0x48494632)  /* "HIF2"; no v1 file starts < 0 */
+#define SAVE_CODE_VBYTE   0
+#define SAVE_CODE_PARENT  1
+
+typedef struct {
+    uint8_t *buf;
+    size_t   cap;
+} SaveBuf;
+
+static uint8_t *savebuf_reserve(SaveBuf *b, size_t n)
+{
+    if (n > b->cap) {
+        b->cap = n > 2 * b->cap ? n : 2 * b->cap;
+        b->buf = realloc(b->buf, b->cap);
+        if (!b->buf) { perror("realloc"); exit(1); }
+    }
+    return b->buf;
 }
 
-static Node *find_minimal_superset_recursive(Node *nd, const int *query,
-                                             int nquery, Node *best)
+/* One node record; children follow in pre-order. */
+static void write_node(const Node *nd, const Node *parent, FILE *fp,
+                       SaveBuf *b)
 {
-    if (is_subset(query, nquery, nd->he.verts, nd->he.nverts)) {
-        if (!best || nd->he.nverts < best->he.nverts) best = nd;
-        for (int i = 0; i < nd->nchildren; ++i) {
-            Node *cb = find_minimal_superset_recursive(nd->children[i],
-                                                       query, nquery, best);
-            if (cb && (!best || cb->he.nverts < best->he.nverts)) best = cb;
+    int      n    = nd->he.nverts;
+    uint32_t nv   = (uint32_t)n;
+    size_t   vb   = vbyte_size(nd->he.verts, n);
+    size_t   bm   = parent ? ((size_t)parent->he.nverts + 7) / 8 : 0;
+    uint8_t  code = SAVE_CODE_VBYTE;
+    if (parent && bm < vb &&
+        is_subset(nd->he.verts, n, parent->he.verts, parent->he.nverts))
+        code = SAVE_CODE_PARENT;
+
+    fwrite(&code, 1, 1, fp);
+    fwrite(&nv, sizeof(uint32_t), 1, fp);
+    if (code == SAVE_CODE_PARENT) {
+        uint8_t *bits = savebuf_reserve(b, bm);
+        memset(bits, 0, bm);
+        for (int i = 0, j = 0; i < n; ++i, ++j) {
+            while (parent->he.verts[j] < nd->he.verts[i]) j++;
+            bits[j >> 3] |= (uint8_t)(1u << (j & 7));
         }
+        fwrite(bits, 1, bm, fp);
+    } else {
+        uint32_t nb  = (uint32_t)vb;
+        uint8_t *enc = savebuf_reserve(b, vb);
+        hif_vbyte_encode(nd->he.verts, n, enc);
+        fwrite(&nb, sizeof(uint32_t), 1, fp);
+        fwrite(enc, 1, vb, fp);
     }
-    return best;
+    double w = nd->he.weight;          /* files store double in every build */
+    fwrite(&w,              sizeof(double), 1,             fp);
+    fwrite(&nd->nchildren,  sizeof(int),    1,             fp);
 }
 
-Node *find_minimal_superset(Forest *f, const int *query, int nquery)
+int forest_save(Forest *f, const char *filename)
 {
-    Node *best = NULL;
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) return -1;
+    int     magic = SAVE_MAGIC;
+    SaveBuf b     = { NULL, 0 };
+    fwrite(&magic, sizeof(int), 1, fp);
+    fwrite(&f->nroots, sizeof(int), 1, fp);
+    /* parents by depth: a snapshot's nodes may have relinked parent fields */
+    Node **path = NULL;
+    int    path_cap = 0;
+    Walk w;
+    walk_init(&w);
     for (int i = 0; i < f->nroots; ++i) {
-        Node *c = find_minimal_superset_recursive(f->roots[i], query,
-                                                  nquery, best);
-        if (c && (!best || c->he.nverts < best->he.nverts)) best = c;
+        Node *nd;
+        int   d;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, &d)) {
+            if (d >= path_cap) {
+                path_cap = path_cap ? path_cap * 2 : 16;
+                path = realloc(path, sizeof(Node*) * path_cap);
+                if (!path) { perror("realloc"); exit(1); }
+            }
+            path[d] = nd;
+            write_node(nd, d ? path[d - 1] : NULL, fp, &b);
+            walk_push_children(&w, nd->children, nd->nchildren, d + 1);
+        }
     }
-    return best;
+    walk_free(&w);
+    free(path);
+    free(b.buf);
+    fclose(fp);
+    return 0;
 }
 
-static Node *find_heaviest_superset_recursive(Node *nd, const int *query,
-                                              int nquery, Node *best)
+/* Vertex set of one node; *nverts set on success, NULL on a bad record. */
+static hif_vertex_t *read_verts(FILE *fp, int version,
+                                const hif_vertex_t *pverts, int pn,
+                                int *nverts)
 {
-    if (is_subset(query, nquery, nd->he.verts, nd->he.nverts)) {
-        if (!best || nd->he.weight > best->he.weight) best = nd;
-        for (int i = 0; i < nd->nchildren; ++i) {
-            Node *cb = find_heaviest_superset_recursive(nd->children[i],
-                                                        query, nquery, best);
-            if (cb && (!best || cb->he.weight > best->he.weight)) best = cb;
+    if (version == 1) {   /* raw int IDs */
+        int n;
+        if (fread(&n, sizeof(int), 1, fp) != 1 || n < 0) return NULL;
+        hif_vertex_t *verts = malloc(sizeof(hif_vertex_t) * (n ? n : 1));
+        if (!verts) return NULL;
+        for (int i = 0; i < n; ++i) {
+            int v;
+            if (fread(&v, sizeof(int), 1, fp) != 1
+#ifdef HIF_VERTEX_BITS
+                || v < 0 || (unsigned long long)v > HIF_VERTEX_MAX
+#endif
+               ) {
+                free(verts); return NULL;
+            }
+            verts[i] = (hif_vertex_t)v;
         }
+        *nverts = n;
+        return verts;
     }
-    return best;
+
+    uint8_t  code;
+    uint32_t nv, nb;
+    if (fread(&code, 1, 1, fp) != 1 || fread(&nv, sizeof(uint32_t), 1, fp) != 1)
+        return NULL;
+    if (nv > INT_MAX / sizeof(hif_vertex_t)) return NULL;
+    if (code == SAVE_CODE_PARENT) {
+        if (!pverts || (int)nv > pn) return NULL;
+        nb = (uint32_t)((pn + 7) / 8);
+    } else if (code == SAVE_CODE_VBYTE) {
+        if (fread(&nb, sizeof(uint32_t), 1, fp) != 1 ||
+            nb > hif_vbyte_bound((int)nv)) return NULL;
+    } else {
+        return NULL;
+    }
+
+    uint8_t      *bytes = malloc(nb ? nb : 1);
+    hif_vertex_t *verts = malloc(sizeof(hif_vertex_t) * (nv ? nv : 1));
+    if (!bytes || !verts || fread(bytes, 1, nb, fp) != nb) {
+        free(bytes); free(verts); return NULL;
+    }
+    int ok;
+    if (code == SAVE_CODE_PARENT) {
+        int n = 0;
+        for (int j = 0; j < pn; ++j)
+            if (bytes[j >> 3] & (1u << (j & 7))) {
+                if (n < (int)nv) verts[n] = pverts[j];
+                n++;
+            }
+        ok = n == (int)nv;
+    } else {
+        ok = vbyte_check(bytes, nb, (int)nv, verts) == (long)nb;
+    }
+    free(bytes);
+    if (!ok) { free(verts); return NULL; }
+    *nverts = (int)nv;
+    return verts;
 }
 
-Node *find_heaviest_superset(Forest *f, const int *query, int nquery)
+/* One node record (without its children); *nchildren follows it. */
+static Node *read_node(Forest *f, FILE *fp, int version,
+                       const Node *parent, int *nchildren)
 {
-    Node *best = NULL;
-    for (int i = 0; i < f->nroots; ++i) {
-        Node *c = find_heaviest_superset_recursive(f->roots[i], query,
-                                                   nquery, best);
-        if (c && (!best || c->he.weight > best->he.weight)) best = c;
+    int           nverts;
+    hif_vertex_t *verts = read_verts(fp, version,
+                                     parent ? parent->he.verts : NULL,
+                                     parent ? parent->he.nverts : 0, &nverts);
+    if (!verts) return NULL;
+
+    double weight;
+    if (fread(&weight, sizeof(double), 1, fp) != 1) {
+        free(verts); return NULL;
     }
-    return best;
+
+    Node *nd = node_create(f, verts, nverts, weight, verts);
+    if (f->arena) free(verts);
+
+    if (fread(nchildren, sizeof(int), 1, fp) != 1) {
+        node_free(f, nd); return NULL;
+    }
+    return nd;
 }
 
-/* ========== CLUSTERING & ANALYSIS ========== */
+/*
+ * Rebuild one pre-order tree with an explicit stack of open nodes.  A
+ * node is attached to its parent only once its own subtree is complete,
+ * so node_add_child folds finished aggregates.  Unattached nodes on the
+ * stack are disjoint, so a bad record frees each of them.
+ */
+typedef struct {
+    Node *nd;
+    int   left;   /* children still to read */
+} ReadFrame;
 
-static void collect_by_threshold_recursive(Node *nd, double threshold,
-                                           Node ***result, int *count, int *cap)
+static Node *read_tree(Forest *f, FILE *fp, int version)
 {
-    if (nd->he.weight >= threshold) {
-        if (*count >= *cap) {
-            *cap    = *cap ? *cap * 2 : 16;
-            *result = realloc(*result, sizeof(Node*) * (*cap));
-            if (!*result) { perror("realloc"); exit(1); }
+    int        n = 0, cap = 16, nk;
+    ReadFrame *st = malloc(sizeof(ReadFrame) * cap);
+    if (!st) { perror("malloc"); exit(1); }
+    Node *root = read_node(f, fp, version, NULL, &nk);
+    if (!root) { free(st); return NULL; }
+    st[n++] = (ReadFrame){ root, nk };
+
+    while (n > 0) {
+        ReadFrame *top = &st[n - 1];
+        if (top->left <= 0) {
+            if (--n > 0) node_add_child(f, st[n - 1].nd, top->nd);
+            continue;
+        }
+        top->left--;
+        Node *child = read_node(f, fp, version, top->nd, &nk);
+        if (!child) {
+            while (n > 0) node_free(f, st[--n].nd);
+            free(st);
+            return NULL;
+        }
+        if (n == cap) {
+            cap *= 2;
+            st   = realloc(st, sizeof(ReadFrame) * cap);
+            if (!st) { perror("realloc"); exit(1); }
         }
-        (*result)[(*count)++] = nd;
-        for (int i = 0; i < nd->nchildren; ++i)
-            collect_by_threshold_recursive(nd->children[i], threshold,
-                                           result, count, cap);
+        st[n++] = (ReadFrame){ child, nk };
     }
+    free(st);
+    return root;
 }
 
-Node **get_clusters_by_weight(Forest *f, double threshold, int *cluster_count)
+Forest *forest_load(const char *filename)
 {
-    Node **result = NULL;
-    int count = 0, cap = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        collect_by_threshold_recursive(f->roots[i], threshold,
-                                       &result, &count, &cap);
-    *cluster_count = count;
-    return result;
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+
+    Forest *f = forest_create();
+    int nroots, version = 1;
+    if (fread(&nroots, sizeof(int), 1, fp) != 1) {
+        forest_free(f); fclose(fp); return NULL;
+    }
+    if (nroots == SAVE_MAGIC) {
+        version = 2;
+        if (fread(&nroots, sizeof(int), 1, fp) != 1 || nroots < 0) {
+            forest_free(f); fclose(fp); return NULL;
+        }
+    }
+
+    for (int i = 0; i < nroots; ++i) {
+        Node *root = read_tree(f, fp, version);
+        if (!root) { forest_free(f); fclose(fp); return NULL; }
+        forest_add_root(f, root);
+    }
+
+    fclose(fp);
+    return f;
 }
 
-double compute_overlap(const Node *a, const Node *b)
+/* ========== FLAT (MMAP-ABLE) FORMAT ========== */
+
+#define FLAT_ALIGN       64
+#define FLAT_BYTE_ORDER  0x01020304u
+
+static uint64_t flat_align(uint64_t off)
 {
-    return overlap_ratio(a->he.verts, a->he.nverts,
-                         b->he.verts, b->he.nverts);
+    return (off + FLAT_ALIGN - 1) & ~(uint64_t)(FLAT_ALIGN - 1);
 }
 
-/* ========== UTILITY ========== */
+/* Version 1 headers end before the flags field. */
+static uint32_t flat_flags(const FlatHeader *h)
+{
+    return h->version >= 2 ? h->flags : 0;
+}
 
-static int count_nodes_recursive(Node *nd)
+static uint32_t flat_elem_types(const FlatHeader *h)
 {
-    int c = 1;
-    for (int i = 0; i < nd->nchildren; ++i)
-        c += count_nodes_recursive(nd->children[i]);
-    return c;
+    return h->version >= 2 ? h->elem_types : 0;
 }
 
-int count_total_nodes(Forest *f)
+/*
+ * Fill in the array offsets and total size for a given shape.  pool_bytes
+ * is only read for HIF_FLAT_VBYTE; otherwise the pool is nverts_total
+ * vertex IDs.
+ */
+static void flat_layout(FlatHeader *h, uint32_t version, uint32_t flags,
+                        uint64_t nnodes, uint64_t nroots,
+                        uint64_t nverts_total, uint64_t pool_bytes)
 {
-    int total = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        total += count_nodes_recursive(f->roots[i]);
-    return total;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, HIF_FLAT_MAGIC, sizeof(HIF_FLAT_MAGIC));
+    if (!(flags & HIF_FLAT_VBYTE))
+        pool_bytes = nverts_total * sizeof(hif_vertex_t);
+    h->version          = version;
+    h->byte_order       = FLAT_BYTE_ORDER;
+    h->nnodes           = nnodes;
+    h->nroots           = nroots;
+    h->nverts_total     = nverts_total;
+    if (version >= 2) {
+        h->flags        = flags;
+        h->elem_types   = HIF_FLAT_ELEM_TYPES;
+        h->pool_bytes   = pool_bytes;
+    }
+    h->off_weights      = flat_align(version >= 2 ? sizeof(FlatHeader)
+                                        : offsetof(FlatHeader, flags));
+    h->off_nverts       = flat_align(h->off_weights + nnodes * sizeof(hif_weight_t));
+    h->off_verts_offset = flat_align(h->off_nverts + nnodes * sizeof(uint32_t));
+    h->off_first_child  = flat_align(h->off_verts_offset + nnodes * sizeof(uint64_t));
+    h->off_child_count  = flat_align(h->off_first_child + nnodes * sizeof(uint32_t));
+    h->off_vertex_pool  = flat_align(h->off_child_count + nnodes * sizeof(uint32_t));
+    h->image_size       = flat_align(h->off_vertex_pool + pool_bytes);
 }
 
-int forest_max_depth(Forest *f)
+/* Point the FlatForest arrays into an image whose header is valid. */
+static void flat_bind(FlatForest *ff, void *image, size_t size, int mapped)
 {
-    int mx = 0;
+    const FlatHeader *h = image;
+    char *b = image;
+    ff->nnodes       = h->nnodes;
+    ff->nroots       = h->nroots;
+    ff->weights      = (const hif_weight_t*)(b + h->off_weights);
+    ff->nverts       = (const uint32_t*)(b + h->off_nverts);
+    ff->verts_offset = (const uint64_t*)(b + h->off_verts_offset);
+    ff->first_child  = (const uint32_t*)(b + h->off_first_child);
+    ff->child_count  = (const uint32_t*)(b + h->off_child_count);
+    ff->vertex_pool  = NULL;
+    ff->vbyte_pool   = NULL;
+    if (flat_flags(h) & HIF_FLAT_VBYTE)
+        ff->vbyte_pool  = (const uint8_t*)(b + h->off_vertex_pool);
+    else
+        ff->vertex_pool = (const hif_vertex_t*)(b + h->off_vertex_pool);
+    ff->image        = image;
+    ff->image_size   = size;
+    ff->mapped       = mapped;
+}
+
+/*
+ * Build the BFS-numbered image of f on the heap.  Returns NULL if the
+ * forest is too large for 32-bit node IDs.
+ */
+static FlatForest *flat_build(Forest *f, int compress)
+{
+    uint64_t nnodes = 0, nverts_total = 0, pool_bytes = 0;
+    Node **queue = NULL;
+    int    cap   = 0;
+
+    /* BFS order: the queue itself becomes the ID → node map */
     for (int i = 0; i < f->nroots; ++i) {
-        int d = node_depth(f->roots[i]);
-        if (d > mx) mx = d;
+        if ((int)nnodes >= cap) {
+            cap   = cap ? cap * 2 : 1024;
+            queue = realloc(queue, sizeof(Node*) * cap);
+            if (!queue) { perror("realloc"); exit(1); }
+        }
+        queue[nnodes++] = f->roots[i];
     }
-    return mx;
+    for (uint64_t front = 0; front < nnodes; ++front) {
+        Node *nd = queue[front];
+        nverts_total += nd->he.nverts;
+        if (compress) pool_bytes += vbyte_size(nd->he.verts, nd->he.nverts);
+        for (int i = 0; i < nd->nchildren; ++i) {
+            if (nnodes >= UINT32_MAX) { free(queue); return NULL; }
+            if ((int)nnodes >= cap) {
+                cap   = cap * 2;
+                queue = realloc(queue, sizeof(Node*) * cap);
+                if (!queue) { perror("realloc"); exit(1); }
+            }
+            queue[nnodes++] = nd->children[i];
+        }
+    }
+
+    FlatHeader h;
+    flat_layout(&h, HIF_FLAT_VERSION, compress ? HIF_FLAT_VBYTE : 0,
+                nnodes, (uint64_t)f->nroots, nverts_total, pool_bytes);
+    char *image = calloc(1, h.image_size);
+    if (!image) { perror("calloc"); exit(1); }
+    memcpy(image, &h, sizeof(h));
+
+    FlatForest *ff = malloc(sizeof(FlatForest));
+    if (!ff) { perror("malloc"); exit(1); }
+    flat_bind(ff, image, h.image_size, 0);
+
+    hif_weight_t *w  = (hif_weight_t*)(image + h.off_weights);
+    uint32_t     *nv = (uint32_t*)    (image + h.off_nverts);
+    uint64_t     *vo = (uint64_t*)    (image + h.off_verts_offset);
+    uint32_t     *fc = (uint32_t*)    (image + h.off_first_child);
+    uint32_t     *cc = (uint32_t*)    (image + h.off_child_count);
+    char         *vp = image + h.off_vertex_pool;
+
+    uint64_t next_child = (uint64_t)f->nroots, pool = 0;
+    for (uint64_t id = 0; id < nnodes; ++id) {
+        Node *nd = queue[id];
+        w[id]  = nd->he.weight;
+        nv[id] = (uint32_t)nd->he.nverts;
+        vo[id] = pool;
+        if (compress) {
+            pool += hif_vbyte_encode(nd->he.verts, nd->he.nverts,
+                                     (uint8_t*)vp + pool);
+        } else {
+            memcpy((hif_vertex_t*)vp + pool, nd->he.verts,
+                   sizeof(hif_vertex_t) * nd->he.nverts);
+            pool += nd->he.nverts;
+        }
+        fc[id] = (uint32_t)next_child;
+        cc[id] = (uint32_t)nd->nchildren;
+        next_child += nd->nchildren;
+    }
+    free(queue);
+    return ff;
 }
 
-/* O(1): heaviest root is always at top of root_heap. */
-double forest_max_weight(Forest *f)
+FlatForest *forest_freeze(Forest *f)
 {
-    if (f->nroots == 0) return 0.0;
-    return f->root_heap->data[0]->he.weight;
+    return flat_build(f, 0);
 }
 
-static void find_min_weight_recursive(Node *nd, double *mn)
+FlatForest *forest_freeze_compressed(Forest *f)
 {
-    if (nd->he.weight < *mn) *mn = nd->he.weight;
-    for (int i = 0; i < nd->nchildren; ++i)
-        find_min_weight_recursive(nd->children[i], mn);
+    return flat_build(f, 1);
 }
 
-double forest_min_weight(Forest *f)
+int flat_forest_save(const FlatForest *ff, const char *filename)
 {
-    if (f->nroots == 0) return 0.0;
-    double mn = f->roots[0]->he.weight;
-    for (int i = 0; i < f->nroots; ++i)
-        find_min_weight_recursive(f->roots[i], &mn);
-    return mn;
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) return -1;
+    int rc = fwrite(ff->image, 1, ff->image_size, fp) == ff->image_size ? 0 : -1;
+    if (fclose(fp) != 0) rc = -1;
+    return rc;
 }
 
-static void print_indent(int depth)
+int forest_save_flat(Forest *f, const char *filename)
 {
-    for (int i = 0; i < depth; ++i) printf("  ");
+    FlatForest *ff = forest_freeze(f);
+    if (!ff) return -1;
+    int rc = flat_forest_save(ff, filename);
+    flat_forest_close(ff);
+    return rc;
 }
 
-static void print_node(Node *nd, int depth)
+static int flat_header_valid(const FlatHeader *h, size_t size)
 {
-    print_indent(depth);
-    printf("⚡ w=%.2f {", nd->he.weight);
-    for (int i = 0; i < nd->he.nverts; ++i) {
-        printf("%d", nd->he.verts[i]);
-        if (i + 1 < nd->he.nverts) printf(",");
-    }
-    printf("}\n");
-    for (int i = 0; i < nd->nchildren; ++i)
-        print_node(nd->children[i], depth + 1);
+    if (size < sizeof(FlatHeader))                                return 0;
+    if (memcmp(h->magic, HIF_FLAT_MAGIC, sizeof(HIF_FLAT_MAGIC))) return 0;
+    if (h->version < 1 || h->version > HIF_FLAT_VERSION)          return 0;
+    if (h->byte_order != FLAT_BYTE_ORDER)                         return 0;
+    if (h->nroots > h->nnodes || h->nnodes > UINT32_MAX)          return 0;
+    if (flat_flags(h) & ~HIF_FLAT_VBYTE)                          return 0;
+    if (flat_elem_types(h) != HIF_FLAT_ELEM_TYPES)                return 0;
+
+    FlatHeader expect;
+    flat_layout(&expect, h->version, flat_flags(h), h->nnodes, h->nroots,
+                h->nverts_total, h->version >= 2 ? h->pool_bytes : 0);
+    return h->off_weights      == expect.off_weights      &&
+           h->off_nverts       == expect.off_nverts       &&
+           h->off_verts_offset == expect.off_verts_offset &&
+           h->off_first_child  == expect.off_first_child  &&
+           h->off_child_count  == expect.off_child_count  &&
+           h->off_vertex_pool  == expect.off_vertex_pool  &&
+           h->image_size       == expect.image_size       &&
+           h->image_size       == size;
 }
 
-void print_forest(Forest *f)
+FlatForest *flat_forest_open(const char *filename)
 {
-    printf("\n╔══════════════════════════════════════════╗\n");
-    printf("║  WEIGHTED HYPERGRAPH DECOMPOSITION      ║\n");
-    printf("╚══════════════════════════════════════════╝\n");
-    printf("Roots: %d | Total: %d | Depth: %d\n",
-           f->nroots, count_total_nodes(f), forest_max_depth(f));
-    if (f->nroots > 0)
-        printf("Weight range: [%.2f, %.2f]\n",
-               forest_min_weight(f), forest_max_weight(f));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
 
-    for (int i = 0; i < f->nroots; ++i) {
-        printf("\n[ROOT %d]\n", i + 1);
-        print_node(f->roots[i], 0);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FlatHeader)) {
+        close(fd); return NULL;
     }
-    printf("\n");
+    size_t size = (size_t)st.st_size;
+    void  *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  /* the mapping keeps the file referenced */
+    if (base == MAP_FAILED) return NULL;
+
+    if (!flat_header_valid(base, size)) { munmap(base, size); return NULL; }
+
+    FlatForest *ff = malloc(sizeof(FlatForest));
+    if (!ff) { perror("malloc"); exit(1); }
+    flat_bind(ff, base, size, 1);
+    return ff;
 }
 
-static int verify_weight_monotonicity(Node *nd)
+void flat_forest_close(FlatForest *ff)
 {
-    for (int i = 0; i < nd->nchildren; ++i) {
-        if (nd->children[i]->he.weight > nd->he.weight + 1e-9) return 0;
-        if (!verify_weight_monotonicity(nd->children[i]))       return 0;
+    if (!ff) return;
+    if (ff->mapped) munmap(ff->image, ff->image_size);
+    else            free(ff->image);
+    free(ff);
+}
+
+int flat_forest_verify(const FlatForest *ff)
+{
+    const FlatHeader *h = ff->image;
+    uint64_t expect_child = ff->nroots;
+    uint64_t nverts_seen  = 0;
+    for (uint64_t id = 0; id < ff->nnodes; ++id) {
+        if (ff->child_count[id] > 0 && ff->first_child[id] != expect_child)
+            return 0;
+        expect_child += ff->child_count[id];
+        if (expect_child > ff->nnodes) return 0;
+        nverts_seen += ff->nverts[id];
+        if (ff->vbyte_pool) {
+            if (ff->verts_offset[id] > h->pool_bytes ||
+                vbyte_check(ff->vbyte_pool + ff->verts_offset[id],
+                            h->pool_bytes - ff->verts_offset[id],
+                            (int)ff->nverts[id], NULL) < 0) return 0;
+        } else {
+            if (ff->verts_offset[id] + ff->nverts[id] > h->nverts_total)
+                return 0;
+            const hif_vertex_t *v = ff->vertex_pool + ff->verts_offset[id];
+            for (uint32_t i = 1; i < ff->nverts[id]; ++i)
+                if (v[i - 1] >= v[i]) return 0;
+        }
+        for (uint32_t c = 0; c < ff->child_count[id]; ++c)
+            if (ff->weights[ff->first_child[id] + c] > ff->weights[id] + 1e-9)
+                return 0;
     }
-    return 1;
+    return expect_child == ff->nnodes && nverts_seen == h->nverts_total;
 }
 
-int verify_forest(Forest *f)
+const hif_vertex_t *flat_node_verts(const FlatForest *ff, uint32_t id,
+                                    int *nverts)
 {
-    for (int i = 0; i < f->nroots; ++i)
-        if (!verify_weight_monotonicity(f->roots[i])) return 0;
-    return 1;
+    *nverts = (int)ff->nverts[id];
+    if (ff->vbyte_pool) return NULL;
+    return ff->vertex_pool + ff->verts_offset[id];
 }
 
-ForestStats get_forest_stats(Forest *f)
+int flat_node_decode(const FlatForest *ff, uint32_t id, hif_vertex_t *out)
 {
-    ForestStats stats = {0};
-    stats.total_nodes = count_total_nodes(f);
-    stats.num_roots   = f->nroots;
-    stats.max_depth   = forest_max_depth(f);
-    stats.max_weight  = forest_max_weight(f);
-    stats.min_weight  = forest_min_weight(f);
+    int n = (int)ff->nverts[id];
+    if (ff->vbyte_pool)
+        hif_vbyte_decode(ff->vbyte_pool + ff->verts_offset[id], n, out);
+    else
+        memcpy(out, ff->vertex_pool + ff->verts_offset[id],
+               sizeof(hif_vertex_t) * n);
+    return n;
+}
 
-    if (stats.total_nodes == 0) return stats;
+/* Max-heap of node IDs keyed by the image's weights. */
+typedef struct {
+    uint32_t *data;
+    int       size, cap;
+} FlatHeap;
+
+static void flat_heap_push(FlatHeap *h, const hif_weight_t *w, uint32_t id)
+{
+    if (h->size >= h->cap) {
+        h->cap  = h->cap ? h->cap * 2 : 64;
+        h->data = realloc(h->data, sizeof(uint32_t) * h->cap);
+        if (!h->data) { perror("realloc"); exit(1); }
+    }
+    int i = h->size++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (w[h->data[parent]] >= w[id]) break;
+        h->data[i] = h->data[parent];
+        i = parent;
+    }
+    h->data[i] = id;
+}
 
-    /* BFS to collect avg_weight and max_children */
-    Node **queue = malloc(sizeof(Node*) * (stats.total_nodes + 1));
-    if (!queue) { perror("malloc"); exit(1); }
+static uint32_t flat_heap_pop(FlatHeap *h, const hif_weight_t *w)
+{
+    uint32_t top  = h->data[0];
+    uint32_t last = h->data[--h->size];
+    int i = 0;
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, big = l;
+        if (l >= h->size) break;
+        if (r < h->size && w[h->data[r]] > w[h->data[l]]) big = r;
+        if (w[h->data[big]] <= w[last]) break;
+        h->data[i] = h->data[big];
+        i = big;
+    }
+    if (h->size > 0) h->data[i] = last;
+    return top;
+}
 
-    int    front = 0, back = 0;
-    double sum   = 0.0;
+uint32_t *flat_find_top_k(const FlatForest *ff, int k, int *result_count)
+{
+    *result_count = 0;
+    if (k <= 0 || ff->nroots == 0) return NULL;
+    uint32_t *result = malloc(sizeof(uint32_t) * k);
+    if (!result) { perror("malloc"); exit(1); }
 
-    for (int i = 0; i < f->nroots; ++i) queue[back++] = f->roots[i];
+    FlatHeap wh = { NULL, 0, 0 };
+    for (uint32_t r = 0; r < ff->nroots; ++r) flat_heap_push(&wh, ff->weights, r);
 
-    while (front < back) {
-        Node *curr = queue[front++];
-        sum += curr->he.weight;
-        if (curr->nchildren > stats.max_children)
-            stats.max_children = curr->nchildren;
-        for (int i = 0; i < curr->nchildren; ++i) {
-            if (back <= stats.total_nodes)   /* fixed off-by-one */
-                queue[back++] = curr->children[i];
-        }
+    int count = 0;
+    while (count < k && wh.size > 0) {
+        uint32_t top = flat_heap_pop(&wh, ff->weights);
+        result[count++] = top;
+        for (uint32_t c = 0; c < ff->child_count[top]; ++c)
+            flat_heap_push(&wh, ff->weights, ff->first_child[top] + c);
     }
+    free(wh.data);
+    *result_count = count;
+    return result;
+}
 
-    free(queue);
-    stats.avg_weight = sum / stats.total_nodes;
-    return stats;
+static int flat_contains(const FlatForest *ff, uint32_t id,
+                         const hif_vertex_t *query, int nquery)
+{
+    if (ff->vbyte_pool)
+        return hif_vbyte_contains(ff->vbyte_pool + ff->verts_offset[id],
+                                  (int)ff->nverts[id], query, nquery);
+    return is_subset(query, nquery, ff->vertex_pool + ff->verts_offset[id],
+                     (int)ff->nverts[id]);
 }
 
-/* ========== ADVANCED QUERY OPERATIONS ========== */
+static int flat_within(const FlatForest *ff, uint32_t id,
+                       const hif_vertex_t *query, int nquery)
+{
+    if (ff->vbyte_pool)
+        return hif_vbyte_within(ff->vbyte_pool + ff->verts_offset[id],
+                                (int)ff->nverts[id], query, nquery);
+    return is_subset(ff->vertex_pool + ff->verts_offset[id],
+                     (int)ff->nverts[id], query, nquery);
+}
 
-static void collect_supersets_recursive(Node *nd, const int *query, int nquery,
-                                        Node ***result, int *count, int *cap)
+static double flat_overlap(const FlatForest *ff, uint32_t id,
+                           const hif_vertex_t *query, int nquery)
 {
-    if (is_subset(query, nquery, nd->he.verts, nd->he.nverts)) {
-        if (*count >= *cap) {
-            *cap    = *cap ? *cap * 2 : 16;
-            *result = realloc(*result, sizeof(Node*) * (*cap));
-            if (!*result) { perror("realloc"); exit(1); }
-        }
-        (*result)[(*count)++] = nd;
-        for (int i = 0; i < nd->nchildren; ++i)
-            collect_supersets_recursive(nd->children[i], query, nquery,
-                                        result, count, cap);
-    }
+    int n = (int)ff->nverts[id];
+    if (!ff->vbyte_pool)
+        return overlap_ratio(query, nquery,
+                             ff->vertex_pool + ff->verts_offset[id], n);
+    int mn = n < nquery ? n : nquery;
+    if (mn == 0) return 0.0;
+    return (double)hif_vbyte_intersect_count(ff->vbyte_pool + ff->verts_offset[id],
+                                             n, query, nquery) / mn;
 }
 
-Node **find_all_supersets(Forest *f, const int *query, int nquery,
-                          int *result_count)
+/*
+ * Pre-order walk descending only into supersets of query (the pruning of
+ * the pointer-based superset queries), with an explicit ID stack.
+ * visit() is called for every superset in the same order as the
+ * recursive walk.
+ */
+static void flat_walk_supersets(const FlatForest *ff, const hif_vertex_t *query,
+                                int nquery, void (*visit)(uint32_t id,
+                                void *ctx), void *ctx)
 {
-    Node **result = NULL;
-    int count = 0, cap = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        collect_supersets_recursive(f->roots[i], query, nquery,
-                                    &result, &count, &cap);
-    *result_count = count;
-    return result;
+    uint32_t *stack = NULL;
+    size_t    top   = 0, cap = 0;
+    for (uint64_t r = ff->nroots; r-- > 0; ) {
+        if (top >= cap) {
+            cap   = cap ? cap * 2 : 256;
+            stack = realloc(stack, sizeof(uint32_t) * cap);
+            if (!stack) { perror("realloc"); exit(1); }
+        }
+        stack[top++] = (uint32_t)r;
+    }
+    while (top > 0) {
+        uint32_t id = stack[--top];
+        if (!flat_contains(ff, id, query, nquery)) continue;
+        visit(id, ctx);
+        for (uint32_t c = ff->child_count[id]; c-- > 0; ) {
+            if (top >= cap) {
+                cap   = cap ? cap * 2 : 256;
+                stack = realloc(stack, sizeof(uint32_t) * cap);
+                if (!stack) { perror("realloc"); exit(1); }
+            }
+            stack[top++] = ff->first_child[id] + c;
+        }
+    }
+    free(stack);
 }
 
-static void collect_subsets_recursive(Node *nd, const int *query, int nquery,
-                                      Node ***result, int *count, int *cap)
+typedef struct {
+    const FlatForest *ff;
+    int64_t           best;
+} FlatBestCtx;
+
+static void flat_visit_heaviest(uint32_t id, void *ctx)
 {
-    if (is_subset(nd->he.verts, nd->he.nverts, query, nquery)) {
-        if (*count >= *cap) {
-            *cap    = *cap ? *cap * 2 : 16;
-            *result = realloc(*result, sizeof(Node*) * (*cap));
-            if (!*result) { perror("realloc"); exit(1); }
-        }
-        (*result)[(*count)++] = nd;
-    }
-    for (int i = 0; i < nd->nchildren; ++i)
-        collect_subsets_recursive(nd->children[i], query, nquery,
-                                  result, count, cap);
+    FlatBestCtx *c = ctx;
+    if (c->best < 0 || c->ff->weights[id] > c->ff->weights[c->best]) c->best = id;
 }
 
-Node **find_all_subsets(Forest *f, const int *query, int nquery,
-                        int *result_count)
+int64_t flat_find_heaviest_superset(const FlatForest *ff,
+                                    const hif_vertex_t *query, int nquery)
 {
-    Node **result = NULL;
-    int count = 0, cap = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        collect_subsets_recursive(f->roots[i], query, nquery,
-                                  &result, &count, &cap);
-    *result_count = count;
-    return result;
+    FlatBestCtx c = { ff, -1 };
+    flat_walk_supersets(ff, query, nquery, flat_visit_heaviest, &c);
+    return c.best;
 }
 
-static void collect_by_weight_range_recursive(Node *nd,
-                                              double min_w, double max_w,
-                                              Node ***result,
-                                              int *count, int *cap)
+typedef struct {
+    uint32_t *ids;
+    int       count, cap;
+} FlatIdList;
+
+static void flat_visit_collect(uint32_t id, void *ctx)
 {
-    if (nd->he.weight >= min_w && nd->he.weight <= max_w) {
-        if (*count >= *cap) {
-            *cap    = *cap ? *cap * 2 : 16;
-            *result = realloc(*result, sizeof(Node*) * (*cap));
-            if (!*result) { perror("realloc"); exit(1); }
-        }
-        (*result)[(*count)++] = nd;
-    }
-    if (nd->he.weight >= min_w) {
-        for (int i = 0; i < nd->nchildren; ++i)
-            collect_by_weight_range_recursive(nd->children[i], min_w, max_w,
-                                              result, count, cap);
+    FlatIdList *l = ctx;
+    if (l->count >= l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 16;
+        l->ids = realloc(l->ids, sizeof(uint32_t) * l->cap);
+        if (!l->ids) { perror("realloc"); exit(1); }
     }
+    l->ids[l->count++] = id;
 }
 
-Node **find_by_weight_range(Forest *f, double min_weight, double max_weight,
-                            int *result_count)
+uint32_t *flat_find_all_supersets(const FlatForest *ff,
+                                  const hif_vertex_t *query, int nquery,
+                                  int *result_count)
 {
-    Node **result = NULL;
-    int count = 0, cap = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        if (f->roots[i]->he.weight >= min_weight)
-            collect_by_weight_range_recursive(f->roots[i], min_weight,
-                                              max_weight, &result,
-                                              &count, &cap);
-    *result_count = count;
-    return result;
+    FlatIdList l = { NULL, 0, 0 };
+    flat_walk_supersets(ff, query, nquery, flat_visit_collect, &l);
+    *result_count = l.count;
+    return l.ids;
 }
 
-static void collect_containing_recursive(Node *nd,
-                                         const int *vertices, int nvertices,
-                                         Node ***result, int *count, int *cap)
+static void flat_visit_minimal(uint32_t id, void *ctx)
 {
-    if (is_subset(vertices, nvertices, nd->he.verts, nd->he.nverts)) {
-        if (*count >= *cap) {
-            *cap    = *cap ? *cap * 2 : 16;
-            *result = realloc(*result, sizeof(Node*) * (*cap));
-            if (!*result) { perror("realloc"); exit(1); }
-        }
-        (*result)[(*count)++] = nd;
-        for (int i = 0; i < nd->nchildren; ++i)
-            collect_containing_recursive(nd->children[i], vertices, nvertices,
-                                         result, count, cap);
-    }
+    FlatBestCtx *c = ctx;
+    if (c->best < 0 || c->ff->nverts[id] < c->ff->nverts[c->best]) c->best = id;
 }
 
-Node **find_containing_vertices(Forest *f, const int *vertices, int nvertices,
-                                int *result_count)
+int64_t flat_find_minimal_superset(const FlatForest *ff,
+                                   const hif_vertex_t *query, int nquery)
 {
-    Node **result = NULL;
-    int count = 0, cap = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        collect_containing_recursive(f->roots[i], vertices, nvertices,
-                                     &result, &count, &cap);
-    *result_count = count;
-    return result;
+    FlatBestCtx c = { ff, -1 };
+    flat_walk_supersets(ff, query, nquery, flat_visit_minimal, &c);
+    return c.best;
 }
 
-/* ---- similarity search ---- */
-
-typedef struct { Node *node; double similarity; } SimilarityPair;
+/*
+ * The remaining queries cannot prune by the tree (subsets, similarity)
+ * or gain little from it (weights are contiguous), so they are straight
+ * scans over the parallel arrays.
+ */
+uint32_t *flat_find_all_subsets(const FlatForest *ff, const hif_vertex_t *query,
+                                int nquery, int *result_count)
+{
+    FlatIdList l = { NULL, 0, 0 };
+    for (uint64_t id = 0; id < ff->nnodes; ++id) {
+        if ((int)ff->nverts[id] > nquery) continue;
+        if (flat_within(ff, (uint32_t)id, query, nquery))
+            flat_visit_collect((uint32_t)id, &l);
+    }
+    *result_count = l.count;
+    return l.ids;
+}
 
-static int cmp_similarity(const void *a, const void *b)
+uint32_t *flat_find_by_weight_range(const FlatForest *ff, double min_weight,
+                                    double max_weight, int *result_count)
 {
-    double da = ((SimilarityPair*)a)->similarity;
-    double db = ((SimilarityPair*)b)->similarity;
-    return (da < db) - (da > db); /* descending */
+    FlatIdList l = { NULL, 0, 0 };
+    for (uint64_t id = 0; id < ff->nnodes; ++id)
+        if (ff->weights[id] >= min_weight && ff->weights[id] <= max_weight)
+            flat_visit_collect((uint32_t)id, &l);
+    *result_count = l.count;
+    return l.ids;
 }
 
-static void collect_all_nodes_recursive(Node *nd,
-                                        Node ***result, int *count, int *cap)
+int flat_count_by_weight_threshold(const FlatForest *ff, double threshold)
 {
-    if (*count >= *cap) {
-        *cap    = *cap ? *cap * 2 : 64;
-        *result = realloc(*result, sizeof(Node*) * (*cap));
-        if (!*result) { perror("realloc"); exit(1); }
-    }
-    (*result)[(*count)++] = nd;
-    for (int i = 0; i < nd->nchildren; ++i)
-        collect_all_nodes_recursive(nd->children[i], result, count, cap);
+    int count = 0;
+    for (uint64_t id = 0; id < ff->nnodes; ++id)
+        count += ff->weights[id] >= threshold;
+    return count;
 }
 
-static Node **collect_all_nodes(Forest *f, int *total_count)
+typedef struct { uint32_t id; double similarity; } FlatSimilarity;
+
+static int cmp_flat_similarity(const void *a, const void *b)
 {
-    Node **all  = NULL;
-    int count   = 0, cap = 0;
-    for (int i = 0; i < f->nroots; ++i)
-        collect_all_nodes_recursive(f->roots[i], &all, &count, &cap);
-    *total_count = count;
-    return all;
+    const FlatSimilarity *x = a, *y = b;
+    if (x->similarity != y->similarity) return x->similarity < y->similarity ? 1 : -1;
+    return (x->id > y->id) - (x->id < y->id);
 }
 
-Node **find_k_most_similar(Forest *f, const int *query, int nquery,
-                           int k, int *result_count)
+uint32_t *flat_find_k_most_similar(const FlatForest *ff,
+                                   const hif_vertex_t *query, int nquery, int k,
+                                   int *result_count)
 {
-    int total;
-    Node **all = collect_all_nodes(f, &total);
-    if (total == 0) { *result_count = 0; return NULL; }
+    *result_count = 0;
+    if (k <= 0 || ff->nnodes == 0) return NULL;
 
-    SimilarityPair *pairs = malloc(sizeof(SimilarityPair) * total);
+    FlatSimilarity *pairs = malloc(sizeof(FlatSimilarity) * ff->nnodes);
     if (!pairs) { perror("malloc"); exit(1); }
-
-    for (int i = 0; i < total; ++i) {
-        pairs[i].node       = all[i];
-        pairs[i].similarity = overlap_ratio(query, nquery,
-                                            all[i]->he.verts,
-                                            all[i]->he.nverts);
+    for (uint64_t id = 0; id < ff->nnodes; ++id) {
+        pairs[id].id         = (uint32_t)id;
+        pairs[id].similarity = flat_overlap(ff, (uint32_t)id, query, nquery);
     }
-    qsort(pairs, total, sizeof(SimilarityPair), cmp_similarity);
+    qsort(pairs, ff->nnodes, sizeof(FlatSimilarity), cmp_flat_similarity);
 
-    int sz      = k < total ? k : total;
-    Node **result = malloc(sizeof(Node*) * sz);
+    int sz = (uint64_t)k < ff->nnodes ? k : (int)ff->nnodes;
+    uint32_t *result = malloc(sizeof(uint32_t) * sz);
     if (!result) { perror("malloc"); exit(1); }
-    for (int i = 0; i < sz; ++i) result[i] = pairs[i].node;
-
+    for (int i = 0; i < sz; ++i) result[i] = pairs[i].id;
     free(pairs);
-    free(all);
     *result_count = sz;
     return result;
 }
 
-/* ========== OPTIMIZATION & MAINTENANCE ========== */
-
-static int cmp_by_weight_desc(const void *a, const void *b)
+ForestStats flat_get_stats(const FlatForest *ff)
 {
-    double wa = (*(Node**)a)->he.weight;
-    double wb = (*(Node**)b)->he.weight;
-    return (wa < wb) - (wa > wb); /* descending */
+    ForestStats stats = {0};
+    stats.total_nodes = (int)ff->nnodes;
+    stats.num_roots   = (int)ff->nroots;
+    if (ff->nnodes == 0) return stats;
+
+    /* BFS numbering: a node's depth is its parent's plus one, and parents
+     * always have lower IDs, so one forward pass fills depth[]. */
+    int *depth = malloc(sizeof(int) * ff->nnodes);
+    if (!depth) { perror("malloc"); exit(1); }
+    for (uint64_t id = 0; id < ff->nroots; ++id) depth[id] = 1;
+
+    double sum = 0.0;
+    stats.max_weight = stats.min_weight = ff->weights[0];
+    for (uint64_t id = 0; id < ff->nnodes; ++id) {
+        double w = ff->weights[id];
+        sum += w;
+        if (w > stats.max_weight) stats.max_weight = w;
+        if (w < stats.min_weight) stats.min_weight = w;
+        if (depth[id] > stats.max_depth) stats.max_depth = depth[id];
+        if ((int)ff->child_count[id] > stats.max_children)
+            stats.max_children = (int)ff->child_count[id];
+        for (uint32_t c = 0; c < ff->child_count[id]; ++c)
+            depth[ff->first_child[id] + c] = depth[id] + 1;
+    }
+    free(depth);
+    stats.avg_weight = sum / ff->nnodes;
+    return stats;
 }
 
-void forest_rebalance(Forest *f)
-{
-    int total;
-    Node **all = collect_all_nodes(f, &total);
-    if (total == 0) { free(all); return; }
+/* ========== TRAVERSAL ========== */
 
-    qsort(all, total, sizeof(Node*), cmp_by_weight_desc);
+void forest_traverse_bfs(Forest *f, NodeVisitor visitor, void *user_data)
+{
+    if (!f || !visitor || f->nroots == 0) return;
 
-    /* Detach every node from its children before reinserting */
-    for (int i = 0; i < total; ++i) {
-        free(all[i]->children);        /* free the pointer array itself */
-        all[i]->children     = NULL;
-        all[i]->nchildren    = 0;
-        all[i]->children_cap = 0;
-    }
+    int    total = count_total_nodes(f);
+    Node **queue = malloc(sizeof(Node*) * (total + 1));
+    if (!queue) return;
 
-    /* Reset forest root list and heap */
-    f->nroots          = 0;
-    f->root_heap->size = 0;
+    int front = 0, back = 0;
+    for (int i = 0; i < f->nroots; ++i) queue[back++] = f->roots[i];
 
-    for (int i = 0; i < total; ++i)
-        forest_insert_node(f, all[i]);
+    while (front < back) {
+        Node *curr = queue[front++];
+        if (visitor(curr, user_data) != 0) break;
+        for (int i = 0; i < curr->nchildren; ++i)
+            if (back <= total) queue[back++] = curr->children[i];
+    }
 
-    free(all);
+    free(queue);
 }
 
-static int vertices_equal(const int *a, int na, const int *b, int nb)
+void forest_traverse_dfs(Forest *f, NodeVisitor visitor, void *user_data)
 {
-    if (na != nb) return 0;
-    for (int i = 0; i < na; ++i) if (a[i] != b[i]) return 0;
-    return 1;
+    if (!f || !visitor) return;
+    int  stop = 0;
+    Walk w;
+    walk_init(&w);
+    for (int i = 0; !stop && i < f->nroots; ++i) {
+        Node *nd;
+        walk_push(&w, f->roots[i], 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            if (visitor(nd, user_data) != 0) { stop = 1; break; }
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
 }
 
-int forest_merge_duplicates(Forest *f, int keep_max)
+void forest_traverse_by_weight(Forest *f, NodeVisitor visitor, void *user_data)
 {
-    int total;
-    Node **all = collect_all_nodes(f, &total);
-    if (total <= 1) { free(all); return 0; }
-
-    int *processed    = calloc(total, sizeof(int));
-    if (!processed) { perror("calloc"); exit(1); }
-    int  merged_count = 0;
-
-    for (int i = 0; i < total; ++i) {
-        if (processed[i]) continue;
-        processed[i] = 1;
-
-        double weight_sum = all[i]->he.weight;
-        double weight_max = all[i]->he.weight;
-        int    dup_count  = 1;
-
-        for (int j = i + 1; j < total; ++j) {
-            if (processed[j]) continue;
-            if (!vertices_equal(all[i]->he.verts, all[i]->he.nverts,
-                                all[j]->he.verts, all[j]->he.nverts))
-                continue;
-
-            weight_sum += all[j]->he.weight;
-            if (all[j]->he.weight > weight_max)
-                weight_max = all[j]->he.weight;
-
-            processed[j] = 1;
-            dup_count++;
-            merged_count++;
-        }
-
-        /* Apply merged weight once, after scanning all duplicates */
-        if (dup_count > 1)
-            all[i]->he.weight = keep_max ? weight_max
-                                         : weight_sum / dup_count;
-    }
+    if (!f || !visitor) return;
+    Frontier q;
+    frontier_init(&q, f->root_heap);
+    Node *nd;
+    while ((nd = frontier_next(&q, f->root_heap)))
+        if (visitor(nd, user_data) != 0) break;
+    free(q.data);
+}
 
-    free(processed);
-    free(all);
+struct WeightIter {
+    Forest  *f;
+    Frontier q;
+};
 
-    if (merged_count > 0) forest_rebalance(f);
-    return merged_count;
+WeightIter *forest_weight_iter_begin(Forest *f)
+{
+    WeightIter *it = malloc(sizeof(WeightIter));
+    if (!it) { perror("malloc"); exit(1); }
+    it->f = f;
+    frontier_init(&it->q, f->root_heap);
+    return it;
 }
 
-static void prune_children(Node *nd, double threshold, int *removed)
+Node *forest_weight_iter_next(WeightIter *it)
 {
-    int i = 0;
-    while (i < nd->nchildren) {
-        if (nd->children[i]->he.weight < threshold) {
-            node_free(nd->children[i]);
-            for (int j = i; j + 1 < nd->nchildren; ++j)
-                nd->children[j] = nd->children[j+1];
-            nd->nchildren--;
-            (*removed)++;
-        } else {
-            prune_children(nd->children[i], threshold, removed);
-            i++;
-        }
-    }
+    return frontier_next(&it->q, it->f->root_heap);
 }
 
-int forest_prune_by_weight(Forest *f, double threshold)
+int forest_weight_iter_next_n(WeightIter *it, Node **out, int max)
 {
-    int removed = 0, i = 0;
-    while (i < f->nroots) {
-        if (f->roots[i]->he.weight < threshold) {
-            node_free(f->roots[i]);
-            forest_remove_root_at(f, i);
-            removed++;
-        } else {
-            prune_children(f->roots[i], threshold, &removed);
-            i++;
-        }
-    }
-    return removed;
+    int n = 0;
+    Node *nd;
+    while (n < max && (nd = frontier_next(&it->q, it->f->root_heap)))
+        out[n++] = nd;
+    return n;
 }
 
-void forest_optimize(Forest *f)
+void forest_weight_iter_end(WeightIter *it)
 {
-    forest_merge_duplicates(f, 1);
-    forest_rebalance(f);
+    if (!it) return;
+    free(it->q.data);
+    free(it);
 }
 
-/* ========== BATCH OPERATIONS ========== */
+/* ========== SHARDED FOREST ========== */
 
 /*
- * forest_insert_batch — sorts a copy of the edge array by weight descending
- * before inserting, which produces a shallower tree than random order.
+ * Shards are keyed by a set's minimum vertex.  Equal sets (and so every
+ * dedup fold) meet in one shard, and under HIF_SHARD_RANGE the shards
+ * holding supersets or subsets of a query follow from its vertex bounds.
  */
-void forest_insert_batch(Forest *f, Hyperedge *edges, int nedges)
+ShardedForest *sharded_forest_create(int nshards, HifShardPolicy policy,
+                                     hif_vertex_t vertex_span)
 {
-    if (nedges <= 0) return;
-
-    Hyperedge *sorted = malloc(sizeof(Hyperedge) * nedges);
-    if (!sorted) { perror("malloc"); exit(1); }
-    memcpy(sorted, edges, sizeof(Hyperedge) * nedges);
-
-    /* sort by weight descending using the same comparator style */
-    qsort(sorted, nedges, sizeof(Hyperedge),
-          (int(*)(const void*, const void*))cmp_by_weight_desc);
+    if (nshards < 1) nshards = 1;
+    if (vertex_span < 1) vertex_span = 1;
+    ShardedForest *sf = malloc(sizeof(ShardedForest));
+    if (!sf) { perror("malloc"); exit(1); }
+    sf->shards = malloc(sizeof(Forest*) * nshards);
+    if (!sf->shards) { perror("malloc"); exit(1); }
+    for (int i = 0; i < nshards; ++i) sf->shards[i] = forest_create();
+    sf->nshards     = nshards;
+    sf->policy      = policy;
+    sf->vertex_span = vertex_span;
+    return sf;
+}
 
-    for (int i = 0; i < nedges; ++i)
-        insert_hyperedge(f, sorted[i].verts, sorted[i].nverts,
-                         sorted[i].weight);
+void sharded_forest_free(ShardedForest *sf)
+{
+    if (!sf) return;
+    for (int i = 0; i < sf->nshards; ++i) forest_free(sf->shards[i]);
+    free(sf->shards);
+    free(sf);
+}
 
-    free(sorted);
+/* Shard owning sets whose minimum vertex is v. */
+static int shard_of_vertex(const ShardedForest *sf, hif_vertex_t v)
+{
+    if (sf->policy == HIF_SHARD_HASH)
+        return (int)(vindex_hash(v) % (unsigned)sf->nshards);
+    if (v <= 0) return 0;
+    hif_vertex_t s = v / sf->vertex_span;
+    return s < (hif_vertex_t)sf->nshards ? (int)s : sf->nshards - 1;
 }
 
-Forest *forest_build_bulk(Hyperedge *edges, int nedges)
+static hif_vertex_t verts_min(const hif_vertex_t *verts, int nverts)
 {
-    Forest *f = forest_create();
-    forest_insert_batch(f, edges, nedges);
-    return f;
+    hif_vertex_t m = verts[0];
+    for (int i = 1; i < nverts; ++i) if (verts[i] < m) m = verts[i];
+    return m;
 }
 
-/* ========== SERIALIZATION ========== */
+int sharded_shard_of(const ShardedForest *sf, const hif_vertex_t *verts,
+                     int nverts)
+{
+    if (nverts <= 0) return -1;
+    return shard_of_vertex(sf, verts_min(verts, nverts));
+}
 
-static void write_node(Node *nd, FILE *fp)
+void sharded_insert_hyperedge(ShardedForest *sf, const hif_vertex_t *verts,
+                              int nverts, double weight)
 {
-    fwrite(&nd->he.nverts,  sizeof(int),    1,             fp);
-    fwrite(nd->he.verts,    sizeof(int),    nd->he.nverts, fp);
-    fwrite(&nd->he.weight,  sizeof(double), 1,             fp);
-    fwrite(&nd->nchildren,  sizeof(int),    1,             fp);
-    for (int i = 0; i < nd->nchildren; ++i) write_node(nd->children[i], fp);
+    int s = sharded_shard_of(sf, verts, nverts);
+    if (s >= 0) insert_hyperedge(sf->shards[s], verts, nverts, weight);
 }
 
-int forest_save(Forest *f, const char *filename)
+int sharded_count_total_nodes(const ShardedForest *sf)
 {
-    FILE *fp = fopen(filename, "wb");
-    if (!fp) return -1;
-    fwrite(&f->nroots, sizeof(int), 1, fp);
-    for (int i = 0; i < f->nroots; ++i) write_node(f->roots[i], fp);
-    fclose(fp);
-    return 0;
+    int total = 0;
+    for (int i = 0; i < sf->nshards; ++i)
+        total += count_total_nodes(sf->shards[i]);
+    return total;
 }
 
-static Node *read_node(FILE *fp)
+typedef struct {
+    Node *nd;
+    int   shard;
+} ShardHead;
+
+/* Max-heap sift-down of heads[i] by weight. */
+static void shard_heads_sift(ShardHead *h, int n, int i)
 {
-    int nverts;
-    if (fread(&nverts, sizeof(int), 1, fp) != 1) return NULL;
+    ShardHead x = h[i];
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && h[c + 1].nd->he.weight > h[c].nd->he.weight) ++c;
+        if (h[c].nd->he.weight <= x.nd->he.weight) break;
+        h[i] = h[c];
+        i = c;
+    }
+    h[i] = x;
+}
 
-    int *verts = malloc(sizeof(int) * nverts);
-    if (!verts) return NULL;
-    if ((int)fread(verts, sizeof(int), nverts, fp) != nverts) {
-        free(verts); return NULL;
+/*
+ * k-way merge of the shards' lazy weight-order frontiers: each shard
+ * yields only the nodes the merge consumes, so the cost is
+ * O(k log k + nshards) rather than nshards * k.
+ */
+Node **sharded_find_top_k(ShardedForest *sf, int k, int *result_count)
+{
+    *result_count = 0;
+    if (k <= 0) return NULL;
+    Frontier  *q     = malloc(sizeof(Frontier) * sf->nshards);
+    ShardHead *heads = malloc(sizeof(ShardHead) * sf->nshards);
+    Node     **result = malloc(sizeof(Node*) * k);
+    if (!q || !heads || !result) { perror("malloc"); exit(1); }
+
+    int nheads = 0;
+    for (int i = 0; i < sf->nshards; ++i) {
+        frontier_init(&q[i], sf->shards[i]->root_heap);
+        Node *nd = frontier_next(&q[i], sf->shards[i]->root_heap);
+        if (nd) {
+            heads[nheads].nd    = nd;
+            heads[nheads].shard = i;
+            nheads++;
+        }
     }
+    for (int i = nheads / 2 - 1; i >= 0; --i) shard_heads_sift(heads, nheads, i);
 
-    double weight;
-    if (fread(&weight, sizeof(double), 1, fp) != 1) {
-        free(verts); return NULL;
+    int count = 0;
+    while (count < k && nheads > 0) {
+        int s = heads[0].shard;
+        result[count++] = heads[0].nd;
+        Node *nd = frontier_next(&q[s], sf->shards[s]->root_heap);
+        if (nd) heads[0].nd = nd;
+        else    heads[0] = heads[--nheads];
+        if (nheads > 0) shard_heads_sift(heads, nheads, 0);
     }
 
-    Node *nd = node_create(verts, nverts, weight);
-    free(verts);
+    for (int i = 0; i < sf->nshards; ++i) free(q[i].data);
+    free(q);
+    free(heads);
+    *result_count = count;
+    return result;
+}
 
-    int nchildren;
-    if (fread(&nchildren, sizeof(int), 1, fp) != 1) {
-        node_free(nd); return NULL;
+/*
+ * A superset's minimum vertex is at most the query's, so under
+ * HIF_SHARD_RANGE the shards above that of min(query) hold none.
+ */
+Node **sharded_find_all_supersets(ShardedForest *sf, const hif_vertex_t *query,
+                                  int nquery, int *result_count)
+{
+    int last = sf->nshards - 1;
+    if (sf->policy == HIF_SHARD_RANGE && nquery > 0)
+        last = shard_of_vertex(sf, verts_min(query, nquery));
+
+    NodeBuffer all, part;
+    node_buffer_init(&all);
+    node_buffer_init(&part);
+    for (int s = 0; s <= last; ++s) {
+        find_all_supersets_into(sf->shards[s], query, nquery, &part);
+        for (int i = 0; i < part.count; ++i)
+            result_push(&all.items, &all.count, &all.cap, part.items[i]);
     }
+    node_buffer_free(&part);
+    return buffer_detach(&all, result_count);
+}
 
-    for (int i = 0; i < nchildren; ++i) {
-        Node *child = read_node(fp);
-        if (!child) { node_free(nd); return NULL; }
-        node_add_child(nd, child);
+Node **sharded_find_by_weight_range(ShardedForest *sf, double min_weight,
+                                    double max_weight, int *result_count)
+{
+    NodeBuffer all, part;
+    node_buffer_init(&all);
+    node_buffer_init(&part);
+    for (int s = 0; s < sf->nshards; ++s) {
+        Forest *f = sf->shards[s];
+        /* the heaviest root bounds the whole shard */
+        if (f->nroots == 0 || f->root_heap->data[0]->he.weight < min_weight)
+            continue;
+        find_by_weight_range_into(f, min_weight, max_weight, &part);
+        for (int i = 0; i < part.count; ++i)
+            result_push(&all.items, &all.count, &all.cap, part.items[i]);
     }
-    return nd;
+    node_buffer_free(&part);
+    return buffer_detach(&all, result_count);
 }
 
-Forest *forest_load(const char *filename)
+/*
+ * Manifest: one text line, "HIFSHARDS <nshards> <policy> <vertex_span>".
+ * Shard i lives next to it in "<path>.<i>", a plain forest_save file.
+ */
+#define SHARD_MANIFEST_TAG "HIFSHARDS"
+
+static void shard_path(char *out, size_t cap, const char *path, int i)
 {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) return NULL;
+    snprintf(out, cap, "%s.%d", path, i);
+}
 
-    Forest *f = forest_create();
-    int nroots;
-    if (fread(&nroots, sizeof(int), 1, fp) != 1) {
-        forest_free(f); fclose(fp); return NULL;
+int sharded_forest_save(ShardedForest *sf, const char *path)
+{
+    size_t cap = strlen(path) + 16;
+    char  *name = malloc(cap);
+    if (!name) { perror("malloc"); exit(1); }
+    int rc = 0;
+    for (int i = 0; rc == 0 && i < sf->nshards; ++i) {
+        shard_path(name, cap, path, i);
+        rc = forest_save(sf->shards[i], name);
     }
+    free(name);
+    if (rc != 0) return -1;
 
-    for (int i = 0; i < nroots; ++i) {
-        Node *root = read_node(fp);
-        if (!root) { forest_free(f); fclose(fp); return NULL; }
-        forest_add_root(f, root);
-    }
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    fprintf(fp, "%s %d %d %lld\n", SHARD_MANIFEST_TAG, sf->nshards,
+            (int)sf->policy, (long long)sf->vertex_span);
+    return fclose(fp) == 0 ? 0 : -1;
+}
 
+ShardedForest *sharded_forest_load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) return NULL;
+    char tag[16];
+    int  nshards, policy;
+    long long span;
+    int  ok = fscanf(fp, "%15s %d %d %lld", tag, &nshards, &policy, &span) == 4;
     fclose(fp);
-    return f;
+    if (!ok || strcmp(tag, SHARD_MANIFEST_TAG) != 0 || nshards < 1 ||
+        (policy != HIF_SHARD_RANGE && policy != HIF_SHARD_HASH) || span < 1 ||
+        (unsigned long long)span > (unsigned long long)HIF_VERTEX_MAX)
+        return NULL;
+
+    ShardedForest *sf = malloc(sizeof(ShardedForest));
+    if (!sf) { perror("malloc"); exit(1); }
+    sf->shards = calloc(nshards, sizeof(Forest*));
+    if (!sf->shards) { perror("calloc"); exit(1); }
+    sf->nshards     = nshards;
+    sf->policy      = (HifShardPolicy)policy;
+    sf->vertex_span = (hif_vertex_t)span;
+
+    size_t cap = strlen(path) + 16;
+    char  *name = malloc(cap);
+    if (!name) { perror("malloc"); exit(1); }
+    for (int i = 0; i < nshards; ++i) {
+        shard_path(name, cap, path, i);
+        sf->shards[i] = forest_load(name);
+        if (!sf->shards[i]) {
+            sf->nshards = i;
+            sharded_forest_free(sf);
+            sf = NULL;
+            break;
+        }
+    }
+    free(name);
+    return sf;
 }
 
-/* ========== TRAVERSAL ========== */
+/* ========== INCREMENTAL MAINTENANCE ========== */
 
-void forest_traverse_bfs(Forest *f, NodeVisitor visitor, void *user_data)
+/*
+ * forest_maintain_step works on whole root subtrees, one writer section
+ * each, so concurrent readers only ever wait for one subtree.  A subtree
+ * is a complete unit for every pass: dedup keeps its root, the relink
+ * only moves nodes between its own members (pieces that fit nowhere
+ * become roots) and the repack only swaps node addresses.
+ */
+
+static Node **collect_subtree(Node *r, int *count)
 {
-    if (!f || !visitor || f->nroots == 0) return;
+    int    n = 0, cap = 0;
+    Node **all = NULL;
+    Walk   w;
+    walk_init(&w);
+    walk_push(&w, r, 0);
+    while (walk_pop(&w, &r, NULL)) {
+        result_push(&all, &n, &cap, r);
+        walk_push_children(&w, r->children, r->nchildren, 0);
+    }
+    walk_free(&w);
+    *count = n;
+    return all;
+}
 
-    int    total = count_total_nodes(f);
-    Node **queue = malloc(sizeof(Node*) * (total + 1));
-    if (!queue) return;
+/* Copy nd to fresh memory, vertex set included, and free the original. */
+static Node *node_repack(Forest *f, Node *nd)
+{
+    Node *c = node_copy(f, nd);
+    c->he.verts = forest_alloc(f, sizeof(hif_vertex_t) * nd->he.nverts);
+    memcpy(c->he.verts, nd->he.verts, sizeof(hif_vertex_t) * nd->he.nverts);
+    c->verts_rc = NULL;
+    node_replace(f, nd, c);
+    node_release(f, nd);
+    return c;
+}
 
-    int front = 0, back = 0;
-    for (int i = 0; i < f->nroots; ++i) queue[back++] = f->roots[i];
+static void maintain_subtree(Forest *f, Node *r, int flags)
+{
+    int snaps = f->versions && f->versions->nsnaps > 0;
+    Walk w;
+    walk_init(&w);
+    if (snaps) {   /* work on a private copy; snapshots keep the old one */
+        Node *nd;
+        walk_push(&w, r, 0);
+        while (walk_pop(&w, &nd, NULL)) {
+            if (node_frozen(f, nd)) {
+                Node *c = node_clone(f, nd);
+                if (nd == r) r = c;
+                nd = c;
+            }
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
 
-    while (front < back) {
-        Node *curr = queue[front++];
-        if (visitor(curr, user_data) != 0) break;
-        for (int i = 0; i < curr->nchildren; ++i)
-            if (back <= total) queue[back++] = curr->children[i];
+    if (flags & HIF_MAINT_DEDUP) {
+        /* r's own group first, with r kept, so r is never a dup below;
+           keepers only gain weight, so r stays a root unless adopted */
+        SetTable *sets = forest_sets(f);
+        merge_group(f, sets, r, 1);
+        int    n, nkeep = 0;
+        Node **sub = collect_subtree(r, &n);
+        for (int i = 1; i < n; ++i)
+            if (settable_find(sets, sub[i]->he.verts, sub[i]->he.nverts) == sub[i])
+                sub[nkeep++] = sub[i];
+        for (int i = 0; i < nkeep; ++i) merge_group(f, sets, sub[i], 1);
+        free(sub);
+    }
+    if (r->parent) { walk_free(&w); return; }   /* adopted by a keeper */
+
+    if (flags & HIF_MAINT_REBALANCE) {
+        int    n, slot = r->root_slot;
+        Node **sub = collect_subtree(r, &n);
+        for (int i = 0; i < n; ++i) qcache_touch(f, sub[i]->he.verts, sub[i]->he.nverts);
+        forest_remove_root_at(f, slot);
+        nodes_unlink(f, sub, n);
+        bulk_link(f, sub, n, 1);
+        free(sub);
+        /* r is heaviest, so a root again: back into its slot, keeping the
+           round-robin order; the pieces that fit nowhere stay at the end */
+        if (!r->parent) {
+            Node *o = f->roots[slot];
+            slot_store(&f->roots[slot], r);
+            slot_store(&f->roots[r->root_slot], o);
+            o->root_slot           = r->root_slot;
+            r->root_slot           = slot;
+        }
     }
 
-    free(queue);
+    /* moving nodes under readers or snapshots would need retiring them */
+    if ((flags & HIF_MAINT_REPACK) && !f->sync && !snaps) {
+        Node *nd;
+        walk_push(&w, r, 0);
+        while (walk_pop(&w, &nd, NULL)) {   /* pre-order: parent copied first */
+            nd = node_repack(f, nd);
+            walk_push_children(&w, nd->children, nd->nchildren, 0);
+        }
+    }
+    walk_free(&w);
 }
 
-static int dfs_helper(Node *nd, NodeVisitor visitor, void *user_data)
+int forest_maintain_step(Forest *f, int flags, int max_roots, double budget_ms)
 {
-    if (visitor(nd, user_data) != 0) return 1;
-    for (int i = 0; i < nd->nchildren; ++i)
-        if (dfs_helper(nd->children[i], visitor, user_data)) return 1;
-    return 0;
+    if (forest_is_snapshot(f) || max_roots <= 0) return 0;
+    double t0   = budget_ms > 0 ? now_ms() : 0.0;
+    int    done = 0;
+    if ((flags & HIF_MAINT_REBALANCE) && f->ndeferred)
+        forest_rebalance_step(f, max_roots);
+    while (done < max_roots && f->nroots > 0) {
+        if (f->maint_cursor >= f->nroots) f->maint_cursor = 0;
+        writer_begin(f);
+        maintain_subtree(f, f->roots[f->maint_cursor++], flags);
+        writer_end(f);
+        done++;
+        if (budget_ms > 0 && now_ms() - t0 >= budget_ms) break;
+    }
+    return done;
 }
 
-void forest_traverse_dfs(Forest *f, NodeVisitor visitor, void *user_data)
+struct HifMaintainer {
+    Forest         *f;
+    int             flags;
+    int             max_roots;
+    double          period_ms;
+    pthread_mutex_t lock;   /* the forest's writer lock */
+    pthread_cond_t  wake;
+    int             stop;
+    pthread_t       tid;
+};
+
+static void *maintainer_main(void *arg)
 {
-    if (!f || !visitor) return;
-    for (int i = 0; i < f->nroots; ++i)
-        if (dfs_helper(f->roots[i], visitor, user_data)) break;
+    HifMaintainer *m = arg;
+    pthread_mutex_lock(&m->lock);
+    while (!m->stop) {
+        forest_maintain_step(m->f, m->flags, m->max_roots, 0.0);
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        long long ns = ts.tv_nsec + (long long)(m->period_ms * 1e6);
+        ts.tv_sec  += ns / 1000000000LL;
+        ts.tv_nsec  = ns % 1000000000LL;
+        /* sleeps with the lock released, so writers get in */
+        if (!m->stop) pthread_cond_timedwait(&m->wake, &m->lock, &ts);
+    }
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
 }
 
-void forest_traverse_by_weight(Forest *f, NodeVisitor visitor, void *user_data)
+HifMaintainer *forest_maintainer_start(Forest *f, int flags, int max_roots,
+                                       double period_ms)
 {
-    if (!f || !visitor) return;
-    int    total;
-    Node **all = collect_all_nodes(f, &total);
-    if (total == 0) { free(all); return; }
+    HifMaintainer *m = calloc(1, sizeof(HifMaintainer));
+    if (!m) { perror("calloc"); exit(1); }
+    m->f         = f;
+    m->flags     = flags;
+    m->max_roots = max_roots > 0 ? max_roots : MAINT_DEFAULT_ROOTS;
+    m->period_ms = period_ms > 0 ? period_ms : MAINT_DEFAULT_PERIOD_MS;
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->wake, NULL);
+    if (pthread_create(&m->tid, NULL, maintainer_main, m) != 0) {
+        pthread_cond_destroy(&m->wake);
+        pthread_mutex_destroy(&m->lock);
+        free(m);
+        return NULL;
+    }
+    return m;
+}
 
-    qsort(all, total, sizeof(Node*), cmp_by_weight_desc);
-    for (int i = 0; i < total; ++i)
-        if (visitor(all[i], user_data) != 0) break;
+void forest_maintainer_lock(HifMaintainer *m)
+{
+    pthread_mutex_lock(&m->lock);
+}
 
-    free(all);
+void forest_maintainer_unlock(HifMaintainer *m)
+{
+    pthread_mutex_unlock(&m->lock);
+}
+
+void forest_maintainer_stop(HifMaintainer *m)
+{
+    if (!m) return;
+    pthread_mutex_lock(&m->lock);
+    m->stop = 1;
+    pthread_cond_signal(&m->wake);
+    pthread_mutex_unlock(&m->lock);
+    pthread_join(m->tid, NULL);
+    pthread_cond_destroy(&m->wake);
+    pthread_mutex_destroy(&m->lock);
+    free(m);
 }
@@ -21,20 +21,92 @@
 #define HYPEREDGE_INCLUSION_FOREST_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/* ========== ELEMENT TYPES ========== */
+
+/*
+ * Vertex ID and weight types are fixed per build.  The default is the
+ * signed int / double instantiation; a build for small shards can pick
+ *
+ *   -DHIF_VERTEX_BITS=16|32|64   unsigned vertex IDs of that width
+ *   -DHIF_WEIGHT_FLOAT           single-precision node weights
+ *
+ * Narrower vertices widen the SIMD subset kernels (8 lanes of uint16_t
+ * per 128-bit compare instead of 4 ints) and shrink every vertex array.
+ * API weight arguments stay double and are rounded on store; subtree
+ * weight sums and compute_overlap() are always accumulated in double.
+ * All translation units must agree on the choice.  forest_save() files
+ * load in any build whose vertex type holds their IDs; flat images are
+ * stored in the native types and flat_forest_open() rejects a mismatch.
+ */
+#if !defined(HIF_VERTEX_BITS)
+typedef int hif_vertex_t;
+#define HIF_VERTEX_MIN INT32_MIN
+#define HIF_VERTEX_MAX INT32_MAX
+#elif HIF_VERTEX_BITS == 16
+typedef uint16_t hif_vertex_t;
+#define HIF_VERTEX_MIN 0
+#define HIF_VERTEX_MAX UINT16_MAX
+#elif HIF_VERTEX_BITS == 32
+typedef uint32_t hif_vertex_t;
+#define HIF_VERTEX_MIN 0
+#define HIF_VERTEX_MAX UINT32_MAX
+#elif HIF_VERTEX_BITS == 64
+typedef uint64_t hif_vertex_t;
+#define HIF_VERTEX_MIN 0
+#define HIF_VERTEX_MAX UINT64_MAX
+#else
+#error "HIF_VERTEX_BITS must be 16, 32 or 64"
+#endif
+
+#ifdef HIF_WEIGHT_FLOAT
+typedef float hif_weight_t;
+#else
+typedef double hif_weight_t;
+#endif
 
 /* ========== TYPE DEFINITIONS ========== */
 
 typedef struct {
-    int    *verts;   /* Sorted array of vertex IDs      */
-    int     nverts;  /* Number of vertices               */
-    double  weight;  /* Weight (importance/score)        */
+    hif_vertex_t *verts;   /* Sorted array of vertex IDs      */
+    int           nverts;  /* Number of vertices               */
+    hif_weight_t  weight;  /* Weight (importance/score)        */
 } Hyperedge;
 
+/*
+ * Fixed-width vertex-set signature: 64-bit hashed bitmap plus the
+ * smallest and largest vertex.  A ⊆ B is impossible unless
+ * A.bits ⊆ B.bits and [A.vmin, A.vmax] ⊆ [B.vmin, B.vmax].
+ */
+typedef struct {
+    uint64_t     bits;
+    hif_vertex_t vmin, vmax;
+} NodeSig;
+
 typedef struct Node {
     Hyperedge      he;
     struct Node  **children;
     int            nchildren;
     int            children_cap;
+    NodeSig        sig;       /* signature of he.verts                 */
+    uint64_t       sub_bits;  /* AND of sig.bits over the subtree;
+                                 may be narrower than exact, never wider */
+    uint64_t       sub_any;   /* OR of sig.bits over the subtree;
+                                 may be wider than exact, never narrower */
+    int            root_slot; /* index in forest roots[], -1 if not a root */
+    int            heap_slot; /* index in forest root_heap, -1 likewise   */
+    struct Node   *parent;    /* NULL for roots                          */
+    int            dup_count; /* inserts folded into this node (dedup)   */
+    /* subtree aggregates, repaired along the changed path on every edit */
+    int            sub_size;   /* nodes in the subtree, self included    */
+    int            sub_height; /* 1 for a leaf                           */
+    int            sub_maxdeg; /* widest child list in the subtree       */
+    hif_weight_t   sub_wmin;   /* lightest weight in the subtree         */
+    double         sub_wsum;   /* total weight of the subtree            */
+    unsigned       version;    /* forest version the node was created at */
+    int           *verts_rc;   /* he.verts shared with copies; NULL = own */
+    int            defer_slot; /* index in forest deferred[], -1 if exact */
 } Node;
 
 /*
@@ -47,11 +119,81 @@ typedef struct {
     int    cap;
 } NodeHeap;
 
+/*
+ * Inverted index vertex ID → nodes containing it (posting lists).
+ * Opaque; enabled per forest with forest_enable_vertex_index().
+ */
+typedef struct VertexIndex VertexIndex;
+
+/*
+ * Slab allocator for nodes, vertex arrays and children arrays.
+ * Opaque; a forest owns one when created with forest_create_with_arena().
+ */
+typedef struct NodeArena NodeArena;
+
+/*
+ * Single-writer / many-reader coordination (sequence counter plus
+ * epoch-based reclamation).  Opaque; see forest_enable_concurrency().
+ */
+typedef struct ForestSync ForestSync;
+
+/*
+ * Work-stealing thread pool for the *_parallel queries.
+ * Opaque; a forest owns one after forest_set_threads(f, n > 1).
+ */
+typedef struct WorkPool WorkPool;
+
+/*
+ * Hash table canonical (sorted) vertex set → nodes with that set.
+ * Opaque; built on first use by delete / update-weight / dedup.
+ */
+typedef struct SetTable SetTable;
+
+/*
+ * Superset-query result cache.  Opaque; see forest_enable_query_cache().
+ */
+typedef struct QueryCache QueryCache;
+
+/*
+ * Snapshot bookkeeping (open snapshots, nodes they still pin).
+ * Opaque; created by the first forest_snapshot().
+ */
+typedef struct ForestVersions ForestVersions;
+
+/* Operation counters; see forest_get_metrics(). */
+typedef struct ForestMetrics ForestMetrics;
+
+/* What insert_hyperedge does with a vertex set already in the forest. */
+typedef enum {
+    HIF_DEDUP_NONE = 0,  /* keep every insert as its own node (default) */
+    HIF_DEDUP_MAX,       /* existing node keeps the larger weight        */
+    HIF_DEDUP_SUM,       /* weights add up                               */
+    HIF_DEDUP_AVG,       /* mean over all folded inserts                 */
+    HIF_DEDUP_LAST       /* newest weight wins                           */
+} HifDedupPolicy;
+
 typedef struct {
-    Node    **roots;
-    int       nroots;
-    int       roots_cap;
-    NodeHeap *root_heap;  /* always-valid heap over current roots */
+    Node        **roots;
+    int           nroots;
+    int           roots_cap;
+    NodeHeap     *root_heap;  /* always-valid heap over current roots      */
+    VertexIndex  *vindex;     /* optional posting lists, NULL when disabled */
+    NodeArena    *arena;      /* optional slab allocator, NULL = malloc     */
+    hif_vertex_t *scratch;    /* reusable normalization buffer              */
+    int           scratch_cap;
+    ForestSync   *sync;       /* optional concurrent-reader mode, NULL = off */
+    WorkPool     *pool;       /* query worker pool, NULL = run on caller    */
+    SetTable     *sets;       /* canonical-set lookup, NULL until needed    */
+    HifDedupPolicy dedup;     /* insert-time duplicate handling             */
+    ForestMetrics *metrics;   /* NULL unless built with -DHIF_METRICS       */
+    QueryCache   *qcache;     /* optional superset-query cache, NULL = off  */
+    ForestVersions *versions; /* snapshot state, NULL until first snapshot  */
+    int           ins_max_roots; /* bounded insertion, 0 = exact placement */
+    int           ins_max_depth;
+    Node        **deferred;   /* boundedly placed, awaiting exact placement */
+    int           ndeferred;
+    int           deferred_cap;
+    int           maint_cursor; /* next root slot for forest_maintain_step  */
 } Forest;
 
 /* ========== HEAP API ========== */
@@ -84,6 +226,24 @@ Node *heap_pop(NodeHeap *h);
  */
 Forest *forest_create(void);
 
+/**
+ * Create an empty forest whose nodes, vertex arrays and children arrays
+ * are bump-allocated from large slabs owned by the forest.
+ *
+ * Blocks released by pruning or children-array growth are recycled
+ * through size-class free lists; forest_free() returns every slab at
+ * once instead of walking the trees.
+ *
+ * @param slab_bytes  Slab size in bytes (0 = default of 1 MiB)
+ */
+Forest *forest_create_with_arena(size_t slab_bytes);
+
+/**
+ * Bytes currently reserved from the system by the forest's arena
+ * (0 if the forest does not use an arena).
+ */
+size_t forest_arena_reserved(const Forest *f);
+
 /**
  * Free forest and all nodes.
  */
@@ -102,14 +262,16 @@ void forest_free(Forest *f);
  * @param nverts  Number of vertices
  * @param weight  Weight / importance score
  */
-void insert_hyperedge(Forest *f, const int *verts, int nverts, double weight);
+void insert_hyperedge(Forest *f, const hif_vertex_t *verts, int nverts,
+                      double weight);
 
 /**
  * Find top-k heaviest hyperedges.
  *
- * Uses a working max-heap seeded with all roots, expanding children
- * on each pop.  Complexity: O(k log k) time, O(k·b) extra space
- * where b is the maximum branching factor.
+ * Walks a lazy frontier that starts at the top of root_heap and
+ * expands root-heap children and tree children on each pop.
+ * Complexity: O(k log k) time, O(k·b) extra space where b is the
+ * maximum branching factor — independent of the number of roots.
  *
  * Caller must free the returned array (but NOT the nodes inside).
  *
@@ -123,12 +285,44 @@ Node **find_top_k(Forest *f, int k, int *result_count);
 /**
  * Count hyperedges with weight >= threshold.
  *
+ * Subtrees that lie wholly above the threshold are counted from their
+ * aggregates, so only the boundary where the threshold cuts a tree is
+ * walked.
+ *
  * @param f         Forest to search
  * @param threshold Minimum weight (inclusive)
  * @return          Number of matching hyperedges
  */
 int find_by_weight_threshold(Forest *f, double threshold);
 
+/**
+ * Count hyperedges with weight in [min_weight, max_weight] without
+ * materializing them.  Like find_by_weight_threshold, only subtrees that
+ * straddle a bound are descended into.
+ */
+int forest_count_by_weight_range(Forest *f, double min_weight,
+                                 double max_weight);
+
+/**
+ * Weight of the k-th heaviest hyperedge (k = 1 is forest_max_weight).
+ *
+ * Bisects the weight domain with range counts and selects among the
+ * last few candidates, so no top-k array is built: O(64 · boundary)
+ * time, O(1) extra space.  Ties count once per hyperedge.
+ *
+ * @param f       Forest to search
+ * @param k       Rank, 1 ≤ k ≤ count_total_nodes(f)
+ * @param weight  Output: the k-th largest weight
+ * @return        0 on success, -1 if k is out of range
+ */
+int forest_kth_heaviest_weight(Forest *f, int k, double *weight);
+
+/**
+ * Percentile rank of a weight: the percentage (0–100) of hyperedges
+ * whose weight is <= weight.  Returns 0 for an empty forest.
+ */
+double forest_weight_percentile(Forest *f, double weight);
+
 /**
  * Find the minimal superset of a query set (fewest extra vertices).
  *
@@ -137,7 +331,7 @@ int find_by_weight_threshold(Forest *f, double threshold);
  * @param nquery Number of vertices in query
  * @return       Node with smallest superset, or NULL if none exists
  */
-Node *find_minimal_superset(Forest *f, const int *query, int nquery);
+Node *find_minimal_superset(Forest *f, const hif_vertex_t *query, int nquery);
 
 /**
  * Find the heaviest superset of a query set.
@@ -147,7 +341,7 @@ Node *find_minimal_superset(Forest *f, const int *query, int nquery);
  * @param nquery Number of vertices in query
  * @return       Heaviest node that is a superset, or NULL
  */
-Node *find_heaviest_superset(Forest *f, const int *query, int nquery);
+Node *find_heaviest_superset(Forest *f, const hif_vertex_t *query, int nquery);
 
 /* ========== CLUSTERING & ANALYSIS ========== */
 
@@ -172,16 +366,16 @@ double compute_overlap(const Node *a, const Node *b);
 
 /* ========== UTILITY ========== */
 
-/** Total number of nodes across all trees. */
+/** Total number of nodes across all trees. O(roots). */
 int    count_total_nodes(Forest *f);
 
-/** Maximum depth of any tree in the forest. */
+/** Maximum depth of any tree in the forest. O(roots). */
 int    forest_max_depth(Forest *f);
 
 /** Maximum weight in the forest. O(1) via root_heap. */
 double forest_max_weight(Forest *f);
 
-/** Minimum weight in the forest. O(n). */
+/** Minimum weight in the forest. O(roots). */
 double forest_min_weight(Forest *f);
 
 /** Print a human-readable representation of the forest. */
@@ -205,6 +399,7 @@ typedef struct {
     int    max_children;
 } ForestStats;
 
+/** O(roots): read from the per-node subtree aggregates. */
 ForestStats get_forest_stats(Forest *f);
 
 /* ========== ADVANCED QUERY OPERATIONS ========== */
@@ -213,14 +408,14 @@ ForestStats get_forest_stats(Forest *f);
  * Find all supersets of a query set.
  * Caller must free the returned array.
  */
-Node **find_all_supersets(Forest *f, const int *query, int nquery,
+Node **find_all_supersets(Forest *f, const hif_vertex_t *query, int nquery,
                           int *result_count);
 
 /**
  * Find all subsets of a query set.
  * Caller must free the returned array.
  */
-Node **find_all_subsets(Forest *f, const int *query, int nquery,
+Node **find_all_subsets(Forest *f, const hif_vertex_t *query, int nquery,
                         int *result_count);
 
 /**
@@ -234,29 +429,86 @@ Node **find_by_weight_range(Forest *f, double min_weight, double max_weight,
  * Find all nodes whose vertex set contains every vertex in `vertices`.
  * Caller must free the returned array.
  */
-Node **find_containing_vertices(Forest *f, const int *vertices, int nvertices,
-                                int *result_count);
+Node **find_containing_vertices(Forest *f, const hif_vertex_t *vertices,
+                                int nvertices, int *result_count);
+
+/**
+ * The k heaviest nodes whose vertex set contains every vertex in
+ * `vertices` (sorted), in descending weight order; ties in no
+ * particular order.
+ *
+ * Follows find_top_k's weight-order frontier, entering only subtrees
+ * whose signature aggregate covers the query, and stops at the k-th
+ * match.  With the vertex index enabled, a rare query vertex is served
+ * from its posting list instead.  Either way the answer is exact.
+ * Typically O(k log k); caller must free the returned array.
+ */
+Node **find_top_k_containing(Forest *f, const hif_vertex_t *vertices,
+                             int nvertices, int k, int *result_count);
+
+/* Set similarity measures for find_k_most_similar_metric. */
+typedef enum {
+    HIF_SIM_OVERLAP = 0,   /* |A ∩ B| / min(|A|,|B|)  */
+    HIF_SIM_JACCARD,       /* |A ∩ B| / |A ∪ B|       */
+    HIF_SIM_COSINE         /* |A ∩ B| / √(|A|·|B|)    */
+} HifSimilarity;
 
 /**
  * Find the k nodes most similar to a query set.
  * Similarity = overlap coefficient (|A ∩ B| / min(|A|,|B|)).
- * Complexity: O(n log n).
+ * Results are in descending similarity; ties go to the node earlier in
+ * depth-first pre-order.
+ * Complexity: O(n log k) worst case, O(k) memory; subtrees whose
+ * signature bound cannot beat the current k-th best are skipped.
  * Caller must free the returned array.
  */
-Node **find_k_most_similar(Forest *f, const int *query, int nquery,
+Node **find_k_most_similar(Forest *f, const hif_vertex_t *query, int nquery,
                            int k, int *result_count);
 
+/**
+ * find_k_most_similar with a choice of similarity measure.
+ * @param scores If non-NULL, receives the similarities (room for k)
+ */
+Node **find_k_most_similar_metric(Forest *f, const hif_vertex_t *query,
+                                  int nquery, int k, HifSimilarity metric,
+                                  double *scores, int *result_count);
+
 /* ========== OPTIMIZATION & MAINTENANCE ========== */
 
 /**
  * Rebalance the forest.
- * Collects all nodes, sorts by weight descending, then reinserts.
+ * Collects all nodes, detaches them and relinks them with the same
+ * batch parent search as forest_build_bulk (each node goes under its
+ * smallest heavier-or-equal superset).
  * Frees children arrays properly before rebuild.
  */
 void forest_rebalance(Forest *f);
 
+/**
+ * Bound the work of insert_hyperedge.  With max_roots > 0 an insert
+ * descends into at most max_roots candidate roots (chosen by the vertex
+ * index when enabled, else by signature), no deeper than max_depth
+ * (<= 0 means 100 levels), and never scans for lighter roots to adopt.
+ * If no candidate accepts it the set becomes a new root.  Queries stay
+ * correct on the looser tree; indexed queries give the same answers.
+ * Each such insert is queued for forest_rebalance_step.  max_roots = 0
+ * restores exact insertion (the default).
+ */
+void forest_set_insert_bounds(Forest *f, int max_roots, int max_depth);
+
+/**
+ * Re-place up to budget boundedly inserted nodes exactly, latest first,
+ * so exact placement can be caught up between ingest batches in small
+ * slices.  forest_rebalance settles all of them at once.
+ * @return Nodes still waiting (budget 0 just reports it)
+ */
+int forest_rebalance_step(Forest *f, int budget);
+
 /**
  * Merge duplicate hyperedges (identical vertex sets, possibly different weights).
+ * Each group is folded into one node and the other nodes are deleted
+ * (their children move up).  O(n) expected via the canonical-set table;
+ * no rebalance is needed afterwards.
  *
  * @param f        Forest to deduplicate
  * @param keep_max 1 = keep maximum weight, 0 = use average weight
@@ -264,6 +516,15 @@ void forest_rebalance(Forest *f);
  */
 int forest_merge_duplicates(Forest *f, int keep_max);
 
+/**
+ * Choose how insert_hyperedge treats a vertex set that is already
+ * present.  Any policy other than HIF_DEDUP_NONE folds the insert into
+ * the existing node in O(1) expected time (plus the local move of
+ * forest_update_weight).  Duplicates inserted before the call are left
+ * alone; run forest_merge_duplicates for those.
+ */
+void forest_set_dedup(Forest *f, HifDedupPolicy policy);
+
 /**
  * Remove all nodes with weight < threshold (recursive, including subtrees).
  *
@@ -278,6 +539,321 @@ int forest_prune_by_weight(Forest *f, double threshold);
  */
 void forest_optimize(Forest *f);
 
+/* ========== SET KERNELS ========== */
+
+/*
+ * Subset and intersection tests on sorted vertex arrays run on the
+ * widest vector kernel the CPU supports (picked on first use), with a
+ * galloping search for very unequal sizes and a scalar merge for short
+ * sets.  The choice is process-wide.  Each vector kernel is built for
+ * the configured vertex width, so a 16-bit build compares twice as many
+ * IDs per instruction.  NEON covers 32-bit IDs only and AVX-512 has no
+ * 16-bit kernel; hif_set_kernel() reports those as unavailable.
+ */
+typedef enum {
+    HIF_KERNEL_AUTO = 0,   /* best supported                 */
+    HIF_KERNEL_SCALAR,
+    HIF_KERNEL_SSE42,
+    HIF_KERNEL_AVX2,
+    HIF_KERNEL_AVX512,
+    HIF_KERNEL_NEON
+} HifSetKernel;
+
+/**
+ * Force a kernel (e.g. HIF_KERNEL_SCALAR for comparison runs).
+ * @return 0 on success, -1 if this build or CPU lacks it
+ */
+int hif_set_kernel(HifSetKernel kernel);
+
+/** Name of the kernel in use ("scalar", "sse4.2", "avx2", ...). */
+const char *hif_set_kernel_name(void);
+
+/* ========== COMPRESSED VERTEX SETS ========== */
+
+/*
+ * Sorted vertex sets as delta + varint bytes: the first ID zigzag-coded,
+ * then each gap minus one, 7 bits per byte.  Used by forest_save and
+ * compressed flat images; typical nested sets take 1–2 bytes per vertex
+ * instead of 4.  The kernels below decode lazily and stop at the first
+ * mismatch, so a rejected test rarely touches the whole set.
+ */
+
+/**
+ * Worst-case encoded size of n vertices: the longest code of this build's
+ * vertex type each (5 bytes, or 10 with 64-bit IDs).
+ */
+size_t hif_vbyte_bound(int n);
+
+/**
+ * Encode strictly increasing verts[0..n) into out (hif_vbyte_bound(n)
+ * bytes available).  @return Bytes written
+ */
+size_t hif_vbyte_encode(const hif_vertex_t *verts, int n, uint8_t *out);
+
+/** Decode n vertices into out.  @return Bytes consumed */
+size_t hif_vbyte_decode(const uint8_t *in, int n, hif_vertex_t *out);
+
+/** 1 if sorted query ⊆ the n encoded vertices, else 0. */
+int hif_vbyte_contains(const uint8_t *enc, int n, const hif_vertex_t *query,
+                       int nquery);
+
+/** 1 if the n encoded vertices ⊆ sorted query, else 0. */
+int hif_vbyte_within(const uint8_t *enc, int n, const hif_vertex_t *query,
+                     int nquery);
+
+/** Size of the intersection of the n encoded vertices with sorted query. */
+int hif_vbyte_intersect_count(const uint8_t *enc, int n,
+                              const hif_vertex_t *query, int nquery);
+
+/* ========== NODE SIGNATURES ========== */
+
+/**
+ * Signature checks performed and rejections (no merge needed) since the
+ * last reset.  Counted only in builds with -DHIF_SIG_STATS or
+ * -DHIF_METRICS; otherwise both are 0.
+ */
+void hif_signature_stats(unsigned long long *checks,
+                         unsigned long long *rejects, int reset);
+
+/* ========== METRICS ========== */
+
+/*
+ * Hot-path counters, compiled in only with -DHIF_METRICS (the library
+ * and its callers need not agree on the flag; without it every counter
+ * reads 0 and the hooks compile to nothing).
+ *
+ * Structural counters are updated by the writer.  Query counters cover
+ * the serial query API (find_top_k, find_by_weight_threshold,
+ * find_minimal/heaviest_superset, find_all_supersets/subsets,
+ * find_by_weight_range, find_containing_vertices, find_k_most_similar*,
+ * and their _into / forest_visit_* variants).
+ * Set-kernel and signature counters are process-wide.
+ *
+ * Histograms are log2-bucketed: bucket b counts values v with
+ * 2^(b-1) <= v < 2^b (bucket 0 holds v == 0).
+ */
+#define HIF_HIST_BUCKETS 32
+
+struct ForestMetrics {
+    /* insertion */
+    unsigned long long inserts;
+    unsigned long long steals;          /* nodes moved under a new node      */
+    unsigned long long deep_inserts;    /* reached depth >= MAX_CHAIN_DEPTH  */
+    int                max_insert_depth;
+    unsigned long long depth_hist[HIF_HIST_BUCKETS];
+    /* every 2^HIF_METRICS_SAMPLE_SHIFT-th insert is timed (nanoseconds) */
+    unsigned long long insert_ns_hist[HIF_HIST_BUCKETS];
+    unsigned long long insert_samples;
+    /* roots and memory */
+    unsigned long long root_heap_ops;   /* root heap insert/remove/re-key    */
+    unsigned long long rebuilds;        /* full relinks (forest_rebalance)   */
+    unsigned long long alloc_bytes;     /* requested via the forest allocator */
+    int                nroots;          /* filled in by forest_get_metrics   */
+    /* queries */
+    unsigned long long queries;
+    unsigned long long visited;         /* nodes examined, all queries       */
+    unsigned long long max_visited;     /* most nodes examined by one query  */
+    unsigned long long visited_hist[HIF_HIST_BUCKETS];
+    /* set kernels and signatures (process-wide) */
+    unsigned long long subset_calls;
+    unsigned long long elements_compared; /* |A| + |B| per kernel call      */
+    unsigned long long sig_checks;
+    unsigned long long sig_rejects;
+    /* query cache (filled in by forest_get_metrics in every build) */
+    unsigned long long cache_hits;
+    unsigned long long cache_misses;
+};
+
+/** Snapshot of f's counters (all zero when built without HIF_METRICS). */
+ForestMetrics forest_get_metrics(const Forest *f);
+
+/** Zero f's counters and the process-wide ones. */
+void forest_reset_metrics(Forest *f);
+
+/** 1 if the library was built with HIF_METRICS. */
+int hif_metrics_enabled(void);
+
+/* ========== DELETION & WEIGHT UPDATE ========== */
+
+/**
+ * Delete every node whose vertex set equals verts (any order, duplicates
+ * ignored).  Children are spliced into the node's parent, or become
+ * roots.  The first call builds the canonical-set table in O(n); later
+ * calls cost O(|verts| + children moved).
+ * @return Number of nodes deleted (0 if the set is not present)
+ */
+int forest_delete_hyperedge(Forest *f, const hif_vertex_t *verts, int nverts);
+
+/**
+ * Set the weight of every node whose vertex set equals verts.  A node
+ * that becomes heavier than its parent is re-placed with its subtree;
+ * children left heavier than a lighter node move up to its parent.
+ * @return Number of nodes updated
+ */
+int forest_update_weight(Forest *f, const hif_vertex_t *verts, int nverts,
+                         double new_weight);
+
+/* ========== VERTEX INDEX ========== */
+
+/**
+ * Build an inverted index from vertex ID to the nodes containing it.
+ *
+ * While enabled, the index is kept current by insert_hyperedge,
+ * forest_prune_by_weight and forest_rebalance, and the containment
+ * queries (find_all_supersets, find_all_subsets, find_containing_vertices,
+ * find_minimal_superset, find_heaviest_superset) check only the nodes on
+ * the rarest query vertex's posting list instead of walking every root.
+ * find_top_k_containing reads that list when it is short next to k.
+ *
+ * Indexed queries are exact: they also report supersets that weight-first
+ * stealing placed under a parent that does not contain the query.
+ *
+ * Extra memory: one Node* per (vertex, node) incidence.
+ * No-op if the index is already enabled.
+ */
+void forest_enable_vertex_index(Forest *f);
+
+/** Drop the vertex index; queries fall back to tree walks. */
+void forest_disable_vertex_index(Forest *f);
+
+/**
+ * Memoize find_minimal_superset and find_heaviest_superset for up to
+ * capacity query sets (rounded up to a power of two), keyed by the
+ * query's vertex array.  An answer can only change when a set containing
+ * every query vertex is inserted, deleted or reweighted, so an entry is
+ * dropped only when each of its vertices has been touched by a mutation
+ * since it was filled; prune and rebalance drop everything.  A hot query
+ * between ingest batches costs one hash probe and O(|query|) stamp
+ * checks.  Hits and misses are reported by forest_get_metrics.
+ * Replaces any existing cache.  Not used by the _concurrent queries.
+ */
+void forest_enable_query_cache(Forest *f, int capacity);
+
+/** Drop the query cache. */
+void forest_disable_query_cache(Forest *f);
+
+/**
+ * Number of nodes containing vertex v (posting-list length).
+ * Returns -1 if the vertex index is disabled.
+ */
+int forest_vertex_degree(Forest *f, hif_vertex_t v);
+
+/* ========== CONCURRENT READERS ========== */
+
+/*
+ * Concurrency model: ONE writer thread calls the mutating API
+ * (insert_hyperedge, forest_insert_batch, forest_prune_by_weight,
+ * forest_rebalance, forest_merge_duplicates, forest_optimize) while any
+ * number of registered reader threads run the *_concurrent queries below
+ * without taking locks.
+ *
+ *   - Every mutation bumps a sequence counter; a reader query that
+ *     overlapped a mutation notices on validation and re-runs.
+ *   - Grown children/root arrays are published by pointer swap, and
+ *     nodes freed by pruning are retired rather than freed: they are
+ *     reclaimed only once every reader that could still see them has
+ *     left its read section (epoch-based reclamation).
+ *
+ * Reader usage:
+ *
+ *     int slot = forest_reader_register(f);
+ *     forest_read_begin(f, slot);
+ *     Node *n = find_heaviest_superset_concurrent(f, q, nq);
+ *     ... use n (valid until forest_read_end) ...
+ *     forest_read_end(f, slot);
+ *     forest_reader_unregister(f, slot);
+ *
+ * The concurrent queries always walk the trees; the vertex index and
+ * the other query functions are writer-thread only.
+ */
+
+/**
+ * Switch the forest into concurrent-reader mode.
+ * Call before any reader thread starts.  No-op if already enabled.
+ *
+ * @param max_readers  Maximum simultaneously registered readers
+ * @return             0 on success, -1 if max_readers <= 0
+ */
+int forest_enable_concurrency(Forest *f, int max_readers);
+
+/** Claim a reader slot. Returns the slot ID, or -1 if none is free. */
+int  forest_reader_register(Forest *f);
+
+/** Release a slot obtained from forest_reader_register. */
+void forest_reader_unregister(Forest *f, int slot);
+
+/**
+ * Enter a read section.  Nodes reachable during the section are not
+ * reclaimed until the matching forest_read_end.
+ */
+void forest_read_begin(Forest *f, int slot);
+
+/** Leave the read section entered with forest_read_begin. */
+void forest_read_end(Forest *f, int slot);
+
+/** find_top_k for reader threads (inside a read section). */
+Node **find_top_k_concurrent(Forest *f, int k, int *result_count);
+
+/** find_heaviest_superset for reader threads (inside a read section). */
+Node *find_heaviest_superset_concurrent(Forest *f, const hif_vertex_t *query,
+                                        int nquery);
+
+/** find_minimal_superset for reader threads (inside a read section). */
+Node *find_minimal_superset_concurrent(Forest *f, const hif_vertex_t *query,
+                                       int nquery);
+
+/** find_all_supersets for reader threads (inside a read section). */
+Node **find_all_supersets_concurrent(Forest *f, const hif_vertex_t *query,
+                                     int nquery, int *result_count);
+
+/** find_by_weight_threshold for reader threads (inside a read section). */
+int find_by_weight_threshold_concurrent(Forest *f, double threshold);
+
+/* ========== PARALLEL QUERIES ========== */
+
+/*
+ * The *_parallel queries split the forest into tasks (runs of roots, and
+ * runs of children wherever a node has a large child list) and execute
+ * them on the forest's work-stealing pool: idle workers steal from the
+ * other workers' deques.
+ *
+ * Results are deterministic and independent of the thread count: each
+ * task writes to its own output segment, segments are linked in
+ * depth-first pre-order, and the final merge walks that list.  The
+ * collecting queries therefore return exactly what the serial tree walk
+ * returns, in the same order.
+ *
+ * Not for use while forest_enable_concurrency readers/writer run.
+ */
+
+/**
+ * Set the number of worker threads for *_parallel queries (including
+ * the calling thread).  n <= 0 = number of online CPUs; n == 1 runs
+ * them on the caller.  Replaces any existing pool.
+ */
+void forest_set_threads(Forest *f, int nthreads);
+
+/** Worker count used by *_parallel queries (1 if no pool). */
+int forest_get_threads(const Forest *f);
+
+/** Parallel find_all_supersets (tree walk). Caller frees the array. */
+Node **find_all_supersets_parallel(Forest *f, const hif_vertex_t *query,
+                                   int nquery, int *result_count);
+
+/** Parallel find_by_weight_range. Caller frees the array. */
+Node **find_by_weight_range_parallel(Forest *f, double min_weight,
+                                     double max_weight, int *result_count);
+
+/**
+ * Parallel find_k_most_similar.  Ties in similarity are broken by
+ * depth-first pre-order position.  Caller frees the array.
+ */
+Node **find_k_most_similar_parallel(Forest *f, const hif_vertex_t *query,
+                                    int nquery, int k, int *result_count);
+
+/** Parallel get_forest_stats (single traversal). */
+ForestStats get_forest_stats_parallel(Forest *f);
+
 /* ========== BATCH OPERATIONS ========== */
 
 /**
@@ -290,16 +866,115 @@ void forest_optimize(Forest *f);
  */
 void forest_insert_batch(Forest *f, Hyperedge *edges, int nedges);
 
+/*
+ * Per-query results in compressed sparse row form: the matches of query
+ * i are nodes[offsets[i] .. offsets[i+1]).  Free with node_csr_free.
+ */
+typedef struct {
+    int    nqueries;
+    int   *offsets;   /* nqueries + 1 entries */
+    Node **nodes;
+} NodeCSR;
+
+/**
+ * find_all_supersets for many queries at once (weights ignored; vertex
+ * arrays sorted as for find_all_supersets).  One walk serves the whole
+ * batch: each node is tested only against the queries its ancestors
+ * contained, and its vertex array is loaded once for all of them.  With
+ * the vertex index, queries sharing a rarest vertex share one posting
+ * scan.  Query i gets the same nodes in the same order as a single
+ * find_all_supersets call.
+ *
+ * @param out Filled with fresh arrays (caller must node_csr_free)
+ * @return    Total number of (query, node) matches
+ */
+int forest_batch_supersets(Forest *f, const Hyperedge *queries, int nqueries,
+                           NodeCSR *out);
+
+/** Batched find_containing_vertices; same as forest_batch_supersets. */
+int forest_batch_containing(Forest *f, const Hyperedge *queries, int nqueries,
+                            NodeCSR *out);
+
+/** Free a NodeCSR's arrays; leaves it empty. */
+void node_csr_free(NodeCSR *csr);
+
 /**
  * Build a new forest from an array of hyperedges.
- * Sorts by weight descending for optimal insertion order.
  *
- * @param edges  Array of hyperedges (not modified)
+ * Bottom-up construction instead of repeated insertion:
+ *   1. sort edges by weight descending (ties: larger set first),
+ *   2. build a vertex → sorted-position index in one counting pass,
+ *   3. for every edge, scan the earlier entries of its rarest vertex's
+ *      postings for the smallest superset and link edge under it.
+ * Step 3 is independent per edge.  The result satisfies verify_forest
+ * and every child is a subset of its parent.
+ *
+ * @param edges  Array of hyperedges (not modified; need not be normalized)
  * @param nedges Number of edges
  * @return       New forest (caller must forest_free)
  */
 Forest *forest_build_bulk(Hyperedge *edges, int nedges);
 
+/**
+ * forest_build_bulk with the parent search split across threads.
+ *
+ * @param nthreads Worker threads (<= 0 = number of online CPUs)
+ */
+Forest *forest_build_bulk_parallel(Hyperedge *edges, int nedges, int nthreads);
+
+/* ========== STREAMING INGEST ========== */
+
+/*
+ * Buffers single-edge events into micro-batches.  A flush normalizes the
+ * batch in place (in parallel for large batches), sorts it by weight
+ * descending and inserts it in one writer section, so heavy edges land
+ * first and little child-stealing is needed.  The buffer runs on the
+ * writer thread; nothing is applied until a flush.
+ */
+typedef struct IngestBuffer IngestBuffer;
+
+typedef struct {
+    unsigned long long pushed;        /* events accepted                    */
+    unsigned long long applied;       /* events inserted by flushes         */
+    unsigned long long batches;       /* non-empty flushes                  */
+    unsigned long long size_flushes;  /* flushes forced by a full buffer    */
+    unsigned long long time_flushes;  /* flushes forced by max_delay_ms     */
+    unsigned long long stalled_pushes;/* pushes that waited on a flush      */
+    double             stall_ms;      /* time those pushes spent flushing   */
+    double             flush_ms;      /* time spent in all flushes          */
+    int                pending;       /* events currently buffered          */
+    int                max_batch;     /* largest batch applied              */
+} IngestStats;
+
+/**
+ * Create an ingest buffer feeding f.
+ *
+ * @param batch_size   Flush when this many events are pending (<= 0 = 4096)
+ * @param max_delay_ms Flush on push/poll once the oldest pending event is
+ *                     this old (<= 0 = no time trigger)
+ * @param nthreads     Normalization threads (<= 0 = online CPUs, 1 = inline)
+ */
+IngestBuffer *forest_ingest_create(Forest *f, int batch_size,
+                                   double max_delay_ms, int nthreads);
+
+/**
+ * Queue one edge (copied; need not be normalized).  May flush first.
+ * @return Number of events applied by a flush this call triggered
+ */
+int forest_ingest_push(IngestBuffer *b, const hif_vertex_t *verts, int nverts,
+                       double weight);
+
+/** Flush if the time trigger has expired.  @return Events applied */
+int forest_ingest_poll(IngestBuffer *b);
+
+/** Apply every pending event.  @return Events applied */
+int forest_ingest_flush(IngestBuffer *b);
+
+IngestStats forest_ingest_get_stats(const IngestBuffer *b);
+
+/** Flush the remaining events and free the buffer (not the forest). */
+void forest_ingest_destroy(IngestBuffer *b);
+
 /* ========== SERIALIZATION ========== */
 
 /**
@@ -314,6 +989,183 @@ int forest_save(Forest *f, const char *filename);
  */
 Forest *forest_load(const char *filename);
 
+/* ========== FLAT (MMAP-ABLE) FORMAT ========== */
+
+/*
+ * Read-only, position-independent forest image.  Nodes are numbered in
+ * breadth-first order (roots are 0 .. nroots-1, each node's children are
+ * consecutive IDs) and stored as parallel arrays; all vertex IDs live in
+ * one contiguous pool.  The on-disk file is byte-for-byte the same image,
+ * so flat_forest_open() only maps it: no per-node allocation or copying,
+ * and pages are read in as queries touch them.
+ *
+ * File layout (native byte order, arrays 64-byte aligned):
+ *   FlatHeader | weights[] | nverts[] | verts_offset[] | first_child[] |
+ *   child_count[] | vertex_pool[]
+ *
+ * With HIF_FLAT_VBYTE set the pool holds each node's set vbyte-coded
+ * (see COMPRESSED VERTEX SETS) and verts_offset is a byte offset; the
+ * queries run on the encoded sets directly.  Version 1 images (no flags)
+ * are still accepted.  elem_types records the vertex and weight widths
+ * of the writing build (0 for the default int / double), so an image
+ * is only opened by a build with the same element types.
+ */
+
+#define HIF_FLAT_MAGIC   "HIFFLAT"
+#define HIF_FLAT_VERSION 2u
+#define HIF_FLAT_VBYTE   1u         /* flags: vbyte-coded vertex pool     */
+#if !defined(HIF_VERTEX_BITS) && !defined(HIF_WEIGHT_FLOAT)
+#define HIF_FLAT_ELEM_TYPES 0u
+#else
+#define HIF_FLAT_ELEM_TYPES \
+    ((uint32_t)sizeof(hif_vertex_t) | (uint32_t)sizeof(hif_weight_t) << 8)
+#endif
+
+typedef struct {
+    char     magic[8];          /* HIF_FLAT_MAGIC, NUL-padded          */
+    uint32_t version;           /* HIF_FLAT_VERSION                   */
+    uint32_t byte_order;        /* 0x01020304 in the writer's order    */
+    uint64_t nnodes;
+    uint64_t nroots;
+    uint64_t nverts_total;      /* vertex pool length                 */
+    uint64_t off_weights;       /* byte offsets from the image start  */
+    uint64_t off_nverts;
+    uint64_t off_verts_offset;
+    uint64_t off_first_child;
+    uint64_t off_child_count;
+    uint64_t off_vertex_pool;
+    uint64_t image_size;
+    uint32_t flags;             /* HIF_FLAT_VBYTE; absent in version 1 */
+    uint32_t elem_types;        /* HIF_FLAT_ELEM_TYPES; 0 in older images */
+    uint64_t pool_bytes;        /* vertex pool size in bytes          */
+} FlatHeader;
+
+typedef struct {
+    uint64_t            nnodes;
+    uint64_t            nroots;
+    const hif_weight_t *weights;       /* per node                          */
+    const uint32_t     *nverts;        /* per node                          */
+    const uint64_t     *verts_offset;  /* per node, index into vertex_pool  */
+    const uint32_t     *first_child;   /* per node, ID of first child       */
+    const uint32_t     *child_count;   /* per node                          */
+    const hif_vertex_t *vertex_pool;   /* NULL in a compressed image        */
+    const uint8_t      *vbyte_pool;    /* compressed image only, else NULL  */
+    void               *image;         /* header + arrays                   */
+    size_t              image_size;
+    int                 mapped;        /* 1 = mmap'd file, 0 = heap image   */
+} FlatForest;
+
+/**
+ * Freeze f into an immutable in-memory snapshot (the same image the flat
+ * file holds).  f is not modified and may keep changing; the snapshot
+ * does not follow it.
+ * @return Snapshot (free with flat_forest_close), or NULL if f has more
+ *         nodes than 32-bit IDs can address
+ */
+FlatForest *forest_freeze(Forest *f);
+
+/**
+ * As forest_freeze, but with the vertex pool vbyte-coded
+ * (HIF_FLAT_VBYTE).  Every flat_* query works on it unchanged;
+ * flat_forest_save writes it and flat_forest_open maps it back.
+ * Use flat_node_decode to read a node's vertices.
+ */
+FlatForest *forest_freeze_compressed(Forest *f);
+
+/**
+ * Write f in the flat format.
+ * @return 0 on success, -1 on error
+ */
+int forest_save_flat(Forest *f, const char *filename);
+
+/**
+ * Write an existing snapshot (frozen or mapped) to a flat file.
+ * @return 0 on success, -1 on error
+ */
+int flat_forest_save(const FlatForest *ff, const char *filename);
+
+/**
+ * Map a flat file read-only.  Only the header is validated (O(1));
+ * use flat_forest_verify() for untrusted files.
+ * @return Mapped forest, or NULL on error (close with flat_forest_close)
+ */
+FlatForest *flat_forest_open(const char *filename);
+
+/** Unmap / free a FlatForest. */
+void flat_forest_close(FlatForest *ff);
+
+/**
+ * Full structural check (every offset and child range in bounds, BFS
+ * child numbering, weight monotonicity).  Touches every page.
+ * @return 1 if valid, 0 otherwise
+ */
+int flat_forest_verify(const FlatForest *ff);
+
+/**
+ * Vertex array of node `id` (sorted); *nverts receives its length.
+ * Returns NULL for a compressed image (use flat_node_decode).
+ */
+const hif_vertex_t *flat_node_verts(const FlatForest *ff, uint32_t id,
+                                    int *nverts);
+
+/**
+ * Copy node `id`'s sorted vertices into out (room for ff->nverts[id]),
+ * decoding a compressed image.  @return Number of vertices
+ */
+int flat_node_decode(const FlatForest *ff, uint32_t id, hif_vertex_t *out);
+
+/**
+ * Top-k heaviest node IDs (heap expansion, as find_top_k).
+ * Caller frees the returned array.
+ */
+uint32_t *flat_find_top_k(const FlatForest *ff, int k, int *result_count);
+
+/**
+ * Heaviest superset of query, or -1 if none (same walk as
+ * find_heaviest_superset).
+ */
+int64_t flat_find_heaviest_superset(const FlatForest *ff,
+                                    const hif_vertex_t *query, int nquery);
+
+/**
+ * All superset node IDs (same walk as find_all_supersets).
+ * Caller frees the returned array.
+ */
+uint32_t *flat_find_all_supersets(const FlatForest *ff,
+                                  const hif_vertex_t *query, int nquery,
+                                  int *result_count);
+
+/** Smallest superset of query, or -1 if none (as find_minimal_superset). */
+int64_t flat_find_minimal_superset(const FlatForest *ff,
+                                   const hif_vertex_t *query, int nquery);
+
+/**
+ * All nodes that are subsets of query, in ID order.  Caller frees.
+ */
+uint32_t *flat_find_all_subsets(const FlatForest *ff, const hif_vertex_t *query,
+                                int nquery, int *result_count);
+
+/**
+ * All nodes with min_weight <= weight <= max_weight, in ID order.
+ * Caller frees.
+ */
+uint32_t *flat_find_by_weight_range(const FlatForest *ff, double min_weight,
+                                    double max_weight, int *result_count);
+
+/** Number of nodes with weight >= threshold. */
+int flat_count_by_weight_threshold(const FlatForest *ff, double threshold);
+
+/**
+ * k nodes with the highest overlap ratio to query (ties by lower ID).
+ * Caller frees.
+ */
+uint32_t *flat_find_k_most_similar(const FlatForest *ff,
+                                   const hif_vertex_t *query, int nquery, int k,
+                                   int *result_count);
+
+/** Same statistics as get_forest_stats, computed from the snapshot. */
+ForestStats flat_get_stats(const FlatForest *ff);
+
 /* ========== TRAVERSAL ========== */
 
 /**
@@ -327,7 +1179,230 @@ void forest_traverse_bfs(Forest *f, NodeVisitor visitor, void *user_data);
 /** Depth-first traversal (pre-order). */
 void forest_traverse_dfs(Forest *f, NodeVisitor visitor, void *user_data);
 
-/** Traverse all nodes in descending weight order. O(n log n). */
+/**
+ * Traverse all nodes in descending weight order.  Nodes are produced
+ * lazily, so stopping after k visits costs O(k log k); a full walk is
+ * O(n log n).
+ */
 void forest_traverse_by_weight(Forest *f, NodeVisitor visitor, void *user_data);
 
+/*
+ * Resumable weight-order cursor.  Holds the same lazy frontier as
+ * find_top_k between calls, so a paginated caller fetches page 2 without
+ * re-reading page 1.  The forest must not be modified while a cursor is
+ * open; free it with forest_weight_iter_end.
+ */
+typedef struct WeightIter WeightIter;
+
+/** Open a cursor positioned before the heaviest node. O(1). */
+WeightIter *forest_weight_iter_begin(Forest *f);
+
+/** Next node in descending weight order, or NULL when exhausted. */
+Node *forest_weight_iter_next(WeightIter *it);
+
+/**
+ * Copy up to max further nodes into out (caller-owned).
+ * @return Number written; less than max only at the end.
+ */
+int forest_weight_iter_next_n(WeightIter *it, Node **out, int max);
+
+/** Release a cursor (does NOT free the nodes). */
+void forest_weight_iter_end(WeightIter *it);
+
+/* ========== CALLER-OWNED RESULTS ========== */
+
+/*
+ * Reusable result buffer for the *_into queries.  Each call resets count,
+ * appends its matches to items and grows items only when they do not
+ * fit; the traversal stack of deep walks is kept here as well.  Once a
+ * buffer has seen the largest result and depth of a workload, repeated
+ * queries through it perform no heap allocation.  One buffer per thread:
+ * it is caller state, not forest state.  items stay valid until the next
+ * query through the buffer or until the nodes are modified.
+ */
+typedef struct {
+    Node  **items;
+    int     count;
+    int     cap;
+    void   *scratch;        /* internal: retained traversal stack */
+    size_t  scratch_bytes;
+} NodeBuffer;
+
+/** Prepare an empty buffer (equivalent to zero-initialising it). */
+void node_buffer_init(NodeBuffer *buf);
+
+/** Release a buffer's storage; it is left empty and reusable. */
+void node_buffer_free(NodeBuffer *buf);
+
+/*
+ * Buffer variants of the queries of the same name: same results in the
+ * same order, written to out.  Each returns out->count.
+ */
+int find_top_k_into(Forest *f, int k, NodeBuffer *out);
+int find_all_supersets_into(Forest *f, const hif_vertex_t *query, int nquery,
+                            NodeBuffer *out);
+int find_all_subsets_into(Forest *f, const hif_vertex_t *query, int nquery,
+                          NodeBuffer *out);
+int find_by_weight_range_into(Forest *f, double min_weight, double max_weight,
+                              NodeBuffer *out);
+int find_containing_vertices_into(Forest *f, const hif_vertex_t *vertices,
+                                  int nvertices, NodeBuffer *out);
+int find_top_k_containing_into(Forest *f, const hif_vertex_t *vertices,
+                               int nvertices, int k, NodeBuffer *out);
+int get_clusters_by_weight_into(Forest *f, double threshold, NodeBuffer *out);
+
+/*
+ * Streaming variants: each match is passed to visitor as it is found and
+ * nothing is collected.  A non-zero return from visitor stops the query.
+ * @return Number of nodes delivered (including the one that stopped it).
+ */
+int forest_visit_supersets(Forest *f, const hif_vertex_t *query, int nquery,
+                           NodeVisitor visitor, void *user_data);
+int forest_visit_subsets(Forest *f, const hif_vertex_t *query, int nquery,
+                         NodeVisitor visitor, void *user_data);
+int forest_visit_weight_range(Forest *f, double min_weight, double max_weight,
+                              NodeVisitor visitor, void *user_data);
+
+/* ========== SHARDED FOREST ========== */
+
+/*
+ * A hypergraph split across independent forests.  Every set is routed by
+ * its minimum vertex, so equal sets always share a shard; queries fan out
+ * to the shards that can hold matches and merge the results.  Nesting
+ * across shards is not tracked: each shard is a complete forest of its
+ * own, saved and loaded with forest_save / forest_load, so shards can be
+ * built or served by separate processes.
+ */
+typedef enum {
+    HIF_SHARD_RANGE,    /* shard = min vertex / vertex_span (last takes the rest) */
+    HIF_SHARD_HASH      /* shard = hash(min vertex) % nshards                     */
+} HifShardPolicy;
+
+typedef struct {
+    Forest       **shards;
+    int            nshards;
+    HifShardPolicy policy;
+    hif_vertex_t   vertex_span;  /* vertices per shard under HIF_SHARD_RANGE */
+} ShardedForest;
+
+/** Create nshards empty shards.  vertex_span is ignored by HIF_SHARD_HASH. */
+ShardedForest *sharded_forest_create(int nshards, HifShardPolicy policy,
+                                     hif_vertex_t vertex_span);
+
+/** Free every shard and the container. */
+void sharded_forest_free(ShardedForest *sf);
+
+/** Shard a set would be routed to, or -1 if nverts <= 0. */
+int sharded_shard_of(const ShardedForest *sf, const hif_vertex_t *verts,
+                     int nverts);
+
+/** insert_hyperedge into the owning shard. */
+void sharded_insert_hyperedge(ShardedForest *sf, const hif_vertex_t *verts,
+                              int nverts, double weight);
+
+/** Total nodes over all shards. */
+int sharded_count_total_nodes(const ShardedForest *sf);
+
+/**
+ * Global top k by weight: a k-way merge of each shard's lazy weight
+ * order, O(k log k + nshards).  Caller must free the returned array.
+ */
+Node **sharded_find_top_k(ShardedForest *sf, int k, int *result_count);
+
+/**
+ * find_all_supersets over all shards, grouped by shard.  HIF_SHARD_RANGE
+ * skips shards above the one owning min(query).  Caller must free.
+ */
+Node **sharded_find_all_supersets(ShardedForest *sf, const hif_vertex_t *query,
+                                  int nquery, int *result_count);
+
+/**
+ * find_by_weight_range over all shards, grouped by shard; shards whose
+ * heaviest root is below min_weight are skipped.  Caller must free.
+ */
+Node **sharded_find_by_weight_range(ShardedForest *sf, double min_weight,
+                                    double max_weight, int *result_count);
+
+/**
+ * Save a text manifest to path and shard i to "<path>.<i>" (forest_save).
+ * @return 0 on success, -1 on error
+ */
+int sharded_forest_save(ShardedForest *sf, const char *path);
+
+/**
+ * Load a manifest and all its shard files.
+ * @return Loaded forest, or NULL if any file is missing or invalid
+ */
+ShardedForest *sharded_forest_load(const char *path);
+
+/* ========== VERSIONED SNAPSHOTS ========== */
+
+/**
+ * O(roots) read-only view of the forest as it is now.  Nodes are shared
+ * copy-on-write: later edits to f copy the path from the changed node to
+ * its root and leave the snapshot's nodes alone, so every query on the
+ * snapshot keeps answering for this version.  Node pointers obtained from
+ * the snapshot stay valid until it is freed.  Mutators on a snapshot
+ * return without doing anything.
+ *
+ * Free with forest_free, on the writer's thread and before f itself.
+ * Prune, rebalance and merge copy the whole forest once while a snapshot
+ * is open.  Snapshots carry no vertex index, set table or query cache.
+ * @return The snapshot, or NULL if f is concurrent or itself a snapshot
+ */
+Forest *forest_snapshot(Forest *f);
+
+/** Number of snapshots of f still open. */
+int forest_snapshot_count(const Forest *f);
+
+/** Nodes gone from f that are kept alive only for open snapshots. */
+size_t forest_snapshot_retained(const Forest *f);
+
+/* ========== INCREMENTAL MAINTENANCE ========== */
+
+/* Passes for forest_maintain_step, or-ed together. */
+enum {
+    HIF_MAINT_REBALANCE = 1,  /* relink each subtree, settle bounded inserts */
+    HIF_MAINT_DEDUP     = 2,  /* merge equal sets, keeping the max weight    */
+    HIF_MAINT_REPACK    = 4,  /* copy each subtree to fresh memory, pre-order */
+    HIF_MAINT_ALL       = 7
+};
+
+/**
+ * Run the chosen passes over up to max_roots root subtrees, continuing
+ * round-robin from where the last call stopped, and stop early once
+ * budget_ms have elapsed (0 = no time limit).  The incremental
+ * counterpart of forest_optimize: a subtree is relinked within itself,
+ * so a full round approximates forest_rebalance without ever holding the
+ * writer side for more than one subtree.  Under concurrent readers each
+ * subtree is its own write section.
+ *
+ * HIF_MAINT_REPACK moves nodes: Node pointers obtained before the call
+ * are invalid afterwards.  It is skipped in concurrent mode and while
+ * snapshots are open.
+ * @return Number of subtrees visited
+ */
+int forest_maintain_step(Forest *f, int flags, int max_roots, double budget_ms);
+
+/* Background thread calling forest_maintain_step periodically. */
+typedef struct HifMaintainer HifMaintainer;
+
+/**
+ * Start a thread that runs forest_maintain_step(f, flags, max_roots, 0)
+ * every period_ms (<= 0 gives 16 roots every 10 ms).  The forest still
+ * has a single writer: every other modification of f, and every query
+ * unless concurrent readers are enabled, must run between
+ * forest_maintainer_lock and forest_maintainer_unlock.
+ * @return The maintainer, or NULL if the thread could not be started
+ */
+HifMaintainer *forest_maintainer_start(Forest *f, int flags, int max_roots,
+                                       double period_ms);
+
+/** Take / release the writer lock shared with the maintainer thread. */
+void forest_maintainer_lock(HifMaintainer *m);
+void forest_maintainer_unlock(HifMaintainer *m);
+
+/** Stop and join the thread; f is left as the last step made it. */
+void forest_maintainer_stop(HifMaintainer *m);
+
 #endif /* HYPEREDGE_INCLUSION_FOREST_H */
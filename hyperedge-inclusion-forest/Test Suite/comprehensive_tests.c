@@ -1,6 +1,8 @@
 /**
  * Comprehensive Test Suite for Hyperedge Inclusion Forest
  * Tests all advanced features: queries, optimization, serialization, traversal
+ * Vertex arrays are hif_vertex_t, so the suite runs under every
+ * -DHIF_VERTEX_BITS / -DHIF_WEIGHT_FLOAT build of the library.
  */
 
 #include "../Core Implementation/hif.h"
@@ -8,6 +10,10 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 
 #define TEST_PASSED(name) printf("✓ %s PASSED\n", name)
 #define TEST_FAILED(name) printf("✗ %s FAILED\n", name)
@@ -18,11 +24,11 @@ void test_find_all_supersets() {
     printf("\n=== TEST 1: Find All Supersets ===\n");
     Forest *f = forest_create();
     
-    int e1[] = {1,2,3,4,5};
-    int e2[] = {1,2,3};
-    int e3[] = {1,2};
-    int e4[] = {1,2,3,4};
-    int e5[] = {6,7};
+    hif_vertex_t e1[] = {1,2,3,4,5};
+    hif_vertex_t e2[] = {1,2,3};
+    hif_vertex_t e3[] = {1,2};
+    hif_vertex_t e4[] = {1,2,3,4};
+    hif_vertex_t e5[] = {6,7};
     
     insert_hyperedge(f, e1, 5, 5.0);
     insert_hyperedge(f, e2, 3, 3.0);
@@ -30,7 +36,7 @@ void test_find_all_supersets() {
     insert_hyperedge(f, e4, 4, 4.0);
     insert_hyperedge(f, e5, 2, 2.0);
     
-    int query[] = {1,2};
+    hif_vertex_t query[] = {1,2};
     int count;
     Node **results = find_all_supersets(f, query, 2, &count);
     
@@ -45,11 +51,11 @@ void test_find_all_subsets() {
     printf("\n=== TEST 2: Find All Subsets ===\n");
     Forest *f = forest_create();
     
-    int e1[] = {1,2,3,4,5};
-    int e2[] = {1,2,3};
-    int e3[] = {1,2};
-    int e4[] = {1};
-    int e5[] = {6,7};
+    hif_vertex_t e1[] = {1,2,3,4,5};
+    hif_vertex_t e2[] = {1,2,3};
+    hif_vertex_t e3[] = {1,2};
+    hif_vertex_t e4[] = {1};
+    hif_vertex_t e5[] = {6,7};
     
     insert_hyperedge(f, e1, 5, 5.0);
     insert_hyperedge(f, e2, 3, 3.0);
@@ -57,7 +63,7 @@ void test_find_all_subsets() {
     insert_hyperedge(f, e4, 1, 1.0);
     insert_hyperedge(f, e5, 2, 2.0);
     
-    int query[] = {1,2,3,4};
+    hif_vertex_t query[] = {1,2,3,4};
     int count;
     Node **results = find_all_subsets(f, query, 4, &count);
     
@@ -73,7 +79,7 @@ void test_find_by_weight_range() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 20; i++) {
-        int verts[] = {i, i+1};
+        hif_vertex_t verts[] = {i, i+1};
         insert_hyperedge(f, verts, 2, (double)i);
     }
     
@@ -91,17 +97,17 @@ void test_find_containing_vertices() {
     printf("\n=== TEST 4: Find Containing Vertices ===\n");
     Forest *f = forest_create();
     
-    int e1[] = {1,2,3,4};
-    int e2[] = {1,2,5};
-    int e3[] = {1,2,6};
-    int e4[] = {3,4,5};
+    hif_vertex_t e1[] = {1,2,3,4};
+    hif_vertex_t e2[] = {1,2,5};
+    hif_vertex_t e3[] = {1,2,6};
+    hif_vertex_t e4[] = {3,4,5};
     
     insert_hyperedge(f, e1, 4, 4.0);
     insert_hyperedge(f, e2, 3, 3.0);
     insert_hyperedge(f, e3, 3, 3.0);
     insert_hyperedge(f, e4, 3, 3.0);
     
-    int query[] = {1,2};
+    hif_vertex_t query[] = {1,2};
     int count;
     Node **results = find_containing_vertices(f, query, 2, &count);
     
@@ -116,17 +122,17 @@ void test_find_k_most_similar() {
     printf("\n=== TEST 5: Find K Most Similar ===\n");
     Forest *f = forest_create();
     
-    int e1[] = {1,2,3};
-    int e2[] = {1,2,4};
-    int e3[] = {1,3,4};
-    int e4[] = {5,6,7};
+    hif_vertex_t e1[] = {1,2,3};
+    hif_vertex_t e2[] = {1,2,4};
+    hif_vertex_t e3[] = {1,3,4};
+    hif_vertex_t e4[] = {5,6,7};
     
     insert_hyperedge(f, e1, 3, 3.0);
     insert_hyperedge(f, e2, 3, 3.0);
     insert_hyperedge(f, e3, 3, 3.0);
     insert_hyperedge(f, e4, 3, 3.0);
     
-    int query[] = {1,2};
+    hif_vertex_t query[] = {1,2};
     int count;
     Node **results = find_k_most_similar(f, query, 2, 3, &count);
     
@@ -147,7 +153,7 @@ void test_forest_rebalance() {
     
     // Insert in suboptimal order
     for (int i = 0; i < 50; i++) {
-        int verts[] = {i, i+1, i+2};
+        hif_vertex_t verts[] = {i, i+1, i+2};
         insert_hyperedge(f, verts, 3, (double)(50-i));
     }
     
@@ -165,7 +171,7 @@ void test_merge_duplicates() {
     printf("\n=== TEST 7: Merge Duplicates ===\n");
     Forest *f = forest_create();
     
-    int e[] = {1,2,3};
+    hif_vertex_t e[] = {1,2,3};
     insert_hyperedge(f, e, 3, 5.0);
     insert_hyperedge(f, e, 3, 7.0);
     insert_hyperedge(f, e, 3, 3.0);
@@ -187,7 +193,7 @@ void test_prune_by_weight() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 20; i++) {
-        int verts[] = {i, i+1};
+        hif_vertex_t verts[] = {i, i+1};
         insert_hyperedge(f, verts, 2, (double)i);
     }
     
@@ -209,7 +215,7 @@ void test_forest_optimize() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 100; i++) {
-        int verts[] = {i % 10, (i+1) % 10};
+        hif_vertex_t verts[] = {i % 10, (i+1) % 10};
         insert_hyperedge(f, verts, 2, (double)(i % 20));
     }
     
@@ -228,7 +234,7 @@ void test_batch_insert() {
     
     Hyperedge edges[10];
     for (int i = 0; i < 10; i++) {
-        edges[i].verts = malloc(sizeof(int) * 3);
+        edges[i].verts = malloc(sizeof(hif_vertex_t) * 3);
         edges[i].verts[0] = i;
         edges[i].verts[1] = i+1;
         edges[i].verts[2] = i+2;
@@ -254,7 +260,7 @@ void test_bulk_build() {
     
     Hyperedge edges[20];
     for (int i = 0; i < 20; i++) {
-        edges[i].verts = malloc(sizeof(int) * 2);
+        edges[i].verts = malloc(sizeof(hif_vertex_t) * 2);
         edges[i].verts[0] = i;
         edges[i].verts[1] = i+1;
         edges[i].nverts = 2;
@@ -274,6 +280,81 @@ void test_bulk_build() {
     TEST_PASSED("bulk_build");
 }
 
+static int children_are_subsets(Node *nd) {
+    for (int i = 0; i < nd->nchildren; i++) {
+        Node *c = nd->children[i];
+        int a = 0, b = 0;
+        while (a < c->he.nverts && b < nd->he.nverts) {
+            if (c->he.verts[a] == nd->he.verts[b]) { a++; b++; }
+            else if (c->he.verts[a] > nd->he.verts[b]) b++;
+            else return 0;
+        }
+        if (a < c->he.nverts) return 0;
+        if (!children_are_subsets(c)) return 0;
+    }
+    return 1;
+}
+
+void test_bulk_build_parallel() {
+    printf("\n=== TEST 20: Bottom-Up Bulk Build ===\n");
+    
+    int n = 3000;
+    Hyperedge *edges = malloc(sizeof(Hyperedge) * n);
+    srand(11);
+    for (int i = 0; i < n; i++) {
+        int size = 1 + rand() % 8;
+        edges[i].verts = malloc(sizeof(hif_vertex_t) * size);
+        for (int j = 0; j < size; j++) edges[i].verts[j] = rand() % 60;  // unsorted, dups
+        edges[i].nverts = size;
+        edges[i].weight = (double)(rand() % 100);
+    }
+    
+    Forest *seq = forest_build_bulk(edges, n);
+    Forest *par = forest_build_bulk_parallel(edges, n, 4);
+    
+    assert(count_total_nodes(seq) == n);
+    assert(count_total_nodes(par) == n);
+    assert(verify_forest(seq) && verify_forest(par));
+    for (int i = 0; i < seq->nroots; i++) assert(children_are_subsets(seq->roots[i]));
+    
+    // The parent search is deterministic, so both builds have the same shape
+    assert(seq->nroots == par->nroots);
+    assert(forest_max_depth(seq) == forest_max_depth(par));
+    
+    // Containment queries agree with a brute-force scan
+    hif_vertex_t query[] = {3, 17};
+    int count;
+    Node **results = find_all_supersets(par, query, 2, &count);
+    int expected = 0;
+    for (int i = 0; i < n; i++) {
+        int has3 = 0, has17 = 0;
+        for (int j = 0; j < edges[i].nverts; j++) {
+            if (edges[i].verts[j] == 3) has3 = 1;
+            if (edges[i].verts[j] == 17) has17 = 1;
+        }
+        expected += has3 && has17;
+    }
+    printf("Roots: %d, depth: %d, supersets of {3,17}: %d\n",
+           par->nroots, forest_max_depth(par), count);
+    assert(count == expected);
+    free(results);
+    
+    // Rebalance relinks with the same batch parent search
+    Forest *inc = forest_create();
+    forest_insert_batch(inc, edges, n);
+    forest_rebalance(inc);
+    assert(count_total_nodes(inc) == n && verify_forest(inc));
+    for (int i = 0; i < inc->nroots; i++) assert(children_are_subsets(inc->roots[i]));
+    assert(inc->nroots == seq->nroots);
+    
+    for (int i = 0; i < n; i++) free(edges[i].verts);
+    free(edges);
+    forest_free(seq);
+    forest_free(par);
+    forest_free(inc);
+    TEST_PASSED("bulk_build_parallel");
+}
+
 // ========== TEST 4: Serialization ==========
 
 void test_serialization() {
@@ -281,7 +362,7 @@ void test_serialization() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 10; i++) {
-        int verts[] = {i, i+1, i+2};
+        hif_vertex_t verts[] = {i, i+1, i+2};
         insert_hyperedge(f, verts, 3, (double)i);
     }
     
@@ -307,6 +388,179 @@ void test_serialization() {
     TEST_PASSED("serialization");
 }
 
+void test_flat_mmap_format() {
+    printf("\n=== TEST 23: Flat mmap Format ===\n");
+    Forest *f = forest_create();
+    srand(23);
+    for (int i = 0; i < 500; i++) {
+        hif_vertex_t verts[6];
+        int n = 1 + rand() % 6;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 40;
+        insert_hyperedge(f, verts, n, (double)(rand() % 1000));
+    }
+
+    assert(forest_save_flat(f, "/tmp/test_forest.flat") == 0);
+    FlatForest *ff = flat_forest_open("/tmp/test_forest.flat");
+    assert(ff != NULL);
+    assert(ff->mapped);
+    assert((int)ff->nnodes == count_total_nodes(f));
+    assert((int)ff->nroots == f->nroots);
+    assert(flat_forest_verify(ff));
+    printf("Mapped %llu nodes (%zu bytes)\n",
+           (unsigned long long)ff->nnodes, ff->image_size);
+
+    // Top-k matches the pointer forest weight for weight
+    int kc, fkc;
+    Node **top = find_top_k(f, 25, &kc);
+    uint32_t *ftop = flat_find_top_k(ff, 25, &fkc);
+    assert(kc == fkc);
+    for (int i = 0; i < kc; i++)
+        assert(top[i]->he.weight == ff->weights[ftop[i]]);
+    free(top);
+    free(ftop);
+
+    // Superset queries agree
+    for (int q = 0; q < 20; q++) {
+        hif_vertex_t query[] = {q, q + 1};
+        int nc, fnc;
+        Node **sup = find_all_supersets(f, query, 2, &nc);
+        uint32_t *fsup = flat_find_all_supersets(ff, query, 2, &fnc);
+        assert(nc == fnc);
+        for (int i = 0; i < nc; i++) {
+            int nv;
+            const hif_vertex_t *v = flat_node_verts(ff, fsup[i], &nv);
+            assert(nv == sup[i]->he.nverts);
+            assert(memcmp(v, sup[i]->he.verts, sizeof(hif_vertex_t) * nv) == 0);
+        }
+        free(sup);
+        free(fsup);
+
+        Node *h = find_heaviest_superset(f, query, 2);
+        int64_t fh = flat_find_heaviest_superset(ff, query, 2);
+        assert((h == NULL) == (fh < 0));
+        if (h) assert(h->he.weight == ff->weights[fh]);
+    }
+    flat_forest_close(ff);
+
+    // A truncated file is rejected at open
+    char head[100];
+    FILE *fp = fopen("/tmp/test_forest.flat", "rb");
+    assert(fp != NULL);
+    assert(fread(head, 1, sizeof(head), fp) == sizeof(head));
+    fclose(fp);
+    fp = fopen("/tmp/test_forest.flat", "wb");
+    fwrite(head, 1, sizeof(head), fp);
+    fclose(fp);
+    assert(flat_forest_open("/tmp/test_forest.flat") == NULL);
+
+    forest_free(f);
+    remove("/tmp/test_forest.flat");
+    TEST_PASSED("flat mmap format");
+}
+
+static int cmp_ptr(const void *a, const void *b) {
+    const void *x = *(void * const *)a, *y = *(void * const *)b;
+    return (x > y) - (x < y);
+}
+
+void test_frozen_snapshot() {
+    printf("\n=== TEST 24: Frozen Snapshot Queries ===\n");
+    Forest *f = forest_create();
+    srand(24);
+    for (int i = 0; i < 800; i++) {
+        hif_vertex_t verts[8];
+        int n = 1 + rand() % 8;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 60;
+        insert_hyperedge(f, verts, n, (double)(rand() % 500));
+    }
+
+    FlatForest *snap = forest_freeze(f);
+    assert(snap != NULL && !snap->mapped);
+    assert(flat_forest_verify(snap));
+
+    // BFS numbering: walk the pointer forest in BFS order alongside IDs
+    Node **bfs = malloc(sizeof(Node*) * snap->nnodes);
+    int front = 0, back = 0;
+    for (int i = 0; i < f->nroots; i++) bfs[back++] = f->roots[i];
+    while (front < back) {
+        Node *n = bfs[front++];
+        for (int i = 0; i < n->nchildren; i++) bfs[back++] = n->children[i];
+    }
+    assert(back == (int)snap->nnodes);
+    for (int id = 0; id < back; id++) {
+        int nv;
+        const hif_vertex_t *v = flat_node_verts(snap, id, &nv);
+        assert(snap->weights[id] == bfs[id]->he.weight);
+        assert(nv == bfs[id]->he.nverts);
+        assert(memcmp(v, bfs[id]->he.verts, sizeof(hif_vertex_t) * nv) == 0);
+    }
+
+    // Query results match as sets (compare through the BFS map)
+    hif_vertex_t query[] = {3, 7, 11, 20, 31, 42};
+    int nc, fnc;
+    Node **sub = find_all_subsets(f, query, 6, &nc);
+    uint32_t *fsub = flat_find_all_subsets(snap, query, 6, &fnc);
+    assert(nc == fnc);
+    Node **mapped = malloc(sizeof(Node*) * (fnc + 1));
+    for (int i = 0; i < fnc; i++) mapped[i] = bfs[fsub[i]];
+    qsort(sub, nc, sizeof(Node*), cmp_ptr);
+    qsort(mapped, fnc, sizeof(Node*), cmp_ptr);
+    assert(nc == 0 || memcmp(sub, mapped, sizeof(Node*) * nc) == 0);
+    free(sub); free(fsub); free(mapped);
+
+    Node **range = find_by_weight_range(f, 100.0, 250.0, &nc);
+    uint32_t *frange = flat_find_by_weight_range(snap, 100.0, 250.0, &fnc);
+    assert(nc == fnc);
+    free(range); free(frange);
+
+    assert(find_by_weight_threshold(f, 300.0) ==
+           flat_count_by_weight_threshold(snap, 300.0));
+
+    hif_vertex_t single[] = {7};
+    Node *m = find_minimal_superset(f, single, 1);
+    int64_t fm = flat_find_minimal_superset(snap, single, 1);
+    assert((m == NULL) == (fm < 0));
+    if (m) assert((int)snap->nverts[fm] == m->he.nverts);
+
+    int sc, pc;
+    uint32_t *sim = flat_find_k_most_similar(snap, query, 6, 5, &sc);
+    Node **psim = find_k_most_similar(f, query, 6, 5, &pc);
+    Node qn = { .he = { query, 6, 0.0 } };
+    assert(sc == 5 && pc == 5);
+    for (int i = 0; i < sc; i++) {
+        Node sn = { .he = { NULL, 0, 0.0 } };
+        sn.he.verts = (hif_vertex_t *)flat_node_verts(snap, sim[i], &sn.he.nverts);
+        assert(compute_overlap(&sn, &qn) == compute_overlap(psim[i], &qn));
+    }
+    free(psim);
+    free(sim);
+
+    ForestStats a = get_forest_stats(f), b = flat_get_stats(snap);
+    assert(a.total_nodes == b.total_nodes && a.num_roots == b.num_roots);
+    assert(a.max_depth == b.max_depth && a.max_children == b.max_children);
+    assert(a.max_weight == b.max_weight && a.min_weight == b.min_weight);
+    printf("Snapshot: %d nodes, depth %d, %zu bytes\n",
+           b.total_nodes, b.max_depth, snap->image_size);
+
+    // The snapshot is independent of later writes
+    hif_vertex_t extra[] = {1000, 1001};
+    insert_hyperedge(f, extra, 2, 1e6);
+    assert((int)snap->nnodes == back);
+
+    // A frozen snapshot saves to the same format the mmap path reads
+    assert(flat_forest_save(snap, "/tmp/test_snapshot.flat") == 0);
+    FlatForest *ff = flat_forest_open("/tmp/test_snapshot.flat");
+    assert(ff != NULL && ff->nnodes == snap->nnodes);
+    assert(memcmp(ff->image, snap->image, snap->image_size) == 0);
+    flat_forest_close(ff);
+    remove("/tmp/test_snapshot.flat");
+
+    free(bfs);
+    flat_forest_close(snap);
+    forest_free(f);
+    TEST_PASSED("frozen snapshot");
+}
+
 // ========== TEST 5: Iteration ==========
 
 static int visit_count = 0;
@@ -328,7 +582,7 @@ void test_traverse_bfs() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 10; i++) {
-        int verts[] = {i, i+1};
+        hif_vertex_t verts[] = {i, i+1};
         insert_hyperedge(f, verts, 2, (double)i);
     }
     
@@ -348,7 +602,7 @@ void test_traverse_dfs() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 10; i++) {
-        int verts[] = {i, i+1};
+        hif_vertex_t verts[] = {i, i+1};
         insert_hyperedge(f, verts, 2, (double)i);
     }
     
@@ -368,7 +622,7 @@ void test_traverse_by_weight() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 10; i++) {
-        int verts[] = {i, i+1};
+        hif_vertex_t verts[] = {i, i+1};
         insert_hyperedge(f, verts, 2, (double)i);
     }
     
@@ -387,7 +641,7 @@ void test_early_stop() {
     Forest *f = forest_create();
     
     for (int i = 0; i < 20; i++) {
-        int verts[] = {i, i+1};
+        hif_vertex_t verts[] = {i, i+1};
         insert_hyperedge(f, verts, 2, (double)i);
     }
     
@@ -409,7 +663,7 @@ void test_top_k_performance() {
     
     // Insert 1000 hyperedges
     for (int i = 0; i < 1000; i++) {
-        int verts[] = {i, i+1, i+2};
+        hif_vertex_t verts[] = {i, i+1, i+2};
         insert_hyperedge(f, verts, 3, (double)(1000-i));
     }
     
@@ -432,6 +686,2161 @@ void test_top_k_performance() {
     TEST_PASSED("top_k_performance");
 }
 
+// ========== TEST 7: Vertex Index ==========
+
+void test_vertex_index_queries() {
+    printf("\n=== TEST 18: Vertex Index Queries ===\n");
+    Forest *f = forest_create();
+    forest_enable_vertex_index(f);
+    
+    hif_vertex_t e1[] = {1,2,3,4,5};
+    hif_vertex_t e2[] = {1,2,3};
+    hif_vertex_t e3[] = {1,2};
+    hif_vertex_t e4[] = {1,2,3,4};
+    hif_vertex_t e5[] = {6,7};
+    hif_vertex_t e6[] = {1};
+    
+    insert_hyperedge(f, e1, 5, 5.0);
+    insert_hyperedge(f, e2, 3, 3.0);
+    insert_hyperedge(f, e3, 2, 2.0);
+    insert_hyperedge(f, e4, 4, 4.0);
+    insert_hyperedge(f, e5, 2, 2.0);
+    insert_hyperedge(f, e6, 1, 1.0);
+    
+    assert(forest_vertex_degree(f, 1) == 5);
+    assert(forest_vertex_degree(f, 6) == 1);
+    assert(forest_vertex_degree(f, 42) == 0);
+    
+    hif_vertex_t query[] = {1,2};
+    int count;
+    Node **results = find_all_supersets(f, query, 2, &count);
+    assert(count == 4);
+    free(results);
+    
+    results = find_containing_vertices(f, query, 2, &count);
+    assert(count == 4);
+    free(results);
+    
+    hif_vertex_t sub_query[] = {1,2,3,6,7};
+    results = find_all_subsets(f, sub_query, 5, &count);
+    assert(count == 4);  // {1}, {1,2}, {1,2,3}, {6,7}
+    free(results);
+    
+    Node *minimal = find_minimal_superset(f, query, 2);
+    assert(minimal && minimal->he.nverts == 2);
+    Node *heaviest = find_heaviest_superset(f, query, 2);
+    assert(heaviest && heaviest->he.weight == 5.0);
+    
+    hif_vertex_t missing[] = {1,99};
+    assert(find_heaviest_superset(f, missing, 2) == NULL);
+    
+    // Pruning must drop removed nodes from the posting lists
+    int removed = forest_prune_by_weight(f, 3.0);
+    assert(removed == 3);
+    assert(forest_vertex_degree(f, 1) == 3);
+    assert(forest_vertex_degree(f, 6) == 0);
+    results = find_all_supersets(f, query, 2, &count);
+    assert(count == 3);
+    free(results);
+    
+    // Rebalance keeps node identities, so the index stays valid
+    forest_rebalance(f);
+    results = find_all_supersets(f, query, 2, &count);
+    assert(count == 3);
+    free(results);
+    
+    forest_disable_vertex_index(f);
+    assert(forest_vertex_degree(f, 1) == -1);
+    results = find_all_supersets(f, query, 2, &count);
+    assert(count == 3);
+    free(results);
+    
+    forest_free(f);
+    TEST_PASSED("vertex_index_queries");
+}
+
+// ========== TEST 8: Arena Allocation ==========
+
+void test_arena_forest() {
+    printf("\n=== TEST 19: Arena-Backed Forest ===\n");
+    Forest *plain = forest_create();
+    Forest *arena = forest_create_with_arena(4096);  // small slabs: exercise slab turnover
+    
+    assert(forest_arena_reserved(plain) == 0);
+    
+    srand(7);
+    for (int i = 0; i < 2000; i++) {
+        hif_vertex_t verts[40];
+        int n = (i % 97 == 0) ? 40 : 1 + rand() % 6;  // a few oversized edges
+        for (int j = 0; j < n; j++) verts[j] = rand() % 200;
+        double w = (double)(rand() % 500);
+        insert_hyperedge(plain, verts, n, w);
+        insert_hyperedge(arena, verts, n, w);
+    }
+    
+    assert(count_total_nodes(arena) == count_total_nodes(plain));
+    assert(forest_max_depth(arena) == forest_max_depth(plain));
+    assert(verify_forest(arena));
+    size_t reserved = forest_arena_reserved(arena);
+    assert(reserved > 0);
+    printf("Arena reserved %zu bytes for %d nodes\n", reserved, count_total_nodes(arena));
+    
+    // Pruning recycles blocks; reinserting must not grow the arena much
+    int removed_plain = forest_prune_by_weight(plain, 250.0);
+    int removed_arena = forest_prune_by_weight(arena, 250.0);
+    assert(removed_plain == removed_arena);
+    for (int i = 0; i < removed_arena; i++) {
+        hif_vertex_t verts[] = {i % 200, (i + 1) % 200};
+        insert_hyperedge(arena, verts, 2, 100.0);
+    }
+    assert(forest_arena_reserved(arena) <= reserved + 4 * 4096);
+    
+    forest_rebalance(arena);
+    assert(verify_forest(arena));
+    
+    // Serialization round-trips into a heap forest
+    assert(forest_save(arena, "/tmp/test_arena_forest.bin") == 0);
+    Forest *loaded = forest_load("/tmp/test_arena_forest.bin");
+    assert(loaded && count_total_nodes(loaded) == count_total_nodes(arena));
+    remove("/tmp/test_arena_forest.bin");
+    
+    forest_free(loaded);
+    forest_free(plain);
+    forest_free(arena);
+    TEST_PASSED("arena_forest");
+}
+
+// ========== TEST 9: Concurrent Readers ==========
+// Run under ThreadSanitizer with `make tsan` (Build System).
+
+typedef struct {
+    Forest *f;
+    int *stop;
+    long queries;
+    int violations;
+} ReaderArgs;
+
+static void *concurrent_reader(void *arg) {
+    ReaderArgs *ra = arg;
+    int slot = forest_reader_register(ra->f);
+    assert(slot >= 0);
+    hif_vertex_t query[] = {1};
+    while (!__atomic_load_n(ra->stop, __ATOMIC_RELAXED)) {
+        forest_read_begin(ra->f, slot);
+        int count;
+        Node **top = find_top_k_concurrent(ra->f, 20, &count);
+        for (int i = 1; i < count; i++)
+            if (top[i]->he.weight > top[i-1]->he.weight) ra->violations++;
+        free(top);
+        Node *best = find_heaviest_superset_concurrent(ra->f, query, 1);
+        if (best && best->he.verts[0] != 1) ra->violations++;
+        find_by_weight_threshold_concurrent(ra->f, 50.0);
+        forest_read_end(ra->f, slot);
+        ra->queries++;
+    }
+    forest_reader_unregister(ra->f, slot);
+    return NULL;
+}
+
+void test_concurrent_readers() {
+    printf("\n=== TEST 21: Concurrent Readers, Single Writer ===\n");
+    Forest *f = forest_create();
+    assert(forest_enable_concurrency(f, 8) == 0);
+    
+    int stop = 0;
+    enum { NREADERS = 4 };
+    pthread_t threads[NREADERS];
+    ReaderArgs args[NREADERS];
+    for (int t = 0; t < NREADERS; t++) {
+        args[t] = (ReaderArgs){ f, &stop, 0, 0 };
+        pthread_create(&threads[t], NULL, concurrent_reader, &args[t]);
+    }
+    
+    srand(5);
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 500; i++) {
+            hif_vertex_t verts[4];
+            int n = 1 + rand() % 4;
+            for (int j = 0; j < n; j++) verts[j] = 1 + rand() % 40;
+            insert_hyperedge(f, verts, n, (double)(rand() % 100));
+        }
+        forest_prune_by_weight(f, (double)(round % 5) * 10.0);
+        if (round % 7 == 6) forest_rebalance(f);
+    }
+    
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    long total_queries = 0;
+    for (int t = 0; t < NREADERS; t++) {
+        pthread_join(threads[t], NULL);
+        assert(args[t].violations == 0);
+        total_queries += args[t].queries;
+    }
+    printf("Readers completed %ld query rounds during ingest\n", total_queries);
+    assert(verify_forest(f));
+    
+    forest_free(f);
+    TEST_PASSED("concurrent_readers");
+}
+
+// ========== TEST 10: Parallel Queries ==========
+
+void test_parallel_queries() {
+    printf("\n=== TEST 22: Parallel Multi-Root Queries ===\n");
+    // A wide root with a big child list plus many small incomparable roots
+    int n = 4001;
+    Hyperedge *edges = malloc(sizeof(Hyperedge) * n);
+    edges[0].verts = malloc(sizeof(hif_vertex_t) * 200);
+    for (int i = 0; i < 200; i++) edges[0].verts[i] = i;
+    edges[0].nverts = 200;
+    edges[0].weight = 1000.0;
+    srand(3);
+    for (int i = 1; i < n; i++) {
+        int size = 1 + rand() % 5;
+        edges[i].verts = malloc(sizeof(hif_vertex_t) * size);
+        for (int j = 0; j < size; j++) edges[i].verts[j] = rand() % 400;
+        edges[i].nverts = size;
+        edges[i].weight = (double)(rand() % 900);
+    }
+    Forest *f = forest_build_bulk(edges, n);
+    for (int i = 0; i < n; i++) free(edges[i].verts);
+    free(edges);
+    
+    hif_vertex_t query[] = {7};
+    int serial_count, par_count, par1_count;
+    Node **serial = find_all_supersets(f, query, 1, &serial_count);
+    forest_set_threads(f, 4);
+    assert(forest_get_threads(f) == 4);
+    Node **par = find_all_supersets_parallel(f, query, 1, &par_count);
+    assert(par_count == serial_count);
+    assert(memcmp(serial, par, sizeof(Node*) * serial_count) == 0);  // same order
+    free(serial); free(par);
+    
+    serial = find_by_weight_range(f, 100.0, 300.0, &serial_count);
+    par = find_by_weight_range_parallel(f, 100.0, 300.0, &par_count);
+    assert(par_count == serial_count);
+    assert(memcmp(serial, par, sizeof(Node*) * serial_count) == 0);
+    free(serial); free(par);
+    
+    ForestStats st = get_forest_stats(f);
+    ForestStats pst = get_forest_stats_parallel(f);
+    assert(st.total_nodes == pst.total_nodes && st.max_depth == pst.max_depth);
+    assert(st.max_children == pst.max_children && st.min_weight == pst.min_weight);
+    assert(st.avg_weight - pst.avg_weight < 1e-9 && pst.avg_weight - st.avg_weight < 1e-9);
+    
+    hif_vertex_t sim_query[] = {1, 2, 3};
+    par = find_k_most_similar_parallel(f, sim_query, 3, 10, &par_count);
+    forest_set_threads(f, 1);
+    Node **par1 = find_k_most_similar_parallel(f, sim_query, 3, 10, &par1_count);
+    serial = find_k_most_similar(f, sim_query, 3, 10, &serial_count);
+    assert(par_count == 10 && par1_count == 10 && serial_count == 10);
+    assert(memcmp(par, par1, sizeof(Node*) * 10) == 0);  // thread-count independent
+    for (int i = 0; i < 10; i++) {
+        Node dummy = { .he = { sim_query, 3, 0.0 } };
+        assert(compute_overlap(par[i], &dummy) == compute_overlap(serial[i], &dummy));
+    }
+    free(par); free(par1); free(serial);
+    
+    printf("Roots: %d, nodes: %d, max children: %d\n",
+           pst.num_roots, pst.total_nodes, pst.max_children);
+    forest_free(f);
+    TEST_PASSED("parallel_queries");
+}
+
+// ========== TEST 11: Set Kernels ==========
+
+static int ref_overlap(const hif_vertex_t *a, int na, const hif_vertex_t *b, int nb) {
+    int i = 0, j = 0, c = 0;
+    while (i < na && j < nb) {
+        if (a[i] == b[j]) { c++; i++; j++; }
+        else if (a[i] < b[j]) i++;
+        else j++;
+    }
+    return c;
+}
+
+// Sorted, duplicate-free random set drawn from [0, range)
+static int random_set(hif_vertex_t *out, int n, int range) {
+    int c = 0;
+    for (int v = 0; v < range && c < n; v++)
+        if (rand() % range < n * 2) out[c++] = v;
+    return c;
+}
+
+void test_set_kernels() {
+    printf("\n=== TEST 25: Vector Set Kernels ===\n");
+    static const HifSetKernel kernels[] = {
+        HIF_KERNEL_SCALAR, HIF_KERNEL_SSE42, HIF_KERNEL_AVX2,
+        HIF_KERNEL_AVX512, HIF_KERNEL_NEON
+    };
+    printf("Auto-selected kernel: %s\n", hif_set_kernel_name());
+
+    hif_vertex_t a[600], b[12000];
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (hif_set_kernel(kernels[k]) != 0) continue;
+        srand(25);
+        int checked = 0;
+        for (int round = 0; round < 300; round++) {
+            int na = random_set(a, 1 + rand() % 600, 1200);
+            int nb = random_set(b, 1 + rand() % (round % 10 == 0 ? 12000 : 600),
+                                round % 10 == 0 ? 20000 : 1200);
+            if (na == 0 || nb == 0) continue;
+
+            // Overlap through the public ratio
+            Node na_n = { .he = { a, na, 0.0 } }, nb_n = { .he = { b, nb, 0.0 } };
+            int mn = na < nb ? na : nb;
+            double expect = (double)ref_overlap(a, na, b, nb) / mn;
+            double diff = compute_overlap(&na_n, &nb_n) - expect;
+            assert(diff < 1e-12 && diff > -1e-12);
+
+            // Subset: a sampled subset of b must be found, a perturbed one not
+            hif_vertex_t sub[600];
+            int ns = 0;
+            for (int i = 0; i < nb && ns < 600; i++)
+                if (rand() % 4 == 0) sub[ns++] = b[i];
+            if (ns == 0) continue;
+            Forest *f = forest_create();
+            insert_hyperedge(f, b, nb, 1.0);
+            int cnt;
+            Node **r = find_all_supersets(f, sub, ns, &cnt);
+            assert(cnt == 1);
+            free(r);
+            int gap = -1;
+            for (int i = 0; i + 1 < nb; i++)
+                if (b[i + 1] > b[i] + 1) { gap = b[i] + 1; break; }
+            if (gap >= 0) {
+                sub[ns / 2] = gap;
+                for (int i = ns / 2; i > 0 && sub[i] < sub[i - 1]; i--) {
+                    hif_vertex_t t = sub[i]; sub[i] = sub[i - 1]; sub[i - 1] = t;
+                }
+                for (int i = ns / 2; i + 1 < ns && sub[i] > sub[i + 1]; i++) {
+                    hif_vertex_t t = sub[i]; sub[i] = sub[i + 1]; sub[i + 1] = t;
+                }
+                int dup = 0;
+                for (int i = 0; i + 1 < ns; i++) dup |= sub[i] == sub[i + 1];
+                if (!dup) {
+                    r = find_all_supersets(f, sub, ns, &cnt);
+                    assert(cnt == 0);
+                    free(r);
+                }
+            }
+            forest_free(f);
+            checked++;
+        }
+        printf("%-7s %d pairs agree with the reference merge\n",
+               hif_set_kernel_name(), checked);
+    }
+    assert(hif_set_kernel(HIF_KERNEL_AUTO) == 0);
+    TEST_PASSED("set kernels");
+}
+
+// ========== TEST 12: Node Signatures ==========
+
+static int collect_visitor(Node *node, void *user_data) {
+    Node ***out = user_data;
+    *(*out)++ = node;
+    return 0;
+}
+
+static int brute_subset(const hif_vertex_t *a, int na, const hif_vertex_t *b, int nb) {
+    int j = 0;
+    for (int i = 0; i < na; i++) {
+        while (j < nb && b[j] < a[i]) j++;
+        if (j == nb || b[j] != a[i]) return 0;
+        j++;
+    }
+    return 1;
+}
+
+void test_signature_pruning() {
+    printf("\n=== TEST 26: Signature Pruning ===\n");
+    Forest *f = forest_create();
+    srand(26);
+    // Nested families inserted in shuffled weight order, so inserts steal
+    // subtrees and subtree summaries must follow the moves
+    for (int fam = 0; fam < 40; fam++) {
+        hif_vertex_t base[12];
+        for (int j = 0; j < 12; j++) base[j] = fam * 50 + j * 3 + rand() % 3;
+        for (int len = 1; len <= 12; len++)
+            insert_hyperedge(f, base, len, (double)(len * 7 + rand() % 40));
+    }
+    assert(verify_forest(f));
+
+    int total = count_total_nodes(f);
+    Node **all = malloc(sizeof(Node*) * total), **cursor = all;
+    forest_traverse_dfs(f, collect_visitor, &cursor);
+
+    for (int round = 0; round < 2; round++) {
+        for (int q = 0; q < 200; q++) {
+            hif_vertex_t query[20];
+            int nq = 0, start = rand() % 2000;
+            for (int v = start; v < start + 200 && nq < 20; v++)
+                if (rand() % 4 == 0) query[nq++] = v;
+            int cnt, expect = 0;
+            Node **sub = find_all_subsets(f, query, nq, &cnt);
+            for (int i = 0; i < total; i++)
+                expect += brute_subset(all[i]->he.verts, all[i]->he.nverts,
+                                       query, nq);
+            assert(cnt == expect);
+            free(sub);
+        }
+        forest_rebalance(f);   // second round: summaries rebuilt by bulk link
+    }
+
+    unsigned long long checks, rejects;
+    hif_signature_stats(&checks, &rejects, 1);
+    printf("Signature checks: %llu, rejected: %llu\n", checks, rejects);
+    free(all);
+    forest_free(f);
+    TEST_PASSED("signature pruning");
+}
+
+// ========== TEST 13: Streaming Similarity ==========
+
+static double ref_similarity(const hif_vertex_t *q, int nq, const Node *n, HifSimilarity m) {
+    int ov = ref_overlap(q, nq, n->he.verts, n->he.nverts);
+    int nn = n->he.nverts;
+    if (m == HIF_SIM_JACCARD) return nq + nn - ov > 0 ? (double)ov / (nq + nn - ov) : 0.0;
+    if (m == HIF_SIM_COSINE)  return nq && nn ? ov / sqrt((double)nq * nn) : 0.0;
+    int mn = nq < nn ? nq : nn;
+    return mn ? (double)ov / mn : 0.0;
+}
+
+void test_streaming_similarity() {
+    printf("\n=== TEST 27: Streaming Top-K Similarity ===\n");
+    Forest *f = forest_create();
+    srand(27);
+    for (int i = 0; i < 3000; i++) {
+        hif_vertex_t verts[10];
+        int n = 1 + rand() % 10;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 400;
+        insert_hyperedge(f, verts, n, (double)(rand() % 100));
+    }
+    int total = count_total_nodes(f);
+    Node **all = malloc(sizeof(Node*) * total), **cursor = all;
+    forest_traverse_dfs(f, collect_visitor, &cursor);   // pre-order
+
+    static const HifSimilarity metrics[] = { HIF_SIM_OVERLAP, HIF_SIM_JACCARD, HIF_SIM_COSINE };
+    double *ref = malloc(sizeof(double) * total);
+    for (int m = 0; m < 3; m++) {
+        for (int q = 0; q < 30; q++) {
+            hif_vertex_t query[8];
+            int nq = 0;
+            for (int v = rand() % 300; nq < 1 + q % 8; v += 1 + rand() % 20)
+                query[nq++] = v;
+            int k = 1 + q % 25, cnt;
+            double scores[25];
+            Node **res = find_k_most_similar_metric(f, query, nq, k, metrics[m],
+                                                    scores, &cnt);
+            assert(cnt == k);
+            for (int i = 0; i < total; i++)
+                ref[i] = ref_similarity(query, nq, all[i], metrics[m]);
+            // Expected: repeatedly the best remaining, earliest pre-order on ties
+            for (int r = 0; r < k; r++) {
+                int best = -1;
+                for (int i = 0; i < total; i++)
+                    if (ref[i] >= 0 && (best < 0 || ref[i] > ref[best])) best = i;
+                assert(res[r] == all[best]);
+                assert(scores[r] == ref[best]);
+                ref[best] = -1.0;
+            }
+            free(res);
+        }
+    }
+
+    // k larger than the forest returns every node
+    hif_vertex_t query[] = {1, 2, 3};
+    int cnt;
+    Node **res = find_k_most_similar(f, query, 3, total * 2, &cnt);
+    assert(cnt == total);
+    free(res);
+
+    printf("Checked 90 queries x 3 metrics against a full scan of %d nodes\n", total);
+    free(ref);
+    free(all);
+    forest_free(f);
+    TEST_PASSED("streaming similarity");
+}
+
+// ========== TEST 14: Indexed Root Heap ==========
+
+static void check_root_heap(Forest *f) {
+    assert(f->root_heap->size == f->nroots);
+    for (int i = 0; i < f->nroots; i++) assert(f->roots[i]->root_slot == i);
+    for (int j = 0; j < f->root_heap->size; j++) {
+        Node *n = f->root_heap->data[j];
+        assert(n->heap_slot == j);
+        if (j > 0) assert(f->root_heap->data[(j - 1) / 2]->he.weight >= n->he.weight);
+    }
+}
+
+void test_indexed_root_heap() {
+    printf("\n=== TEST 28: Indexed Root Heap ===\n");
+    Forest *f = forest_create();
+    const int n = 4000;
+    // Disjoint edges in non-increasing weight order: every one stays a
+    // root (a heavier edge would steal all lighter roots)
+    for (int i = 0; i < n; i++) {
+        hif_vertex_t verts[] = { 2 * i, 2 * i + 1 };
+        insert_hyperedge(f, verts, 2, (double)((n - i) / 3) * 2.5);
+    }
+    assert(f->nroots == n);
+    check_root_heap(f);
+    int roots_before = f->nroots;
+
+    // Prune removes roots from the middle of roots[] and the heap
+    int removed = forest_prune_by_weight(f, 1000.0);
+    check_root_heap(f);
+    assert(f->nroots + removed == roots_before);
+    for (int i = 0; i < f->nroots; i++) assert(f->roots[i]->he.weight >= 1000.0);
+
+    // One heavy edge steals every remaining root: n swap-removes
+    hif_vertex_t verts[] = { -1 };
+    double t0 = (double)clock();
+    insert_hyperedge(f, verts, 1, 1e9);
+    double ms = ((double)clock() - t0) * 1000.0 / CLOCKS_PER_SEC;
+    assert(f->nroots == 1);
+    check_root_heap(f);
+    assert(f->roots[0]->nchildren == roots_before - removed);
+    assert(f->roots[0]->root_slot == 0 && f->roots[0]->heap_slot == 0);
+    for (int i = 0; i < f->roots[0]->nchildren; i++) {
+        assert(f->roots[0]->children[i]->root_slot == -1);
+        assert(f->roots[0]->children[i]->heap_slot == -1);
+    }
+    printf("Stole %d roots in %.2f ms\n", f->roots[0]->nchildren, ms);
+
+    // Top-k still works from the heap seed
+    int count;
+    Node **top = find_top_k(f, 5, &count);
+    assert(count == 5 && top[0] == f->roots[0]);
+    for (int i = 1; i < count; i++) assert(top[i - 1]->he.weight >= top[i]->he.weight);
+    free(top);
+
+    forest_free(f);
+    TEST_PASSED("indexed root heap");
+}
+
+// ========== TEST 15: Deletion & Weight Update ==========
+
+typedef struct { hif_vertex_t verts[4]; int n; double w; int live; } RefEdge;
+
+/* Live reference edges whose (sorted) set equals verts */
+static int ref_matches(RefEdge *ref, int nref, const hif_vertex_t *verts, int n) {
+    int hits = 0;
+    for (int i = 0; i < nref; i++)
+        if (ref[i].live && ref[i].n == n &&
+            memcmp(ref[i].verts, verts, sizeof(hif_vertex_t) * n) == 0) hits++;
+    return hits;
+}
+
+static int cmp_double_desc(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x < y) - (x > y);
+}
+
+/* Forest weights must equal the live reference weights as a multiset */
+static void check_weights(Forest *f, RefEdge *ref, int nref) {
+    int count, live = 0;
+    Node **all = find_by_weight_range(f, -1e18, 1e18, &count);
+    double *got = malloc(sizeof(double) * (count + 1));
+    double *want = malloc(sizeof(double) * (nref + 1));
+    for (int i = 0; i < count; i++) got[i] = all[i]->he.weight;
+    for (int i = 0; i < nref; i++) if (ref[i].live) want[live++] = ref[i].w;
+    assert(count == live && count_total_nodes(f) == live);
+    qsort(got, count, sizeof(double), cmp_double_desc);
+    qsort(want, live, sizeof(double), cmp_double_desc);
+    for (int i = 0; i < live; i++) assert(got[i] == want[i]);
+    free(got); free(want); free(all);
+}
+
+void test_delete_update() {
+    printf("\n=== TEST 29: Hyperedge Deletion & Weight Update ===\n");
+    Forest *f = forest_create();
+    const int n = 600;
+    RefEdge *ref = malloc(sizeof(RefEdge) * (n + 1));
+    srand(29);
+    // Small sets over 8 vertices: many subsets and exact duplicates
+    for (int i = 0; i < n; i++) {
+        int k = 1 + rand() % 4, m = 0;
+        for (int v = 0; v < 8 && m < k; v++)
+            if (rand() % (8 - v) < k - m) ref[i].verts[m++] = v;
+        ref[i].n = m;
+        ref[i].w = (double)(rand() % 1000);
+        ref[i].live = 1;
+        insert_hyperedge(f, ref[i].verts, m, ref[i].w);
+    }
+    assert(verify_forest(f));
+
+    // Unordered / repeated input names the same canonical set
+    hif_vertex_t probe[] = { 3, 1, 3 }, canon[] = { 1, 3 };
+    int expect = ref_matches(ref, n, canon, 2);
+    assert(expect > 0);
+    assert(forest_update_weight(f, probe, 3, 2000.0) == expect);
+    for (int i = 0; i < n; i++)
+        if (ref[i].live && ref[i].n == 2 && ref[i].verts[0] == 1 && ref[i].verts[1] == 3)
+            ref[i].w = 2000.0;
+    assert(verify_forest(f));
+    check_root_heap(f);
+    check_weights(f, ref, n);
+
+    // Random deletes and re-weights (both directions) against the reference
+    for (int round = 0; round < 200; round++) {
+        RefEdge *e = &ref[rand() % n];
+        int hits = ref_matches(ref, n, e->verts, e->n);
+        if (round % 2 == 0) {
+            assert(forest_delete_hyperedge(f, e->verts, e->n) == hits);
+            for (int i = 0; i < n; i++)
+                if (ref_matches(&ref[i], 1, e->verts, e->n)) ref[i].live = 0;
+        } else {
+            double w = (double)(rand() % 1500);
+            assert(forest_update_weight(f, e->verts, e->n, w) == hits);
+            for (int i = 0; i < n; i++)
+                if (ref_matches(&ref[i], 1, e->verts, e->n)) ref[i].w = w;
+        }
+        assert(verify_forest(f));
+        check_root_heap(f);
+    }
+    check_weights(f, ref, n);
+
+    // Inserts and prunes after the set table exists keep it in sync
+    hif_vertex_t fresh[] = { 100, 101 };
+    insert_hyperedge(f, fresh, 2, 5.0);
+    assert(forest_update_weight(f, fresh, 2, 6.0) == 1);
+    forest_prune_by_weight(f, 10.0);
+    assert(forest_delete_hyperedge(f, fresh, 2) == 0);
+    assert(forest_update_weight(f, fresh, 2, 1.0) == 0);
+    assert(verify_forest(f));
+    check_root_heap(f);
+
+    // A node outgrowing its parent moves up to the nearest ancestor holding it
+    {
+        Forest *g = forest_create();
+        hif_vertex_t a[] = { 1, 2, 3, 4 }, b[] = { 1, 2, 3 }, c[] = { 1, 2 };
+        insert_hyperedge(g, a, 4, 100.0);
+        insert_hyperedge(g, b, 3, 50.0);
+        insert_hyperedge(g, c, 2, 20.0);
+        assert(g->nroots == 1 && g->roots[0]->nchildren == 1);
+        assert(forest_update_weight(g, c, 2, 70.0) == 1);
+        Node *top = g->roots[0];
+        // ...and, being heavier now, takes its old parent as a child
+        assert(g->nroots == 1 && top->nchildren == 1);
+        assert(top->children[0]->he.nverts == 2 && top->children[0]->nchildren == 1);
+        assert(verify_forest(g));
+        check_root_heap(g);
+        // Outgrowing every ancestor still ends at the roots
+        assert(forest_update_weight(g, b, 3, 500.0) == 1);
+        assert(g->nroots == 1 && g->roots[0]->he.nverts == 3);
+        assert(verify_forest(g));
+        check_root_heap(g);
+        forest_free(g);
+    }
+
+    // Deleting everything leaves an empty forest
+    for (int i = 0; i < n; i++) forest_delete_hyperedge(f, ref[i].verts, ref[i].n);
+    assert(f->nroots == 0 && count_total_nodes(f) == 0);
+
+    free(ref);
+    forest_free(f);
+    TEST_PASSED("deletion & weight update");
+}
+
+// ========== TEST 16: Insert-Time Dedup ==========
+
+void test_dedup_policies() {
+    printf("\n=== TEST 30: Insert-Time Dedup & Linear Merge ===\n");
+    HifDedupPolicy policies[] = { HIF_DEDUP_MAX, HIF_DEDUP_SUM, HIF_DEDUP_AVG,
+                                  HIF_DEDUP_LAST };
+    double expect[] = { 7.0, 15.0, 5.0, 3.0 };
+    for (int p = 0; p < 4; p++) {
+        Forest *f = forest_create();
+        hif_vertex_t big[] = { 1, 2, 3, 4, 5 };
+        insert_hyperedge(f, big, 5, 6.0);
+        forest_set_dedup(f, policies[p]);
+        hif_vertex_t a[] = { 1, 2, 3 }, b[] = { 3, 2, 1, 2 }, c[] = { 2, 3, 1 };
+        insert_hyperedge(f, a, 3, 5.0);
+        insert_hyperedge(f, b, 4, 7.0);
+        insert_hyperedge(f, c, 3, 3.0);
+        assert(count_total_nodes(f) == 2);
+        assert(verify_forest(f));
+        Node *dup = find_minimal_superset(f, a, 3);
+        assert(dup && dup->he.nverts == 3 && dup->he.weight == expect[p]);
+        assert(dup->dup_count == 3);
+        forest_free(f);
+    }
+
+    // Linear offline merge: many copies of few sets, no rebalance
+    Forest *f = forest_create();
+    const int distinct = 500, copies = 40;
+    double *maxw = calloc(distinct, sizeof(double));
+    srand(30);
+    for (int r = 0; r < copies; r++) {
+        for (int i = 0; i < distinct; i++) {
+            hif_vertex_t verts[] = { i % 50, 50 + i / 50, 100 + (i * 7) % 13 };
+            double w = (double)(rand() % 10000);
+            if (w > maxw[i]) maxw[i] = w;
+            insert_hyperedge(f, verts, 3, w);
+        }
+    }
+    assert(count_total_nodes(f) == distinct * copies);
+    double t0 = (double)clock();
+    int merged = forest_merge_duplicates(f, 1);
+    double ms = ((double)clock() - t0) * 1000.0 / CLOCKS_PER_SEC;
+    printf("Merged %d duplicates in %.2f ms\n", merged, ms);
+    assert(merged == distinct * (copies - 1));
+    assert(count_total_nodes(f) == distinct);
+    assert(verify_forest(f));
+    int count;
+    Node **all = find_by_weight_range(f, -1.0, 1e9, &count);
+    assert(count == distinct);
+    for (int i = 0; i < count; i++) {
+        // verts = { i % 50, 50 + i / 50, ... } identifies the set
+        int id = all[i]->he.verts[0] + 50 * (all[i]->he.verts[1] - 50);
+        assert(all[i]->he.weight == maxw[id] && all[i]->dup_count == copies);
+    }
+    free(all);
+    assert(forest_merge_duplicates(f, 1) == 0);
+
+    free(maxw);
+    forest_free(f);
+    TEST_PASSED("insert-time dedup");
+}
+
+// ========== TEST 17: Streaming Ingest ==========
+
+static double total_weight(Forest *f) {
+    int count;
+    double sum = 0.0;
+    Node **all = find_by_weight_range(f, -1e18, 1e18, &count);
+    for (int i = 0; i < count; i++) sum += all[i]->he.weight;
+    free(all);
+    return sum;
+}
+
+void test_streaming_ingest() {
+    printf("\n=== TEST 31: Streaming Ingest Buffer ===\n");
+    Forest *direct = forest_create();
+    Forest *f = forest_create();
+    IngestBuffer *b = forest_ingest_create(f, 1000, 0.0, 4);
+    const int n = 10000;
+    srand(31);
+    int applied = 0;
+    for (int i = 0; i < n; i++) {
+        // unsorted with repeats: the buffer normalizes in place
+        hif_vertex_t verts[6];
+        int k = 1 + rand() % 6;
+        for (int j = 0; j < k; j++) verts[j] = rand() % 40;
+        double w = (double)(rand() % 5000);
+        insert_hyperedge(direct, verts, k, w);
+        applied += forest_ingest_push(b, verts, k, w);
+    }
+    IngestStats st = forest_ingest_get_stats(b);
+    assert(st.pushed == (unsigned long long)n && st.size_flushes == 9);
+    assert(st.stalled_pushes == 9 && applied == 9000 && st.pending == 1000);
+    assert(count_total_nodes(f) == 9000);
+    assert(forest_ingest_flush(b) == 1000);
+    st = forest_ingest_get_stats(b);
+    assert(st.applied == (unsigned long long)n && st.batches == 10);
+    assert(st.pending == 0 && st.max_batch == 1000);
+    printf("%llu batches, %.2f ms flushing, %.2f ms stalled\n",
+           st.batches, st.flush_ms, st.stall_ms);
+
+    assert(verify_forest(f));
+    assert(count_total_nodes(f) == count_total_nodes(direct));
+    assert(total_weight(f) == total_weight(direct));
+    forest_ingest_destroy(b);
+
+    // Time trigger, and dedup applies to flushed events
+    Forest *g = forest_create();
+    forest_set_dedup(g, HIF_DEDUP_SUM);
+    b = forest_ingest_create(g, 0, 2.0, 1);
+    hif_vertex_t e1[] = { 5, 4 }, e2[] = { 4, 5, 5 };
+    forest_ingest_push(b, e1, 2, 1.0);
+    forest_ingest_push(b, e2, 3, 2.0);
+    clock_t t0 = clock();
+    while ((double)(clock() - t0) * 1000.0 / CLOCKS_PER_SEC < 5.0) {}
+    assert(forest_ingest_poll(b) == 2);
+    assert(forest_ingest_get_stats(b).time_flushes == 1);
+    assert(count_total_nodes(g) == 1 && g->roots[0]->he.weight == 3.0);
+    forest_ingest_destroy(b);
+
+    forest_free(g);
+    forest_free(f);
+    forest_free(direct);
+    TEST_PASSED("streaming ingest");
+}
+
+// ========== TEST 18: Metrics ==========
+
+void test_metrics() {
+    printf("\n=== TEST 32: Hot-Path Metrics ===\n");
+    Forest *f = forest_create();
+    forest_reset_metrics(f);
+    // Decreasing-weight nested chain: edge i lands at depth i
+    const int n = 200;
+    hif_vertex_t verts[200];
+    for (int i = 0; i < n; i++) verts[i] = i;
+    for (int i = 0; i < n; i++) insert_hyperedge(f, verts, n - i, (double)(n - i));
+    hif_vertex_t q[] = { 0 };
+    int count;
+    free(find_all_supersets(f, q, 1, &count));
+    assert(count == n);
+    // One heavy edge steals the single root
+    hif_vertex_t big[] = { -1, -2 };
+    insert_hyperedge(f, big, 2, 1e6);
+
+    ForestMetrics m = forest_get_metrics(f);
+    assert(m.nroots == f->nroots);
+    if (!hif_metrics_enabled()) {
+        assert(m.inserts == 0 && m.queries == 0 && m.visited == 0);
+        printf("Built without HIF_METRICS: counters read 0\n");
+    } else {
+        unsigned long long hist = 0, samples = 0;
+        for (int b = 0; b < HIF_HIST_BUCKETS; b++) {
+            hist    += m.depth_hist[b];
+            samples += m.insert_ns_hist[b];
+        }
+        assert(m.inserts == (unsigned long long)n + 1 && hist == m.inserts);
+        assert(m.max_insert_depth == n - 1 && m.deep_inserts == 100);
+        assert(m.insert_samples == samples && samples == (m.inserts + 63) / 64);
+        assert(m.steals == 1 && m.root_heap_ops >= 3 && m.alloc_bytes > 0);
+        assert(m.queries == 1 && m.visited >= (unsigned long long)n);
+        assert(m.max_visited == m.visited && m.subset_calls > 0);
+        assert(m.elements_compared > 0 && m.sig_checks > 0);
+        printf("%llu inserts, max depth %d, %llu nodes visited\n",
+               m.inserts, m.max_insert_depth, m.visited);
+    }
+    forest_reset_metrics(f);
+    m = forest_get_metrics(f);
+    assert(m.inserts == 0 && m.visited == 0 && m.subset_calls == 0);
+
+    forest_free(f);
+    TEST_PASSED("metrics");
+}
+
+// ========== TEST 19: Subtree Aggregates ==========
+
+typedef struct { int size, height, maxdeg; double wmin, wsum; } Agg;
+
+/* Recompute every node's aggregates from scratch and compare */
+static Agg check_aggregates(Node *nd) {
+    Agg a = { 1, 1, nd->nchildren, nd->he.weight, nd->he.weight };
+    for (int i = 0; i < nd->nchildren; i++) {
+        Agg c = check_aggregates(nd->children[i]);
+        a.size += c.size;
+        if (c.height + 1 > a.height) a.height = c.height + 1;
+        if (c.maxdeg > a.maxdeg) a.maxdeg = c.maxdeg;
+        if (c.wmin < a.wmin) a.wmin = c.wmin;
+        a.wsum += c.wsum;
+    }
+    assert(nd->sub_size == a.size && nd->sub_height == a.height);
+    assert(nd->sub_maxdeg == a.maxdeg && nd->sub_wmin == a.wmin);
+    assert(fabs(nd->sub_wsum - a.wsum) <= 1e-9 * (1.0 + fabs(a.wsum)));
+    return a;
+}
+
+static void check_forest_aggregates(Forest *f) {
+    Agg t = { 0, 0, 0, 0.0, 0.0 };
+    for (int i = 0; i < f->nroots; i++) {
+        Agg r = check_aggregates(f->roots[i]);
+        if (i == 0 || r.wmin < t.wmin) t.wmin = r.wmin;
+        t.size += r.size;
+        t.wsum += r.wsum;
+        if (r.height > t.height) t.height = r.height;
+        if (r.maxdeg > t.maxdeg) t.maxdeg = r.maxdeg;
+    }
+    ForestStats st = get_forest_stats(f);
+    assert(st.total_nodes == t.size && count_total_nodes(f) == t.size);
+    assert(st.max_depth == t.height && forest_max_depth(f) == t.height);
+    assert(st.max_children == t.maxdeg && st.num_roots == f->nroots);
+    if (t.size > 0) {
+        assert(st.min_weight == t.wmin && forest_min_weight(f) == t.wmin);
+        assert(fabs(st.avg_weight - t.wsum / t.size) <= 1e-9 * (1.0 + fabs(st.avg_weight)));
+    }
+}
+
+void test_subtree_aggregates() {
+    printf("\n=== TEST 33: Incremental Subtree Aggregates ===\n");
+    Forest *f = forest_create();
+    srand(33);
+    hif_vertex_t sets[400][5];
+    int sizes[400];
+    for (int i = 0; i < 400; i++) {
+        sizes[i] = 1 + rand() % 5;
+        for (int j = 0; j < sizes[i]; j++) sets[i][j] = rand() % 10;
+        insert_hyperedge(f, sets[i], sizes[i], (double)(rand() % 500));
+    }
+    check_forest_aggregates(f);
+
+    for (int round = 0; round < 100; round++) {
+        int i = rand() % 400;
+        switch (round % 4) {
+        case 0: forest_delete_hyperedge(f, sets[i], sizes[i]); break;
+        case 1: forest_update_weight(f, sets[i], sizes[i], (double)(rand() % 800)); break;
+        case 2: forest_update_weight(f, sets[i], sizes[i], (double)(rand() % 50)); break;
+        case 3: insert_hyperedge(f, sets[i], sizes[i], (double)(rand() % 800)); break;
+        }
+        check_forest_aggregates(f);
+    }
+
+    forest_prune_by_weight(f, 40.0);
+    check_forest_aggregates(f);
+    forest_merge_duplicates(f, 0);
+    check_forest_aggregates(f);
+    forest_rebalance(f);
+    check_forest_aggregates(f);
+
+    assert(forest_save(f, "/tmp/test_aggregates.bin") == 0);
+    Forest *g = forest_load("/tmp/test_aggregates.bin");
+    remove("/tmp/test_aggregates.bin");
+    assert(g && count_total_nodes(g) == count_total_nodes(f));
+    check_forest_aggregates(g);
+    forest_free(g);
+
+    // Stats on a large forest without a traversal
+    Forest *big = forest_create();
+    for (int i = 0; i < 50000; i++) {
+        hif_vertex_t verts[] = { i % 1000, 1000 + i % 7 };
+        insert_hyperedge(big, verts, 2, (double)(i % 97));
+    }
+    double t0 = (double)clock();
+    ForestStats st;
+    for (int i = 0; i < 1000; i++) st = get_forest_stats(big);
+    double ms = ((double)clock() - t0) * 1000.0 / CLOCKS_PER_SEC;
+    printf("1000 x get_forest_stats over %d nodes / %d roots: %.2f ms\n",
+           st.total_nodes, st.num_roots, ms);
+    assert(st.total_nodes == 50000);
+    check_forest_aggregates(big);
+    forest_free(big);
+
+    forest_free(f);
+    TEST_PASSED("subtree aggregates");
+}
+
+// ========== TEST 20: Order Statistics ==========
+
+void test_order_statistics() {
+    printf("\n=== TEST 34: Range Counts & Rank Queries ===\n");
+    Forest *f = forest_create();
+    double dummy;
+    assert(forest_kth_heaviest_weight(f, 1, &dummy) == -1);
+    assert(forest_weight_percentile(f, 1.0) == 0.0);
+
+    srand(34);
+    for (int i = 0; i < 3000; i++) {
+        hif_vertex_t verts[4];
+        int n = 1 + rand() % 4;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 40;
+        // few distinct weights (ties) plus a spread including negatives
+        double w = (i % 3 == 0) ? (double)(rand() % 8)
+                                : (rand() % 20000) / 7.0 - 500.0;
+        insert_hyperedge(f, verts, n, w);
+    }
+    int total = count_total_nodes(f);
+    int nref;
+    Node **all = find_top_k(f, total, &nref);
+    assert(nref == total);
+    double *ref = malloc(sizeof(double) * total);
+    for (int i = 0; i < total; i++) ref[i] = all[i]->he.weight;
+    free(all);
+    qsort(ref, total, sizeof(double), cmp_double_desc);
+
+    // Range counts agree with materialized ranges
+    double bounds[][2] = { {0, 7}, {-500, 2357}, {3.0, 3.0}, {100, 50},
+                           {-1e9, 1e9}, {1500.5, 1800.25} };
+    for (int b = 0; b < 6; b++) {
+        int n;
+        Node **r = find_by_weight_range(f, bounds[b][0], bounds[b][1], &n);
+        free(r);
+        assert(forest_count_by_weight_range(f, bounds[b][0], bounds[b][1]) == n);
+    }
+    assert(find_by_weight_threshold(f, 5.0) ==
+           forest_count_by_weight_range(f, 5.0, INFINITY));
+
+    // k-th heaviest matches the sorted reference at every rank
+    for (int k = 1; k <= total; k++) {
+        double w;
+        assert(forest_kth_heaviest_weight(f, k, &w) == 0);
+        assert(w == ref[k - 1]);
+    }
+    assert(forest_kth_heaviest_weight(f, 0, &dummy) == -1);
+    assert(forest_kth_heaviest_weight(f, total + 1, &dummy) == -1);
+
+    // Percentile = share of weights <= w
+    for (int i = 0; i < total; i += 97) {
+        int below = 0;
+        for (int j = 0; j < total; j++) below += ref[j] <= ref[i];
+        assert(fabs(forest_weight_percentile(f, ref[i]) -
+                    100.0 * below / total) < 1e-9);
+    }
+    assert(forest_weight_percentile(f, ref[0]) == 100.0);
+    assert(forest_weight_percentile(f, ref[total - 1] - 1.0) == 0.0);
+
+    // A median survives deletes and reweights
+    hif_vertex_t verts[] = {1, 2};
+    insert_hyperedge(f, verts, 2, 1e6);
+    double w;
+    assert(forest_kth_heaviest_weight(f, 1, &w) == 0 && w == 1e6);
+    forest_update_weight(f, verts, 2, -1e6);
+    assert(forest_kth_heaviest_weight(f, count_total_nodes(f), &w) == 0 && w == -1e6);
+    printf("median weight of %d edges: %.3f\n", total, ref[total / 2]);
+
+    free(ref);
+    forest_free(f);
+    TEST_PASSED("order statistics");
+}
+
+// ========== TEST 21: Weight-Order Iterator ==========
+
+static int stop_after_5(Node *node, void *user_data) {
+    double *last = user_data;
+    assert(node->he.weight <= *last);
+    *last = node->he.weight;
+    return ++visit_count >= 5;
+}
+
+void test_weight_iterator() {
+    printf("\n=== TEST 35: Resumable Weight-Order Iterator ===\n");
+    Forest *f = forest_create();
+    WeightIter *it = forest_weight_iter_begin(f);
+    assert(forest_weight_iter_next(it) == NULL);
+    forest_weight_iter_end(it);
+
+    srand(35);
+    for (int i = 0; i < 5000; i++) {
+        hif_vertex_t verts[3];
+        int n = 1 + rand() % 3;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 300;
+        insert_hyperedge(f, verts, n, (double)(rand() % 1000));
+    }
+    int total = count_total_nodes(f);
+
+    // Pages of 100 reproduce find_top_k order, weight by weight
+    int nref;
+    Node **ref = find_top_k(f, total, &nref);
+    assert(nref == total);
+    for (int i = 1; i < total; i++) assert(ref[i - 1]->he.weight >= ref[i]->he.weight);
+
+    it = forest_weight_iter_begin(f);
+    Node *page[100];
+    int seen = 0, n;
+    while ((n = forest_weight_iter_next_n(it, page, 100)) > 0) {
+        for (int i = 0; i < n; i++)
+            assert(page[i]->he.weight == ref[seen + i]->he.weight);
+        seen += n;
+        if (n < 100) break;
+    }
+    assert(seen == total);
+    assert(forest_weight_iter_next(it) == NULL);
+    forest_weight_iter_end(it);
+
+    // Every node exactly once
+    it = forest_weight_iter_begin(f);
+    Node **got = malloc(sizeof(Node*) * total);
+    for (int i = 0; i < total; i++) assert((got[i] = forest_weight_iter_next(it)));
+    assert(forest_weight_iter_next(it) == NULL);
+    forest_weight_iter_end(it);
+    for (int i = 0; i < total; i++) {
+        int hits = 0;
+        for (int j = 0; j < total; j++) hits += got[j] == ref[i];
+        assert(hits == 1);
+    }
+    free(got);
+    free(ref);
+
+    // Early stop in the visitor form
+    double last = INFINITY;
+    visit_count = 0;
+    forest_traverse_by_weight(f, stop_after_5, &last);
+    assert(visit_count == 5 && last <= forest_max_weight(f));
+
+    forest_free(f);
+    TEST_PASSED("weight iterator");
+}
+
+// ========== TEST 22: Compressed Vertex Sets ==========
+
+static int brute_intersect(const hif_vertex_t *a, int na, const hif_vertex_t *b, int nb) {
+    int c = 0;
+    for (int i = 0; i < na; i++)
+        for (int j = 0; j < nb; j++) c += a[i] == b[j];
+    return c;
+}
+
+static int cmp_vertex(const void *a, const void *b) {
+    hif_vertex_t x = *(const hif_vertex_t *)a, y = *(const hif_vertex_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int sorted_unique(hif_vertex_t *v, int n) {
+    qsort(v, n, sizeof(hif_vertex_t), cmp_vertex);
+    int m = 0;
+    for (int i = 0; i < n; i++) if (m == 0 || v[m - 1] != v[i]) v[m++] = v[i];
+    return m;
+}
+
+void test_compressed_vertex_sets() {
+    printf("\n=== TEST 36: Compressed Vertex Sets ===\n");
+    srand(36);
+
+    // Codec round trip and kernels against brute force, extremes included
+    for (int round = 0; round < 300; round++) {
+        hif_vertex_t a[64], b[64];
+        int na = rand() % 64, nb = rand() % 64;
+        for (int i = 0; i < na; i++) a[i] = rand() % 100 - 50;
+        for (int i = 0; i < nb; i++) b[i] = rand() % 100 - 50;
+        if (round % 10 == 0 && na > 1) { a[0] = HIF_VERTEX_MIN; a[1] = HIF_VERTEX_MAX; }
+        na = sorted_unique(a, na);
+        nb = sorted_unique(b, nb);
+
+        uint8_t enc[64 * 10];
+        hif_vertex_t dec[64];
+        size_t bytes = hif_vbyte_encode(a, na, enc);
+        assert(bytes <= hif_vbyte_bound(na));
+        assert(hif_vbyte_decode(enc, na, dec) == bytes);
+        assert(na == 0 || memcmp(a, dec, sizeof(hif_vertex_t) * na) == 0);
+
+        int inter = brute_intersect(a, na, b, nb);
+        assert(hif_vbyte_intersect_count(enc, na, b, nb) == inter);
+        assert(hif_vbyte_within(enc, na, b, nb) == (inter == na));
+        assert(hif_vbyte_contains(enc, na, b, nb) == (inter == nb));
+        int half = na / 2;
+        assert(hif_vbyte_contains(enc, na, a + half, na - half));
+    }
+
+    Forest *f = forest_create();
+    for (int i = 0; i < 2000; i++) {
+        hif_vertex_t verts[12];
+        int n = 1 + rand() % 12, base = rand() % 5000;
+        for (int j = 0; j < n; j++) verts[j] = base + rand() % 64;
+        insert_hyperedge(f, verts, n, (double)(rand() % 1000));
+    }
+    hif_vertex_t top[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    insert_hyperedge(f, top, 16, 5000.0);
+    insert_hyperedge(f, top, 8, 4000.0);   // nested: stored relative to parent
+    insert_hyperedge(f, top + 4, 4, 3000.0);
+
+    // forest_save format 2 round-trips to an identical tree
+    assert(forest_save(f, "/tmp/test_vbyte.bin") == 0);
+    FILE *fp = fopen("/tmp/test_vbyte.bin", "rb");
+    fseek(fp, 0, SEEK_END);
+    long saved = ftell(fp);
+    fclose(fp);
+    Forest *g = forest_load("/tmp/test_vbyte.bin");
+    assert(g != NULL);
+    FlatForest *a = forest_freeze(f), *b = forest_freeze(g);
+    assert(a->image_size == b->image_size &&
+           memcmp(a->image, b->image, a->image_size) == 0);
+    flat_forest_close(b);
+    forest_free(g);
+    long raw = 8;
+    for (uint64_t id = 0; id < a->nnodes; id++) raw += 16 + 4 * (long)a->nverts[id];
+    printf("forest_save: %ld bytes (%ld with raw int arrays)\n", saved, raw);
+    assert(saved < raw);
+
+    // A truncated file is rejected; an original-format file still loads
+    char *bytes = malloc(saved);
+    fp = fopen("/tmp/test_vbyte.bin", "rb");
+    assert(fread(bytes, 1, saved, fp) == (size_t)saved);
+    fclose(fp);
+    fp = fopen("/tmp/test_vbyte.bin", "wb");
+    fwrite(bytes, 1, saved / 2, fp);
+    fclose(fp);
+    free(bytes);
+    assert(forest_load("/tmp/test_vbyte.bin") == NULL);
+    fp = fopen("/tmp/test_vbyte.bin", "wb");
+    int legacy_hdr[] = {1, 3, 2, 5, 9};
+    double legacy_w = 7.5;
+    int legacy_kids = 0;
+    fwrite(legacy_hdr, sizeof(int), 5, fp);
+    fwrite(&legacy_w, sizeof(double), 1, fp);
+    fwrite(&legacy_kids, sizeof(int), 1, fp);
+    fclose(fp);
+    g = forest_load("/tmp/test_vbyte.bin");
+    assert(g && count_total_nodes(g) == 1 && g->roots[0]->he.nverts == 3);
+    assert(g->roots[0]->he.verts[2] == 9 && g->roots[0]->he.weight == 7.5);
+    forest_free(g);
+    remove("/tmp/test_vbyte.bin");
+
+    // Compressed snapshot: same answers as the plain one, smaller image
+    FlatForest *c = forest_freeze_compressed(f);
+    assert(c && c->vbyte_pool && !c->vertex_pool && flat_forest_verify(c));
+    printf("flat image: %zu bytes compressed, %zu plain\n",
+           c->image_size, a->image_size);
+    assert(c->image_size < a->image_size);
+    hif_vertex_t buf[64];
+    int nv;
+    assert(flat_node_verts(c, 0, &nv) == NULL);
+    for (uint64_t id = 0; id < a->nnodes; id++) {
+        int n = flat_node_decode(c, (uint32_t)id, buf);
+        const hif_vertex_t *v = flat_node_verts(a, (uint32_t)id, &nv);
+        assert(n == nv && memcmp(buf, v, sizeof(hif_vertex_t) * n) == 0);
+    }
+    for (int q = 0; q < 40; q++) {
+        hif_vertex_t query[6];
+        int nq = 1 + rand() % 3;
+        if (q < 10) { for (int j = 0; j < nq; j++) query[j] = 2 * j + q % 3; }
+        else { for (int j = 0; j < nq; j++) query[j] = rand() % 5000; }
+        nq = sorted_unique(query, nq);
+        int n1, n2;
+        uint32_t *r1 = flat_find_all_supersets(a, query, nq, &n1);
+        uint32_t *r2 = flat_find_all_supersets(c, query, nq, &n2);
+        assert(n1 == n2 && (n1 == 0 || memcmp(r1, r2, sizeof(uint32_t) * n1) == 0));
+        free(r1); free(r2);
+        assert(flat_find_heaviest_superset(a, query, nq) ==
+               flat_find_heaviest_superset(c, query, nq));
+        r1 = flat_find_all_subsets(a, query, nq, &n1);
+        r2 = flat_find_all_subsets(c, query, nq, &n2);
+        assert(n1 == n2 && (n1 == 0 || memcmp(r1, r2, sizeof(uint32_t) * n1) == 0));
+        free(r1); free(r2);
+        r1 = flat_find_k_most_similar(a, query, nq, 10, &n1);
+        r2 = flat_find_k_most_similar(c, query, nq, 10, &n2);
+        assert(n1 == n2 && memcmp(r1, r2, sizeof(uint32_t) * n1) == 0);
+        free(r1); free(r2);
+    }
+    hif_vertex_t sup[] = {4, 5};
+    assert(flat_find_minimal_superset(c, sup, 2) >= 0);
+
+    // ... and it maps back from disk
+    assert(flat_forest_save(c, "/tmp/test_vbyte.flat") == 0);
+    FlatForest *m = flat_forest_open("/tmp/test_vbyte.flat");
+    assert(m && m->mapped && m->vbyte_pool && flat_forest_verify(m));
+    assert(memcmp(m->image, c->image, c->image_size) == 0);
+    flat_forest_close(m);
+    remove("/tmp/test_vbyte.flat");
+
+    flat_forest_close(c);
+    flat_forest_close(a);
+    forest_free(f);
+    TEST_PASSED("compressed vertex sets");
+}
+
+// ========== TEST 23: Deep Chains ==========
+
+void test_deep_chain() {
+    printf("\n=== TEST 37: Deep Chains Without Recursion ===\n");
+    // Same set, rising weights: every insert steals the previous root,
+    // so the forest is a single chain far deeper than any C stack.
+    const int depth = 300000;
+    Forest *f = forest_create();
+    hif_vertex_t verts[] = {1, 2};
+    for (int i = 0; i < depth; i++) insert_hyperedge(f, verts, 2, (double)i);
+    assert(f->nroots == 1 && forest_max_depth(f) == depth);
+    assert(verify_forest(f));
+
+    // Lighter than everything: descends the whole chain
+    insert_hyperedge(f, verts, 2, -1.0);
+    hif_vertex_t single[] = {1};
+    assert(forest_max_depth(f) == depth + 1);
+
+    int n;
+    Node **r = find_all_supersets(f, single, 1, &n);
+    assert(n == depth + 1 && r[0]->he.weight == depth - 1 && r[n - 1]->he.weight == -1.0);
+    free(r);
+    r = find_all_subsets(f, verts, 2, &n);
+    assert(n == depth + 1);
+    free(r);
+    r = find_by_weight_range(f, 10.0, 19.0, &n);
+    assert(n == 10);
+    free(r);
+    r = get_clusters_by_weight(f, depth - 100.0, &n);
+    assert(n == 100);
+    free(r);
+    assert(find_minimal_superset(f, single, 1) != NULL);
+    assert(find_heaviest_superset(f, single, 1)->he.weight == depth - 1);
+    assert(find_by_weight_threshold(f, 0.0) == depth);
+    int sk;
+    r = find_k_most_similar(f, verts, 2, 3, &sk);
+    assert(sk == 3);
+    free(r);
+
+    visit_count = 0;
+    forest_traverse_dfs(f, test_visitor, NULL);
+    assert(visit_count == depth + 1);
+
+    assert(forest_save(f, "/tmp/test_chain.bin") == 0);
+    Forest *g = forest_load("/tmp/test_chain.bin");
+    remove("/tmp/test_chain.bin");
+    assert(g && forest_max_depth(g) == depth + 1 && verify_forest(g));
+    forest_free(g);
+
+    assert(forest_prune_by_weight(f, depth / 2.0) == depth / 2 + 1);
+    assert(forest_max_depth(f) == depth / 2 && verify_forest(f));
+    forest_free(f);
+    TEST_PASSED("deep chain");
+}
+
+// ========== TEST 24: Caller-Owned Results ==========
+
+static int same_nodes(Node **a, int na, Node **b, int nb) {
+    if (na != nb) return 0;
+    for (int i = 0; i < na; i++) if (a[i] != b[i]) return 0;
+    return 1;
+}
+
+void test_result_buffers() {
+    printf("\n=== TEST 38: Caller-Owned Result Buffers ===\n");
+    Forest *f = forest_create();
+    srand(38);
+    for (int i = 0; i < 500; i++) {
+        hif_vertex_t verts[8];
+        int n = 1 + rand() % 8;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 24;
+        insert_hyperedge(f, verts, n, (double)(rand() % 1000));
+    }
+    hif_vertex_t q1[] = {3}, q2[] = {1, 2, 3, 5, 8, 13, 21};
+
+    NodeBuffer buf;
+    node_buffer_init(&buf);
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) forest_enable_vertex_index(f);
+        int n;
+        Node **r = find_all_supersets(f, q1, 1, &n);
+        assert(find_all_supersets_into(f, q1, 1, &buf) == n && n > 0);
+        assert(same_nodes(buf.items, buf.count, r, n));
+        free(r);
+        r = find_all_subsets(f, q2, 7, &n);
+        assert(find_all_subsets_into(f, q2, 7, &buf) == n && n > 0);
+        assert(same_nodes(buf.items, buf.count, r, n));
+        free(r);
+        r = find_containing_vertices(f, q1, 1, &n);
+        assert(find_containing_vertices_into(f, q1, 1, &buf) == n);
+        assert(same_nodes(buf.items, buf.count, r, n));
+        free(r);
+        r = find_by_weight_range(f, 200.0, 400.0, &n);
+        assert(find_by_weight_range_into(f, 200.0, 400.0, &buf) == n && n > 0);
+        assert(same_nodes(buf.items, buf.count, r, n));
+        free(r);
+        r = get_clusters_by_weight(f, 900.0, &n);
+        assert(get_clusters_by_weight_into(f, 900.0, &buf) == n);
+        assert(same_nodes(buf.items, buf.count, r, n));
+        free(r);
+        r = find_top_k(f, 25, &n);
+        assert(find_top_k_into(f, 25, &buf) == 25 && n == 25);
+        assert(same_nodes(buf.items, buf.count, r, n));
+        free(r);
+    }
+
+    // Steady state: once warmed, storage is reused rather than regrown
+    find_all_supersets_into(f, q1, 1, &buf);
+    Node **items = buf.items;
+    void *scratch = buf.scratch;
+    for (int i = 0; i < 100; i++) {
+        find_all_supersets_into(f, q1, 1, &buf);
+        find_by_weight_range_into(f, 200.0, 400.0, &buf);
+        find_top_k_into(f, 10, &buf);
+    }
+    assert(buf.items == items && buf.scratch == scratch);
+
+    // Streaming: every match is delivered; a non-zero return stops early
+    int n;
+    Node **r = find_all_supersets(f, q1, 1, &n);
+    free(r);
+    visit_count = 0;
+    assert(forest_visit_supersets(f, q1, 1, test_visitor, NULL) == n);
+    assert(visit_count == n);
+    visit_count = 0;
+    assert(forest_visit_weight_range(f, 0.0, 1000.0, early_stop_visitor, NULL) == 5);
+    assert(visit_count == 5);
+    visit_count = 0;
+    assert(forest_visit_subsets(f, q2, 7, early_stop_visitor, NULL) == 5);
+    node_buffer_free(&buf);
+    assert(buf.items == NULL && buf.count == 0);
+    forest_free(f);
+
+    // Wide walks keep their spilled stack in the buffer
+    Forest *wide = forest_create();
+    hif_vertex_t all[200];
+    for (int i = 0; i < 200; i++) {
+        all[i] = i;
+        insert_hyperedge(wide, &all[i], 1, 1.0);
+    }
+    insert_hyperedge(wide, all, 200, 1000.0);
+    assert(wide->nroots == 1);
+    node_buffer_init(&buf);
+    assert(find_by_weight_range_into(wide, 0.0, 1000.0, &buf) == 201);
+    scratch = buf.scratch;
+    assert(scratch != NULL);
+    assert(find_all_subsets_into(wide, all, 200, &buf) == 201);
+    assert(buf.scratch == scratch);
+    node_buffer_free(&buf);
+
+    // Folded duplicates normalize in the forest's reusable scratch
+    forest_set_dedup(wide, HIF_DEDUP_MAX);
+    hif_vertex_t rev[] = {2, 1, 2};
+    insert_hyperedge(wide, rev, 3, 1.0);
+    hif_vertex_t *norm = wide->scratch;
+    for (int i = 0; i < 100; i++) insert_hyperedge(wide, rev, 3, 1.0);
+    assert(wide->scratch == norm && count_total_nodes(wide) == 202);
+    forest_free(wide);
+    TEST_PASSED("caller-owned result buffers");
+}
+
+// ========== TEST 25: Sharded Forest ==========
+
+void test_sharded_forest() {
+    printf("\n=== TEST 39: Sharded Forest ===\n");
+    for (int policy = HIF_SHARD_RANGE; policy <= HIF_SHARD_HASH; policy++) {
+        Forest *whole = forest_create();
+        ShardedForest *sf = sharded_forest_create(4, (HifShardPolicy)policy, 10);
+        srand(39);
+        for (int i = 0; i < 600; i++) {
+            hif_vertex_t verts[6];
+            int n = 1 + rand() % 6;
+            for (int j = 0; j < n; j++) verts[j] = rand() % 48;
+            double w = (double)(rand() % 10000);
+            insert_hyperedge(whole, verts, n, w);
+            sharded_insert_hyperedge(sf, verts, n, w);
+            int s = sharded_shard_of(sf, verts, n);
+            assert(s >= 0 && s < 4);
+        }
+        assert(sharded_count_total_nodes(sf) == count_total_nodes(whole));
+        hif_vertex_t empty[] = {0};
+        assert(sharded_shard_of(sf, empty, 0) == -1);
+        if (policy == HIF_SHARD_RANGE) {
+            hif_vertex_t lo[] = {12, 3}, hi[] = {47, 99};
+            assert(sharded_shard_of(sf, lo, 2) == 0);
+            assert(sharded_shard_of(sf, hi, 2) == 3);
+        }
+
+        // k-way merge reproduces the single forest's weight order
+        int n1, n2;
+        Node **a = find_top_k(whole, 50, &n1);
+        Node **b = sharded_find_top_k(sf, 50, &n2);
+        assert(n1 == 50 && n2 == 50);
+        for (int i = 0; i < 50; i++) assert(a[i]->he.weight == b[i]->he.weight);
+        free(a);
+        free(b);
+        b = sharded_find_top_k(sf, 10000, &n2);
+        assert(n2 == count_total_nodes(whole));
+        free(b);
+
+        hif_vertex_t q[] = {15};
+        a = find_all_supersets(whole, q, 1, &n1);
+        b = sharded_find_all_supersets(sf, q, 1, &n2);
+        assert(n1 == n2 && n1 > 0);
+        for (int i = 0; i < n2; i++) {
+            int hits = 0;
+            for (int j = 0; j < b[i]->he.nverts; j++)
+                hits += b[i]->he.verts[j] == 15;
+            assert(hits == 1);
+        }
+        free(a);
+        free(b);
+
+        a = find_by_weight_range(whole, 2500.0, 5000.0, &n1);
+        b = sharded_find_by_weight_range(sf, 2500.0, 5000.0, &n2);
+        assert(n1 == n2 && n1 > 0);
+        for (int i = 0; i < n2; i++)
+            assert(b[i]->he.weight >= 2500.0 && b[i]->he.weight <= 5000.0);
+        free(a);
+        free(b);
+
+        // Every shard is an ordinary forest_save file
+        assert(sharded_forest_save(sf, "/tmp/test_shards") == 0);
+        Forest *s2 = forest_load("/tmp/test_shards.2");
+        assert(s2 && count_total_nodes(s2) == count_total_nodes(sf->shards[2]));
+        forest_free(s2);
+        ShardedForest *back = sharded_forest_load("/tmp/test_shards");
+        assert(back && back->nshards == 4 && back->policy == (HifShardPolicy)policy);
+        assert(sharded_count_total_nodes(back) == sharded_count_total_nodes(sf));
+        for (int i = 0; i < 4; i++) assert(verify_forest(back->shards[i]));
+        b = sharded_find_top_k(back, 5, &n2);
+        assert(n2 == 5 && b[0]->he.weight == forest_max_weight(whole));
+        free(b);
+        sharded_forest_free(back);
+
+        remove("/tmp/test_shards.1");
+        assert(sharded_forest_load("/tmp/test_shards") == NULL);
+        for (int i = 0; i < 4; i++) {
+            char name[64];
+            snprintf(name, sizeof(name), "/tmp/test_shards.%d", i);
+            remove(name);
+        }
+        remove("/tmp/test_shards");
+        sharded_forest_free(sf);
+        forest_free(whole);
+    }
+
+    // Spans as wide as the vertex type route and round-trip unclamped
+    hif_vertex_t span = HIF_VERTEX_MAX / 4 + 1;
+    ShardedForest *wide = sharded_forest_create(4, HIF_SHARD_RANGE, span);
+    hif_vertex_t mid[] = { (hif_vertex_t)(span * 2 + 5) }, top[] = { HIF_VERTEX_MAX };
+    assert(sharded_shard_of(wide, mid, 1) == 2 && sharded_shard_of(wide, top, 1) == 3);
+    sharded_insert_hyperedge(wide, mid, 1, 1.0);
+    assert(sharded_forest_save(wide, "/tmp/test_shards") == 0);
+    ShardedForest *back = sharded_forest_load("/tmp/test_shards");
+    assert(back && back->vertex_span == span && sharded_shard_of(back, mid, 1) == 2);
+    assert(back->shards[2]->nroots == 1);
+    sharded_forest_free(back);
+    for (int i = 0; i < 4; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "/tmp/test_shards.%d", i);
+        remove(name);
+    }
+    remove("/tmp/test_shards");
+    sharded_forest_free(wide);
+    TEST_PASSED("sharded forest");
+}
+
+// ========== TEST 26: Query Cache ==========
+
+void test_query_cache() {
+    printf("\n=== TEST 40: Superset Query Cache ===\n");
+    Forest *f = forest_create();
+    srand(40);
+    for (int i = 0; i < 400; i++) {
+        hif_vertex_t verts[6];
+        int n = 1 + rand() % 6;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 30;
+        insert_hyperedge(f, verts, n, (double)(rand() % 1000));
+    }
+    hif_vertex_t q[] = {4, 7};
+    Node *heavy = find_heaviest_superset(f, q, 2);
+    Node *minimal = find_minimal_superset(f, q, 2);
+    forest_enable_query_cache(f, 64);
+
+    // Cached answers match, and repeats are hits
+    for (int i = 0; i < 10; i++) {
+        assert(find_heaviest_superset(f, q, 2) == heavy);
+        assert(find_minimal_superset(f, q, 2) == minimal);
+    }
+    ForestMetrics m = forest_get_metrics(f);
+    assert(m.cache_misses == 2 && m.cache_hits == 18);
+
+    // A set missing a query vertex cannot change the answer
+    hif_vertex_t other[] = {4, 8, 9};
+    insert_hyperedge(f, other, 3, 5000.0);
+    assert(find_heaviest_superset(f, q, 2) == heavy);
+    assert(forest_get_metrics(f).cache_hits == 19);
+
+    // A heavier superset does
+    hif_vertex_t sup[] = {4, 7, 29};
+    insert_hyperedge(f, sup, 3, 6000.0);
+    Node *top = find_heaviest_superset(f, q, 2);
+    assert(top->he.weight == 6000.0 && forest_get_metrics(f).cache_misses == 3);
+    hif_vertex_t exact[] = {4, 7};
+    insert_hyperedge(f, exact, 2, 1.0);
+    assert(find_minimal_superset(f, q, 2)->he.nverts == 2);
+
+    // Deleting or reweighting the cached node invalidates it
+    assert(forest_delete_hyperedge(f, sup, 3) == 1);
+    Node *now = find_heaviest_superset(f, q, 2);
+    assert(now && now->he.weight < 6000.0);
+    assert(forest_update_weight(f, now->he.verts, now->he.nverts, 9000.0) >= 1);
+    assert(find_heaviest_superset(f, q, 2)->he.weight == 9000.0);
+
+    // Prune flushes the cache; the answer is recomputed
+    forest_prune_by_weight(f, 9500.0);
+    assert(find_heaviest_superset(f, q, 2) == NULL);
+    assert(find_minimal_superset(f, q, 2) == NULL);
+
+    // Unknown queries miss, uncached queries bypass
+    hif_vertex_t none[] = {1000};
+    m = forest_get_metrics(f);
+    assert(find_heaviest_superset(f, none, 1) == NULL);
+    assert(find_heaviest_superset(f, none, 1) == NULL);
+    assert(forest_get_metrics(f).cache_hits == m.cache_hits + 1);
+    forest_reset_metrics(f);
+    assert(forest_get_metrics(f).cache_hits == 0);
+    forest_disable_query_cache(f);
+    assert(forest_get_metrics(f).cache_misses == 0);
+
+    // Tiny cache: evictions never return a wrong answer
+    forest_enable_query_cache(f, 2);
+    forest_enable_vertex_index(f);  // exact answers despite weight-first stealing
+    for (int i = 0; i < 30; i++) insert_hyperedge(f, (hif_vertex_t[]){i, i + 1}, 2, 10000.0 + i);
+    for (int round = 0; round < 3; round++)
+        for (int v = 0; v < 30; v++) {
+            hif_vertex_t qv[] = {v};
+            Node *h = find_heaviest_superset(f, qv, 1);
+            assert(h && h->he.weight == 10000.0 + v);
+        }
+    forest_free(f);
+    TEST_PASSED("query cache");
+}
+
+// ========== TEST 27: Batched Queries ==========
+
+void test_batch_supersets() {
+    printf("\n=== TEST 41: Batched Superset Queries ===\n");
+    Forest *f = forest_create();
+    srand(41);
+    for (int i = 0; i < 800; i++) {
+        hif_vertex_t verts[8];
+        int n = 1 + rand() % 8;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 40;
+        insert_hyperedge(f, verts, n, (double)(rand() % 1000));
+    }
+
+    // Random sorted queries, an empty one, a repeat and one with no match
+    enum { NQ = 300 };
+    static hif_vertex_t qbuf[NQ][3];
+    Hyperedge qs[NQ];
+    for (int i = 0; i < NQ; i++) {
+        int n = 1 + rand() % 3;
+        for (int j = 0; j < n; j++) qbuf[i][j] = rand() % 40;
+        qs[i].nverts = sorted_unique(qbuf[i], n);
+        qs[i].verts  = qbuf[i];
+        qs[i].weight = 0.0;
+    }
+    qs[7].nverts = 0;
+    qs[8] = qs[9];
+    qbuf[10][0] = 1000;
+    qs[10].verts = qbuf[10];
+    qs[10].nverts = 1;
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) forest_enable_vertex_index(f);
+        NodeCSR csr;
+        int total = forest_batch_supersets(f, qs, NQ, &csr);
+        assert(csr.nqueries == NQ && csr.offsets[0] == 0 && csr.offsets[NQ] == total);
+        for (int i = 0; i < NQ; i++) {
+            int n;
+            Node **r = find_all_supersets(f, qs[i].verts, qs[i].nverts, &n);
+            assert(csr.offsets[i + 1] - csr.offsets[i] == n);
+            for (int j = 0; j < n; j++) assert(csr.nodes[csr.offsets[i] + j] == r[j]);
+            free(r);
+        }
+        assert(csr.offsets[8] - csr.offsets[7] == count_total_nodes(f));
+        assert(csr.offsets[11] == csr.offsets[10]);
+        node_csr_free(&csr);
+
+        assert(forest_batch_containing(f, qs, 5, &csr) == csr.offsets[5]);
+        node_csr_free(&csr);
+    }
+
+    NodeCSR none;
+    assert(forest_batch_supersets(f, qs, 0, &none) == 0 && none.offsets[0] == 0);
+    node_csr_free(&none);
+    assert(none.offsets == NULL && none.nodes == NULL);
+    forest_free(f);
+    TEST_PASSED("batched superset queries");
+}
+
+// ========== TEST 28: Snapshots ==========
+
+/* Order-sensitive hash of the whole tree shape, sets and weights */
+static unsigned long long digest_node(const Node *nd, unsigned long long h) {
+    h = h * 1099511628211ULL ^ (unsigned long long)(nd->he.weight * 1000.0);
+    for (int i = 0; i < nd->he.nverts; i++)
+        h = h * 1099511628211ULL ^ (unsigned)nd->he.verts[i];
+    h = h * 1099511628211ULL ^ (unsigned)nd->nchildren;
+    for (int i = 0; i < nd->nchildren; i++) h = digest_node(nd->children[i], h);
+    return h;
+}
+
+static unsigned long long forest_digest(Forest *f) {
+    unsigned long long h = 14695981039346656037ULL ^ (unsigned)f->nroots;
+    for (int i = 0; i < f->nroots; i++) h = digest_node(f->roots[i], h);
+    return h;
+}
+
+static void snapshot_churn(Forest *f, int rounds) {
+    for (int i = 0; i < rounds; i++) {
+        hif_vertex_t verts[5];
+        int n = 1 + rand() % 5;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 60;
+        n = sorted_unique(verts, n);
+        switch (rand() % 4) {
+        case 0:  forest_delete_hyperedge(f, verts, n); break;
+        case 1:  forest_update_weight(f, verts, n, (double)(rand() % 500)); break;
+        default: insert_hyperedge(f, verts, n, (double)(rand() % 500)); break;
+        }
+    }
+}
+
+void test_snapshots() {
+    printf("\n=== TEST 42: Copy-on-Write Snapshots ===\n");
+    for (int arena = 0; arena < 2; arena++) {
+        Forest *f = arena ? forest_create_with_arena(0) : forest_create();
+        forest_set_dedup(f, HIF_DEDUP_SUM);
+        forest_enable_vertex_index(f);
+        srand(42 + arena);
+        snapshot_churn(f, 1500);
+
+        int n1 = count_total_nodes(f);
+        unsigned long long d1 = forest_digest(f);
+        Forest *s1 = forest_snapshot(f);
+        assert(s1 && forest_snapshot_count(f) == 1);
+        assert(forest_digest(s1) == d1);
+        assert(forest_snapshot(s1) == NULL);
+        assert(forest_enable_concurrency(f, 2) == -1);
+
+        // Edits, duplicates and deletes leave s1 alone
+        snapshot_churn(f, 1500);
+        assert(forest_digest(s1) == d1 && count_total_nodes(s1) == n1);
+        assert(verify_forest(s1) && verify_forest(f));
+        check_forest_aggregates(s1);
+        check_forest_aggregates(f);
+        assert(forest_snapshot_retained(f) > 0);
+
+        // Mutators on a snapshot do nothing
+        hif_vertex_t q[] = {1, 2};
+        insert_hyperedge(s1, q, 2, 1e6);
+        assert(forest_delete_hyperedge(s1, q, 2) == 0);
+        forest_rebalance(s1);
+        assert(forest_prune_by_weight(s1, 1e9) == 0);
+        assert(forest_digest(s1) == d1);
+
+        // The index follows the copies: it agrees with a full scan of f
+        int ni, nall;
+        Node **by_index = find_all_supersets(f, q, 1, &ni);
+        Node **all = malloc(sizeof(Node*) * count_total_nodes(f)), **cursor = all;
+        forest_traverse_dfs(f, collect_visitor, &cursor);
+        nall = (int)(cursor - all);
+        int expect = 0;
+        for (int i = 0; i < nall; i++)
+            expect += bsearch(&q[0], all[i]->he.verts, all[i]->he.nverts,
+                              sizeof(hif_vertex_t), cmp_vertex) != NULL;
+        assert(ni == expect);
+        for (int i = 0; i < ni; i++) {
+            int found = 0;
+            for (int j = 0; j < nall && !found; j++) found = all[j] == by_index[i];
+            assert(found);
+        }
+        free(by_index);
+        free(all);
+
+        // Second snapshot, then whole-forest passes on f
+        unsigned long long d2 = forest_digest(f);
+        int n2 = count_total_nodes(f);
+        Forest *s2 = forest_snapshot(f);
+        assert(forest_snapshot_count(f) == 2);
+        forest_prune_by_weight(f, 100.0);
+        forest_merge_duplicates(f, 1);
+        forest_rebalance(f);
+        snapshot_churn(f, 500);
+        assert(verify_forest(f));
+        check_forest_aggregates(f);
+        assert(forest_digest(s1) == d1 && forest_digest(s2) == d2);
+        assert(count_total_nodes(s2) == n2);
+        check_forest_aggregates(s2);
+
+        // Queries on a snapshot answer for its version
+        int k, ks;
+        Node **top = find_top_k(s2, 10, &k);
+        for (int i = 1; i < k; i++) assert(top[i - 1]->he.weight >= top[i]->he.weight);
+        Node **sup = find_all_supersets(s1, q, 1, &ks);
+        for (int i = 0; i < ks; i++)
+            assert(bsearch(&q[0], sup[i]->he.verts, sup[i]->he.nverts, sizeof(hif_vertex_t), cmp_vertex));
+        free(top);
+        free(sup);
+
+        // A snapshot saves like any forest
+        assert(forest_save(s1, "/tmp/test_snapshot.bin") == 0);
+        Forest *loaded = forest_load("/tmp/test_snapshot.bin");
+        assert(loaded && count_total_nodes(loaded) == n1);
+        forest_free(loaded);
+        remove("/tmp/test_snapshot.bin");
+
+        // Releasing out of order frees what no snapshot still sees
+        size_t pinned = forest_snapshot_retained(f);
+        forest_free(s1);
+        assert(forest_snapshot_count(f) == 1 && forest_snapshot_retained(f) <= pinned);
+        assert(forest_digest(s2) == d2);
+        forest_free(s2);
+        assert(forest_snapshot_count(f) == 0 && forest_snapshot_retained(f) == 0);
+
+        // Without snapshots edits are in place again
+        snapshot_churn(f, 300);
+        assert(forest_snapshot_retained(f) == 0 && verify_forest(f));
+        check_forest_aggregates(f);
+        printf("%s: %d nodes at v1, %d at v2, %zu retained across both\n",
+               arena ? "arena" : "malloc", n1, n2, pinned);
+        forest_free(f);
+    }
+    TEST_PASSED("copy-on-write snapshots");
+}
+
+// ========== TEST 29: Bounded Insertion ==========
+
+static void same_superset_answers(Forest *a, Forest *b) {
+    for (int v = 0; v < 80; v++) {
+        hif_vertex_t q[2] = { v, v + 1 + v % 7 };
+        int na, nb;
+        Node **ra = find_all_supersets(a, q, 1 + v % 2, &na);
+        Node **rb = find_all_supersets(b, q, 1 + v % 2, &nb);
+        assert(na == nb);
+        double wa = 0, wb = 0;
+        for (int i = 0; i < na; i++) { wa += ra[i]->he.weight; wb += rb[i]->he.weight; }
+        assert(wa == wb);
+        free(ra);
+        free(rb);
+    }
+}
+
+void test_bounded_insert() {
+    printf("\n=== TEST 43: Bounded Insertion ===\n");
+    for (int indexed = 0; indexed < 2; indexed++) {
+        Forest *exact = forest_create(), *fast = forest_create();
+        forest_enable_vertex_index(exact);
+        if (indexed) forest_enable_vertex_index(fast);
+        forest_set_insert_bounds(fast, 3, 4);
+        srand(43);
+        for (int i = 0; i < 3000; i++) {
+            hif_vertex_t verts[6];
+            int n = 1 + rand() % 6;
+            for (int j = 0; j < n; j++) verts[j] = rand() % 90;
+            double w = (double)(rand() % 1000);
+            insert_hyperedge(exact, verts, n, w);
+            insert_hyperedge(fast, verts, n, w);
+            if (i % 10 == 9) {   // deletes hit queued nodes too
+                n = sorted_unique(verts, n);
+                assert(forest_delete_hyperedge(exact, verts, n) ==
+                       forest_delete_hyperedge(fast, verts, n));
+            }
+        }
+        int total = count_total_nodes(exact);
+        assert(count_total_nodes(fast) == total);
+        assert(verify_forest(fast));
+        check_forest_aggregates(fast);
+        int pending = forest_rebalance_step(fast, 0);
+        assert(pending > 0 && pending <= total);
+        printf("%s: %d roots bounded vs %d exact, %d queued\n",
+               indexed ? "indexed" : "signature", fast->nroots, exact->nroots, pending);
+
+        if (!indexed) forest_enable_vertex_index(fast);
+        same_superset_answers(exact, fast);
+        int ka, kb;
+        Node **ta = find_top_k(exact, 50, &ka), **tb = find_top_k(fast, 50, &kb);
+        assert(ka == kb);
+        for (int i = 0; i < ka; i++) assert(ta[i]->he.weight == tb[i]->he.weight);
+        free(ta);
+        free(tb);
+
+        // Incremental exact placement, interleaved with a snapshot
+        Forest *snap = forest_snapshot(fast);
+        unsigned long long d = forest_digest(snap);
+        int steps = 0;
+        while (forest_rebalance_step(fast, 200) > 0) steps++;
+        assert(steps >= pending / 200 - 1 && forest_rebalance_step(fast, 0) == 0);
+        assert(forest_digest(snap) == d);
+        forest_free(snap);
+        assert(count_total_nodes(fast) == total && verify_forest(fast));
+        check_forest_aggregates(fast);
+        same_superset_answers(exact, fast);
+
+        // Back to exact inserts; a full rebalance clears the queue
+        forest_set_insert_bounds(fast, 0, 0);
+        hif_vertex_t extra[] = {500, 501};
+        insert_hyperedge(fast, extra, 2, 1.0);
+        assert(forest_rebalance_step(fast, 0) == 0);
+        forest_set_insert_bounds(fast, 1, 1);
+        insert_hyperedge(fast, extra, 2, 2.0);
+        assert(forest_rebalance_step(fast, 0) == 1);
+        forest_rebalance(fast);
+        assert(forest_rebalance_step(fast, 0) == 0 && verify_forest(fast));
+        forest_free(exact);
+        forest_free(fast);
+    }
+    TEST_PASSED("bounded insertion");
+}
+
+// ========== TEST 30: Incremental Maintenance ==========
+
+void test_incremental_maintenance() {
+    printf("\n=== TEST 44: Incremental Maintenance ===\n");
+    Forest *f = forest_create(), *ref = forest_create();
+    forest_enable_vertex_index(f);
+    forest_enable_vertex_index(ref);
+    srand(44);
+    for (int i = 0; i < 2500; i++) {
+        hif_vertex_t verts[5];
+        int n = 1 + rand() % 5;
+        for (int j = 0; j < n; j++) verts[j] = rand() % 70;
+        double w = (double)(rand() % 1000);
+        if (i == 1500) forest_set_insert_bounds(f, 2, 3);   // leave some queued
+        insert_hyperedge(f, verts, n, w);
+        insert_hyperedge(ref, verts, n, w);
+    }
+    int merged = forest_merge_duplicates(ref, 1);
+    assert(merged > 0);
+    forest_set_insert_bounds(f, 0, 0);
+
+    // Time-limited call still makes progress
+    assert(forest_maintain_step(f, HIF_MAINT_REBALANCE, INT_MAX, 1e-6) >= 1);
+
+    // A snapshot pins its version; repack waits until it is gone
+    Forest *snap = forest_snapshot(f);
+    unsigned long long d = forest_digest(snap);
+    assert(forest_maintain_step(f, HIF_MAINT_ALL, 50, 0) == 50);
+    assert(forest_digest(snap) == d && verify_forest(f));
+    forest_free(snap);
+
+    int rounds = 0;
+    while (count_total_nodes(f) != count_total_nodes(ref) && rounds < 20) {
+        int roots = f->nroots;
+        assert(forest_maintain_step(f, HIF_MAINT_ALL, roots, 0) == roots);
+        rounds++;
+    }
+    assert(count_total_nodes(f) == count_total_nodes(ref));
+    assert(forest_rebalance_step(f, 0) == 0);
+    assert(verify_forest(f));
+    check_forest_aggregates(f);
+    same_superset_answers(ref, f);
+    printf("%d duplicates merged in %d rounds, %d roots\n", merged, rounds, f->nroots);
+
+    // Index, set table and query results survive the moves
+    hif_vertex_t q[] = {3};
+    Node **all = malloc(sizeof(Node*) * count_total_nodes(f)), **cursor = all;
+    forest_traverse_dfs(f, collect_visitor, &cursor);
+    int nall = (int)(cursor - all), expect = 0, got;
+    for (int i = 0; i < nall; i++)
+        expect += bsearch(&q[0], all[i]->he.verts, all[i]->he.nverts, sizeof(hif_vertex_t), cmp_vertex) != NULL;
+    free(find_all_supersets(f, q, 1, &got));
+    assert(got == expect);
+    Node *victim = all[nall / 2];
+    hif_vertex_t vset[5];
+    int nv = victim->he.nverts;
+    memcpy(vset, victim->he.verts, sizeof(hif_vertex_t) * nv);
+    free(all);
+    assert(forest_delete_hyperedge(f, vset, nv) == 1);
+    assert(verify_forest(f));
+
+    // Background thread, other writer holding the shared lock
+    forest_enable_concurrency(f, 2);
+    HifMaintainer *m = forest_maintainer_start(f, HIF_MAINT_ALL, 8, 0.2);
+    assert(m);
+    for (int i = 0; i < 1500; i++) {
+        hif_vertex_t verts[3] = { rand() % 70, 70 + rand() % 30, 100 + rand() % 30 };
+        forest_maintainer_lock(m);
+        insert_hyperedge(f, verts, 3, (double)(rand() % 1000));
+        insert_hyperedge(f, verts, 3, 1.0);
+        forest_maintainer_unlock(m);
+    }
+    forest_maintainer_stop(m);
+    assert(forest_maintain_step(f, HIF_MAINT_DEDUP, f->nroots, 0) > 0);
+    assert(forest_merge_duplicates(f, 1) == 0);
+    assert(verify_forest(f));
+    check_forest_aggregates(f);
+    forest_free(f);
+    forest_free(ref);
+    TEST_PASSED("incremental maintenance");
+}
+
+// ========== TEST 31: Vertex and Weight Types ==========
+
+// Sorted, duplicate-free, non-empty random set drawn from [base, base + range)
+static int random_vertex_set(hif_vertex_t *out, int n, hif_vertex_t base, int range) {
+    int c = 0;
+    for (int v = 0; v < range && c < n; v++)
+        if (rand() % range < n * 2) out[c++] = (hif_vertex_t)(base + (hif_vertex_t)v);
+    if (c == 0) out[c++] = base;
+    return c;
+}
+
+static int vertex_subset(const hif_vertex_t *a, int na, const hif_vertex_t *b, int nb) {
+    for (int i = 0, j = 0; i < na; i++, j++) {
+        while (j < nb && b[j] < a[i]) j++;
+        if (j == nb || b[j] != a[i]) return 0;
+    }
+    return 1;
+}
+
+void test_element_types() {
+    printf("\n=== TEST 45: Vertex and Weight Types ===\n");
+#ifdef HIF_VERTEX_BITS
+    assert(sizeof(hif_vertex_t) * 8 == HIF_VERTEX_BITS && (hif_vertex_t)-1 > 0);
+#else
+    assert(sizeof(hif_vertex_t) == sizeof(int) && (hif_vertex_t)-1 < 0);
+#endif
+#ifndef HIF_WEIGHT_FLOAT
+    assert(sizeof(hif_weight_t) == sizeof(double));
+#endif
+    printf("%zu-byte vertices, %zu-byte weights\n", sizeof(hif_vertex_t), sizeof(hif_weight_t));
+
+    // Sets at the top of the ID range, plus both extremes
+    static hif_vertex_t sets[300][48];
+    int nsets[300];
+    const hif_vertex_t base = HIF_VERTEX_MAX - 2047;
+    hif_vertex_t ends[] = { HIF_VERTEX_MIN, base, HIF_VERTEX_MAX };
+    srand(45);
+    Forest *f = forest_create();
+    forest_enable_vertex_index(f);   // exact superset answers
+    for (int i = 0; i < 300; i++) {
+        nsets[i] = random_vertex_set(sets[i], 1 + rand() % 48,
+                                     (hif_vertex_t)(base + (hif_vertex_t)(rand() % 1024)), 1024);
+        insert_hyperedge(f, sets[i], nsets[i], (double)(rand() % 100) + 0.5);
+    }
+    insert_hyperedge(f, ends, 3, 1000.1);
+    Node *top = find_heaviest_superset(f, ends, 3);
+    assert(top && top->he.nverts == 3 && top->he.weight == (hif_weight_t)1000.1);
+    assert(forest_max_weight(f) == (hif_weight_t)1000.1);
+
+    // Every kernel this build has agrees with a brute-force scan
+    static hif_vertex_t qv[100][48];
+    int nq[100], expect[100];
+    for (int q = 0; q < 100; q++) {
+        nq[q] = 0;
+        for (int j = 0; j < nsets[q]; j += 1 + q % 3) qv[q][nq[q]++] = sets[q][j];
+        expect[q] = vertex_subset(qv[q], nq[q], ends, 3);
+        for (int i = 0; i < 300; i++)
+            expect[q] += vertex_subset(qv[q], nq[q], sets[i], nsets[i]);
+    }
+    static const HifSetKernel kernels[] = {
+        HIF_KERNEL_SCALAR, HIF_KERNEL_SSE42, HIF_KERNEL_AVX2,
+        HIF_KERNEL_AVX512, HIF_KERNEL_NEON
+    };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (hif_set_kernel(kernels[k]) != 0) continue;
+        for (int q = 0; q < 100; q++) {
+            int cnt;
+            free(find_all_supersets(f, qv[q], nq[q], &cnt));
+            assert(cnt == expect[q]);
+        }
+        printf("%-7s agrees on 100 queries\n", hif_set_kernel_name());
+    }
+    assert(hif_set_kernel(HIF_KERNEL_AUTO) == 0);
+
+    // Codec round trip at the range ends
+    uint8_t enc[48 * 10];
+    hif_vertex_t dec[48];
+    for (int i = 0; i <= 300; i++) {
+        const hif_vertex_t *s = i < 300 ? sets[i] : ends;
+        int n = i < 300 ? nsets[i] : 3;
+        size_t bytes = hif_vbyte_encode(s, n, enc);
+        assert(bytes <= hif_vbyte_bound(n));
+        assert(hif_vbyte_decode(enc, n, dec) == bytes);
+        assert(memcmp(dec, s, sizeof(hif_vertex_t) * n) == 0);
+        assert(hif_vbyte_contains(enc, n, s + n / 2, n - n / 2));
+    }
+
+    // forest_save round-trips; a flat image records its element types
+    assert(forest_save(f, "/tmp/test_types.bin") == 0);
+    Forest *g = forest_load("/tmp/test_types.bin");
+    assert(g != NULL);
+    FlatForest *a = forest_freeze(f), *b = forest_freeze(g);
+    assert(a->image_size == b->image_size &&
+           memcmp(a->image, b->image, a->image_size) == 0);
+    assert(((const FlatHeader *)a->image)->elem_types == HIF_FLAT_ELEM_TYPES);
+    flat_forest_close(b);
+    forest_free(g);
+    FlatForest *c = forest_freeze_compressed(f);
+    assert(c && flat_forest_verify(c) && flat_forest_verify(a));
+    for (uint32_t id = 0; id < a->nnodes; id++) {
+        int n;
+        const hif_vertex_t *v = flat_node_verts(a, id, &n);
+        assert(flat_node_decode(c, id, dec) == n);
+        assert(memcmp(v, dec, sizeof(hif_vertex_t) * n) == 0);
+        assert(a->weights[id] == c->weights[id]);
+    }
+    flat_forest_close(c);
+
+    assert(flat_forest_save(a, "/tmp/test_types.bin") == 0);
+    FlatForest *m = flat_forest_open("/tmp/test_types.bin");
+    assert(m && m->nnodes == a->nnodes);
+    flat_forest_close(m);
+    FILE *fp = fopen("/tmp/test_types.bin", "r+b");
+    uint32_t other = HIF_FLAT_ELEM_TYPES ^ 0x0808u;   // a different build's types
+    fseek(fp, (long)offsetof(FlatHeader, elem_types), SEEK_SET);
+    fwrite(&other, sizeof(other), 1, fp);
+    fclose(fp);
+    assert(flat_forest_open("/tmp/test_types.bin") == NULL);
+    remove("/tmp/test_types.bin");
+    flat_forest_close(a);
+    forest_free(f);
+    TEST_PASSED("vertex and weight types");
+}
+
+// ========== TEST 32: Top-K Containing ==========
+
+typedef struct {
+    const hif_vertex_t *q;
+    int     nq;
+    double *w;
+    int     n;
+} ContainRef;
+
+static int contain_visitor(Node *nd, void *ud) {
+    ContainRef *r = ud;
+    if (vertex_subset(r->q, r->nq, nd->he.verts, nd->he.nverts)) r->w[r->n++] = nd->he.weight;
+    return 0;
+}
+
+// Result must be the k heaviest supersets of q, heaviest first
+static void check_top_containing(Forest *f, const hif_vertex_t *q, int nq, int k, NodeBuffer *buf) {
+    static double w[4096];
+    ContainRef r = { q, nq, w, 0 };
+    forest_traverse_dfs(f, contain_visitor, &r);
+    qsort(w, r.n, sizeof(double), cmp_double_desc);
+    int want = r.n < k ? r.n : k;
+
+    int cnt;
+    Node **res = find_top_k_containing(f, q, nq, k, &cnt);
+    assert(cnt == want);
+    for (int i = 0; i < cnt; i++) {
+        assert(vertex_subset(q, nq, res[i]->he.verts, res[i]->he.nverts));
+        assert(res[i]->he.weight == w[i]);
+    }
+    assert(find_top_k_containing_into(f, q, nq, k, buf) == cnt);
+    assert(memcmp(buf->items, res, sizeof(Node*) * cnt) == 0);
+    free(res);
+}
+
+void test_top_k_containing() {
+    printf("\n=== TEST 46: Top-K Containing ===\n");
+    srand(46);
+    Forest *f = forest_create();
+    hif_vertex_t v[12];
+    for (int i = 0; i < 3000; i++) {
+        int n = 1 + rand() % 12;
+        for (int j = 0; j < n; j++) v[j] = (hif_vertex_t)(rand() % 150);
+        if (i % 10 == 0) v[0] = 500;   // a common vertex
+        if (i % 300 == 0) v[0] = 900;  // a rare one
+        insert_hyperedge(f, v, n, (double)(rand() % 2000) / 10.0);
+    }
+
+    NodeBuffer buf;
+    node_buffer_init(&buf);
+    hif_vertex_t common[] = { 500 }, rare[] = { 900 }, absent[] = { 777 };
+    hif_vertex_t pair[2] = { 3, 500 };
+    for (int pass = 0; pass < 2; pass++) {
+        // pass 0 walks in weight order; pass 1 also uses posting lists
+        if (pass) forest_enable_vertex_index(f);
+        static const int ks[] = { 1, 5, 50, 5000 };
+        for (int i = 0; i < 4; i++) {
+            check_top_containing(f, common, 1, ks[i], &buf);
+            check_top_containing(f, rare, 1, ks[i], &buf);
+            check_top_containing(f, pair, 2, ks[i], &buf);
+            check_top_containing(f, absent, 1, ks[i], &buf);
+        }
+        for (hif_vertex_t x = 0; x < 150; x += 7) {
+            hif_vertex_t q[2] = { x, (hif_vertex_t)(x + 1) };
+            check_top_containing(f, q, 1, 10, &buf);
+            check_top_containing(f, q, 2, 10, &buf);
+        }
+    }
+
+    // No query vertices: the same weights as find_top_k
+    int n1, n2;
+    Node **all = find_top_k(f, 20, &n1);
+    Node **any = find_top_k_containing(f, NULL, 0, 20, &n2);
+    assert(n1 == 20 && n2 == 20);
+    for (int i = 0; i < 20; i++) assert(all[i]->he.weight == any[i]->he.weight);
+    free(all);
+    free(any);
+    assert(find_top_k_containing_into(f, common, 1, 0, &buf) == 0);
+
+    // Posting lists and the costed choice stay right across deletes and reweights
+    for (int i = 0; i < 200; i++) {
+        Node **hit = find_top_k_containing(f, common, 1, 1, &n1);
+        if (n1 == 0) break;
+        int n = hit[0]->he.nverts;
+        double w = hit[0]->he.weight;
+        memcpy(v, hit[0]->he.verts, sizeof(hif_vertex_t) * n);
+        free(hit);
+        if (i % 2) assert(forest_update_weight(f, v, n, w / 4.0) > 0);
+        else       assert(forest_delete_hyperedge(f, v, n) > 0);
+    }
+    assert(verify_forest(f));
+    check_top_containing(f, common, 1, 25, &buf);
+    check_top_containing(f, rare, 1, 3, &buf);
+    forest_disable_vertex_index(f);
+    check_top_containing(f, common, 1, 25, &buf);
+    node_buffer_free(&buf);
+    forest_free(f);
+    TEST_PASSED("top-k containing");
+}
+
 // ========== MAIN ==========
 
 int main(void) {
@@ -455,30 +2864,115 @@ int main(void) {
     // Batch Operations
     test_batch_insert();
     test_bulk_build();
+    test_bulk_build_parallel();
     
     // Serialization
     test_serialization();
+    test_flat_mmap_format();
+    test_frozen_snapshot();
+    test_compressed_vertex_sets();
     
     // Iteration
     test_traverse_bfs();
     test_traverse_dfs();
     test_traverse_by_weight();
     test_early_stop();
+    test_weight_iterator();
+    test_deep_chain();
     
     // Performance
     test_top_k_performance();
     
+    // Vertex Index
+    test_vertex_index_queries();
+    
+    // Memory
+    test_arena_forest();
+    
+    // Streaming ingest
+    test_streaming_ingest();
+    
+    // Instrumentation
+    test_metrics();
+    test_subtree_aggregates();
+    
+    // Order statistics
+    test_order_statistics();
+    
+    // Caller-owned results
+    test_result_buffers();
+    
+    // Sharding
+    test_sharded_forest();
+    
+    // Query cache
+    test_query_cache();
+    
+    // Batched queries
+    test_batch_supersets();
+    
+    // Snapshots
+    test_snapshots();
+    
+    // Bounded insertion
+    test_bounded_insert();
+    
+    // Incremental maintenance
+    test_incremental_maintenance();
+    
+    // Element types
+    test_element_types();
+    
+    // Top-k containing
+    test_top_k_containing();
+    
+    // Concurrency
+    test_concurrent_readers();
+    test_parallel_queries();
+    
+    // Set Kernels & Signatures
+    test_set_kernels();
+    test_signature_pruning();
+    
+    // Similarity
+    test_streaming_similarity();
+    
+    // Root management & updates
+    test_indexed_root_heap();
+    test_delete_update();
+    test_dedup_policies();
+    
     printf("\n╔══════════════════════════════════════════════════════╗\n");
-    printf("║            ALL 17 TESTS PASSED ✓✓✓                  ║\n");
+    printf("║            ALL 46 TESTS PASSED ✓✓✓                  ║\n");
     printf("╚══════════════════════════════════════════════════════╝\n\n");
     
     printf("Summary of tested features:\n");
     printf("✓ Advanced query operations (5 tests)\n");
     printf("✓ Optimization & maintenance (4 tests)\n");
-    printf("✓ Batch operations (2 tests)\n");
-    printf("✓ Serialization (1 test)\n");
-    printf("✓ Traversal & iteration (4 tests)\n");
-    printf("✓ Top-K performance (1 test)\n\n");
+    printf("✓ Batch operations (3 tests)\n");
+    printf("✓ Serialization & snapshots (4 tests)\n");
+    printf("✓ Traversal & iteration (6 tests)\n");
+    printf("✓ Top-K performance (1 test)\n");
+    printf("✓ Vertex index (1 test)\n");
+    printf("✓ Arena allocation (1 test)\n");
+    printf("✓ Concurrency & parallel queries (2 tests)\n");
+    printf("✓ Set kernels & signatures (2 tests)\n");
+    printf("✓ Streaming similarity (1 test)\n");
+    printf("✓ Indexed root heap (1 test)\n");
+    printf("✓ Deletion & weight update (1 test)\n");
+    printf("✓ Insert-time dedup (1 test)\n");
+    printf("✓ Streaming ingest (1 test)\n");
+    printf("✓ Hot-path metrics & aggregates (2 tests)\n");
+    printf("✓ Range counts & rank queries (1 test)\n");
+    printf("✓ Caller-owned result buffers (1 test)\n");
+    printf("✓ Sharded forest (1 test)\n");
+    printf("✓ Query cache (1 test)\n");
+    printf("✓ Batched queries (1 test)\n");
+    printf("✓ Snapshots (1 test)\n");
+    printf("✓ Bounded insertion (1 test)\n");
+    printf("✓ Incremental maintenance (1 test)\n");
+    printf("✓ Vertex and weight types (1 test)\n");
+    printf("✓ Top-k containing (1 test)\n\n");
     
     return 0;
 }